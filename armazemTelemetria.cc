@@ -0,0 +1,777 @@
+// Copyright [2016] <Dúnia Marchiori(14200724) e Vinicius Steffani Schweitzer(14200768)>
+
+// Armazém colunar, para o computador, da telemetria gravada pelo coletorTelemetria.
+// Os registros brutos são compactados em um arquivo por mês (AAAA-MM.col), com um bloco por soquete:
+// tempos com delta-do-delta e consumos com XOR de floats (como o Gorilla), cada campo em sua coluna.
+// O índice de cada arquivo guarda os totais de cada bloco, então o relatório mensal só lê o índice.
+// Compilação: g++ -O2 -o armazemTelemetria armazemTelemetria.cc
+// Uso: armazemTelemetria compactar tomadas.tel diretorio
+//      armazemTelemetria mensal diretorio AAAA-MM
+//      armazemTelemetria serie diretorio REMETENTE SOQUETE AAAA-MM-DD AAAA-MM-DD
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#define VERSAO_ARQUIVO_TELEMETRIA 1 /*!< Versão do arquivo do coletorTelemetria aceita. */
+#define VERSAO_ARQUIVO_COLUNAR 2 /*!< Versão do formato colunar. A versão 2 acrescentou o grupo de orçamento ao índice. */
+#define INICIO_2016 1451606400LL /*!< 01/01/2016 em segundos desde 01/01/1970. Origem do tempo das tomadas. */
+#define BYTES_ENDERECO 2 /*!< Bytes do endereço NIC da EPOSMoteIII. */
+
+#define COLUNA_TEMPO 0 /*!< Coluna dos tempos, em segundos desde 01/01/1970 (delta-do-delta). */
+#define COLUNA_ULTIMO_CONSUMO 1 /*!< Coluna do consumo de cada período (XOR de floats). */
+#define COLUNA_CONSUMO_PREVISTO 2 /*!< Coluna do consumo previsto até o fim do mês (XOR de floats). */
+#define COLUNA_PRIORIDADE 3 /*!< Coluna da prioridade (um bit quando não muda). */
+#define NUMERO_COLUNAS 4 /*!< Quantidade de colunas de cada bloco. */
+
+//!  Struct Registro
+/*!
+	Registro bruto do arquivo do coletorTelemetria (o mesmo formato).
+*/
+struct Registro {
+	int64_t chegada; /*!< Tempo do computador (microssegundos desde 01/01/1970) na chegada do quadro. */
+	int64_t tempo; /*!< Tempo do gateway (microssegundos desde 01/01/2016). */
+	uint32_t remetente; /*!< Endereço da placa, com o primeiro byte nos bits menos significativos. */
+	uint32_t epoca; /*!< Época em que os dados foram enviados. */
+	float consumoPrevisto; /*!< Consumo previsto do soquete até o fim do mês. */
+	float ultimoConsumo; /*!< Consumo do soquete desde a última sincronização. */
+	float consumoMensal; /*!< Consumo do sistema no mês, segundo o remetente. */
+	float maximoConsumoMensal; /*!< Consumo máximo mensal configurado no remetente. */
+	int8_t soquete; /*!< Soquete da placa. */
+	int8_t prioridade; /*!< Prioridade do soquete. */
+	uint8_t indicadores; /*!< 1: pode desligar, 2: tem dimmer, 4: dados do próprio gateway. */
+	uint8_t grupo; /*!< Grupo de orçamento da placa. */
+	uint8_t reservado[4]; /*!< Completa o registro em 48 bytes. */
+};
+
+//!  Struct CabecalhoTelemetria
+/*!
+	Início do arquivo do coletorTelemetria.
+*/
+struct CabecalhoTelemetria {
+	char assinatura[8]; /*!< "TOMADAS\0". */
+	uint32_t versao; /*!< VERSAO_ARQUIVO_TELEMETRIA. */
+	uint32_t tamanhoRegistro; /*!< sizeof(Registro). */
+	uint64_t quantidade; /*!< Quantidade de registros gravados. */
+};
+
+//!  Struct CabecalhoColunar
+/*!
+	Início de um arquivo mensal. As colunas dos blocos vêm em seguida e o índice (quantidadeBlocos Blocos) fica no fim.
+*/
+struct CabecalhoColunar {
+	char assinatura[8]; /*!< "TOMCOL\0\0". */
+	uint32_t versao; /*!< VERSAO_ARQUIVO_COLUNAR. */
+	uint32_t quantidadeBlocos; /*!< Quantidade de blocos (soquetes) no mês. */
+	uint64_t inicioIndice; /*!< Posição do índice no arquivo. */
+};
+
+//!  Struct Bloco
+/*!
+	Entrada do índice: as amostras de um soquete em um mês, com os totais usados no relatório mensal.
+	O índice é ordenado por remetente e soquete.
+*/
+struct Bloco {
+	uint32_t remetente; /*!< Endereço da placa. */
+	int32_t soquete; /*!< Soquete da placa. */
+	uint32_t quantidade; /*!< Quantidade de amostras. */
+	int32_t prioridadeFinal; /*!< Prioridade na última amostra. */
+	int32_t grupoFinal; /*!< Grupo de orçamento na última amostra. */
+	uint32_t reservado; /*!< Alinha os campos seguintes. */
+	int64_t tempoInicial; /*!< Tempo da primeira amostra (segundos desde 01/01/1970). */
+	int64_t tempoFinal; /*!< Tempo da última amostra. */
+	double somaUltimoConsumo; /*!< Consumo do soquete no mês (soma dos consumos de cada período). */
+	float previstoFinal; /*!< Consumo previsto até o fim do mês na última amostra. */
+	float maiorUltimoConsumo; /*!< Maior consumo de um período. */
+	uint64_t inicio[NUMERO_COLUNAS]; /*!< Posição de cada coluna no arquivo. */
+	uint32_t tamanho[NUMERO_COLUNAS]; /*!< Bytes de cada coluna. */
+};
+
+//!  Struct Amostra
+/*!
+	Uma amostra de um soquete, já sem duplicatas.
+*/
+struct Amostra {
+	int64_t tempo; /*!< Segundos desde 01/01/1970. */
+	float ultimoConsumo; /*!< Consumo do período. */
+	float consumoPrevisto; /*!< Consumo previsto até o fim do mês. */
+	int prioridade; /*!< Prioridade. */
+	int grupo; /*!< Grupo de orçamento. */
+};
+
+//!  Classe EscritorDeBits
+/*!
+	Sequência de bits gravada do bit mais significativo para o menos significativo de cada byte.
+*/
+class EscritorDeBits {
+	private:
+		std::vector<unsigned char> bytes; /*!< Bytes gravados. */
+		int livres; /*!< Bits livres no último byte. */
+
+	public:
+		EscritorDeBits() {
+			livres = 0;
+		}
+
+		/*!
+			Método que grava os quantidade bits menos significativos de valor.
+		*/
+		void escrever(uint64_t valor, int quantidade) {
+			while (quantidade > 0) {
+				if (livres == 0) {
+					bytes.push_back(0);
+					livres = 8;
+				}
+				int agora = std::min(livres, quantidade);
+				unsigned int parte = (unsigned int) ((valor >> (quantidade - agora)) & ((1u << agora) - 1));
+				bytes.back() |= (unsigned char) (parte << (livres - agora));
+				livres -= agora;
+				quantidade -= agora;
+			}
+		}
+
+		const std::vector<unsigned char>& getBytes() const {
+			return bytes;
+		}
+};
+
+//!  Classe LeitorDeBits
+/*!
+	Leitura de uma sequência gravada pelo EscritorDeBits.
+*/
+class LeitorDeBits {
+	private:
+		const unsigned char* bytes; /*!< Início da sequência. */
+		uint64_t posicao; /*!< Próximo bit a ler. */
+
+	public:
+		explicit LeitorDeBits(const unsigned char* b) {
+			bytes = b;
+			posicao = 0;
+		}
+
+		/*!
+			Método que lê quantidade bits.
+		*/
+		uint64_t ler(int quantidade) {
+			uint64_t valor = 0;
+			for (int i = 0; i < quantidade; i++) {
+				valor = (valor << 1) | ((bytes[posicao >> 3] >> (7 - (posicao & 7))) & 1);
+				posicao++;
+			}
+			return valor;
+		}
+};
+
+//!  Classe CodificadorDeTempo
+/*!
+	Tempos com delta-do-delta: com amostras a cada 20 minutos, quase todas ocupam um bit.
+*/
+class CodificadorDeTempo {
+	private:
+		int64_t anterior; /*!< Último tempo. */
+		int64_t deltaAnterior; /*!< Última diferença. */
+		bool primeiro; /*!< Indica que nenhum tempo foi gravado. */
+
+	public:
+		CodificadorDeTempo() {
+			anterior = 0;
+			deltaAnterior = 0;
+			primeiro = true;
+		}
+
+		void escrever(EscritorDeBits* saida, int64_t tempo) {
+			if (primeiro) {
+				saida->escrever((uint64_t) tempo, 64);
+				primeiro = false;
+			} else {
+				int64_t delta = tempo - anterior;
+				int64_t dd = delta - deltaAnterior;
+				if (dd == 0) {
+					saida->escrever(0, 1);
+				} else if ((dd >= -63) && (dd <= 64)) {
+					saida->escrever(2, 2);
+					saida->escrever((uint64_t) (dd + 63), 7);
+				} else if ((dd >= -255) && (dd <= 256)) {
+					saida->escrever(6, 3);
+					saida->escrever((uint64_t) (dd + 255), 9);
+				} else if ((dd >= -2047) && (dd <= 2048)) {
+					saida->escrever(14, 4);
+					saida->escrever((uint64_t) (dd + 2047), 12);
+				} else {
+					saida->escrever(15, 4);
+					saida->escrever((uint64_t) dd, 64);
+				}
+				deltaAnterior = delta;
+			}
+			anterior = tempo;
+		}
+
+		int64_t ler(LeitorDeBits* entrada) {
+			if (primeiro) {
+				primeiro = false;
+				anterior = (int64_t) entrada->ler(64);
+				return anterior;
+			}
+			int64_t dd;
+			if (entrada->ler(1) == 0) {
+				dd = 0;
+			} else if (entrada->ler(1) == 0) {
+				dd = (int64_t) entrada->ler(7) - 63;
+			} else if (entrada->ler(1) == 0) {
+				dd = (int64_t) entrada->ler(9) - 255;
+			} else if (entrada->ler(1) == 0) {
+				dd = (int64_t) entrada->ler(12) - 2047;
+			} else {
+				dd = (int64_t) entrada->ler(64);
+			}
+			deltaAnterior += dd;
+			anterior += deltaAnterior;
+			return anterior;
+		}
+};
+
+//!  Classe CodificadorDeReal
+/*!
+	Floats com XOR do valor anterior: valores repetidos ocupam um bit e valores próximos só os bits significativos do XOR.
+*/
+class CodificadorDeReal {
+	private:
+		uint32_t anterior; /*!< Bits do último valor. */
+		int zerosEsquerda; /*!< Zeros à esquerda da janela atual. */
+		int zerosDireita; /*!< Zeros à direita da janela atual. */
+		bool primeiro; /*!< Indica que nenhum valor foi gravado. */
+
+		static int contarEsquerda(uint32_t x) {
+			int n = 0;
+			while ((n < 32) && !(x & (0x80000000u >> n))) {
+				n++;
+			}
+			return n;
+		}
+
+		static int contarDireita(uint32_t x) {
+			int n = 0;
+			while ((n < 32) && !(x & (1u << n))) {
+				n++;
+			}
+			return n;
+		}
+
+	public:
+		CodificadorDeReal() {
+			anterior = 0;
+			zerosEsquerda = 33;
+			zerosDireita = 0;
+			primeiro = true;
+		}
+
+		void escrever(EscritorDeBits* saida, float valor) {
+			uint32_t bits;
+			memcpy(&bits, &valor, 4);
+			if (primeiro) {
+				saida->escrever(bits, 32);
+				primeiro = false;
+				anterior = bits;
+				return;
+			}
+			uint32_t x = bits ^ anterior;
+			anterior = bits;
+			if (x == 0) {
+				saida->escrever(0, 1);
+				return;
+			}
+			saida->escrever(1, 1);
+			int esquerda = std::min(contarEsquerda(x), 31);
+			int direita = contarDireita(x);
+			if ((zerosEsquerda <= esquerda) && (zerosDireita <= direita)) { // Cabe na janela anterior.
+				saida->escrever(0, 1);
+				saida->escrever(x >> zerosDireita, 32 - zerosEsquerda - zerosDireita);
+			} else {
+				saida->escrever(1, 1);
+				int significativos = 32 - esquerda - direita;
+				saida->escrever((uint64_t) esquerda, 5);
+				saida->escrever((uint64_t) (significativos - 1), 5);
+				saida->escrever(x >> direita, significativos);
+				zerosEsquerda = esquerda;
+				zerosDireita = direita;
+			}
+		}
+
+		float ler(LeitorDeBits* entrada) {
+			uint32_t bits;
+			if (primeiro) {
+				primeiro = false;
+				bits = (uint32_t) entrada->ler(32);
+			} else if (entrada->ler(1) == 0) {
+				bits = anterior;
+			} else {
+				if (entrada->ler(1) == 1) {
+					zerosEsquerda = (int) entrada->ler(5);
+					int significativos = (int) entrada->ler(5) + 1;
+					zerosDireita = 32 - zerosEsquerda - significativos;
+				}
+				uint32_t x = (uint32_t) (entrada->ler(32 - zerosEsquerda - zerosDireita) << zerosDireita);
+				bits = anterior ^ x;
+			}
+			anterior = bits;
+			float valor;
+			memcpy(&valor, &bits, 4);
+			return valor;
+		}
+};
+
+//!  Classe CodificadorDePrioridade
+/*!
+	Prioridades: um bit quando não mudam, senão um bit e a nova prioridade.
+*/
+class CodificadorDePrioridade {
+	private:
+		int anterior; /*!< Última prioridade. */
+
+	public:
+		CodificadorDePrioridade() {
+			anterior = 0;
+		}
+
+		void escrever(EscritorDeBits* saida, int prioridade) {
+			if (prioridade == anterior) {
+				saida->escrever(0, 1);
+			} else {
+				saida->escrever(1, 1);
+				saida->escrever((uint64_t) (uint8_t) prioridade, 8);
+				anterior = prioridade;
+			}
+		}
+
+		int ler(LeitorDeBits* entrada) {
+			if (entrada->ler(1) == 1) {
+				anterior = (int8_t) entrada->ler(8);
+			}
+			return anterior;
+		}
+};
+
+//!  Classe ArquivoMapeado
+/*!
+	Arquivo somente para leitura mapeado em memória.
+*/
+class ArquivoMapeado {
+	private:
+		void* memoria; /*!< Início do mapeamento. */
+		size_t tamanho; /*!< Bytes mapeados. */
+
+	public:
+		ArquivoMapeado() {
+			memoria = 0;
+			tamanho = 0;
+		}
+
+		~ArquivoMapeado() {
+			if (memoria != 0) {
+				munmap(memoria, tamanho);
+			}
+		}
+
+		/*!
+			Método que mapeia um arquivo.
+			\return Valor booleano que indica se o arquivo existe e pôde ser mapeado.
+		*/
+		bool abrir(const std::string& nome) {
+			int descritor = open(nome.c_str(), O_RDONLY);
+			if (descritor < 0) {
+				return false;
+			}
+			struct stat info;
+			bool sucesso = (fstat(descritor, &info) == 0) && (info.st_size > 0);
+			if (sucesso) {
+				tamanho = (size_t) info.st_size;
+				memoria = mmap(0, tamanho, PROT_READ, MAP_SHARED, descritor, 0);
+				if (memoria == MAP_FAILED) {
+					memoria = 0;
+					sucesso = false;
+				}
+			}
+			close(descritor);
+			return sucesso;
+		}
+
+		const unsigned char* getDados() const {
+			return static_cast<const unsigned char*>(memoria);
+		}
+
+		size_t getTamanho() const {
+			return tamanho;
+		}
+};
+
+//!  Classe MesColunar
+/*!
+	Um arquivo mensal aberto para consultas.
+*/
+class MesColunar {
+	private:
+		ArquivoMapeado arquivo; /*!< Arquivo mapeado. */
+		const CabecalhoColunar* cabecalho; /*!< Cabeçalho. */
+		const Bloco* indice; /*!< Índice, ordenado por remetente e soquete. */
+
+	public:
+		MesColunar() {
+			cabecalho = 0;
+			indice = 0;
+		}
+
+		bool abrir(const std::string& nome) {
+			if (!arquivo.abrir(nome) || (arquivo.getTamanho() < sizeof(CabecalhoColunar))) {
+				return false;
+			}
+			cabecalho = reinterpret_cast<const CabecalhoColunar*>(arquivo.getDados());
+			if ((memcmp(cabecalho->assinatura, "TOMCOL", 6) != 0) || (cabecalho->versao != VERSAO_ARQUIVO_COLUNAR)
+					|| (cabecalho->inicioIndice + cabecalho->quantidadeBlocos * sizeof(Bloco) > arquivo.getTamanho())) {
+				return false;
+			}
+			indice = reinterpret_cast<const Bloco*>(arquivo.getDados() + cabecalho->inicioIndice);
+			return true;
+		}
+
+		uint32_t getQuantidadeBlocos() const {
+			return cabecalho->quantidadeBlocos;
+		}
+
+		const Bloco& getBloco(uint32_t i) const {
+			return indice[i];
+		}
+
+		/*!
+			Método que procura o bloco de um soquete por busca binária no índice.
+			\return Bloco do soquete, ou 0 se ele não tem amostras no mês.
+		*/
+		const Bloco* buscar(uint32_t remetente, int32_t soquete) const {
+			uint32_t inicio = 0;
+			uint32_t fim = cabecalho->quantidadeBlocos;
+			while (inicio < fim) {
+				uint32_t meio = (inicio + fim) / 2;
+				const Bloco& b = indice[meio];
+				if ((b.remetente < remetente) || ((b.remetente == remetente) && (b.soquete < soquete))) {
+					inicio = meio + 1;
+				} else {
+					fim = meio;
+				}
+			}
+			if ((inicio < cabecalho->quantidadeBlocos) && (indice[inicio].remetente == remetente) && (indice[inicio].soquete == soquete)) {
+				return &indice[inicio];
+			}
+			return 0;
+		}
+
+		/*!
+			Método que decodifica as amostras de um bloco entre dois tempos (inclusive).
+		*/
+		void ler(const Bloco& bloco, int64_t de, int64_t ate, std::vector<Amostra>* amostras) const {
+			if ((bloco.tempoFinal < de) || (bloco.tempoInicial > ate)) {
+				return;
+			}
+			const unsigned char* dados = arquivo.getDados();
+			LeitorDeBits tempos(dados + bloco.inicio[COLUNA_TEMPO]);
+			LeitorDeBits ultimos(dados + bloco.inicio[COLUNA_ULTIMO_CONSUMO]);
+			LeitorDeBits previstos(dados + bloco.inicio[COLUNA_CONSUMO_PREVISTO]);
+			LeitorDeBits prioridades(dados + bloco.inicio[COLUNA_PRIORIDADE]);
+			CodificadorDeTempo ct;
+			CodificadorDeReal cu;
+			CodificadorDeReal cp;
+			CodificadorDePrioridade cr;
+			for (uint32_t i = 0; i < bloco.quantidade; i++) {
+				Amostra a;
+				a.tempo = ct.ler(&tempos);
+				a.ultimoConsumo = cu.ler(&ultimos);
+				a.consumoPrevisto = cp.ler(&previstos);
+				a.prioridade = cr.ler(&prioridades);
+				a.grupo = bloco.grupoFinal; // O grupo não tem coluna: um soquete muda de grupo raramente.
+				if (a.tempo > ate) {
+					break;
+				}
+				if (a.tempo >= de) {
+					amostras->push_back(a);
+				}
+			}
+		}
+};
+
+/*!
+	Função que retorna o nome do arquivo mensal de um tempo.
+*/
+static std::string nomeDoMes(const std::string& diretorio, int64_t tempo) {
+	time_t t = (time_t) tempo;
+	struct tm data;
+	gmtime_r(&t, &data);
+	char nome[32];
+	snprintf(nome, sizeof nome, "%04d-%02d.col", data.tm_year + 1900, data.tm_mon + 1);
+	return diretorio + "/" + nome;
+}
+
+/*!
+	Função que converte "AAAA-MM-DD" em segundos desde 01/01/1970 (UTC).
+*/
+static bool lerData(const char* texto, int64_t* tempo) {
+	struct tm data;
+	memset(&data, 0, sizeof data);
+	if (sscanf(texto, "%d-%d-%d", &data.tm_year, &data.tm_mon, &data.tm_mday) != 3) {
+		return false;
+	}
+	data.tm_year -= 1900;
+	data.tm_mon -= 1;
+	*tempo = (int64_t) timegm(&data);
+	return true;
+}
+
+/*!
+	Função que imprime um endereço como os decodificadores.
+*/
+static void imprimirEndereco(uint32_t endereco) {
+	for (int i = 0; i < BYTES_ENDERECO; i++) {
+		printf((i == 0) ? "%02x" : ":%02x", (endereco >> (8 * i)) & 0xff);
+	}
+}
+
+/*!
+	Função que lê um endereço no formato "xx:xx".
+*/
+static uint32_t lerEndereco(const char* texto) {
+	uint32_t endereco = 0;
+	for (int i = 0; (i < BYTES_ENDERECO) && (*texto != '\0'); i++) {
+		endereco |= (uint32_t) (strtoul(texto, const_cast<char**>(&texto), 16) & 0xff) << (8 * i);
+		if (*texto == ':') {
+			texto++;
+		}
+	}
+	return endereco;
+}
+
+/*!
+	Função que grava um arquivo mensal com as séries de seus soquetes.
+*/
+static bool gravarMes(const std::string& nome, std::map<std::pair<uint32_t, int32_t>, std::vector<Amostra> >& series) {
+	FILE* saida = fopen(nome.c_str(), "wb");
+	if (saida == 0) {
+		return false;
+	}
+	CabecalhoColunar cabecalho;
+	memset(&cabecalho, 0, sizeof cabecalho);
+	memcpy(cabecalho.assinatura, "TOMCOL", 6);
+	cabecalho.versao = VERSAO_ARQUIVO_COLUNAR;
+	fwrite(&cabecalho, sizeof cabecalho, 1, saida);
+	uint64_t posicao = sizeof cabecalho;
+
+	std::vector<Bloco> indice;
+	for (auto it = series.begin(); it != series.end(); it++) { // O map já percorre por remetente e soquete.
+		std::vector<Amostra>& amostras = it->second;
+		std::sort(amostras.begin(), amostras.end(), [](const Amostra& a, const Amostra& b) { return a.tempo < b.tempo; });
+
+		Bloco bloco;
+		memset(&bloco, 0, sizeof bloco);
+		bloco.remetente = it->first.first;
+		bloco.soquete = it->first.second;
+		bloco.quantidade = (uint32_t) amostras.size();
+		bloco.tempoInicial = amostras.front().tempo;
+		bloco.tempoFinal = amostras.back().tempo;
+		bloco.previstoFinal = amostras.back().consumoPrevisto;
+		bloco.prioridadeFinal = amostras.back().prioridade;
+		bloco.grupoFinal = amostras.back().grupo;
+
+		EscritorDeBits colunas[NUMERO_COLUNAS];
+		CodificadorDeTempo ct;
+		CodificadorDeReal cu;
+		CodificadorDeReal cp;
+		CodificadorDePrioridade cr;
+		for (size_t i = 0; i < amostras.size(); i++) {
+			const Amostra& a = amostras[i];
+			ct.escrever(&colunas[COLUNA_TEMPO], a.tempo);
+			cu.escrever(&colunas[COLUNA_ULTIMO_CONSUMO], a.ultimoConsumo);
+			cp.escrever(&colunas[COLUNA_CONSUMO_PREVISTO], a.consumoPrevisto);
+			cr.escrever(&colunas[COLUNA_PRIORIDADE], a.prioridade);
+			bloco.somaUltimoConsumo += a.ultimoConsumo;
+			bloco.maiorUltimoConsumo = std::max(bloco.maiorUltimoConsumo, a.ultimoConsumo);
+		}
+		for (int c = 0; c < NUMERO_COLUNAS; c++) {
+			const std::vector<unsigned char>& bytes = colunas[c].getBytes();
+			bloco.inicio[c] = posicao;
+			bloco.tamanho[c] = (uint32_t) bytes.size();
+			if (!bytes.empty()) {
+				fwrite(&bytes[0], 1, bytes.size(), saida);
+			}
+			posicao += bytes.size();
+		}
+		indice.push_back(bloco);
+	}
+	// O índice começa alinhado, para ser lido direto do mapeamento.
+	while (posicao % 8 != 0) {
+		fputc(0, saida);
+		posicao++;
+	}
+	cabecalho.quantidadeBlocos = (uint32_t) indice.size();
+	cabecalho.inicioIndice = posicao;
+	if (!indice.empty()) {
+		fwrite(&indice[0], sizeof(Bloco), indice.size(), saida);
+	}
+	fseek(saida, 0, SEEK_SET);
+	fwrite(&cabecalho, sizeof cabecalho, 1, saida);
+	return fclose(saida) == 0;
+}
+
+/*!
+	Função que compacta o arquivo do coletor: as amostras são separadas por mês e soquete, e as repetidas
+	(a mesma época de um soquete, ouvida mais de uma vez na janela de sincronização) são descartadas.
+	Cada mês presente no arquivo do coletor é regravado por completo.
+*/
+static int compactar(const char* entrada, const char* diretorio) {
+	ArquivoMapeado arquivo;
+	if (!arquivo.abrir(entrada) || (arquivo.getTamanho() < sizeof(CabecalhoTelemetria))) {
+		fprintf(stderr, "Nao foi possivel ler %s.\n", entrada);
+		return 1;
+	}
+	const CabecalhoTelemetria* cabecalho = reinterpret_cast<const CabecalhoTelemetria*>(arquivo.getDados());
+	if ((memcmp(cabecalho->assinatura, "TOMADAS", 8) != 0) || (cabecalho->versao != VERSAO_ARQUIVO_TELEMETRIA)
+			|| (cabecalho->tamanhoRegistro != sizeof(Registro))
+			|| (sizeof(CabecalhoTelemetria) + cabecalho->quantidade * sizeof(Registro) > arquivo.getTamanho())) {
+		fprintf(stderr, "%s nao e um arquivo do coletorTelemetria.\n", entrada);
+		return 1;
+	}
+	const Registro* registros = reinterpret_cast<const Registro*>(cabecalho + 1);
+
+	typedef std::pair<uint32_t, int32_t> Soquete;
+	std::map<std::string, std::map<Soquete, std::vector<Amostra> > > meses;
+	std::map<Soquete, uint32_t> ultimaEpoca;
+	uint64_t repetidas = 0;
+	for (uint64_t i = 0; i < cabecalho->quantidade; i++) {
+		const Registro& r = registros[i];
+		Soquete soquete(r.remetente, r.soquete);
+		auto anterior = ultimaEpoca.find(soquete);
+		if ((anterior != ultimaEpoca.end()) && (anterior->second == r.epoca)) {
+			repetidas++;
+			continue;
+		}
+		ultimaEpoca[soquete] = r.epoca;
+		Amostra a;
+		a.tempo = INICIO_2016 + r.tempo / 1000000;
+		a.ultimoConsumo = r.ultimoConsumo;
+		a.consumoPrevisto = r.consumoPrevisto;
+		a.prioridade = r.prioridade;
+		a.grupo = r.grupo;
+		meses[nomeDoMes(diretorio, a.tempo)][soquete].push_back(a);
+	}
+
+	for (auto it = meses.begin(); it != meses.end(); it++) {
+		std::string temporario = it->first + ".tmp";
+		if (!gravarMes(temporario, it->second) || (rename(temporario.c_str(), it->first.c_str()) != 0)) {
+			fprintf(stderr, "Nao foi possivel gravar %s.\n", it->first.c_str());
+			return 1;
+		}
+		struct stat info;
+		stat(it->first.c_str(), &info);
+		printf("%s: %zu soquetes, %lld bytes.\n", it->first.c_str(), it->second.size(), (long long) info.st_size);
+	}
+	printf("%llu registros lidos, %llu repetidos descartados.\n", (unsigned long long) cabecalho->quantidade, (unsigned long long) repetidas);
+	return 0;
+}
+
+/*!
+	Função que imprime o relatório de um mês: o consumo de cada soquete, o de cada grupo de orçamento e o total. Só o índice é lido.
+*/
+static int relatorioMensal(const char* diretorio, const char* mes) {
+	std::string nome = std::string(diretorio) + "/" + mes + ".col";
+	MesColunar arquivo;
+	if (!arquivo.abrir(nome)) {
+		fprintf(stderr, "Nao foi possivel ler %s.\n", nome.c_str());
+		return 1;
+	}
+	double total = 0;
+	double previstoTotal = 0;
+	std::map<int, double> totalGrupo;
+	std::map<int, double> previstoGrupo;
+	for (uint32_t i = 0; i < arquivo.getQuantidadeBlocos(); i++) {
+		const Bloco& b = arquivo.getBloco(i);
+		printf("Placa ");
+		imprimirEndereco(b.remetente);
+		printf(", soquete %d (grupo %d): consumo %.1f, previsto %.1f, maior periodo %.1f, prioridade %d, %u amostras.\n",
+			b.soquete, b.grupoFinal, b.somaUltimoConsumo, b.previstoFinal, b.maiorUltimoConsumo, b.prioridadeFinal, b.quantidade);
+		total += b.somaUltimoConsumo;
+		previstoTotal += b.previstoFinal;
+		totalGrupo[b.grupoFinal] += b.somaUltimoConsumo;
+		previstoGrupo[b.grupoFinal] += b.previstoFinal;
+	}
+	for (auto it = totalGrupo.begin(); it != totalGrupo.end(); it++) {
+		printf("Grupo %d: consumo %.1f, previsto ate o fim do mes %.1f.\n", it->first, it->second, previstoGrupo[it->first]);
+	}
+	printf("Total de %u soquetes: consumo %.1f, previsto ate o fim do mes %.1f.\n", arquivo.getQuantidadeBlocos(), total, previstoTotal);
+	return 0;
+}
+
+/*!
+	Função que imprime as amostras de um soquete entre duas datas, abrindo os arquivos mensais do intervalo.
+*/
+static int serie(const char* diretorio, const char* remetente, const char* soquete, const char* de, const char* ate) {
+	int64_t inicio;
+	int64_t fim;
+	if (!lerData(de, &inicio) || !lerData(ate, &fim)) {
+		fprintf(stderr, "Datas no formato AAAA-MM-DD.\n");
+		return 1;
+	}
+	fim += 86400 - 1; // Inclui o último dia.
+	uint32_t endereco = lerEndereco(remetente);
+	int32_t numero = atoi(soquete);
+
+	std::vector<Amostra> amostras;
+	std::string ultimoNome;
+	for (int64_t t = inicio; t <= fim + 31 * 86400; t += 28 * 86400) { // Passa por todos os meses do intervalo.
+		std::string nome = nomeDoMes(diretorio, std::min(t, fim));
+		if (nome == ultimoNome) {
+			continue;
+		}
+		ultimoNome = nome;
+		MesColunar arquivo;
+		if (!arquivo.abrir(nome)) {
+			continue;
+		}
+		const Bloco* bloco = arquivo.buscar(endereco, numero);
+		if (bloco != 0) {
+			arquivo.ler(*bloco, inicio, fim, &amostras);
+		}
+	}
+	for (size_t i = 0; i < amostras.size(); i++) {
+		time_t t = (time_t) amostras[i].tempo;
+		struct tm data;
+		gmtime_r(&t, &data);
+		printf("%04d-%02d-%02d %02d:%02d:%02d  consumo %.2f  previsto %.1f  prioridade %d\n", data.tm_year + 1900, data.tm_mon + 1, data.tm_mday,
+			data.tm_hour, data.tm_min, data.tm_sec, amostras[i].ultimoConsumo, amostras[i].consumoPrevisto, amostras[i].prioridade);
+	}
+	return 0;
+}
+
+/*!
+	Função inicial.
+*/
+int main(int argc, char** argv) {
+	if ((argc == 4) && (strcmp(argv[1], "compactar") == 0)) {
+		return compactar(argv[2], argv[3]);
+	}
+	if ((argc == 4) && (strcmp(argv[1], "mensal") == 0)) {
+		return relatorioMensal(argv[2], argv[3]);
+	}
+	if ((argc == 7) && (strcmp(argv[1], "serie") == 0)) {
+		return serie(argv[2], argv[3], argv[4], argv[5], argv[6]);
+	}
+	fprintf(stderr, "Uso: %s compactar tomadas.tel diretorio\n", argv[0]);
+	fprintf(stderr, "     %s mensal diretorio AAAA-MM\n", argv[0]);
+	fprintf(stderr, "     %s serie diretorio REMETENTE SOQUETE AAAA-MM-DD AAAA-MM-DD\n", argv[0]);
+	return 1;
+}
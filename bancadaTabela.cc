@@ -0,0 +1,226 @@
+// Copyright [2016] <Dúnia Marchiori(14200724) e Vinicius Steffani Schweitzer(14200768)>
+
+// Bancada de desempenho e simulador, no computador, das somas da tabela de tomadas (ColunasDaTabela, a mesma da placa).
+// "desempenho" mede as somas escalares (as da placa) e as com SSE2 com 1k, 10k e 100k tomadas e confere que os resultados são idênticos.
+// "simular" acompanha um sistema de muitas tomadas época a época e imprime o nível de corte decidido com as somas da tabela.
+// Compilação: g++ -O2 -o bancadaTabela bancadaTabela.cc
+// Uso: bancadaTabela desempenho
+//      bancadaTabela simular tomadas epocas limite
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+
+#include "colunasDaTabela.h"
+
+#define NUMERO_NIVEIS_PRIORIDADE 8 /*!< Níveis de prioridade. O mesmo valor de tomadasInteligentes.cc. */
+#define ENTRADAS_POR_MEDIDA 50000000 /*!< Entradas somadas em cada medida (as repetições são ajustadas ao tamanho da tabela). */
+#define FRACAO_SEM_NOTICIAS 10 /*!< Porcentagem das tomadas que não enviam dados em cada época. */
+#define EPOCA_INICIAL 1000 /*!< Primeira época das tabelas geradas. */
+
+//!  Struct Somas
+/*!
+	Somas de uma época, com os campos que ColunasDaTabela::somarEpoca() preenche (os mesmos de Agregado).
+*/
+struct Somas {
+	float consumoPrevisto; /*!< Soma do consumo previsto até o fim do mês. */
+	float ultimoConsumo; /*!< Soma do consumo desde a última sincronização. */
+	float previstoDesligavel[NUMERO_NIVEIS_PRIORIDADE]; /*!< Soma do consumo previsto das tomadas que podem ser desligadas, por nível. */
+	float consumoMensalMaior; /*!< Maior consumo mensal informado. */
+	float limiteMenor; /*!< Menor consumo máximo informado. */
+	int quantidade; /*!< Quantidade de entradas somadas. */
+};
+
+/*!
+	Função que retorna um número real sorteado entre 0 e maximo.
+*/
+static float sortear(float maximo) {
+	return maximo * (float) rand() / (float) RAND_MAX;
+}
+
+/*!
+	Função que retorna o tempo do computador em nanossegundos.
+*/
+static double agora() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double) t.tv_sec * 1e9 + (double) t.tv_nsec;
+}
+
+/*!
+	Função que preenche uma tabela: a maioria das tomadas enviou dados na época dada e as outras em uma época anterior.
+*/
+template <int CAPACIDADE>
+static void preencher(ColunasDaTabela<CAPACIDADE, NUMERO_NIVEIS_PRIORIDADE>* colunas, int epoca) {
+	for (int i = 0; i < CAPACIDADE; i++) {
+		int enviada = (rand() % 100 < FRACAO_SEM_NOTICIAS) ? epoca - 1 - rand() % 3 : epoca;
+		colunas->atualizar(i, sortear(50), sortear(5), sortear(200), 150 + sortear(100), enviada, enviada,
+				rand() % NUMERO_NIVEIS_PRIORIDADE, (rand() % 4) != 0);
+	}
+}
+
+/*!
+	Função que soma uma época da tabela.
+*/
+template <int CAPACIDADE>
+static Somas somar(const ColunasDaTabela<CAPACIDADE, NUMERO_NIVEIS_PRIORIDADE>& colunas, int epoca, bool vetorial) {
+	Somas somas;
+	memset(&somas, 0, sizeof somas);
+	somas.limiteMenor = 1e30f;
+	somas.quantidade = colunas.somarEpoca(epoca, &somas, &somas.consumoMensalMaior, &somas.limiteMenor, vetorial);
+	return somas;
+}
+
+/*!
+	Função que mede as somas de uma tabela de CAPACIDADE tomadas e confere que as duas versões dão o mesmo resultado.
+	\return Valor booleano que indica se os resultados são idênticos.
+*/
+template <int CAPACIDADE>
+static bool medir() {
+	ColunasDaTabela<CAPACIDADE, NUMERO_NIVEIS_PRIORIDADE>* colunas = new ColunasDaTabela<CAPACIDADE, NUMERO_NIVEIS_PRIORIDADE>();
+	preencher(colunas, EPOCA_INICIAL);
+	int repeticoes = ENTRADAS_POR_MEDIDA / CAPACIDADE;
+	double ns[2][3];
+	float previsto[2];
+	float ultimo[2];
+	Somas somas[2];
+	for (int v = 0; v < 2; v++) {
+		bool vetorial = (v == 1);
+		volatile float destino = 0; // Impede que as somas repetidas sejam descartadas.
+		double inicio = agora();
+		for (int r = 0; r < repeticoes; r++) {
+			destino = colunas->somarPrevisto(EPOCA_INICIAL, vetorial);
+		}
+		ns[v][0] = (agora() - inicio) / ((double) repeticoes * CAPACIDADE);
+		previsto[v] = destino;
+		inicio = agora();
+		for (int r = 0; r < repeticoes; r++) {
+			destino = colunas->somarUltimoConsumo(EPOCA_INICIAL, vetorial);
+		}
+		ns[v][1] = (agora() - inicio) / ((double) repeticoes * CAPACIDADE);
+		ultimo[v] = destino;
+		inicio = agora();
+		for (int r = 0; r < repeticoes; r++) {
+			somas[v] = somar(*colunas, EPOCA_INICIAL, vetorial);
+			destino = somas[v].consumoPrevisto;
+		}
+		ns[v][2] = (agora() - inicio) / ((double) repeticoes * CAPACIDADE);
+	}
+	delete colunas;
+
+	bool iguais = (memcmp(&previsto[0], &previsto[1], sizeof(float)) == 0) && (memcmp(&ultimo[0], &ultimo[1], sizeof(float)) == 0)
+			&& (memcmp(&somas[0], &somas[1], sizeof(Somas)) == 0);
+	printf("%7d  %8.3f %8.3f  %8.3f %8.3f  %8.3f %8.3f  %s\n", CAPACIDADE, ns[0][0], ns[1][0], ns[0][1], ns[1][1], ns[0][2], ns[1][2],
+			iguais ? "iguais" : "DIFERENTES");
+	return iguais;
+}
+
+/*!
+	Função que mede as somas com 1k, 10k e 100k tomadas.
+*/
+static int desempenho() {
+#if !defined(__SSE2__)
+	printf("Compilado sem SSE2: as duas colunas medem a versão escalar.\n");
+#endif
+	printf("ns por tomada (escalar, SSE2)\n");
+	printf("tomadas  somarPrevisto      somarUltimoConsumo somarEpoca\n");
+	bool iguais = medir<1000>();
+	iguais = medir<10000>() && iguais;
+	iguais = medir<100000>() && iguais;
+	return iguais ? 0 : 1;
+}
+
+/*!
+	Função que corta os níveis de prioridade, do menor para o maior, até eliminar o excesso, como PlanejadorDeCorte::resumirDecisao().
+*/
+static int nivelDeCorte(const Somas& somas, float consumoMensal, float limite, float* fracao) {
+	*fracao = 0;
+	float excesso = consumoMensal + somas.consumoPrevisto - limite;
+	for (int nivel = 0; nivel < NUMERO_NIVEIS_PRIORIDADE; nivel++) {
+		float consumoNivel = somas.previstoDesligavel[nivel];
+		if (excesso <= 0) {
+			return nivel;
+		}
+		if (consumoNivel > excesso) {
+			*fracao = excesso / consumoNivel;
+			return nivel;
+		}
+		excesso -= consumoNivel;
+	}
+	return NUMERO_NIVEIS_PRIORIDADE;
+}
+
+/*!
+	Função que simula um sistema de tomadas. Cada tomada tem um consumo médio por época. A cada época, as tomadas que enviam dados atualizam
+	suas colunas, a tabela é somada (pelas duas versões, que devem coincidir) e o nível de corte é calculado com o consumo acumulado no mês.
+	Na época seguinte, as tomadas que podem desligar abaixo do nível de corte não consomem e as do nível de corte consomem só a parte não cortada.
+*/
+static int simular(int tomadas, int epocas, float limite) {
+	const int CAPACIDADE = 100000;
+	if ((tomadas <= 0) || (tomadas > CAPACIDADE) || (epocas <= 0)) {
+		fprintf(stderr, "A quantidade de tomadas deve estar entre 1 e %d e a de epocas deve ser positiva.\n", CAPACIDADE);
+		return 1;
+	}
+	ColunasDaTabela<CAPACIDADE, NUMERO_NIVEIS_PRIORIDADE>* colunas = new ColunasDaTabela<CAPACIDADE, NUMERO_NIVEIS_PRIORIDADE>();
+	float* media = new float[tomadas];
+	int* nivel = new int[tomadas];
+	bool* podeDesligar = new bool[tomadas];
+	for (int i = 0; i < CAPACIDADE; i++) {
+		colunas->zerar(i);
+	}
+	for (int i = 0; i < tomadas; i++) {
+		media[i] = sortear(2.4f * limite / ((float) tomadas * epocas)); // Em média, o sistema consome 20% acima do limite.
+		nivel[i] = rand() % NUMERO_NIVEIS_PRIORIDADE;
+		podeDesligar[i] = (rand() % 4) != 0;
+	}
+
+	float consumoMensal = 0;
+	int corte = 0;
+	float fracao = 0;
+	int diferentes = 0;
+	printf("epoca tomadas consumoMensal previsto nivel fracao\n");
+	for (int e = 0; e < epocas; e++) {
+		for (int i = 0; i < tomadas; i++) {
+			float ultimo = media[i] * (0.5f + sortear(1));
+			if (podeDesligar[i] && (nivel[i] < corte)) {
+				ultimo = 0;
+			} else if (podeDesligar[i] && (nivel[i] == corte)) {
+				ultimo *= 1 - fracao;
+			}
+			consumoMensal += ultimo;
+			if (rand() % 100 < FRACAO_SEM_NOTICIAS) {
+				continue;
+			}
+			colunas->atualizar(i, media[i] * (epocas - e - 1), ultimo, consumoMensal, limite, e, e, nivel[i], podeDesligar[i]);
+		}
+		Somas somas = somar(*colunas, e, false);
+		Somas vetorial = somar(*colunas, e, true);
+		if (memcmp(&somas, &vetorial, sizeof somas) != 0) {
+			diferentes++;
+		}
+		corte = nivelDeCorte(somas, consumoMensal, limite, &fracao);
+		printf("%5d %7d %13.1f %8.1f %5d %6.3f\n", e, somas.quantidade, consumoMensal, somas.consumoPrevisto, corte, fracao);
+	}
+	printf("Consumo no mes: %.1f (limite %.1f). Epocas com somas diferentes entre as versoes: %d\n", consumoMensal, limite, diferentes);
+	delete colunas;
+	delete[] media;
+	delete[] nivel;
+	delete[] podeDesligar;
+	return (diferentes == 0) ? 0 : 1;
+}
+
+/*!
+	Função inicial.
+*/
+int main(int argc, char** argv) {
+	srand(1);
+	if ((argc == 2) && (strcmp(argv[1], "desempenho") == 0)) {
+		return desempenho();
+	}
+	if ((argc == 5) && (strcmp(argv[1], "simular") == 0)) {
+		return simular(atoi(argv[2]), atoi(argv[3]), (float) atof(argv[4]));
+	}
+	fprintf(stderr, "Uso: %s desempenho\n       %s simular tomadas epocas limite\n", argv[0], argv[0]);
+	return 1;
+}
@@ -0,0 +1,353 @@
+// Copyright [2016] <Dúnia Marchiori(14200724) e Vinicius Steffani Schweitzer(14200768)>
+
+// Coletor, para o computador, dos quadros de telemetria enviados por uma tomada no modo gateway (comando "PLACA GATEWAY LIG").
+// Os dados são acrescentados a um arquivo mapeado em memória; o texto e os quadros do registro são repassados como estão.
+// Os quadros da captura de tráfego são descartados: para guardá-los, ponha o reprodutorTrafego (gravar) antes do coletor.
+// Compilação: g++ -o coletorTelemetria coletorTelemetria.cc
+// Uso: coletorTelemetria tomadas.tel < /dev/ttyACM0 | decodificadorRegistro
+
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#define INICIO_QUADRO_TELEMETRIA 0xA6 /*!< Primeiro byte de cada quadro. O mesmo valor de tomadasInteligentes.cc. */
+#define INICIO_QUADRO_REGISTRO 0xA5 /*!< Primeiro byte dos quadros do registro, repassados como estão. */
+#define INICIO_QUADRO_CAPTURA 0xA7 /*!< Primeiro byte dos quadros da captura de tráfego, descartados. */
+#define TAMANHO_DADOS 36 /*!< Bytes dos dados de um quadro (GatewayUSB::TAMANHO_DADOS). */
+#define TAMANHO_MAXIMO_QUADRO (255 + 4) /*!< Bytes do maior quadro. */
+#define CRESCIMENTO 65536 /*!< Quantidade de registros acrescentada ao arquivo cada vez que ele enche. */
+#define VERSAO_ARQUIVO 1 /*!< Versão do formato do arquivo. */
+
+//!  Struct Cabecalho
+/*!
+	Início do arquivo. Os registros vêm logo depois; só os quantidade primeiros são válidos.
+*/
+struct Cabecalho {
+	char assinatura[8]; /*!< "TOMADAS\0". */
+	uint32_t versao; /*!< VERSAO_ARQUIVO. */
+	uint32_t tamanhoRegistro; /*!< sizeof(Registro). */
+	volatile uint64_t quantidade; /*!< Quantidade de registros gravados. Atualizada depois de cada registro. */
+};
+
+//!  Struct Registro
+/*!
+	Dados de um soquete recebidos do gateway.
+*/
+struct Registro {
+	int64_t chegada; /*!< Tempo do computador (microssegundos desde 01/01/1970) na chegada do quadro. */
+	int64_t tempo; /*!< Tempo do gateway (microssegundos desde 01/01/2016). */
+	uint32_t remetente; /*!< Endereço da placa, com o primeiro byte nos bits menos significativos. */
+	uint32_t epoca; /*!< Época em que os dados foram enviados. */
+	float consumoPrevisto; /*!< Consumo previsto do soquete até o fim do mês. */
+	float ultimoConsumo; /*!< Consumo do soquete desde a última sincronização. */
+	float consumoMensal; /*!< Consumo do sistema no mês, segundo o remetente. */
+	float maximoConsumoMensal; /*!< Consumo máximo mensal configurado no remetente. */
+	int8_t soquete; /*!< Soquete da placa. */
+	int8_t prioridade; /*!< Prioridade do soquete. */
+	uint8_t indicadores; /*!< 1: pode desligar, 2: tem dimmer, 4: dados do próprio gateway. */
+	uint8_t grupo; /*!< Grupo de orçamento da placa. */
+	uint8_t reservado[4]; /*!< Completa o registro em 48 bytes. */
+};
+
+//!  Classe Arquivo
+/*!
+	Arquivo de registros que só cresce, mapeado em memória. Gravar um registro é uma cópia na memória mapeada, sem chamada de sistema.
+*/
+class Arquivo {
+	private:
+		int descritor; /*!< Descritor do arquivo. */
+		Cabecalho* cabecalho; /*!< Início do mapeamento. */
+		uint64_t capacidade; /*!< Quantidade de registros que cabem no mapeamento. */
+
+		/*!
+			Método que (re)mapeia o arquivo com espaço para capacidade registros.
+		*/
+		bool mapear(uint64_t novaCapacidade) {
+			size_t tamanho = sizeof(Cabecalho) + novaCapacidade * sizeof(Registro);
+			if (cabecalho != 0) {
+				munmap(cabecalho, sizeof(Cabecalho) + capacidade * sizeof(Registro));
+				cabecalho = 0;
+			}
+			if (ftruncate(descritor, tamanho) != 0) {
+				return false;
+			}
+			void* memoria = mmap(0, tamanho, PROT_READ | PROT_WRITE, MAP_SHARED, descritor, 0);
+			if (memoria == MAP_FAILED) {
+				return false;
+			}
+			cabecalho = static_cast<Cabecalho*>(memoria);
+			capacidade = novaCapacidade;
+			return true;
+		}
+
+	public:
+		/*!
+			Método construtor da classe.
+		*/
+		Arquivo() {
+			descritor = -1;
+			cabecalho = 0;
+			capacidade = 0;
+		}
+
+		/*!
+			Método que abre o arquivo, criando-o se não existir, para acrescentar registros.
+			\param nome é o caminho do arquivo.
+			\return Valor booleano que indica se o arquivo pôde ser usado.
+		*/
+		bool abrir(const char* nome) {
+			descritor = open(nome, O_RDWR | O_CREAT, 0644);
+			if (descritor < 0) {
+				return false;
+			}
+			struct stat info;
+			if (fstat(descritor, &info) != 0) {
+				return false;
+			}
+			bool novo = (info.st_size == 0);
+			if (!novo && (info.st_size < (off_t) sizeof(Cabecalho))) {
+				return false;
+			}
+			uint64_t existentes = novo ? 0 : (info.st_size - sizeof(Cabecalho)) / sizeof(Registro);
+			if (!mapear(existentes + CRESCIMENTO)) {
+				return false;
+			}
+			if (novo) {
+				memcpy(cabecalho->assinatura, "TOMADAS", 8);
+				cabecalho->versao = VERSAO_ARQUIVO;
+				cabecalho->tamanhoRegistro = sizeof(Registro);
+				cabecalho->quantidade = 0;
+			} else if ((memcmp(cabecalho->assinatura, "TOMADAS", 8) != 0) || (cabecalho->versao != VERSAO_ARQUIVO)
+					|| (cabecalho->tamanhoRegistro != sizeof(Registro)) || (cabecalho->quantidade > existentes)) {
+				return false;
+			}
+			return true;
+		}
+
+		/*!
+			Método que acrescenta um registro, aumentando o arquivo se necessário.
+		*/
+		bool acrescentar(const Registro& registro) {
+			uint64_t quantidade = cabecalho->quantidade;
+			if ((quantidade == capacidade) && !mapear(capacidade + CRESCIMENTO)) {
+				return false;
+			}
+			Registro* registros = reinterpret_cast<Registro*>(cabecalho + 1);
+			registros[quantidade] = registro;
+			__sync_synchronize(); // Quem lê o arquivo enquanto ele cresce só vê registros completos.
+			cabecalho->quantidade = quantidade + 1;
+			return true;
+		}
+
+		/*!
+			Método que fecha o arquivo, descartando o espaço reservado e não usado.
+		*/
+		void fechar() {
+			if (cabecalho != 0) {
+				uint64_t quantidade = cabecalho->quantidade;
+				msync(cabecalho, sizeof(Cabecalho) + capacidade * sizeof(Registro), MS_SYNC);
+				munmap(cabecalho, sizeof(Cabecalho) + capacidade * sizeof(Registro));
+				cabecalho = 0;
+				if (ftruncate(descritor, sizeof(Cabecalho) + quantidade * sizeof(Registro)) != 0) {
+					perror("ftruncate");
+				}
+			}
+			if (descritor >= 0) {
+				close(descritor);
+				descritor = -1;
+			}
+		}
+
+		/*!
+			Método que retorna a quantidade de registros gravados.
+		*/
+		uint64_t getQuantidade() {
+			return cabecalho->quantidade;
+		}
+};
+
+//!  Classe Separador
+/*!
+	Separa, byte a byte, os quadros de telemetria do resto da saída da tomada, como o Separador do reprodutorTrafego.
+	Cada quadro é lido inteiro pelo seu byte inicial e tamanho, então um byte INICIO_QUADRO_TELEMETRIA nos dados de outro quadro não é confundido com um quadro.
+	Um quadro de telemetria só é aceito com o tamanho e a verificação certos; senão, seus bytes são devolvidos como texto.
+*/
+class Separador {
+	private:
+		unsigned char quadro[TAMANHO_MAXIMO_QUADRO]; /*!< Quadro sendo recebido. */
+		int recebidos; /*!< Bytes do quadro atual já recebidos; 0 fora de um quadro. */
+
+		/*!
+			Método que retorna o tamanho do quadro atual, ou 0 se ainda não é conhecido.
+		*/
+		int tamanhoDoQuadro() {
+			if (quadro[0] == INICIO_QUADRO_TELEMETRIA) {
+				return (recebidos >= 2) ? (quadro[1] + 3) : 0; // [início][tamanho][dados][verificação]
+			}
+			return (recebidos >= 3) ? (quadro[2] + 4) : 0; // [início][tipo ou evento][tamanho][dados][verificação]
+		}
+
+	public:
+		unsigned long corrompidos; /*!< Quadros de telemetria descartados pelo tamanho ou pela verificação. */
+		unsigned long capturas; /*!< Quadros da captura de tráfego descartados. */
+
+		/*!
+			Método construtor da classe.
+		*/
+		Separador() {
+			recebidos = 0;
+			corrompidos = 0;
+			capturas = 0;
+		}
+
+		/*!
+			Método que trata um byte.
+			\param c é o byte.
+			\param texto recebe os bytes a repassar como texto.
+			\param quantidadeTexto recebe a quantidade de bytes em texto.
+			\return Valor booleano que indica se este byte completou um quadro de telemetria (em getQuadro()).
+		*/
+		bool tratar(unsigned char c, unsigned char* texto, int* quantidadeTexto) {
+			*quantidadeTexto = 0;
+			if (recebidos == 0) {
+				if ((c == INICIO_QUADRO_TELEMETRIA) || (c == INICIO_QUADRO_REGISTRO) || (c == INICIO_QUADRO_CAPTURA)) {
+					quadro[recebidos++] = c;
+				} else {
+					texto[(*quantidadeTexto)++] = c;
+				}
+				return false;
+			}
+			if ((quadro[0] == INICIO_QUADRO_TELEMETRIA) && (recebidos == 1) && (c != TAMANHO_DADOS)) {
+				// Não é um quadro de telemetria: o byte inicial vira texto e este byte é tratado de novo, porque pode começar um quadro.
+				corrompidos++;
+				recebidos = 0;
+				int quantidade;
+				tratar(c, texto + 1, &quantidade);
+				texto[0] = INICIO_QUADRO_TELEMETRIA;
+				*quantidadeTexto = quantidade + 1;
+				return false;
+			}
+			quadro[recebidos++] = c;
+			int tamanho = tamanhoDoQuadro();
+			if ((tamanho == 0) || (recebidos < tamanho)) {
+				return false;
+			}
+			recebidos = 0;
+			if (quadro[0] == INICIO_QUADRO_CAPTURA) {
+				capturas++;
+				return false;
+			}
+			if (quadro[0] == INICIO_QUADRO_REGISTRO) {
+				memcpy(texto, quadro, tamanho);
+				*quantidadeTexto = tamanho;
+				return false;
+			}
+			unsigned char verificacao = 0;
+			for (int i = 1; i < tamanho - 1; i++) {
+				verificacao ^= quadro[i];
+			}
+			if (verificacao == quadro[tamanho - 1]) {
+				return true;
+			}
+			corrompidos++;
+			memcpy(texto, quadro, tamanho);
+			*quantidadeTexto = tamanho;
+			return false;
+		}
+
+		/*!
+			Método que retorna os dados do último quadro de telemetria completo.
+		*/
+		const unsigned char* getDados() {
+			return quadro + 2;
+		}
+};
+
+/*!
+	Função que lê um valor em little-endian.
+*/
+static uint64_t ler(const unsigned char* dados, int bytes) {
+	uint64_t valor = 0;
+	for (int b = 0; b < bytes; b++) {
+		valor |= ((uint64_t) dados[b]) << (8 * b);
+	}
+	return valor;
+}
+
+/*!
+	Função que converte os dados de um quadro em um registro.
+*/
+static Registro converter(const unsigned char* dados, int64_t chegada) {
+	Registro registro;
+	memset(&registro, 0, sizeof registro);
+	uint32_t bits;
+	registro.chegada = chegada;
+	registro.tempo = (int64_t) ler(dados, 8);
+	registro.remetente = (uint32_t) ler(dados + 8, 4);
+	registro.soquete = (int8_t) dados[12];
+	registro.epoca = (uint32_t) ler(dados + 13, 4);
+	bits = (uint32_t) ler(dados + 17, 4);
+	memcpy(&registro.consumoPrevisto, &bits, 4);
+	bits = (uint32_t) ler(dados + 21, 4);
+	memcpy(&registro.ultimoConsumo, &bits, 4);
+	bits = (uint32_t) ler(dados + 25, 4);
+	memcpy(&registro.consumoMensal, &bits, 4);
+	bits = (uint32_t) ler(dados + 29, 4);
+	memcpy(&registro.maximoConsumoMensal, &bits, 4);
+	registro.prioridade = (int8_t) dados[33];
+	registro.indicadores = dados[34];
+	registro.grupo = dados[35];
+	return registro;
+}
+
+/*!
+	Função que retorna o tempo do computador em microssegundos.
+*/
+static int64_t agora() {
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/*!
+	Função inicial: lê a saída da tomada em blocos, grava os quadros de telemetria e repassa o resto.
+*/
+int main(int argc, char** argv) {
+	if (argc != 2) {
+		fprintf(stderr, "Uso: %s arquivo < saida_da_tomada\n", argv[0]);
+		return 1;
+	}
+	Arquivo arquivo;
+	if (!arquivo.abrir(argv[1])) {
+		fprintf(stderr, "Nao foi possivel usar o arquivo %s.\n", argv[1]);
+		return 1;
+	}
+
+	Separador separador;
+	unsigned char bloco[4096];
+	unsigned char texto[TAMANHO_MAXIMO_QUADRO];
+	ssize_t lidos;
+	while ((lidos = read(STDIN_FILENO, bloco, sizeof bloco)) > 0) {
+		int64_t chegada = agora();
+		for (ssize_t i = 0; i < lidos; i++) {
+			int quantidadeTexto;
+			bool completo = separador.tratar(bloco[i], texto, &quantidadeTexto);
+			fwrite(texto, 1, quantidadeTexto, stdout);
+			if (completo && !arquivo.acrescentar(converter(separador.getDados(), chegada))) {
+				fprintf(stderr, "Nao foi possivel aumentar o arquivo.\n");
+				arquivo.fechar();
+				return 1;
+			}
+		}
+		fflush(stdout);
+	}
+	fprintf(stderr, "%llu registros no arquivo, %lu quadros corrompidos, %lu quadros da captura descartados.\n",
+			(unsigned long long) arquivo.getQuantidade(), separador.corrompidos, separador.capturas);
+	arquivo.fechar();
+	return 0;
+}
@@ -0,0 +1,249 @@
+// Copyright [2016] <Dúnia Marchiori(14200724) e Vinicius Steffani Schweitzer(14200768)>
+
+// Colunas da tabela de tomadas e as somas feitas sobre elas. Usadas pela placa (tomadasInteligentes.cc)
+// e, no computador, pela bancada de desempenho e pelo simulador (bancadaTabela.cc).
+
+#ifndef COLUNAS_DA_TABELA_H
+#define COLUNAS_DA_TABELA_H
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+//----------------------------------------------------------------------------
+//!  Classe ColunasDaTabela
+/*!
+	Campos das entradas da tabela usados nas somas, cada um em um vetor (coluna) indexado pela entrada.
+	Entradas livres têm colunas nulas e época -1, então não entram em nenhuma soma. CAPACIDADE deve ser múltiplo de LARGURA_SOMA.
+	As somas seguem sempre a mesma ordem: cada uma das LARGURA_SOMA parcelas soma as entradas i com i % LARGURA_SOMA igual ao seu índice,
+	em ordem crescente, e as parcelas são somadas como (0 + 1) + (2 + 3). A versão com SSE2 (no computador) faz as parcelas em um registro
+	vetorial e a escalar (na placa) em um vetor, então as duas dão exatamente o mesmo resultado (a escalar pula as entradas fora da máscara,
+	que na vetorial somam +0 e não mudam a parcela).
+	\param CAPACIDADE é a quantidade de entradas.
+	\param NIVEIS é a quantidade de níveis de prioridade.
+*/
+template <int CAPACIDADE, int NIVEIS>
+class ColunasDaTabela {
+	public:
+		enum {
+			LARGURA_SOMA = 4 /*!< Parcelas de cada soma (entradas somadas por instrução vetorial). */
+		};
+
+	private:
+		float consumoPrevisto[CAPACIDADE]; /*!< Coluna do consumo previsto de cada entrada.*/
+		float ultimoConsumo[CAPACIDADE]; /*!< Coluna do último consumo de cada entrada.*/
+		float consumoMensal[CAPACIDADE]; /*!< Coluna do consumo mensal informado por cada entrada.*/
+		float maximoConsumoMensal[CAPACIDADE]; /*!< Coluna do consumo máximo informado por cada entrada.*/
+		int epoca[CAPACIDADE]; /*!< Coluna da época em que cada entrada foi enviada (-1 nas livres).*/
+		int epocaOuvida[CAPACIDADE]; /*!< Coluna da época local em que cada entrada foi ouvida (-1 nas livres).*/
+		int nivel[CAPACIDADE]; /*!< Coluna do nível de prioridade de cada entrada.*/
+		int desligavel[CAPACIDADE]; /*!< Coluna com -1 nas entradas que podem ser desligadas e 0 nas outras (máscara das somas).*/
+
+		/*!
+			Método que soma as parcelas na ordem fixa.
+		*/
+		static float reduzir(const float* parcelas) {
+			return (parcelas[0] + parcelas[1]) + (parcelas[2] + parcelas[3]);
+		}
+
+		/*!
+			Método que soma, sem instruções vetoriais, os valores das entradas cuja época é e.
+		*/
+		static float somarMascaradoEscalar(const int* epocas, const float* valores, int e) {
+			float parcelas[LARGURA_SOMA] = {0, 0, 0, 0};
+			for (int i = 0; i < CAPACIDADE; i++) {
+				if (epocas[i] == e) {
+					parcelas[i % LARGURA_SOMA] += valores[i];
+				}
+			}
+			return reduzir(parcelas);
+		}
+
+#if defined(__SSE2__)
+		/*!
+			Método que soma, com SSE2, os valores das entradas cuja época é e.
+		*/
+		static float somarMascaradoVetorial(const int* epocas, const float* valores, int e) {
+			__m128i alvo = _mm_set1_epi32(e);
+			__m128 soma = _mm_setzero_ps();
+			for (int i = 0; i < CAPACIDADE; i += LARGURA_SOMA) {
+				__m128 mascara = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (epocas + i)), alvo));
+				soma = _mm_add_ps(soma, _mm_and_ps(mascara, _mm_loadu_ps(valores + i)));
+			}
+			float parcelas[LARGURA_SOMA];
+			_mm_storeu_ps(parcelas, soma);
+			return reduzir(parcelas);
+		}
+#endif
+
+	public:
+		/*!
+			Método que zera as colunas de uma entrada livre.
+			\param i é a entrada.
+		*/
+		void zerar(int i) {
+			consumoPrevisto[i] = 0;
+			ultimoConsumo[i] = 0;
+			consumoMensal[i] = 0;
+			maximoConsumoMensal[i] = 0;
+			epoca[i] = -1;
+			epocaOuvida[i] = -1;
+			nivel[i] = 0;
+			desligavel[i] = 0;
+		}
+
+		/*!
+			Método que copia para as colunas os campos de uma entrada.
+			\param i é a entrada.
+			\param previsto é o consumo previsto.
+			\param ultimo é o último consumo.
+			\param mensal é o consumo mensal informado.
+			\param maximo é o consumo máximo informado.
+			\param enviada é a época em que a entrada foi enviada.
+			\param ouvida é a época local em que a entrada foi ouvida.
+			\param n é o nível de prioridade (0 a NIVEIS - 1).
+			\param podeDesligar indica se a entrada pode ser desligada.
+		*/
+		void atualizar(int i, float previsto, float ultimo, float mensal, float maximo, int enviada, int ouvida, int n, bool podeDesligar) {
+			consumoPrevisto[i] = previsto;
+			ultimoConsumo[i] = ultimo;
+			consumoMensal[i] = mensal;
+			maximoConsumoMensal[i] = maximo;
+			epoca[i] = enviada;
+			epocaOuvida[i] = ouvida;
+			nivel[i] = n;
+			desligavel[i] = podeDesligar ? -1 : 0;
+		}
+
+		/*!
+			Método que soma o consumo previsto das entradas enviadas em uma época.
+			\param e é a época.
+			\param vetorial indica se as instruções vetoriais são usadas (só existem com SSE2).
+			\return Soma do consumo previsto.
+		*/
+		float somarPrevisto(unsigned long e, bool vetorial = true) const {
+#if defined(__SSE2__)
+			if (vetorial) {
+				return somarMascaradoVetorial(epoca, consumoPrevisto, (int) e);
+			}
+#endif
+			return somarMascaradoEscalar(epoca, consumoPrevisto, (int) e);
+		}
+
+		/*!
+			Método que soma o último consumo das entradas ouvidas em uma época.
+			\param e é a época local.
+			\param vetorial indica se as instruções vetoriais são usadas (só existem com SSE2).
+			\return Soma do último consumo.
+		*/
+		float somarUltimoConsumo(unsigned long e, bool vetorial = true) const {
+#if defined(__SSE2__)
+			if (vetorial) {
+				return somarMascaradoVetorial(epocaOuvida, ultimoConsumo, (int) e);
+			}
+#endif
+			return somarMascaradoEscalar(epocaOuvida, ultimoConsumo, (int) e);
+		}
+
+		/*!
+			Método que soma as entradas enviadas em uma época: consumo previsto, último consumo e consumo previsto desligável por nível.
+			\param e é a época.
+			\param somas recebe as somas (somadas ao valor anterior). Somas tem os campos consumoPrevisto, ultimoConsumo e previstoDesligavel[NIVEIS].
+			\param consumoMensalMaior recebe o maior consumo mensal informado, se ele for maior que o valor anterior.
+			\param limiteMenor recebe o menor consumo máximo informado, se ele for menor que o valor anterior.
+			\param vetorial indica se as instruções vetoriais são usadas (só existem com SSE2).
+			\return Quantidade de entradas somadas.
+		*/
+		template <class Somas>
+		int somarEpoca(unsigned long e, Somas* somas, float* consumoMensalMaior, float* limiteMenor, bool vetorial = true) const {
+			int quantidade = 0;
+			float previsto[LARGURA_SOMA];
+			float ultimo[LARGURA_SOMA];
+			float desligaveis[NIVEIS][LARGURA_SOMA];
+			float maior[LARGURA_SOMA];
+			float menor[LARGURA_SOMA];
+#if defined(__SSE2__)
+			if (vetorial) {
+				__m128i alvo = _mm_set1_epi32((int) e);
+				__m128 vPrevisto = _mm_setzero_ps();
+				__m128 vUltimo = _mm_setzero_ps();
+				for (int n = 0; n < NIVEIS; n++) {
+					for (int k = 0; k < LARGURA_SOMA; k++) {
+						desligaveis[n][k] = 0;
+					}
+				}
+				__m128 vMaior = _mm_set1_ps(*consumoMensalMaior);
+				__m128 vMenor = _mm_set1_ps(*limiteMenor);
+				for (int i = 0; i < CAPACIDADE; i += LARGURA_SOMA) {
+					__m128i mascaraInteira = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (epoca + i)), alvo);
+					__m128 mascara = _mm_castsi128_ps(mascaraInteira);
+					__m128 p = _mm_and_ps(mascara, _mm_loadu_ps(consumoPrevisto + i));
+					vPrevisto = _mm_add_ps(vPrevisto, p);
+					vUltimo = _mm_add_ps(vUltimo, _mm_and_ps(mascara, _mm_loadu_ps(ultimoConsumo + i)));
+
+					// Cada parcela vai para o nível da sua entrada: a separação por nível é escalar, na mesma ordem da versão escalar.
+					float desligavelDoBloco[LARGURA_SOMA];
+					_mm_storeu_ps(desligavelDoBloco, _mm_and_ps(p, _mm_castsi128_ps(_mm_loadu_si128((const __m128i*) (desligavel + i)))));
+					for (int k = 0; k < LARGURA_SOMA; k++) {
+						desligaveis[nivel[i + k]][k] += desligavelDoBloco[k];
+					}
+
+					// Entradas fora da máscara ficam com o valor anterior, que não altera o máximo nem o mínimo.
+					vMaior = _mm_max_ps(vMaior, _mm_or_ps(_mm_and_ps(mascara, _mm_loadu_ps(consumoMensal + i)), _mm_andnot_ps(mascara, vMaior)));
+					vMenor = _mm_min_ps(vMenor, _mm_or_ps(_mm_and_ps(mascara, _mm_loadu_ps(maximoConsumoMensal + i)), _mm_andnot_ps(mascara, vMenor)));
+					int bits = _mm_movemask_ps(mascara);
+					quantidade += (bits & 1) + ((bits >> 1) & 1) + ((bits >> 2) & 1) + ((bits >> 3) & 1);
+				}
+				_mm_storeu_ps(previsto, vPrevisto);
+				_mm_storeu_ps(ultimo, vUltimo);
+				_mm_storeu_ps(maior, vMaior);
+				_mm_storeu_ps(menor, vMenor);
+			} else
+#endif
+			{
+				for (int k = 0; k < LARGURA_SOMA; k++) {
+					previsto[k] = 0;
+					ultimo[k] = 0;
+					for (int n = 0; n < NIVEIS; n++) {
+						desligaveis[n][k] = 0;
+					}
+					maior[k] = *consumoMensalMaior;
+					menor[k] = *limiteMenor;
+				}
+				for (int i = 0; i < CAPACIDADE; i++) {
+					if (epoca[i] != (int) e) {
+						continue;
+					}
+					int k = i % LARGURA_SOMA;
+					previsto[k] += consumoPrevisto[i];
+					ultimo[k] += ultimoConsumo[i];
+					if (desligavel[i]) {
+						desligaveis[nivel[i]][k] += consumoPrevisto[i];
+					}
+					if (consumoMensal[i] > maior[k]) {
+						maior[k] = consumoMensal[i];
+					}
+					if (maximoConsumoMensal[i] < menor[k]) {
+						menor[k] = maximoConsumoMensal[i];
+					}
+					quantidade++;
+				}
+			}
+			somas->consumoPrevisto += reduzir(previsto);
+			somas->ultimoConsumo += reduzir(ultimo);
+			for (int n = 0; n < NIVEIS; n++) {
+				somas->previstoDesligavel[n] += reduzir(desligaveis[n]);
+			}
+			for (int k = 0; k < LARGURA_SOMA; k++) {
+				if (maior[k] > *consumoMensalMaior) {
+					*consumoMensalMaior = maior[k];
+				}
+				if (menor[k] < *limiteMenor) {
+					*limiteMenor = menor[k];
+				}
+			}
+			return quantidade;
+		}
+};
+
+#endif
@@ -0,0 +1,159 @@
+// Copyright [2016] <Dúnia Marchiori(14200724) e Vinicius Steffani Schweitzer(14200768)>
+
+// Decodificador, para o computador, dos quadros do RegistroDeEventos enviados pelas tomadas por USB.
+// Compilação: g++ -o decodificadorRegistro decodificadorRegistro.cc
+// Uso: decodificadorRegistro < /dev/ttyACM0
+
+#include <cstdio>
+#include <cstring>
+
+#define INICIO_QUADRO_REGISTRO 0xA5 /*!< Primeiro byte de cada quadro. O mesmo valor de tomadasInteligentes.cc. */
+#define ARGUMENTOS_REGISTRO 5 /*!< Quantidade máxima de argumentos de um evento. O mesmo valor de tomadasInteligentes.cc. */
+#define BYTES_ENDERECO 2 /*!< Bytes do endereço NIC da EPOSMoteIII. */
+
+//!  Textos dos eventos
+/*!
+	Texto de cada evento, na ordem do enum Evento de tomadasInteligentes.cc.
+	Os argumentos são impressos por %d (inteiro), %f (número real) e %e (endereço).
+*/
+static const char* const textos[] = {
+	"Registros perdidos com o anel cheio: %d.",
+	"Nova raiz de tempo: %e",
+	"Raiz de tempo perdida.",
+	"Fila de envio cheia, mensagem descartada.",
+	"   Mensagem Recebida de %e",
+	"  Mensagens descartadas nas filas: %d recebidas, %d a enviar.",
+	"  Medidor: tensao RMS %d V, %d blocos perdidos.",
+	"    Soquete %d: corrente RMS %d% e pico %d% do fundo de escala.",
+	"Radio ligado na ultima hora: %d ms (%d%).",
+	"Fila de comandos pendentes cheia, comando descartado.",
+	"  Reacao ao alerta de %e em %d us (%d medidas, media %d us, maxima %d us).",
+	"Comando USB maior que %d caracteres, truncado.",
+	"  USB: %d bytes perdidos, %d linhas truncadas.",
+	"- Previsao.\n  Consumo efetivo do ultimo periodo: %f\n  Previsao propria ate o fim do mes: %d",
+	"- Entrando em sincronizacao (epoca %d).",
+	"  Placas sincronizadas.\n- Dados obtidos (%d tomadas vivas):",
+	"   Placa %e, soquete %d:\n    Consumo previsto: .. %d\n    Ultimo consumo: .... %f\n    Prioridade: ........ %d",
+	"- Dados proprios:\n   Placa %e:\n    Consumo previsto: .. %d\n    Ultimo consumo: .... %f",
+	"    Soquete %d: previsto %d, prioridade %d",
+	"- Tomada de decisao:\n  Consumo total deste mes ate o momento: ............... %d\n"
+		"  Consumo maximo permitido ate o final do mes: ......... %d\n  Consumo total previsto do sistema ate o fim do mes: .. %d",
+	"  Latencia da chegada das mensagens ao seu tratamento: %d medidas, media %d us, maxima %d us.",
+	"  Amostras descartadas: %d, comandos descartados: %d.",
+	"  Somas do sistema obtidas por gossip (%d vizinhos).",
+	"  Gossip sem peso nesta rodada, usando apenas os dados proprios.",
+	"  Sou chefe de cluster. Clusters ouvidos: %d, tomadas no sistema: %d.",
+	"  Decisao recebida do chefe %e. Tomadas no sistema: %d.",
+	"  Nenhuma decisao recebida do chefe %e, usando apenas os dados proprios.",
+	"  A previsao passa do limite.",
+	"  A previsao esta dentro do limite. Posso ligar.",
+	"  Estou configurada para nao desligar. Fico ligada.",
+	"  Tomadas expiradas: %d.",
+	"- Alerta de excesso recebido de %e.",
+	"  Epoca %d: %d tomadas no plano (resumo %d).\n  Tomadas que usaram a mesma visao na epoca anterior: %d de %d.",
+	"- Alerta: previsao do sistema passou do limite (%d).",
+	"   Soquete %d: No plano de corte devo ser desligada.",
+	"   Soquete %d: No plano de corte devo ser dimerizada para %f%.",
+	"   Soquete %d: No plano de corte posso ficar ligada.",
+	"Prioridade alterada.",
+	"Permissao para desligar alterada.",
+	"Relogio alterado",
+	"Modo de agregacao alterado.",
+	"Ciclo do radio alterado.",
+	"Consumo maximo alterado",
+	"Comando invalido",
+	"Gateway alterado (ativo: %d).",
+	"  Gateway: %d dados descartados.",
+	"- Consultando o historico de %e, soquete %d, camada %d, a partir do indice %d.",
+	"   %e soquete %d camada %d indice %d: %f",
+	"  Consulta de historico a %e concluida: %d entradas recebidas, %d ja fora do historico.",
+	"  Consulta de historico a %e sem resposta (camada %d, soquete %d). Retomar do indice %d.",
+	"Grupo de orcamento alterado para %d.",
+	"  Grupo %d: consumo do mes %d, limite %d.",
+	"Limite de potencia alterado.",
+	"- Soquete %d cortado pelo limite de pico (do grupo: %d): media de %d% do fundo de escala, %d us apos o primeiro sinal do excesso.",
+	"- Disparo do limite de pico em %e, soquete %d (%d% do fundo de escala).",
+	"  Disparos do limite de pico por latencia: ate 5 ms: %d, 5 a 10 ms: %d, 10 a 15 ms: %d, 15 a 20 ms: %d, 20 ms ou mais: %d.",
+	"Reproducao: %d registros perdidos neste ponto (anel da captura ou fila da reproducao cheios).",
+	"Reproducao: quadro da captura corrompido.",
+	"Reproducao concluida: %d voltas, media %d us, maxima %d us por volta.",
+	"  Proxima sincronizacao em %d min (proposta desta tomada: %d min), %d envios por janela (entrega medida: %d%, -1 antes da primeira medida).",
+	"Limites da adaptacao da sincronizacao alterados."
+};
+
+/*!
+	Função que imprime um evento, substituindo os argumentos no seu texto.
+	\param evento é o número do evento.
+	\param argumentos são os argumentos recebidos.
+	\param quantidade é a quantidade de argumentos.
+*/
+static void imprimirEvento(int evento, const unsigned int* argumentos, int quantidade) {
+	if (evento >= (int) (sizeof(textos) / sizeof(textos[0]))) {
+		printf("[evento desconhecido %d]\n", evento);
+		return;
+	}
+	int usado = 0;
+	for (const char* c = textos[evento]; *c != '\0'; c++) {
+		if ((*c != '%') || ((c[1] != 'd') && (c[1] != 'f') && (c[1] != 'e'))) {
+			putchar(*c);
+			continue;
+		}
+		c++;
+		if (usado >= quantidade) {
+			printf("?");
+			continue;
+		}
+		unsigned int valor = argumentos[usado++];
+		if (*c == 'd') {
+			printf("%d", (int) valor);
+		} else if (*c == 'f') {
+			float real;
+			memcpy(&real, &valor, sizeof real);
+			printf("%g", real);
+		} else {
+			for (int i = 0; i < BYTES_ENDERECO; i++) {
+				printf((i == 0) ? "%02x" : ":%02x", (valor >> (8 * i)) & 0xff);
+			}
+		}
+	}
+	putchar('\n');
+}
+
+/*!
+	Função inicial: lê a saída da tomada, decodifica os quadros do registro e repassa o resto (texto) como está.
+*/
+int main() {
+	int c;
+	while ((c = getchar()) != EOF) {
+		if (c != INICIO_QUADRO_REGISTRO) {
+			putchar(c);
+			continue;
+		}
+		int evento = getchar();
+		int tamanho = getchar();
+		if ((evento == EOF) || (tamanho == EOF) || (tamanho % 4 != 0) || (tamanho > ARGUMENTOS_REGISTRO * 4)) {
+			printf("[quadro invalido]\n");
+			continue;
+		}
+		unsigned char verificacao = (unsigned char) (evento ^ tamanho);
+		unsigned int argumentos[ARGUMENTOS_REGISTRO] = {0};
+		bool completo = true;
+		for (int i = 0; i < tamanho; i++) {
+			int b = getchar();
+			if (b == EOF) {
+				completo = false;
+				break;
+			}
+			verificacao ^= (unsigned char) b;
+			argumentos[i / 4] |= ((unsigned int) b) << (8 * (i % 4));
+		}
+		int recebida = completo ? getchar() : EOF;
+		if ((recebida == EOF) || ((unsigned char) recebida != verificacao)) {
+			printf("[quadro corrompido]\n");
+			continue;
+		}
+		imprimirEvento(evento, argumentos, tamanho / 4);
+		fflush(stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,416 @@
+// Copyright [2016] <Dúnia Marchiori(14200724) e Vinicius Steffani Schweitzer(14200768)>
+
+// Gravação, reprodução e comparação, no computador, das capturas de tráfego de uma tomada (CAPTURA_TRAFEGO em tomadasInteligentes.cc).
+// Uma captura é um arquivo com os quadros [0xA7][tipo][tamanho][dados][verificação] como a tomada os enviou.
+// Compilação: g++ -o reprodutorTrafego reprodutorTrafego.cc
+// Uso: reprodutorTrafego gravar traco.trc < /dev/ttyACM0 | decodificadorRegistro
+//      reprodutorTrafego listar traco.trc
+//      reprodutorTrafego reproduzir traco.trc /dev/ttyACM0 saida.trc | decodificadorRegistro   (placa gravada com REPRODUCAO_TRAFEGO)
+//      reprodutorTrafego comparar traco.trc saida.trc
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#define INICIO_QUADRO_CAPTURA 0xA7 /*!< Primeiro byte de cada quadro. O mesmo valor de tomadasInteligentes.cc. */
+#define INICIO_QUADRO_REGISTRO 0xA5 /*!< Primeiro byte dos quadros do registro, repassados como estão. */
+#define INICIO_QUADRO_TELEMETRIA 0xA6 /*!< Primeiro byte dos quadros de telemetria, repassados como estão. */
+#define TAMANHO_MAXIMO_QUADRO (255 + 4) /*!< Bytes do maior quadro. */
+#define CAPTURA_INICIO 0 /*!< Tipos dos registros. Os mesmos valores de tomadasInteligentes.cc. */
+#define CAPTURA_PASSO 1
+#define CAPTURA_RECEBIDO 2
+#define CAPTURA_ENVIADO 3
+#define CAPTURA_COMANDO 4
+#define CAPTURA_AMOSTRA 5
+#define CAPTURA_DISPARO 6
+#define CAPTURA_PERDA 7
+#define CAPTURA_FIM 8
+
+//!  Classe Separador
+/*!
+	Separa, byte a byte, os quadros da captura do resto da saída da tomada (texto e quadros do registro e do gateway).
+	Os quadros do registro e do gateway são repassados inteiros, então um byte INICIO_QUADRO_CAPTURA nos seus dados não é confundido com um quadro da captura.
+	Um quadro da captura só é aceito com a verificação certa; senão, seus bytes são devolvidos como texto.
+*/
+class Separador {
+	private:
+		unsigned char quadro[TAMANHO_MAXIMO_QUADRO]; /*!< Quadro sendo recebido. */
+		int recebidos; /*!< Bytes do quadro atual já recebidos; 0 fora de um quadro. */
+
+		/*!
+			Método que retorna o tamanho do quadro atual, ou 0 se ainda não é conhecido.
+		*/
+		int tamanhoDoQuadro() {
+			if (quadro[0] == INICIO_QUADRO_TELEMETRIA) {
+				return (recebidos >= 2) ? (quadro[1] + 3) : 0; // [início][tamanho][dados][verificação]
+			}
+			return (recebidos >= 3) ? (quadro[2] + 4) : 0; // [início][tipo ou evento][tamanho][dados][verificação]
+		}
+
+	public:
+		unsigned long corrompidos; /*!< Quadros descartados pela verificação. */
+
+		/*!
+			Método construtor da classe.
+		*/
+		Separador() {
+			recebidos = 0;
+			corrompidos = 0;
+		}
+
+		/*!
+			Método que trata um byte.
+			\param c é o byte.
+			\param texto recebe os bytes a repassar como texto.
+			\param quantidadeTexto recebe a quantidade de bytes em texto.
+			\return Tamanho do quadro completado por este byte (em quadro), ou 0.
+		*/
+		int tratar(unsigned char c, unsigned char* texto, int* quantidadeTexto) {
+			*quantidadeTexto = 0;
+			if (recebidos == 0) {
+				if ((c == INICIO_QUADRO_CAPTURA) || (c == INICIO_QUADRO_REGISTRO) || (c == INICIO_QUADRO_TELEMETRIA)) {
+					quadro[recebidos++] = c;
+				} else {
+					texto[(*quantidadeTexto)++] = c;
+				}
+				return 0;
+			}
+			quadro[recebidos++] = c;
+			int tamanho = tamanhoDoQuadro();
+			if ((tamanho == 0) || (recebidos < tamanho)) {
+				return 0;
+			}
+			recebidos = 0;
+			if (quadro[0] != INICIO_QUADRO_CAPTURA) {
+				memcpy(texto, quadro, tamanho);
+				*quantidadeTexto = tamanho;
+				return 0;
+			}
+			unsigned char verificacao = 0;
+			for (int i = 1; i < tamanho - 1; i++) {
+				verificacao ^= quadro[i];
+			}
+			if (verificacao == quadro[tamanho - 1]) {
+				return tamanho;
+			}
+			corrompidos++;
+			memcpy(texto, quadro, tamanho);
+			*quantidadeTexto = tamanho;
+			return 0;
+		}
+
+		/*!
+			Método que retorna o último quadro completo.
+		*/
+		const unsigned char* getQuadro() {
+			return quadro;
+		}
+};
+
+/*!
+	Função que lê um valor em little-endian.
+*/
+static unsigned int ler(const unsigned char* dados, int bytes) {
+	unsigned int valor = 0;
+	for (int b = 0; b < bytes; b++) {
+		valor |= ((unsigned int) dados[b]) << (8 * b);
+	}
+	return valor;
+}
+
+/*!
+	Função que lê o próximo quadro de um arquivo de captura.
+	\return Tamanho do quadro, 0 no fim do arquivo ou -1 se o arquivo está corrompido.
+*/
+static int lerQuadro(FILE* arquivo, unsigned char* quadro) {
+	if (fread(quadro, 1, 3, arquivo) != 3) {
+		return 0;
+	}
+	if ((quadro[0] != INICIO_QUADRO_CAPTURA) || (fread(quadro + 3, 1, quadro[2] + 1, arquivo) != (size_t) (quadro[2] + 1))) {
+		return -1;
+	}
+	return quadro[2] + 4;
+}
+
+/*!
+	Função que imprime um registro da captura.
+	\param tempo é o tempo da volta do registro, em microssegundos desde a inicialização da placa.
+*/
+static void imprimir(const unsigned char* quadro, unsigned long long tempo) {
+	const unsigned char* dados = quadro + 3;
+	int tamanho = quadro[2];
+	printf("%12llu ", tempo);
+	switch (quadro[1]) {
+		case CAPTURA_INICIO:
+			printf("inicio: versao %d, %d soquetes, endereco", dados[0], dados[1]);
+			for (int i = 0; (i < dados[2]) && (3 + i < tamanho); i++) {
+				printf((i == 0) ? " %02x" : ":%02x", dados[3 + i]);
+			}
+			printf("\n");
+			return;
+		case CAPTURA_PASSO:
+			printf("passo\n");
+			return;
+		case CAPTURA_RECEBIDO:
+			printf("recebido: protocolo %04x, %d us na fila, %d bytes\n", ler(dados, 2), (int) ler(dados + 2, 4), tamanho - 6);
+			return;
+		case CAPTURA_ENVIADO:
+			printf("enviado: %d bytes\n", tamanho);
+			return;
+		case CAPTURA_COMANDO:
+			printf("comando: %.*s\n", tamanho, (const char*) dados);
+			return;
+		case CAPTURA_AMOSTRA:
+			printf("amostra:");
+			for (int i = 0; i < tamanho / 8; i++) {
+				float consumo;
+				float nivel;
+				unsigned int bits = ler(dados + 4 * i, 4);
+				memcpy(&consumo, &bits, 4);
+				bits = ler(dados + tamanho / 2 + 4 * i, 4);
+				memcpy(&nivel, &bits, 4);
+				printf(" %g (%g)", consumo, nivel);
+			}
+			printf("\n");
+			return;
+		case CAPTURA_DISPARO:
+			printf("disparo: soquete %d, grupo %d, passos %d, potencia %d%%, latencia %d us\n", dados[0], dados[1], dados[2], (int) ler(dados + 4, 4), (int) ler(dados + 8, 4));
+			return;
+		case CAPTURA_PERDA:
+			printf("perda: %u registros\n", ler(dados, 4));
+			return;
+		case CAPTURA_FIM:
+			printf("fim\n");
+			return;
+	}
+	printf("tipo desconhecido %d, %d bytes\n", quadro[1], tamanho);
+}
+
+/*!
+	Função que avança o tempo das voltas com um registro CAPTURA_PASSO (tempo desde o passo anterior, 7 bits por byte).
+*/
+static void avancar(const unsigned char* quadro, unsigned long long* tempo) {
+	unsigned long long decorrido = 0;
+	for (int i = 0; (i < quadro[2]) && (i < 10); i++) {
+		decorrido |= ((unsigned long long) (quadro[3 + i] & 0x7f)) << (7 * i);
+	}
+	*tempo += decorrido;
+}
+
+/*!
+	Função que grava os quadros da captura lidos da entrada padrão e repassa o resto.
+*/
+static int gravar(const char* nome) {
+	FILE* arquivo = fopen(nome, "wb");
+	if (arquivo == 0) {
+		fprintf(stderr, "Nao foi possivel criar o arquivo %s.\n", nome);
+		return 1;
+	}
+	Separador separador;
+	unsigned char bloco[4096];
+	unsigned char texto[TAMANHO_MAXIMO_QUADRO];
+	unsigned long quadros = 0;
+	ssize_t lidos;
+	while ((lidos = read(STDIN_FILENO, bloco, sizeof bloco)) > 0) {
+		for (ssize_t i = 0; i < lidos; i++) {
+			int quantidadeTexto;
+			int tamanho = separador.tratar(bloco[i], texto, &quantidadeTexto);
+			fwrite(texto, 1, quantidadeTexto, stdout);
+			if (tamanho > 0) {
+				fwrite(separador.getQuadro(), 1, tamanho, arquivo);
+				quadros++;
+			}
+		}
+		fflush(stdout);
+		fflush(arquivo);
+	}
+	fclose(arquivo);
+	fprintf(stderr, "%lu quadros gravados, %lu corrompidos.\n", quadros, separador.corrompidos);
+	return 0;
+}
+
+/*!
+	Função que imprime os registros de uma captura.
+*/
+static int listar(const char* nome) {
+	FILE* arquivo = fopen(nome, "rb");
+	if (arquivo == 0) {
+		fprintf(stderr, "Nao foi possivel abrir o arquivo %s.\n", nome);
+		return 1;
+	}
+	unsigned char quadro[TAMANHO_MAXIMO_QUADRO];
+	unsigned long long tempo = 0;
+	int tamanho;
+	while ((tamanho = lerQuadro(arquivo, quadro)) > 0) {
+		if (quadro[1] == CAPTURA_PASSO) {
+			avancar(quadro, &tempo);
+		}
+		imprimir(quadro, tempo);
+	}
+	fclose(arquivo);
+	if (tamanho < 0) {
+		fprintf(stderr, "Arquivo corrompido.\n");
+		return 1;
+	}
+	return 0;
+}
+
+/*!
+	Função que envia uma captura a uma placa com REPRODUCAO_TRAFEGO, seguida de CAPTURA_FIM, e grava a captura feita pela placa durante a reprodução.
+	A placa só retira bytes do USB enquanto cabem no seu buffer; o envio espera enquanto isso.
+*/
+static int reproduzir(const char* nome, const char* dispositivo, const char* nomeSaida) {
+	FILE* arquivo = fopen(nome, "rb");
+	FILE* saida = fopen(nomeSaida, "wb");
+	int placa = open(dispositivo, O_RDWR | O_NOCTTY);
+	if ((arquivo == 0) || (saida == 0) || (placa < 0)) {
+		fprintf(stderr, "Nao foi possivel abrir %s, %s ou %s.\n", nome, dispositivo, nomeSaida);
+		return 1;
+	}
+	unsigned char enviar[TAMANHO_MAXIMO_QUADRO];
+	int tamanhoEnviar = 0;
+	int enviados = 0;
+	bool fimEnviado = false;
+	bool fimRecebido = false;
+	Separador separador;
+	unsigned char bloco[4096];
+	unsigned char texto[TAMANHO_MAXIMO_QUADRO];
+	while (!fimRecebido) {
+		if ((enviados == tamanhoEnviar) && !fimEnviado) {
+			tamanhoEnviar = lerQuadro(arquivo, enviar);
+			if (tamanhoEnviar < 0) {
+				fprintf(stderr, "Arquivo corrompido.\n");
+				return 1;
+			}
+			if (tamanhoEnviar == 0) {
+				unsigned char fim[4] = {INICIO_QUADRO_CAPTURA, CAPTURA_FIM, 0, CAPTURA_FIM};
+				memcpy(enviar, fim, sizeof fim);
+				tamanhoEnviar = sizeof fim;
+				fimEnviado = true;
+			}
+			enviados = 0;
+		}
+		struct pollfd espera;
+		espera.fd = placa;
+		espera.events = POLLIN | ((enviados < tamanhoEnviar) ? POLLOUT : 0);
+		if (poll(&espera, 1, -1) < 0) {
+			perror("poll");
+			return 1;
+		}
+		if (espera.revents & POLLOUT) {
+			ssize_t escritos = write(placa, enviar + enviados, tamanhoEnviar - enviados);
+			if (escritos > 0) {
+				enviados += escritos;
+			}
+		}
+		if (espera.revents & (POLLIN | POLLHUP)) {
+			ssize_t lidos = read(placa, bloco, sizeof bloco);
+			if (lidos <= 0) {
+				break;
+			}
+			for (ssize_t i = 0; i < lidos; i++) {
+				int quantidadeTexto;
+				int tamanho = separador.tratar(bloco[i], texto, &quantidadeTexto);
+				fwrite(texto, 1, quantidadeTexto, stdout);
+				if (tamanho > 0) {
+					fwrite(separador.getQuadro(), 1, tamanho, saida);
+					fimRecebido = fimRecebido || (separador.getQuadro()[1] == CAPTURA_FIM);
+				}
+			}
+			fflush(stdout);
+		}
+	}
+	close(placa);
+	fclose(arquivo);
+	fclose(saida);
+	if (!fimRecebido) {
+		fprintf(stderr, "A placa parou antes do fim da reproducao.\n");
+		return 1;
+	}
+	return 0;
+}
+
+/*!
+	Função que lê o próximo registro comparável de uma captura: CAPTURA_INICIO e CAPTURA_FIM são pulados e o tempo das voltas é acumulado.
+*/
+static int proximoComparavel(FILE* arquivo, unsigned char* quadro, unsigned long long* tempo) {
+	int tamanho;
+	while ((tamanho = lerQuadro(arquivo, quadro)) > 0) {
+		if (quadro[1] == CAPTURA_PASSO) {
+			avancar(quadro, tempo);
+		}
+		if ((quadro[1] != CAPTURA_INICIO) && (quadro[1] != CAPTURA_FIM)) {
+			break;
+		}
+	}
+	return tamanho;
+}
+
+/*!
+	Função que compara duas capturas registro a registro e mostra a primeira divergência.
+	Uma reprodução fiel da captura original tem exatamente os mesmos registros, inclusive as mensagens enviadas.
+*/
+static int comparar(const char* nomeA, const char* nomeB) {
+	FILE* a = fopen(nomeA, "rb");
+	FILE* b = fopen(nomeB, "rb");
+	if ((a == 0) || (b == 0)) {
+		fprintf(stderr, "Nao foi possivel abrir %s ou %s.\n", nomeA, nomeB);
+		return 1;
+	}
+	unsigned char quadroA[TAMANHO_MAXIMO_QUADRO];
+	unsigned char quadroB[TAMANHO_MAXIMO_QUADRO];
+	unsigned long long tempoA = 0;
+	unsigned long long tempoB = 0;
+	unsigned long registros = 0;
+	while (true) {
+		int tamanhoA = proximoComparavel(a, quadroA, &tempoA);
+		int tamanhoB = proximoComparavel(b, quadroB, &tempoB);
+		if ((tamanhoA < 0) || (tamanhoB < 0)) {
+			fprintf(stderr, "Arquivo corrompido.\n");
+			return 1;
+		}
+		if ((tamanhoA == 0) && (tamanhoB == 0)) {
+			printf("Capturas iguais: %lu registros.\n", registros);
+			return 0;
+		}
+		if ((tamanhoA != tamanhoB) || (memcmp(quadroA, quadroB, tamanhoA) != 0)) {
+			printf("Primeira divergencia no registro %lu:\n", registros);
+			printf("%s: ", nomeA);
+			if (tamanhoA > 0) {
+				imprimir(quadroA, tempoA);
+			} else {
+				printf("fim\n");
+			}
+			printf("%s: ", nomeB);
+			if (tamanhoB > 0) {
+				imprimir(quadroB, tempoB);
+			} else {
+				printf("fim\n");
+			}
+			return 2;
+		}
+		registros++;
+	}
+}
+
+/*!
+	Função inicial.
+*/
+int main(int argc, char** argv) {
+	if ((argc == 3) && (strcmp(argv[1], "gravar") == 0)) {
+		return gravar(argv[2]);
+	} else if ((argc == 3) && (strcmp(argv[1], "listar") == 0)) {
+		return listar(argv[2]);
+	} else if ((argc == 5) && (strcmp(argv[1], "reproduzir") == 0)) {
+		return reproduzir(argv[2], argv[3], argv[4]);
+	} else if ((argc == 4) && (strcmp(argv[1], "comparar") == 0)) {
+		return comparar(argv[2], argv[3]);
+	}
+	fprintf(stderr, "Uso: %s gravar traco.trc < saida_da_tomada\n"
+		"     %s listar traco.trc\n"
+		"     %s reproduzir traco.trc dispositivo saida.trc\n"
+		"     %s comparar traco.trc saida.trc\n", argv[0], argv[0], argv[0], argv[0]);
+	return 1;
+}
@@ -9,14 +9,157 @@
 #include <utility/math.h>
 #include <utility/string.h>
 #include <alarm.h>
+#include <thread.h>
+#include <semaphore.h>
+#include "colunasDaTabela.h"
 
 #define NUMERO_ENTRADAS_HISTORICO 28 /*!< Quantidade de entradas no histórico. Cada entrada corresponde ao consumo entre uma sincronização e outra. */
-#define NUMERO_CHAR_CONFIG 40 /*!< Quantidade máxima de caracteres por mensagem. */
-
-#define MIN_ENTRE_SINC 20 /*!< Tempo entre sincronizações em minutos. */
+#define NUMERO_HORAS_HISTORICO 48 /*!< Quantidade de horas guardadas no histórico, com o consumo médio por período de cada hora. */
+#define NUMERO_DIAS_HISTORICO 28 /*!< Quantidade de dias guardados no histórico, com o consumo médio por período de cada dia. */
+#define SEM_DADOS -1.0f /*!< Valor das horas e dias do histórico em que a tomada não esteve ligada. */
+#define PESO_PREVISAO_RECENTE 0.25f /*!< Peso dos últimos períodos na previsão quando há uma semana (ou um dia) completa no histórico. */
+#define NUMERO_CHAR_CONFIG 40 /*!< Quantidade máxima de caracteres por mensagem, incluindo o '\0' final. */
+
+#define MIN_POR_EPOCA 5 /*!< Duração (em minutos) de uma época. As sincronizações acontecem no início de uma época, a cada AdaptacaoDaSincronizacao::getEpocasEntreSincs() épocas, e o histórico e as previsões contam o consumo por época. */
+#define EPOCAS_ENTRE_SINC_PADRAO 4 /*!< Épocas entre sincronizações antes da primeira medida da variação da previsão (20 minutos). Potência de 2. */
+#define EPOCAS_ENTRE_SINC_MAXIMO 16 /*!< Maior quantidade de épocas entre sincronizações (80 minutos). Potência de 2 que divide as épocas de um dia, para que as sincronizações fiquem alinhadas ao início do mês. */
+#define DESVIOS_FOLGA 3 /*!< A folga até o limite deve cobrir esta quantidade de desvios padrão da variação da previsão do sistema até a próxima sincronização. */
+#define PESO_VARIACAO_PREVISAO 0.25f /*!< Peso da última medida na média móvel da variância da previsão do sistema. */
+#define REPETICOES_SINC_MINIMO 3 /*!< Menor quantidade padrão de envios dos dados em cada janela de sincronização. */
+#define REPETICOES_SINC_MAXIMO 15 /*!< Maior quantidade de envios dos dados em cada janela de sincronização, usada enquanto a taxa de entrega não foi medida. Cabe no carimbo. */
+#define ENTREGA_ALVO 0.999f /*!< Probabilidade desejada de que pelo menos um dos envios de uma janela chegue a cada vizinha. */
+#define PESO_TAXA_ENTREGA 0.25f /*!< Peso da última janela na média móvel da taxa de entrega. */
 #define SEGS_ENTRE_CONSUMO 10 /*!< Intervalo de tempo em segundos entre cada checagem do consumo. */
 #define INTERVALO_ENVIO_MENSAGENS 1 /*!< Intervalo (em minutos) em que as tomadas trocam mensagens para garantir sua sincronização. */
 
+#define CALENDARIO_SINCRONIZACAO 1 /*!< Evento do calendário: começou uma nova época (hora de sincronizar). */
+#define CALENDARIO_PERIODO 2 /*!< Evento do calendário: começou outro quarto do dia (madrugada, manhã, tarde ou noite). */
+#define CALENDARIO_HORA 4 /*!< Evento do calendário: começou outra hora. */
+#define CALENDARIO_MES 8 /*!< Evento do calendário: começou outro mês. */
+#define CALENDARIO_EPOCA 16 /*!< Evento do calendário: começou outra época de MIN_POR_EPOCA minutos. */
+
+#define NUMERO_PONTOS_REGRESSAO 8 /*!< Quantidade de pares (tempo local, diferença para a raiz) usados na estimativa da taxa do relógio. */
+#define INTERVALO_CORRECAO_TAXA 600 /*!< Intervalo mínimo (em segundos) entre o primeiro e o último ponto para que a taxa do relógio seja corrigida. */
+#define LIMIAR_SINCRONIZADA 2000 /*!< Erro máximo (em microssegundos) do último ajuste para que o relógio seja considerado sincronizado. */
+#define JANELA_SINC_SINCRONIZADA 5000 /*!< Duração (em milissegundos) da janela de sincronização quando o relógio está sincronizado com a raiz. */
+
+#define PERIODO_ESCUTA_PADRAO 10 /*!< Intervalo (em segundos) entre as janelas de escuta do rádio fora da sincronização, quando o ciclo de rádio está ativo. */
+#define JANELA_ESCUTA_PADRAO 500 /*!< Duração (em milissegundos) de cada janela de escuta do rádio fora da sincronização. */
+#define NUMERO_COMANDOS_PENDENTES 4 /*!< Quantidade de comandos que podem aguardar a próxima janela de escuta para serem reenviados. */
+#define REPETICOES_COMANDO 3 /*!< Quantidade de janelas de escuta em que cada comando pendente é reenviado. */
+
+#define TAMANHO_FILA_RECEBIDOS 8 /*!< Capacidade (mais um) da fila de mensagens recebidas, da tarefa do rádio para a de decisão. */
+#define TAMANHO_FILA_ENVIO 8 /*!< Capacidade (mais um) da fila de mensagens a enviar, da tarefa de decisão para a do rádio. */
+#define TAMANHO_FILA_AMOSTRAS 8 /*!< Capacidade (mais um) da fila de amostras de consumo, da tarefa de amostragem para a de decisão. */
+#define TAMANHO_FILA_COMANDOS 4 /*!< Capacidade (mais um) da fila de comandos recebidos por USB, da tarefa de comandos para a de decisão. */
+
+#define TAMANHO_BUFFER_USB 512 /*!< Capacidade (mais um) do buffer de bytes recebidos por USB. Comporta vários comandos colados de uma vez. */
+#define PERIODO_LEITURA_USB 1000 /*!< Intervalo (em microssegundos) entre as leituras do USB feitas pela interrupção do alarme. */
+
+#define NIVEL_REGISTRO_ERRO 0 /*!< Nível dos eventos de perda de dados (filas cheias, descartes). */
+#define NIVEL_REGISTRO_AVISO 1 /*!< Nível dos eventos que mudam o estado da tomada (alertas, decisões, comandos). */
+#define NIVEL_REGISTRO_INFO 2 /*!< Nível dos resumos de cada sincronização. */
+#define NIVEL_REGISTRO_DEPURACAO 3 /*!< Nível dos eventos por mensagem recebida e por entrada da tabela. */
+#define NIVEL_REGISTRO NIVEL_REGISTRO_INFO /*!< Maior nível gravado no registro. Os pontos de registro de nível maior são removidos na compilação. */
+#define TAMANHO_REGISTRO 64 /*!< Quantidade de eventos no anel do registro (potência de 2). */
+#define ARGUMENTOS_REGISTRO 5 /*!< Quantidade máxima de argumentos de um evento do registro. */
+#define INICIO_QUADRO_REGISTRO 0xA5 /*!< Primeiro byte de cada quadro do registro enviado por USB. Não aparece em texto ASCII. */
+
+#define INICIO_QUADRO_TELEMETRIA 0xA6 /*!< Primeiro byte de cada quadro de telemetria enviado por USB no modo gateway. */
+#define TAMANHO_FILA_TELEMETRIA 12 /*!< Capacidade (mais um) da fila de dados a encaminhar no modo gateway. Comporta uma MensagemRegua completa; a interrupção do leitor USB a esvazia a cada PERIODO_LEITURA_USB. */
+#define TELEMETRIA_PODE_DESLIGAR 1 /*!< Indicador de telemetria: o soquete pode ser desligado. */
+#define TELEMETRIA_TEM_DIMMER 2 /*!< Indicador de telemetria: o soquete tem dimmer. */
+#define TELEMETRIA_PROPRIA 4 /*!< Indicador de telemetria: os dados são do próprio gateway. */
+
+#define CAPTURA_TRAFEGO 0 /*!< 1 captura, desde a inicialização, todas as entradas da tarefa de decisão e as mensagens enviadas, e as envia por USB (CapturaDeTrafego). */
+#define REPRODUCAO_TRAFEGO 0 /*!< 1 faz a placa reproduzir, sob tempo virtual, o tráfego capturado por outra placa e recebido por USB, em vez de trabalhar (Gerente::reproduzir()). */
+#define TAMANHO_ANEL_CAPTURA 1024 /*!< Bytes do anel da captura (potência de 2). Só é alocado com CAPTURA_TRAFEGO, que, por ser um modo de depuração, pode passar do ORCAMENTO_RAM por este tamanho. */
+#define INICIO_QUADRO_CAPTURA 0xA7 /*!< Primeiro byte de cada quadro da captura enviado (ou recebido, na reprodução) por USB. */
+#define VERSAO_CAPTURA 1 /*!< Versão do formato da captura, gravada no registro CAPTURA_INICIO. */
+#define CAPTURA_INICIO 0 /*!< Registro da captura: versão, soquetes e endereço da placa, no início. */
+#define CAPTURA_PASSO 1 /*!< Registro da captura: nova volta do laço de decisão, com o tempo (microssegundos) desde a volta anterior gravada. */
+#define CAPTURA_RECEBIDO 2 /*!< Registro da captura: mensagem tratada pela tarefa de decisão, com o protocolo e o tempo desde a chegada. */
+#define CAPTURA_ENVIADO 3 /*!< Registro da captura: mensagem enviada, com o destino e o protocolo. */
+#define CAPTURA_COMANDO 4 /*!< Registro da captura: comando recebido por USB. */
+#define CAPTURA_AMOSTRA 5 /*!< Registro da captura: consumo e dimmerização de cada soquete em uma amostra. */
+#define CAPTURA_DISPARO 6 /*!< Registro da captura: corte feito pelo limite de pico. */
+#define CAPTURA_PERDA 7 /*!< Registro da captura: registros descartados com o anel cheio neste ponto. */
+#define CAPTURA_FIM 8 /*!< Registro da captura: fim do tráfego, enviado à placa que reproduz. */
+
+#define TAXA_AMOSTRAGEM 1000 /*!< Amostras de tensão e corrente por segundo. */
+#define AMOSTRAS_POR_BLOCO 100 /*!< Amostras em cada metade do buffer duplo. A tarefa de amostragem integra um bloco por vez. */
+#define FREQUENCIA_REDE 60 /*!< Frequência da rede elétrica em Hz. */
+#define TENSAO_REDE 127 /*!< Tensão RMS da rede em volts. */
+#define TENSAO_FUNDO_ESCALA 200 /*!< Tensão de pico (em volts) que corresponde ao fundo de escala do conversor. */
+#define ENERGIA_FUNDO_ESCALA 2.0f /*!< Consumo em SEGS_ENTRE_CONSUMO segundos com tensão e corrente senoidais, em fase e no fundo de escala. Calibração da integração. */
+#define BITS_TABELA_SENO 6 /*!< A tabela de seno do gerador de sinal tem 2^BITS_TABELA_SENO pontos por ciclo. */
+#define CHANCE_PICO 600 /*!< Em média, um a cada CHANCE_PICO blocos simulados tem um pico de carga. */
+#define FATOR_PICO 3 /*!< Multiplicador da carga simulada durante um pico. */
+#define AMOSTRAS_JANELA_POTENCIA 25 /*!< Amostras da média móvel de potência comparada ao limite de pico na interrupção de amostragem. 25 ms são três ciclos exatos da potência instantânea (120 Hz), que assim não ondula na média. */
+#define POTENCIA_FUNDO_ESCALA 16384 /*!< Potência média (Q15) com tensão e corrente senoidais, em fase e no fundo de escala. Os limites de pico são dados em % dela. */
+#define FAIXAS_HISTOGRAMA_DISPARO 5 /*!< Faixas do histograma da latência dos disparos do limite de pico. Cabe em um evento do registro (ARGUMENTOS_REGISTRO). */
+#define LARGURA_FAIXA_DISPARO 5000 /*!< Largura (em microssegundos) de cada faixa do histograma de disparo. A última faixa inclui as latências maiores. O mesmo valor do texto do decodificador. */
+
+#define PASSOS_PWM_DIMMER 32 /*!< Níveis da saída do dimmer: cada período da saída tem PASSOS_PWM_DIMMER interrupções. */
+#define PERIODO_TICK_DIMMER 260 /*!< Intervalo (em microssegundos) entre as interrupções do dimmer. PASSOS_PWM_DIMMER interrupções duram cerca de meio ciclo da rede. */
+#define NIVEIS_RAMPA_DIMMER 1 /*!< Quantidade máxima de níveis que a saída do dimmer anda a cada período (rampa). */
+#define DIMERIZACAO_MINIMA 0.1f /*!< Menor dimmerização aplicada. Quando o plano precisaria de menos, a tomada é desligada. */
+#define PORTA_DIMMER 'B' /*!< Porta GPIO das saídas dos dimmers. */
+#define PINO_DIMMER 0 /*!< Pino GPIO da saída do primeiro dimmer. Os seguintes usam os próximos pinos. */
+
+#define TAMANHO_PILHA_TAREFA 1024 /*!< Tamanho (em bytes) da pilha de cada tarefa criada pelo gerente (rádio, amostragem e comandos). */
+
+#define ORCAMENTO_RAM 25600 /*!< Máximo de bytes de RAM que os objetos do controlador (Gerente, tomada e tudo o que eles contêm) podem ocupar. Verificado em tempo de compilação. */
+
+#define NUMERO_MAXIMO_TOMADAS 64 /*!< Quantidade máxima de tomadas (incluindo a própria) consideradas no plano de corte. A tabela guarda no máximo NUMERO_MAXIMO_TOMADAS - 1 outras tomadas. */
+#define NUMERO_SOQUETES 1 /*!< Quantidade de soquetes desta placa. Com mais de um, a placa é uma régua: um único gerente controla todos os soquetes. */
+#define NUMERO_MAXIMO_SOQUETES 8 /*!< Quantidade máxima de soquetes em uma régua. Fixa o formato das mensagens PROTOCOLO_REGUA. */
+#define NUMERO_GRUPOS 16 /*!< Quantidade de grupos de orçamento (0 a NUMERO_GRUPOS - 1). Tomadas de grupos diferentes dividem o rádio, mas cada grupo tem seu próprio limite e suas próprias decisões. */
+#define SINCS_PARA_EXPIRAR 3 /*!< Quantidade de sincronizações sem ouvir uma tomada após a qual sua entrada é removida da tabela. */
+
+#define PROTOCOLO_DADOS 0x88f7 /*!< Protocolo NIC das mensagens com Dados (o mesmo valor de NIC::PTP, usado originalmente). */
+#define PROTOCOLO_AGREGACAO 0x88f8 /*!< Protocolo NIC das mensagens de agregação por gossip (push-sum). */
+#define PROTOCOLO_CLUSTER 0x88f9 /*!< Protocolo NIC das mensagens trocadas no modo de agregação hierárquica. */
+#define PROTOCOLO_ALERTA 0x88fa /*!< Protocolo NIC dos alertas de excesso, tratados assim que recebidos. */
+#define PROTOCOLO_REGUA 0x88fb /*!< Protocolo NIC das mensagens com os dados de todos os soquetes de uma placa, enviadas na sincronização. */
+#define PROTOCOLO_HISTORICO 0x88fc /*!< Protocolo NIC dos pedidos e respostas de consulta ao histórico de outra tomada, trocados só quando alguém pede. */
+
+#define NUMERO_ALERTAS_LEMBRADOS 8 /*!< Quantidade de alertas recentes lembrados para que cada alerta seja tratado e repassado uma única vez. */
+#define REPETICOES_ALERTA 3 /*!< Quantidade de janelas de escuta em que a tomada que detectou o excesso repete o alerta, quando o ciclo de rádio está ativo. */
+#define ALERTA_EXCESSO_PREVISTO 0 /*!< Alerta de que a previsão do sistema passou do limite mensal. */
+#define ALERTA_DISPARO_POTENCIA 1 /*!< Aviso de que um soquete da origem foi cortado pelo limite de pico de potência. */
+
+#define NUMERO_NIVEIS_PRIORIDADE 8 /*!< Quantidade de níveis de prioridade distinguidos na agregação. Prioridades maiores são somadas no último nível. */
+#define NUMERO_VIZINHOS_GOSSIP 8 /*!< Quantidade de vizinhos lembrados para a escolha do destino de cada rodada de gossip. */
+
+#define AGREGACAO_DIRETA 0 /*!< Modo em que cada tomada recebe os dados de todas as outras. */
+#define AGREGACAO_GOSSIP 1 /*!< Modo em que as somas do sistema são calculadas por gossip (push-sum). */
+#define AGREGACAO_HIERARQUICA 2 /*!< Modo em que as tomadas se dividem em clusters e apenas os chefes trocam as somas de seus clusters. */
+
+#define NUMERO_MAXIMO_CLUSTERS 16 /*!< Quantidade máxima de outros clusters cujas somas um chefe guarda. */
+
+#define CLUSTER_ANUNCIO 0 /*!< Mensagem de cluster que anuncia uma tomada às vizinhas. */
+#define CLUSTER_CHEFE 1 /*!< Mensagem de cluster com que uma tomada se anuncia como chefe. */
+#define CLUSTER_AGREGADO 2 /*!< Mensagem de cluster com as somas de um cluster, trocada entre chefes. */
+#define CLUSTER_DECISAO 3 /*!< Mensagem de cluster com a decisão resumida, enviada do chefe aos membros. */
+
+#define HISTORICO_PEDIDO 0 /*!< Mensagem de histórico que pede um trecho de uma camada do histórico de um soquete. */
+#define HISTORICO_RESPOSTA 1 /*!< Mensagem de histórico com um pedaço do trecho pedido. */
+
+#define CAMADA_PERIODOS 0 /*!< Camada do histórico com o consumo de cada período entre sincronizações. */
+#define CAMADA_HORAS 1 /*!< Camada do histórico com o consumo médio por período de cada hora. */
+#define CAMADA_DIAS 2 /*!< Camada do histórico com o consumo médio por período de cada dia. */
+
+#define VALORES_POR_QUADRO_HISTORICO 12 /*!< Quantidade máxima de entradas do histórico em cada resposta. Mantém a MensagemHistorico menor que a MensagemRegua. */
+#define TEMPO_REENVIO_HISTORICO 2000 /*!< Tempo (em milissegundos) sem resposta após o qual o pedido de histórico é repetido a partir da primeira entrada que falta. */
+#define TENTATIVAS_HISTORICO 5 /*!< Quantidade de pedidos seguidos sem resposta após a qual a consulta de histórico é abandonada. */
+
+#define FASE_ANUNCIO 0 /*!< Fase da sincronização hierárquica em que as tomadas se anunciam (0% a 20% da janela). */
+#define FASE_CHEFE 1 /*!< Fase em que as tomadas de menor endereço entre as vizinhas se anunciam como chefes (20% a 30%). */
+#define FASE_MEMBROS 2 /*!< Fase em que os membros enviam seus Dados ao chefe (30% a 55%). */
+#define FASE_AGREGADOS 3 /*!< Fase em que os chefes trocam as somas de seus clusters (55% a 80%). */
+#define FASE_DECISAO 4 /*!< Fase em que os chefes enviam a decisão resumida aos membros (80% a 100%). */
+
 using namespace EPOS;
 
 OStream cout;
@@ -35,18 +178,40 @@ struct Prioridades {
 	int noite; /*!< Corresponde à prioridade da tomada no horário das 18:00 (incluso) às 00:00 (não incluso). */
 };
 
+//!  Struct CarimboDeTempo
+/*!
+	Informações de tempo incluídas no início de todas as mensagens, usadas na sincronização dos relógios, e o que a AdaptacaoDaSincronizacao precisa do remetente.
+*/
+struct CarimboDeTempo {
+	long long tempo; /*!< Tempo do remetente (microssegundos desde 01/01/2016) no momento do envio. */
+	Address raiz; /*!< Tomada com a qual o relógio do remetente está sincronizado. */
+	bool valido; /*!< Indica se o relógio do remetente é a raiz ou está sincronizado com ela. */
+	unsigned char grupo; /*!< Grupo de orçamento do remetente. Preenchido pelo Mensageiro em todo envio, com ou sem sincronizador. */
+	unsigned char epocasPropostas; /*!< Épocas entre sincronizações propostas pelo remetente. Preenchido pelo Mensageiro em todo envio. */
+	unsigned char sequencia; /*!< Número do envio na janela de sincronização (1 a envios), ou 0 nas mensagens que não são numeradas. Preenchido por quem envia. */
+	unsigned char envios; /*!< Quantidade de envios do remetente na janela de sincronização, ou 0 nas mensagens que não são numeradas. Preenchido por quem envia. */
+};
+
 //!  Struct Dados
 /*!
 	Agrupamento dos dados que serão transmitidos e recebidos pelo EPOSMoteIII.
 */
 struct Dados {
+	CarimboDeTempo carimbo; /*!< Tempo do remetente. Preenchido pelo Mensageiro no envio. */
 	Address remetente; /*!< Endereço da tomada remetente da mensagem. */
+	int soquete; /*!< Soquete da placa remetente a que os dados se referem. Junto com o remetente, identifica a entrada na tabela. */
 	//bool ligada; /*!< Indica se a tomada remetente está ligada. */
 	float consumoPrevisto; /*!< Corresponde ao consumo previsto da tomada até o fim do mês. */
 	float ultimoConsumo; /*!< Corresponde ao valor do consumo da tomada desde a ultima sincronização. */
 	int prioridade; /*!< Corresponde à prioridade da tomada no período de envio da mensagem. */
 	char configuracao[NUMERO_CHAR_CONFIG]; /*!< É uma possível configuração que precise ser feita pela tomada. */
 	bool podeDesligar; /*!< Indica se a tomada pode ser desligada no período de envio da mensagem. */
+	bool temDimmer; /*!< Indica se a tomada remetente possui dimmer. */
+	unsigned long epoca; /*!< Época (número da rodada de sincronização) em que a mensagem foi enviada. */
+	unsigned long resumo; /*!< Resumo da visão da tabela que o remetente usou no plano de corte da época anterior. */
+	float consumoMensal; /*!< Consumo do sistema no mês até o momento, segundo o remetente. */
+	float maximoConsumoMensal; /*!< Consumo máximo mensal configurado no remetente. */
+	unsigned long ultimaEpocaOuvida; /*!< Época local em que a tomada foi ouvida pela última vez. Preenchido por quem recebe a mensagem. */
 };
 
 //!  Struct Data
@@ -63,618 +228,2529 @@ struct Data {
 	long long microssegundos; /*!< Variável que representa os microssegundos atuais.*/
 };
 
+//!  Struct Agregado
+/*!
+	Somas de valores de todas as tomadas do sistema, usadas quando as tomadas não trocam mensagens todas com todas.
+*/
+struct Agregado {
+	float consumoPrevisto; /*!< Soma do consumo previsto até o fim do mês. */
+	float ultimoConsumo; /*!< Soma do consumo desde a última sincronização. */
+	float previstoDesligavel[NUMERO_NIVEIS_PRIORIDADE]; /*!< Soma do consumo previsto das tomadas que podem ser desligadas, por nível de prioridade. */
+};
+
+//!  Struct MensagemAgregacao
+/*!
+	Mensagem de tamanho fixo trocada a cada rodada da agregação por gossip (push-sum).
+*/
+struct MensagemAgregacao {
+	CarimboDeTempo carimbo; /*!< Tempo do remetente. Preenchido pelo Mensageiro no envio. */
+	Address remetente; /*!< Endereço da tomada remetente da mensagem. */
+	Address raiz; /*!< Menor endereço conhecido pelo remetente. A tomada raiz é a única que inicia a rodada com peso 1. */
+	unsigned long epoca; /*!< Época da rodada de agregação. */
+	float peso; /*!< Peso enviado. Mensagens de anúncio têm peso e somas nulos. */
+	Agregado somas; /*!< Somas enviadas. */
+	float soquetes; /*!< Soma da quantidade de soquetes enviada, que dividida pelo peso estima os soquetes do grupo. */
+};
+
+//!  Struct DecisaoResumida
+/*!
+	Decisão de corte de todo o sistema expressa por nível de prioridade.
+*/
+struct DecisaoResumida {
+	int nivelCorte; /*!< Tomadas que podem desligar com nível inferior a este são desligadas e as de nível superior ficam ligadas. */
+	float fracao; /*!< Fração do consumo do nível nivelCorte que deve ser cortada. */
+};
+
+//!  Struct MensagemCluster
+/*!
+	Mensagem trocada no modo de agregação hierárquica. O campo tipo indica quais dos outros campos são usados.
+*/
+struct MensagemCluster {
+	CarimboDeTempo carimbo; /*!< Tempo do remetente. Preenchido pelo Mensageiro no envio. */
+	Address remetente; /*!< Endereço da tomada remetente da mensagem. */
+	Address chefe; /*!< Chefe do cluster do remetente. */
+	int tipo; /*!< Tipo da mensagem (CLUSTER_ANUNCIO, CLUSTER_CHEFE, CLUSTER_AGREGADO ou CLUSTER_DECISAO). */
+	unsigned long epoca; /*!< Época da mensagem. */
+	int membros; /*!< Quantidade de tomadas incluídas nas somas. */
+	float consumoMensal; /*!< Maior consumo mensal informado pelas tomadas incluídas. */
+	float maximoConsumoMensal; /*!< Menor consumo máximo mensal informado pelas tomadas incluídas. */
+	Agregado somas; /*!< Somas do cluster (CLUSTER_AGREGADO) ou do sistema (CLUSTER_DECISAO). */
+	DecisaoResumida decisao; /*!< Decisão do sistema (CLUSTER_DECISAO). */
+};
+
+//!  Struct MensagemAlerta
+/*!
+	Mensagem enviada quando uma tomada detecta que a previsão do sistema passou do limite entre duas sincronizações.
+	Leva a nova previsão da tomada de origem, para que as outras tomadas refaçam a decisão com os dados que já têm.
+	A mesma mensagem avisa as outras tomadas de que um soquete da origem foi cortado pelo limite de pico (motivo ALERTA_DISPARO_POTENCIA); esse aviso não muda a decisão.
+*/
+struct MensagemAlerta {
+	CarimboDeTempo carimbo; /*!< Tempo do remetente. Preenchido pelo Mensageiro no envio. */
+	Address origem; /*!< Tomada que detectou o excesso. */
+	int soquete; /*!< Soquete da origem cuja previsão mais aumentou. */
+	unsigned long sequencia; /*!< Número do alerta na tomada de origem. Junto com a origem, identifica o alerta. */
+	long long instanteDeteccao; /*!< Tempo da origem (microssegundos desde 01/01/2016) em que o excesso foi detectado. */
+	int prioridade; /*!< Prioridade atual da origem. */
+	int podeDesligar; /*!< Se a origem pode ser desligada no período atual. */
+	float consumoPrevistoAnterior; /*!< Previsão da origem enviada na última sincronização. */
+	float consumoPrevisto; /*!< Nova previsão da origem até o fim do mês. */
+	float maximoConsumoMensal; /*!< Consumo máximo mensal configurado na origem. */
+	unsigned char motivo; /*!< ALERTA_EXCESSO_PREVISTO ou ALERTA_DISPARO_POTENCIA. */
+	short potencia; /*!< ALERTA_DISPARO_POTENCIA: potência média do soquete no disparo, em % do fundo de escala. */
+};
+
+//!  Struct MensagemRegua
+/*!
+	Dados de todos os soquetes de uma placa em uma única mensagem, enviada na sincronização no lugar de um Dados por soquete.
+	Os campos comuns à placa vão uma vez só e os de cada soquete vão em vetores indexados pelo soquete.
+*/
+struct MensagemRegua {
+	CarimboDeTempo carimbo; /*!< Tempo do remetente. Preenchido pelo Mensageiro no envio. */
+	Address remetente; /*!< Endereço da placa remetente. */
+	unsigned long epoca; /*!< Época em que a mensagem foi enviada. */
+	unsigned long resumo; /*!< Resumo da visão da tabela que o remetente usou no plano de corte da época anterior. */
+	float consumoMensal; /*!< Consumo do sistema no mês até o momento, segundo o remetente. */
+	float maximoConsumoMensal; /*!< Consumo máximo mensal configurado no remetente. */
+	unsigned char quantidade; /*!< Quantidade de soquetes do remetente. */
+	unsigned char podeDesligar; /*!< Um bit por soquete: se ele pode ser desligado no período de envio. */
+	unsigned char temDimmer; /*!< Um bit por soquete: se ele possui dimmer. */
+	signed char prioridade[NUMERO_MAXIMO_SOQUETES]; /*!< Prioridade de cada soquete no período de envio. */
+	float consumoPrevisto[NUMERO_MAXIMO_SOQUETES]; /*!< Consumo previsto de cada soquete até o fim do mês. */
+	float ultimoConsumo[NUMERO_MAXIMO_SOQUETES]; /*!< Consumo de cada soquete desde a última sincronização. */
+};
+
+//!  Struct MensagemHistorico
+/*!
+	Pedido ou resposta da consulta ao histórico de um soquete de outra placa, enviado só ao destino (unicast).
+	As entradas são identificadas pelo índice absoluto na camada (0 é a primeira entrada registrada desde que a placa ligou), que não muda quando o anel avança.
+	Assim, uma consulta interrompida continua do primeiro índice que falta, sem receber de novo o que já chegou.
+*/
+struct MensagemHistorico {
+	CarimboDeTempo carimbo; /*!< Tempo do remetente. Preenchido pelo Mensageiro no envio. */
+	Address remetente; /*!< Tomada remetente da mensagem. */
+	unsigned char tipo; /*!< HISTORICO_PEDIDO ou HISTORICO_RESPOSTA. */
+	unsigned char camada; /*!< CAMADA_PERIODOS, CAMADA_HORAS ou CAMADA_DIAS. */
+	signed char soquete; /*!< Soquete consultado. */
+	unsigned char quantidade; /*!< Pedido: entradas que ainda faltam (limitada a 255). Resposta: entradas em valores. */
+	unsigned short consulta; /*!< Número da consulta no solicitante, repetido na resposta para descartar respostas de consultas antigas. */
+	unsigned long primeiro; /*!< Índice absoluto da primeira entrada pedida ou enviada. Na resposta, pode ser maior que o pedido se as entradas pedidas já saíram do anel. */
+	unsigned long total; /*!< Resposta: quantidade de entradas já registradas na camada (o próximo índice). */
+	float valores[VALORES_POR_QUADRO_HISTORICO]; /*!< Resposta: entradas a partir de primeiro. */
+};
+
+//!  Union Quadro
+/*!
+	Espaço suficiente para receber qualquer uma das mensagens trocadas pelas tomadas. O tipo é identificado pelo protocolo NIC.
+*/
+union Quadro {
+	char dados[sizeof(Dados)]; /*!< Espaço de uma mensagem PROTOCOLO_DADOS. */
+	char agregacao[sizeof(MensagemAgregacao)]; /*!< Espaço de uma mensagem PROTOCOLO_AGREGACAO. */
+	char cluster[sizeof(MensagemCluster)]; /*!< Espaço de uma mensagem PROTOCOLO_CLUSTER. */
+	char alerta[sizeof(MensagemAlerta)]; /*!< Espaço de uma mensagem PROTOCOLO_ALERTA. */
+	char regua[sizeof(MensagemRegua)]; /*!< Espaço de uma mensagem PROTOCOLO_REGUA. */
+	char historico[sizeof(MensagemHistorico)]; /*!< Espaço de uma mensagem PROTOCOLO_HISTORICO. */
+};
+
+//!  Struct QuadroRecebido
+/*!
+	Mensagem recebida pela tarefa do rádio, aguardando a tarefa de decisão.
+*/
+struct QuadroRecebido {
+	Protocol protocolo; /*!< Protocolo da mensagem. */
+	unsigned short tamanho; /*!< Tamanho da mensagem em bytes. O resto do quadro é zerado. */
+	long long chegada; /*!< Leitura da BaseDeTempo quando a mensagem chegou. */
+	Quadro quadro; /*!< Conteúdo da mensagem. */
+};
+
+//!  Struct QuadroEnvio
+/*!
+	Mensagem a enviar, aguardando a tarefa do rádio.
+*/
+struct QuadroEnvio {
+	Address destino; /*!< Endereço do destinatário. */
+	Protocol protocolo; /*!< Protocolo da mensagem. */
+	unsigned int tamanho; /*!< Tamanho da mensagem em bytes. */
+	long long enfileirado; /*!< Leitura da BaseDeTempo quando o carimbo de tempo foi preenchido (a da volta do laço de decisão). */
+	Quadro quadro; /*!< Conteúdo da mensagem. */
+};
+
+//!  Struct LinhaDeComando
+/*!
+	Comando de configuração recebido por USB, aguardando a tarefa de decisão.
+*/
+struct LinhaDeComando {
+	char texto[NUMERO_CHAR_CONFIG]; /*!< Texto do comando. */
+};
+
+//!  Struct AmostraDeConsumo
+/*!
+	Consumo de cada soquete em um período de SEGS_ENTRE_CONSUMO segundos, da tarefa de amostragem para a de decisão.
+*/
+struct AmostraDeConsumo {
+	float consumo[NUMERO_SOQUETES]; /*!< Consumo de cada soquete no período. */
+	float nivel[NUMERO_SOQUETES]; /*!< Dimmerização aplicada em cada soquete quando a amostra foi tratada. Preenchida pela tarefa de decisão (ou pela captura, na reprodução). */
+};
+
+//!  Struct DisparoDePotencia
+/*!
+	Corte de um soquete feito pela interrupção de amostragem ao passar do limite de pico, entregue à tarefa de decisão para ser registrado e avisado.
+*/
+struct DisparoDePotencia {
+	int soquete; /*!< Soquete cortado. */
+	int potencia; /*!< Potência média da janela no disparo, em % do fundo de escala. */
+	int latencia; /*!< Tempo (em microssegundos) entre o primeiro sinal do excesso e o corte. */
+	bool peloGrupo; /*!< Indica se o corte foi pela parte da placa no limite do grupo, e não pelo limite do soquete. */
+	int passos; /*!< Nível imposto ao dimmer pelo corte, ou 0 se o soquete foi desligado. */
+};
+
 typedef List_Elements::Singly_Linked_Ordered<Dados, Address> Hash_Element;
 typedef Simple_Hash<Dados, sizeof(Dados), Address> Tabela;
 
 //----------------------------------------------------------------------------
-//!  Classe Mensageiro
+//!  Classe ComparadorDeEnderecos
 /*!
-	Classe encarregada de enviar e receber mensagens.
+	Classe que define uma ordem total entre endereços, usada sempre que as tomadas precisam escolher uma delas da mesma forma (desempates, raízes e chefes).
 */
-class Mensageiro {
+class ComparadorDeEnderecos {
+	public:
+		/*!
+			Método que compara dois endereços byte a byte.
+			\return Valor negativo se a < b, positivo se a > b e 0 se forem iguais.
+		*/
+		static int comparar(const Address& a, const Address& b) {
+			for (unsigned int i = 0; i < sizeof(Address); i++) {
+				if (a[i] != b[i]) {
+					return (a[i] < b[i]) ? -1 : 1;
+				}
+			}
+			return 0;
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe Estatico
+/*!
+	Espaço reservado em memória estática para um objeto que é construído depois (placement new).
+	Os objetos de longa duração do controlador são construídos nesses espaços, de forma que nenhum deles usa o heap e o tamanho total é conhecido na ligação.
+*/
+template<typename T>
+class Estatico {
 	private:
-		NIC * nic; /*!< Variável que representa o NIC.*/
+		char memoria[sizeof(T)] __attribute__((aligned(8))); /*!< Espaço do objeto.*/
 
 	public:
 		/*!
-			Método construtor da classe.
+			Método que constrói o objeto no espaço reservado.
+			\param argumentos são os parâmetros do construtor de T.
+			\return Ponteiro para o objeto construído.
 		*/
-		Mensageiro() {
-			nic = new NIC();
+		template<typename ... Argumentos>
+		T* construir(Argumentos ... argumentos) {
+			return new (memoria) T(argumentos ...);
 		}
 
 		/*!
-			Método que transmite uma mensagem em broadcast.
-			\param msg é a mensagem que será enviada.
+			Método que destrói o objeto, liberando o espaço para uma nova construção.
 		*/
-		void enviarBroadcast(Dados msg) {
-			enviarMensagem(nic->broadcast(), msg);
+		void destruir() {
+			reinterpret_cast<T*>(memoria)->~T();
 		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe FilaSPSC
+/*!
+	Fila circular sem travas para um único produtor e um único consumidor, usada entre as tarefas do controlador.
+	Só o produtor escreve fim e só o consumidor escreve inicio; as barreiras garantem que o elemento é escrito (ou lido) antes do índice mudar.
+	Com a fila cheia, o elemento novo é descartado e contado.
+*/
+template<typename T, unsigned int N>
+class FilaSPSC {
+	private:
+		T elementos[N]; /*!< Espaço dos elementos. Uma posição fica sempre livre para distinguir fila cheia de vazia.*/
+		volatile unsigned int inicio; /*!< Posição do próximo elemento a retirar. Escrita só pelo consumidor.*/
+		volatile unsigned int fim; /*!< Posição do próximo elemento a inserir. Escrita só pelo produtor.*/
+		volatile unsigned int descartados; /*!< Quantidade de elementos descartados com a fila cheia. Escrita só pelo produtor.*/
 
+	public:
 		/*!
-			Método que transmite uma mensagem para um destinatário.
-			\param destino é o endereço do dispositivo destinatário.
-			\param msg é a mensagem que será enviada.
+			Método construtor da classe.
 		*/
-		void enviarMensagem(const Address destino, const Dados msg) {
-			const Protocol prot = NIC::PTP;
-			nic->send(destino, prot, &msg, sizeof msg);
+		FilaSPSC() {
+			inicio = 0;
+			fim = 0;
+			descartados = 0;
 		}
 
 		/*!
-			Método que recebe uma mensagem.
-			\return Retorna a mensagem recebida.
+			Método que insere um elemento. Chamado apenas pelo produtor.
+			\param elemento é o elemento a inserir.
+			\return Valor booleano que indica se havia espaço na fila.
 		*/
-		Dados* receberMensagem() {
-			Address* remetente;
-			Protocol* prot;
-			Dados* msg = new Dados();
-
-			bool hasMsg = nic->receive(remetente, prot, msg, sizeof *msg);
-
-			if (!hasMsg) { // Se não foi recebida nenhuma mensagem
-				//msg->remetente = -1;
-				//msg->ligada = false;
-				msg->consumoPrevisto = -1;
-				msg->ultimoConsumo = -1;
-				msg->prioridade = -1;
-				msg->configuracao[0] = '\0';
-				msg->podeDesligar = -1;
-			} else {
-				cout << "   Mensagem Recebida de " << msg->remetente << endl;
+		bool inserir(const T& elemento) {
+			unsigned int proximo = (fim + 1) % N;
+			if (proximo == inicio) {
+				descartados = descartados + 1;
+				return false;
 			}
-
-			return msg;
+			elementos[fim] = elemento;
+			__sync_synchronize(); // O elemento fica completo antes de ser visto pelo consumidor.
+			fim = proximo;
+			return true;
 		}
 
 		/*!
-			Método que retorna o endereço NIC do dispositivo.
-			\return Valor do tipo Address que representa o endereço do dispositivo.
+			Método que retira um elemento. Chamado apenas pelo consumidor.
+			\param elemento recebe o elemento retirado.
+			\return Valor booleano que indica se havia algum elemento.
 		*/
-		const Address obterEnderecoNIC() {
-			return nic->address();
+		bool retirar(T* elemento) {
+			if (inicio == fim) {
+				return false;
+			}
+			__sync_synchronize(); // O elemento é lido depois de ver o novo fim.
+			*elemento = elementos[inicio];
+			__sync_synchronize(); // A posição só é devolvida ao produtor depois da leitura.
+			inicio = (inicio + 1) % N;
+			return true;
 		}
 
 		/*!
-			Método que retorna um endereço, convertendo seus valores hexadecimais para decimais.
-			\param endereco string com o endereço em hexadecimal.
-			\param retorno ponteiro que recebera a string convertida.
+			Método que verifica se a fila está cheia. Chamado apenas pelo produtor.
+			\return Valor booleano que indica se um elemento inserido agora seria descartado.
 		*/
-		void converterEndereco(char* endereco, char* retorno) {
-			char endA[3];
-			char endB[3];
-
-			int numA = 0;
-			int numB = 0;
-			int num = 0;
-			char c;
-			for (int i = 0; i < 5; i++) {
-				if (i == 2) {
-					i++;
-				}
-				c = endereco[i];
-				switch (c) {
-					case 'a':
-						num = 10;
-						break;
-					case 'b':
-						num = 11;
-						break;
-					case 'c':
-						num = 12;
-						break;
-					case 'd':
-						num = 13;
-						break;
-					case 'e':
-						num = 14;
-						break;
-					case 'f':
-						num = 15;
-						break;
-					default:
-						num = c - '0';
-						break;
-				}
-				if (i < 2) {
-					numA += num*pow(16, (1-i));
-				} else {
-					numB += num*pow(16, (4-i));
-				}
-			}
-
-			for (int i = 0; i < 3; i++) {
-				endA[2-i] = (numA % 10) + '0';
-				numA /= 10;
-				endB[2-i] = (numB % 10) + '0';
-				numB /= 10;
-			}
+		bool cheia() {
+			return ((fim + 1) % N) == inicio;
+		}
 
-			for (int i = 0; i < 6; i++) {
-				if (i < 3) {
-					retorno[i] = endA[i];
-				} else {
-					retorno[i+1] = endB[i-3];
-				}
-			}
-			retorno[3] = ':';
+		/*!
+			Método que retorna a quantidade de elementos descartados com a fila cheia.
+			\return Quantidade de elementos descartados.
+		*/
+		unsigned int getDescartados() {
+			return descartados;
 		}
 };
 
 //----------------------------------------------------------------------------
-//!  Classe Relogio
+//!  Classe EstatisticaLatencia
 /*!
-	Classe que lida com as informações de datas e horários.
+	Quantidade, média e máximo de uma série de latências, em microssegundos.
 */
-class Relogio {
+class EstatisticaLatencia {
 	private:
-		Data data; /*!< É uma struct Data para o controle da data atual.*/
-		int diasNoMes[12]; /*!< Vetor que guarda quantos dias tem em cada mês.*/
-		Chronometer* cronometro; /*!< Objeto da classe Chronometer que representa um cronômetro.*/
-
-		/*!
-			Método que inicializa o vetor com a quantidade de dias em cada mẽs.
-		*/
-		void inicializarMeses() {
-			diasNoMes[0]  = 31; // Janeiro;
-			diasNoMes[1]  = 28; // Fevereiro;
-			diasNoMes[2]  = 31; // Março;
-			diasNoMes[3]  = 30; // Abril;
-			diasNoMes[4]  = 31; // Maio;
-			diasNoMes[5]  = 30; // Junho;
-			diasNoMes[6]  = 31; // Julho;
-			diasNoMes[7]  = 31; // Agosto;
-			diasNoMes[8]  = 30; // Setembro;
-			diasNoMes[9]  = 31; // Outubro;
-			diasNoMes[10] = 30; // Novembro;
-			diasNoMes[11] =	31;	// Dezembro.
-		}
+		int quantidade; /*!< Quantidade de latências registradas.*/
+		long long soma; /*!< Soma das latências registradas.*/
+		long long maxima; /*!< Maior latência registrada.*/
 
 	public:
 		/*!
 			Método construtor da classe.
 		*/
-		Relogio() {
-			cronometro = new Chronometer();
-
-			// data default
-			data.ano = 2016;
-			data.mes= 1;
-			data.dia = 1;
-			data.hora = 0;
-			data.minuto = 0;
-
-			data.segundo = 0;
-			data.microssegundos = 0;
-			cronometro->reset();
-			cronometro->start();
-			inicializarMeses();
+		EstatisticaLatencia() {
+			zerar();
 		}
 
 		/*!
-			Método que retorna o dia atual.
-			\return um inteiro que representa o dia atual.
+			Método que descarta as latências registradas.
 		*/
-		Data getData() {
-			atualizaRelogio();
-			return data;
+		void zerar() {
+			quantidade = 0;
+			soma = 0;
+			maxima = 0;
 		}
 
 		/*!
-			Método que retorna quantos tempo se passou em microssegundos desde 01/01/2016.
-			\param data data que será convertida para microssegundos.
-			\return Quanto tempo em microssegundos se passou desde 01/01/2016.
+			Método que registra uma latência.
+			\param latencia é a latência em microssegundos.
 		*/
-		unsigned long long dataEmMicrosec(Data data) {
-			// Valores para "conversão".
-			float micssNumSeg = 1000000;
-			float micssNumMin = 60 * micssNumSeg;
-			float micssNumaHor = 60 * micssNumMin;
-			float micssNumDia = 24 * micssNumaHor;
-
-			// Conversões de unidades dentro de um dia.
-			unsigned long long tempoEmMicrosec = 0;
-			tempoEmMicrosec += data.microssegundos;
-			tempoEmMicrosec += data.segundo * micssNumSeg;
-			tempoEmMicrosec += data.minuto * micssNumMin;
-			tempoEmMicrosec += data.hora * micssNumaHor;
-
-			// Conversões maiores que de um dia.
-			// Dia.
-			tempoEmMicrosec += (data.dia - 1) * micssNumDia;
-
-			// Mês.
-			for (int i = 1; i < data.mes; i++) { // i < data.mes ??
-				tempoEmMicrosec += getDiasNoMes(i, data.ano) * micssNumDia;
-			}
-
-			// Ano.
-			// A contagem começa em 2016.
-			// Para que o valor não seja muito grande.
-			int anoMin = 2016;
-			data.ano -= anoMin;
-			if (data.ano < 0) {
-				data.ano = 0;
+		void registrar(long long latencia) {
+			quantidade++;
+			soma += latencia;
+			if (latencia > maxima) {
+				maxima = latencia;
 			}
-			tempoEmMicrosec += ((data.ano) * 365 + (data.ano) / 4) * micssNumDia;
-
-			return tempoEmMicrosec;
-		}
-
-		/*!
-			Método que altera a data atual.
-			\param d é a data para qual será feita a alteração.
-		*/
-		void setData(Data d) {
-			data = d;
-			cronometro->reset();
-			cronometro->start();
 		}
 
 		/*!
-			Método que altera o ano atual.
-			\param a é um inteiro que indica o ano.
+			Método que retorna a quantidade de latências registradas.
 		*/
-		void setAno(int a) {
-			data.ano = a;
-			cronometro->reset();
-			cronometro->start();
+		int getQuantidade() {
+			return quantidade;
 		}
 
 		/*!
-			Método que altera o mês atual.
-			\param m é um inteiro que indica o mês.
+			Método que retorna a média das latências registradas, em microssegundos (0 sem medidas).
 		*/
-		void setMes(int m) {
-			data.mes= m;
-			cronometro->reset();
-			cronometro->start();
+		int getMedia() {
+			return (quantidade == 0) ? 0 : (int) (soma / quantidade);
 		}
 
 		/*!
-			Método que altera o dia atual.
-			\param d é um inteiro que indica o dia.
+			Método que retorna a maior latência registrada, em microssegundos.
 		*/
-		void setDia(int d) {
-			data.dia = d;
-			cronometro->reset();
-			cronometro->start();
+		int getMaxima() {
+			return (int) maxima;
 		}
+};
 
-		/*!
-			Método que altera a hora atual.
-			\param h é um inteiro que indica a hora.
-		*/
-		void setHora(int h) {
-			data.hora = h;
-			cronometro->reset();
-			cronometro->start();
-		}
+//----------------------------------------------------------------------------
+//!  Enum Evento
+/*!
+	Eventos gravados no registro. O texto de cada evento fica no decodificador (decodificadorRegistro.cc), na mesma ordem.
+*/
+enum Evento {
+	EVENTO_REGISTROS_PERDIDOS, /*!< Registros descartados com o anel cheio (quantidade). */
+	EVENTO_NOVA_RAIZ, /*!< Nova raiz de tempo (endereço). */
+	EVENTO_RAIZ_PERDIDA, /*!< Raiz de tempo perdida. */
+	EVENTO_FILA_ENVIO_CHEIA, /*!< Mensagem a enviar descartada com a fila cheia. */
+	EVENTO_MENSAGEM_RECEBIDA, /*!< Mensagem com Dados recebida (remetente). */
+	EVENTO_DESCARTES_MENSAGENS, /*!< Mensagens descartadas nas filas (recebidas, a enviar). */
+	EVENTO_MEDIDOR, /*!< Tensão RMS do último período em volts e blocos perdidos. */
+	EVENTO_MEDIDOR_SOQUETE, /*!< Corrente RMS e de pico em % do fundo de escala (soquete, RMS, pico). */
+	EVENTO_RADIO_LIGADO, /*!< Tempo com o rádio ligado na última hora (ms, %). */
+	EVENTO_COMANDO_PENDENTE_DESCARTADO, /*!< Comando descartado com a fila de comandos pendentes cheia. */
+	EVENTO_REACAO_ALERTA, /*!< Reação a um alerta (origem, latência, medidas, média, máxima). */
+	EVENTO_COMANDO_TRUNCADO, /*!< Comando USB truncado (tamanho máximo). */
+	EVENTO_DESCARTES_USB, /*!< Bytes perdidos e linhas truncadas no USB. */
+	EVENTO_PREVISAO, /*!< Consumo efetivo do último período e previsão própria até o fim do mês. */
+	EVENTO_INICIO_SINCRONIZACAO, /*!< Início da sincronização (época). */
+	EVENTO_FIM_SINCRONIZACAO, /*!< Fim da sincronização (tomadas vivas). */
+	EVENTO_TOMADA_DA_TABELA, /*!< Entrada da tabela (placa, soquete, consumo previsto, último consumo, prioridade). */
+	EVENTO_DADOS_PROPRIOS, /*!< Dados da própria placa (endereço, consumo previsto, último consumo). */
+	EVENTO_SOQUETE_PROPRIO, /*!< Dados de um soquete próprio (soquete, consumo previsto, prioridade). */
+	EVENTO_CONSUMO_DO_SISTEMA, /*!< Consumo do mês, consumo máximo e consumo previsto do sistema até o fim do mês. */
+	EVENTO_LATENCIA_MENSAGENS, /*!< Latência da chegada das mensagens ao tratamento (medidas, média, máxima). */
+	EVENTO_DESCARTES_TAREFAS, /*!< Amostras e comandos descartados nas filas entre as tarefas. */
+	EVENTO_GOSSIP, /*!< Somas do sistema obtidas por gossip (vizinhos). */
+	EVENTO_GOSSIP_SEM_PESO, /*!< Gossip sem peso na rodada. */
+	EVENTO_CHEFE_DE_CLUSTER, /*!< A placa é chefe de cluster (clusters ouvidos, tomadas no sistema). */
+	EVENTO_DECISAO_DO_CHEFE, /*!< Decisão recebida do chefe (chefe, tomadas no sistema). */
+	EVENTO_CHEFE_SEM_DECISAO, /*!< Nenhuma decisão recebida do chefe (chefe). */
+	EVENTO_ACIMA_DO_LIMITE, /*!< A previsão passa do limite. */
+	EVENTO_DENTRO_DO_LIMITE, /*!< A previsão está dentro do limite. */
+	EVENTO_NAO_PODE_DESLIGAR, /*!< Nenhum soquete pode ser desligado. */
+	EVENTO_TOMADAS_EXPIRADAS, /*!< Entradas removidas da tabela por expiração (quantidade). */
+	EVENTO_ALERTA_RECEBIDO, /*!< Alerta de excesso recebido (origem). */
+	EVENTO_PLANO, /*!< Plano de corte (época, tomadas no plano, resumo, tomadas com a mesma visão, outras tomadas). */
+	EVENTO_ALERTA_ENVIADO, /*!< Alerta de excesso detectado pela placa (projeção). */
+	EVENTO_DESLIGADA, /*!< Soquete desligado pelo plano de corte (soquete). */
+	EVENTO_DIMERIZADA, /*!< Soquete dimerizado pelo plano de corte (soquete, dimmerização em %). */
+	EVENTO_LIGADA, /*!< Soquete ligado pelo plano de corte (soquete). */
+	EVENTO_PRIORIDADE_ALTERADA, /*!< Comando PRIORID executado. */
+	EVENTO_PERMISSAO_ALTERADA, /*!< Comando DESLIGA executado. */
+	EVENTO_RELOGIO_ALTERADO, /*!< Comando RELOGIO executado. */
+	EVENTO_AGREGACAO_ALTERADA, /*!< Comando AGREGAC executado. */
+	EVENTO_CICLO_RADIO_ALTERADO, /*!< Comando ESCUTAS executado. */
+	EVENTO_CONSUMO_MAXIMO_ALTERADO, /*!< Comando CONSUMO executado. */
+	EVENTO_COMANDO_INVALIDO, /*!< Comando desconhecido. */
+	EVENTO_GATEWAY_ALTERADO, /*!< Comando GATEWAY executado (1 se ativo). */
+	EVENTO_DESCARTES_TELEMETRIA, /*!< Dados descartados na fila do gateway. */
+	EVENTO_CONSULTA_HISTORICO, /*!< Comando HISTORI executado (placa consultada, soquete, camada, primeiro índice). */
+	EVENTO_ENTRADA_HISTORICO, /*!< Entrada recebida de uma consulta de histórico (placa, soquete, camada, índice, consumo). */
+	EVENTO_CONSULTA_HISTORICO_CONCLUIDA, /*!< Consulta de histórico terminada (placa, entradas recebidas, entradas que já tinham saído do anel). */
+	EVENTO_CONSULTA_HISTORICO_ABANDONADA, /*!< Consulta de histórico sem resposta (placa, camada, soquete, índice em que ela pode ser retomada). */
+	EVENTO_GRUPO_ALTERADO, /*!< Comando GRUPOID executado (novo grupo). */
+	EVENTO_RESUMO_GRUPO, /*!< Outro grupo de orçamento ouvido na sincronização (grupo, consumo do mês, limite). */
+	EVENTO_LIMITE_POTENCIA_ALTERADO, /*!< Comando POTENCI executado. */
+	EVENTO_DISPARO_POTENCIA, /*!< Soquete cortado pelo limite de pico (soquete, 1 se pelo limite do grupo, potência em % do fundo de escala, latência). */
+	EVENTO_DISPARO_RECEBIDO, /*!< Aviso de disparo do limite de pico recebido (origem, soquete, potência em % do fundo de escala). */
+	EVENTO_HISTOGRAMA_DISPARO, /*!< Disparos do limite de pico desde o início, por faixa de latência. */
+	EVENTO_CAPTURA_PERDIDA, /*!< Reprodução: registros que a captura perdeu com o anel cheio, ou que a reprodução descartou com a fila cheia (quantidade). */
+	EVENTO_CAPTURA_INVALIDA, /*!< Reprodução: quadro da captura com a verificação errada. */
+	EVENTO_REPRODUCAO_CONCLUIDA, /*!< Reprodução terminada (voltas do laço de decisão, tempo médio e máximo de uma volta). */
+	EVENTO_ADAPTACAO_SINCRONIZACAO, /*!< Intervalo até a próxima sincronização (minutos combinados e propostos) e envios por janela (quantidade, taxa de entrega em %). */
+	EVENTO_ADAPTACAO_ALTERADA /*!< Comando ADAPTAR executado. */
+};
+
+//----------------------------------------------------------------------------
+//!  Struct EntradaDoRegistro
+/*!
+	Um evento gravado no anel do registro, com seus argumentos ainda em binário.
+*/
+struct EntradaDoRegistro {
+	volatile unsigned char pronta; /*!< Indica que o produtor terminou de escrever a entrada. */
+	unsigned char evento; /*!< Evento gravado. */
+	unsigned char quantidade; /*!< Quantidade de argumentos usados. */
+	int argumentos[ARGUMENTOS_REGISTRO]; /*!< Argumentos do evento. Números reais e endereços são guardados com real() e endereco(). */
+};
+
+//----------------------------------------------------------------------------
+//!  Classe RegistroDeEventos
+/*!
+	Classe que substitui as impressões feitas durante o trabalho da placa. Cada ponto de registro grava só o evento e seus argumentos
+	em um anel na RAM (algumas escritas, sem formatação), e a SaidaUSB envia os quadros quando o USB aceita bytes.
+	Eventos de nível maior que NIVEL_REGISTRO são removidos na compilação.
+	Cada quadro é [INICIO_QUADRO_REGISTRO][evento][tamanho][argumentos em little-endian][xor de evento, tamanho e argumentos];
+	o decodificador no computador (decodificadorRegistro.cc) os transforma em texto e repassa o resto da saída como está.
+	Qualquer tarefa pode gravar: a posição é reservada com compare-and-swap e a entrada só é enviada depois de marcada como pronta.
+	Com o anel cheio, o evento é descartado e contado, e a quantidade perdida é enviada como EVENTO_REGISTROS_PERDIDOS.
+*/
+class RegistroDeEventos {
+	private:
+		static EntradaDoRegistro entradas[TAMANHO_REGISTRO]; /*!< Anel de entradas.*/
+		static volatile unsigned int reservadas; /*!< Quantidade de posições já reservadas pelos produtores (contador que dá a volta).*/
+		static volatile unsigned int escoadas; /*!< Quantidade de posições já liberadas pelo envio. Escrita só pela interrupção.*/
+		static volatile unsigned int descartadas; /*!< Quantidade de eventos descartados com o anel cheio.*/
+		static unsigned int descartadasEnviadas; /*!< Quantidade de descartes já informados.*/
 
 		/*!
-			Método que altera o minuto atual.
-			\param m é um inteiro que indica o minuto.
+			Método que grava um evento no anel, ou o descarta se o anel estiver cheio.
 		*/
-		void setMinuto(int m) {
-			data.minuto = m;
-			cronometro->reset();
-			cronometro->start();
+		static void gravar(Evento evento, int quantidade, int a0, int a1, int a2, int a3, int a4) {
+			unsigned int posicao;
+			do {
+				posicao = reservadas;
+				if (posicao - escoadas >= TAMANHO_REGISTRO) {
+					__sync_fetch_and_add(&descartadas, 1);
+					return;
+				}
+			} while (!__sync_bool_compare_and_swap(&reservadas, posicao, posicao + 1));
+
+			EntradaDoRegistro& entrada = entradas[posicao % TAMANHO_REGISTRO];
+			entrada.evento = (unsigned char) evento;
+			entrada.quantidade = (unsigned char) quantidade;
+			entrada.argumentos[0] = a0;
+			entrada.argumentos[1] = a1;
+			entrada.argumentos[2] = a2;
+			entrada.argumentos[3] = a3;
+			entrada.argumentos[4] = a4;
+			__sync_synchronize(); // A entrada fica completa antes de ser vista pelo envio.
+			entrada.pronta = 1;
 		}
 
 		/*!
-			Método que altera o segundo atual.
-			\param s é um inteiro que indica o segundo.
+			Método que monta o quadro de um evento.
+			\param quadro recebe o quadro.
+			\return Tamanho do quadro em bytes.
 		*/
-		void setSegundo(int s) {
-			data.segundo = s;
-			cronometro->reset();
-			cronometro->start();
+		static int montarQuadro(unsigned char* quadro, int evento, int quantidade, const int* argumentos) {
+			quadro[0] = INICIO_QUADRO_REGISTRO;
+			quadro[1] = (unsigned char) evento;
+			quadro[2] = (unsigned char) (quantidade * 4);
+			unsigned char verificacao = quadro[1] ^ quadro[2];
+			int tamanho = 3;
+			for (int i = 0; i < quantidade; i++) {
+				unsigned int valor = (unsigned int) argumentos[i];
+				for (int b = 0; b < 4; b++) {
+					quadro[tamanho] = (unsigned char) (valor >> (8 * b));
+					verificacao ^= quadro[tamanho++];
+				}
+			}
+			quadro[tamanho++] = verificacao;
+			return tamanho;
 		}
 
+	public:
+		enum {
+			TAMANHO_MAXIMO_QUADRO = ARGUMENTOS_REGISTRO * 4 + 4 /*!< Tamanho do maior quadro do registro. */
+		};
+
 		/*!
-			Método que atualiza os dados do relógio, baseado no tempo desde a última requisição.
+			Método que prepara o próximo quadro a enviar: primeiro os descartes ainda não informados, depois a próxima entrada pronta do anel.
+			Chamado apenas pela SaidaUSB, na interrupção do leitor USB.
+			\param quadro recebe o quadro, com espaço para TAMANHO_MAXIMO_QUADRO bytes.
+			\return Tamanho do quadro em bytes, ou 0 se não há quadro a enviar.
 		*/
-		void atualizaRelogio() {
-			long long tempoDecorrido = cronometro->read();
-			cronometro->reset();
-			cronometro->start();
-			incrementarMicrossegundo(tempoDecorrido);
+		static int proximoQuadro(unsigned char* quadro) {
+			unsigned int perdidas = descartadas - descartadasEnviadas;
+			if (perdidas > 0) {
+				int argumento = (int) perdidas;
+				descartadasEnviadas += perdidas;
+				return montarQuadro(quadro, EVENTO_REGISTROS_PERDIDOS, 1, &argumento);
+			}
+			if (escoadas == reservadas) {
+				return 0;
+			}
+			EntradaDoRegistro& entrada = entradas[escoadas % TAMANHO_REGISTRO];
+			if (!entrada.pronta) { // O produtor foi interrompido no meio da gravação.
+				return 0;
+			}
+			__sync_synchronize(); // A entrada é lida depois de vê-la pronta.
+			int tamanho = montarQuadro(quadro, entrada.evento, entrada.quantidade, entrada.argumentos);
+			entrada.pronta = 0;
+			__sync_synchronize(); // A posição só é devolvida aos produtores depois da leitura.
+			escoadas = escoadas + 1;
+			return tamanho;
 		}
 
 		/*!
-			Método que incrementa o ano.
-			\param anos é a quantidade de anos que serão incrementados no relógio.
+			Métodos que gravam um evento com até ARGUMENTOS_REGISTRO argumentos, se o nível do evento não for maior que NIVEL_REGISTRO.
+			\param evento é o evento gravado.
 		*/
-		void incrementarAno(long long anos){
-			data.ano+=anos;
+		template<int nivel>
+		static void registrar(Evento evento) {
+			if (nivel <= NIVEL_REGISTRO) {
+				gravar(evento, 0, 0, 0, 0, 0, 0);
+			}
 		}
 
-		/*!
-			Método que incrementa os meses de forma a atualizar todas as unidades de tempo superiores.
-			\param meses é a quantidade de meses que serão incrementados no relógio.
-		*/
-		void incrementarMes(long long meses){
-			data.mes+=meses;
-			if (data.mes > 12) {
-				incrementarAno( data.mes/12 );
-				data.mes = data.mes % 12;
+		template<int nivel>
+		static void registrar(Evento evento, int a0) {
+			if (nivel <= NIVEL_REGISTRO) {
+				gravar(evento, 1, a0, 0, 0, 0, 0);
 			}
 		}
 
-		/*!
-			Método que incrementa os dias de forma a atualizar todas as unidades de tempo superiores.
-			\param dias é a quantidade de dias que serão incrementados no relógio.
-		*/
-		void incrementarDia(long long dias){
-			while (dias > 0) {
-				data.dia++;
-				if (data.dia > getDiasNoMes(data.mes, data.ano)) {
-					incrementarMes(1);
-					data.dia = 1;
-				}
-				dias--;
+		template<int nivel>
+		static void registrar(Evento evento, int a0, int a1) {
+			if (nivel <= NIVEL_REGISTRO) {
+				gravar(evento, 2, a0, a1, 0, 0, 0);
 			}
 		}
 
-		/*!
-			Método que incrementa as horas de forma a atualizar todas as unidades de tempo superiores.
-			\param hrs é a quantidade de horas que serão incrementadas no relógio.
-		*/
-		void incrementarHora(long long hrs){
-			data.hora+=hrs;
-			if (data.hora >= 24) {
-				incrementarDia( data.hora/24 );
-				data.hora = data.hora % 24;
+		template<int nivel>
+		static void registrar(Evento evento, int a0, int a1, int a2) {
+			if (nivel <= NIVEL_REGISTRO) {
+				gravar(evento, 3, a0, a1, a2, 0, 0);
 			}
 		}
 
-		/*!
-			Método que incrementa os minutos de forma a atualizar todas as unidades de tempo superiores.
-			\param mins é a quantidade de minutos que serão incrementados no relógio.
-		*/
-		void incrementarMinuto(long long mins){
-			data.minuto+=mins;
-			if (data.minuto >= 60) {
-				incrementarHora( data.minuto/60 );
-				data.minuto = data.minuto % 60;
+		template<int nivel>
+		static void registrar(Evento evento, int a0, int a1, int a2, int a3) {
+			if (nivel <= NIVEL_REGISTRO) {
+				gravar(evento, 4, a0, a1, a2, a3, 0);
 			}
 		}
 
-		/*!
-			Método que incrementa os segundos de forma a atualizar todas as unidades de tempo superiores.
-			\param secs é a quantidade de segundos que serão incrementados no relógio.
-		*/
-		void incrementarSegundo(long long secs){
-			data.segundo+=secs;
-			if (data.segundo >= 60) {
-				incrementarMinuto( data.segundo/60 );
-				data.segundo = data.segundo % 60;
+		template<int nivel>
+		static void registrar(Evento evento, int a0, int a1, int a2, int a3, int a4) {
+			if (nivel <= NIVEL_REGISTRO) {
+				gravar(evento, 5, a0, a1, a2, a3, a4);
 			}
 		}
 
 		/*!
-			Método que incrementa os microssegundos de forma a atualizar todas as unidades de tempo superiores.
-			\param mcsec é a quantidade de microssegundos que serão incrementados no relógio.
+			Método que guarda um número real em um argumento, sem conversão.
+			\param valor é o número guardado.
+			\return Bits de valor.
 		*/
-		void incrementarMicrossegundo(long long mcsec){
-			data.microssegundos+=mcsec;
-			if (data.microssegundos >= 1000000) {
-				incrementarSegundo( data.microssegundos/1000000 );
-				data.microssegundos = data.microssegundos % 1000000;
-			}
+		static int real(float valor) {
+			union {
+				float f;
+				int i;
+			} bits;
+			bits.f = valor;
+			return bits.i;
 		}
 
 		/*!
-			Método que retorna quantos dias tem no mês atual.
- 			\param mes é um inteiro que indica o mês atual.
- 			\param ano é um inteiro que indica o ano atual.
-			\return Valor inteiro que representa quantos dias tem no mês.
+			Método que guarda um endereço em um argumento, com o primeiro byte nos bits menos significativos.
+			\param a é o endereço guardado.
+			\return Bytes de a.
 		*/
-		int getDiasNoMes(int mes, int ano) {
-			if (ano % 4 == 0 && mes == 2) { // Se é ano bissexto e o mês é fevereiro.
-				return 29;
-			} else {
-				return diasNoMes[mes-1];
+		static int endereco(const Address& a) {
+			unsigned int valor = 0;
+			for (unsigned int i = 0; i < sizeof(Address); i++) {
+				valor |= ((unsigned int) (unsigned char) a[i]) << (8 * i);
 			}
+			return (int) valor;
 		}
 };
 
+static_assert((TAMANHO_REGISTRO & (TAMANHO_REGISTRO - 1)) == 0, "TAMANHO_REGISTRO deve ser uma potencia de 2.");
+static_assert(sizeof(Address) <= sizeof(int), "O endereco nao cabe em um argumento do registro.");
+
+EntradaDoRegistro RegistroDeEventos::entradas[TAMANHO_REGISTRO];
+volatile unsigned int RegistroDeEventos::reservadas = 0;
+volatile unsigned int RegistroDeEventos::escoadas = 0;
+volatile unsigned int RegistroDeEventos::descartadas = 0;
+unsigned int RegistroDeEventos::descartadasEnviadas = 0;
+
 //----------------------------------------------------------------------------
-//!  Classe Led
+//!  Classe CapturaDeTrafego
 /*!
-	Classe que faz o controle do LED do EPOSMoteIII.
+	Classe que, com CAPTURA_TRAFEGO, grava em um anel na RAM tudo o que entra na tarefa de decisão (mensagens, comandos USB, amostras de consumo e cortes do limite de pico)
+	e as mensagens enviadas, e a SaidaUSB envia os registros ao computador quando o USB aceita bytes (reprodutorTrafego.cc os grava em um arquivo).
+	Os registros de cada volta do laço de decisão vêm depois de um CAPTURA_PASSO com o instante da volta, gravado só nas voltas que tratam ou enviam algo
+	ou em que o tempo, sozinho, muda o estado (marcarPasso()). Como a volta inteira usa o mesmo instante (BaseDeTempo), a captura basta para repetir as decisões (Gerente::reproduzir()).
+	Cada quadro é [INICIO_QUADRO_CAPTURA][tipo][tamanho][dados][xor de tipo, tamanho e dados]; os valores vão em little-endian, e as mensagens e amostras como estão na memória.
+	Só a tarefa de decisão grava. Com o anel cheio, o registro é descartado e contado, e a quantidade perdida é gravada como CAPTURA_PERDA assim que houver espaço.
 */
-class Led {
+class CapturaDeTrafego {
 	private:
-		GPIO *led; /*!< Variável que representa o LED.*/
+		static unsigned char anel[CAPTURA_TRAFEGO ? TAMANHO_ANEL_CAPTURA : 1]; /*!< Anel de registros, cada um [tipo][tamanho][dados].*/
+		static volatile unsigned int gravados; /*!< Bytes já gravados no anel (contador que dá a volta). Escrito só pela tarefa de decisão.*/
+		static volatile unsigned int escoados; /*!< Bytes já retirados do anel. Escrito só pela interrupção.*/
+		static unsigned int perdidos; /*!< Registros descartados com o anel cheio e ainda não gravados como CAPTURA_PERDA.*/
+		static long long tempoDoPasso; /*!< Instante (BaseDeTempo) da volta atual do laço de decisão.*/
+		static long long ultimoPasso; /*!< Instante do último CAPTURA_PASSO gravado.*/
+		static bool passoGravado; /*!< Indica se o CAPTURA_PASSO da volta atual já foi gravado.*/
 
-	public:
 		/*!
-			Método construtor da classe
+			Método que copia bytes para o anel a partir de uma posição.
+			\param posicao é a posição (contador) do primeiro byte, avançada pelo método.
 		*/
-		Led() {
-			led = new GPIO('C',3, GPIO::OUTPUT);
+		static void copiar(unsigned int* posicao, const void* dados, int tamanho) {
+			const unsigned char* bytes = static_cast<const unsigned char*>(dados);
+			for (int i = 0; i < tamanho; i++) {
+				anel[(*posicao)++ % TAMANHO_ANEL_CAPTURA] = bytes[i];
+			}
 		}
 
 		/*!
-			Método que acende o LED do EPOSMoteIII.
+			Método que escreve um valor em little-endian.
+			\return Quantidade de bytes escritos.
 		*/
-		void acenderLED() {
-			led->set(true);
+		static int escrever(unsigned char* dados, unsigned long long valor, int bytes) {
+			for (int b = 0; b < bytes; b++) {
+				dados[b] = (unsigned char) (valor >> (8 * b));
+			}
+			return bytes;
 		}
 
 		/*!
-			Método que desliga o LED do EPOSMoteIII.
+			Método que grava um registro de até duas partes, precedido da perda pendente e do CAPTURA_PASSO da volta, se ainda não foram gravados.
+			Ou tudo é gravado, ou o registro é descartado e contado.
+			\param tipo é o tipo do registro. CAPTURA_PASSO grava só o passo da volta.
+			\param a é a primeira parte dos dados.
+			\param b é a segunda parte dos dados.
 		*/
-		void desligarLED() {
-			led->set(false);
+		static void gravar(unsigned char tipo, const void* a, int tamanhoA, const void* b, int tamanhoB) {
+			if (!CAPTURA_TRAFEGO || ((tipo == CAPTURA_PASSO) && passoGravado)) {
+				return;
+			}
+			unsigned char passo[10]; // Tempo desde o último passo, 7 bits por byte (o bit 7 indica que há mais bytes).
+			int tamanhoPasso = 0;
+			if (!passoGravado) {
+				unsigned long long decorrido = (unsigned long long) (tempoDoPasso - ultimoPasso);
+				do {
+					passo[tamanhoPasso++] = (unsigned char) ((decorrido & 0x7f) | ((decorrido > 0x7f) ? 0x80 : 0));
+					decorrido >>= 7;
+				} while (decorrido > 0);
+			}
+			unsigned int necessario = (perdidos > 0) ? 6 : 0;
+			necessario += passoGravado ? 0 : (2 + tamanhoPasso);
+			necessario += (tipo == CAPTURA_PASSO) ? 0 : (2 + tamanhoA + tamanhoB);
+			unsigned int posicao = gravados;
+			if (posicao - escoados + necessario > TAMANHO_ANEL_CAPTURA) {
+				perdidos++;
+				return;
+			}
+			if (perdidos > 0) {
+				unsigned char perda[6];
+				perda[0] = CAPTURA_PERDA;
+				perda[1] = 4;
+				escrever(perda + 2, perdidos, 4);
+				copiar(&posicao, perda, 6);
+				perdidos = 0;
+			}
+			if (!passoGravado) {
+				unsigned char cabecalho[2] = {CAPTURA_PASSO, (unsigned char) tamanhoPasso};
+				copiar(&posicao, cabecalho, 2);
+				copiar(&posicao, passo, tamanhoPasso);
+				ultimoPasso = tempoDoPasso;
+				passoGravado = true;
+			}
+			if (tipo != CAPTURA_PASSO) {
+				unsigned char cabecalho[2] = {tipo, (unsigned char) (tamanhoA + tamanhoB)};
+				copiar(&posicao, cabecalho, 2);
+				copiar(&posicao, a, tamanhoA);
+				copiar(&posicao, b, tamanhoB);
+			}
+			__sync_synchronize(); // Os registros ficam completos antes de serem vistos pelo envio.
+			gravados = posicao;
 		}
-};
-
-//----------------------------------------------------------------------------
-//!  Classe Tomada
-/*!
-	Classe que representa uma tomada.
-*/
-class Tomada {
-	protected:
-		bool ligada; /*!< Variável booleana que indica se a tomada está ligada.*/
-	private:
-		Led *led; /*!< Variável que representa o LED.*/
 
 	public:
+		enum {
+			TAMANHO_MAXIMO_REGISTRO = 255, /*!< Bytes dos dados do maior registro. */
+			TAMANHO_MAXIMO_QUADRO = CAPTURA_TRAFEGO ? (TAMANHO_MAXIMO_REGISTRO + 4) : 0 /*!< Tamanho do maior quadro da captura (nenhum sem CAPTURA_TRAFEGO). */
+		};
+
 		/*!
-			Método construtor da classe
+			Método que grava o registro CAPTURA_INICIO, antes da primeira volta do laço de decisão.
+			\param endereco é o endereço da placa.
 		*/
-		Tomada() {
-			led  = new Led();
-			ligar();
+		static void iniciar(const Address& endereco) {
+			unsigned char dados[3 + sizeof(Address)];
+			dados[0] = VERSAO_CAPTURA;
+			dados[1] = NUMERO_SOQUETES;
+			dados[2] = sizeof(Address);
+			memcpy(dados + 3, &endereco, sizeof(Address));
+			passoGravado = true;
+			gravar(CAPTURA_INICIO, dados, sizeof dados, 0, 0);
 		}
 
 		/*!
-			Método que verifica se a tomada está ligada ou não.
-			\return Valor booleano que indica se a tomada está ligada.
+			Método chamado no início de cada volta do laço de decisão.
+			\param tempo é o instante da volta (BaseDeTempo::marcarPasso()).
 		*/
-		bool estaLigada() {
-			return ligada;
+		static void novoPasso(long long tempo) {
+			tempoDoPasso = tempo;
+			passoGravado = false;
 		}
 
 		/*!
-			Método que liga a tomada.
+			Método que grava o CAPTURA_PASSO da volta atual mesmo que nada mais seja gravado nela. Chamado quando o tempo, sozinho, mudou o estado da tomada.
 		*/
-		void ligar() {
-			ligada = true;
-			led->acenderLED();
+		static void marcarPasso() {
+			gravar(CAPTURA_PASSO, 0, 0, 0, 0);
 		}
 
 		/*!
-			Método que desliga a tomada.
+			Método que grava uma mensagem tratada pela tarefa de decisão.
+			\param protocolo é o protocolo da mensagem.
+			\param atraso é o tempo (em microssegundos) entre a chegada da mensagem e o início da volta.
+			\param quadro é a mensagem, com tamanho bytes.
 		*/
-		void desligar() {
-			ligada = false;
-			led->desligarLED();
+		static void recebido(Protocol protocolo, long long atraso, const void* quadro, int tamanho) {
+			unsigned char cabecalho[6];
+			escrever(cabecalho, protocolo, 2);
+			escrever(cabecalho + 2, (unsigned int) atraso, 4);
+			gravar(CAPTURA_RECEBIDO, cabecalho, sizeof cabecalho, quadro, tamanho);
 		}
-};
 
-//----------------------------------------------------------------------------
-//!  Classe TomadaComDimmer
-/*!
-	Classe que representa uma tomada com dimmer.
-*/
-class TomadaComDimmer: virtual public Tomada {
-	protected:
-		float dimPorcentagem; /*!< Váriavel float que indica a porcentagem de dimmerização da tomada.*/
+		/*!
+			Método que grava uma mensagem enviada, já com o carimbo de tempo.
+			\param destino é o destinatário.
+			\param protocolo é o protocolo da mensagem.
+			\param quadro é a mensagem, com tamanho bytes.
+		*/
+		static void enviado(const Address& destino, Protocol protocolo, const void* quadro, int tamanho) {
+			unsigned char cabecalho[sizeof(Address) + 2];
+			memcpy(cabecalho, &destino, sizeof(Address));
+			escrever(cabecalho + sizeof(Address), protocolo, 2);
+			gravar(CAPTURA_ENVIADO, cabecalho, sizeof cabecalho, quadro, tamanho);
+		}
 
-	public:
 		/*!
-			Método construtor da classe
+			Método que grava um comando recebido por USB.
 		*/
-		TomadaComDimmer() {
-			dimPorcentagem = 1; // 100%
+		static void comando(const char* texto) {
+			gravar(CAPTURA_COMANDO, texto, strlen(texto), 0, 0);
 		}
 
 		/*!
-			Método que retorna a porcentagem de dimmerização da tomada.
-			\return Valor float que indica a porcentagem de dimmerização da tomada.
+			Método que grava uma amostra de consumo, com a dimmerização usada no seu tratamento.
+			\param quantidade é a quantidade de soquetes.
 		*/
-		float getPorcentagem() {
-			return dimPorcentagem;
+		static void amostra(const AmostraDeConsumo& a, int quantidade) {
+			gravar(CAPTURA_AMOSTRA, a.consumo, quantidade * sizeof(float), a.nivel, quantidade * sizeof(float));
+		}
+
+		/*!
+			Método que grava um corte do limite de pico entregue à tarefa de decisão.
+		*/
+		static void disparo(const DisparoDePotencia& d) {
+			unsigned char dados[12];
+			dados[0] = (unsigned char) d.soquete;
+			dados[1] = d.peloGrupo ? 1 : 0;
+			dados[2] = (unsigned char) d.passos;
+			dados[3] = 0;
+			escrever(dados + 4, (unsigned int) d.potencia, 4);
+			escrever(dados + 8, (unsigned int) d.latencia, 4);
+			gravar(CAPTURA_DISPARO, dados, sizeof dados, 0, 0);
+		}
+
+		/*!
+			Método que grava o registro CAPTURA_FIM, que marca o fim de uma reprodução.
+		*/
+		static void fim() {
+			passoGravado = true;
+			gravar(CAPTURA_FIM, 0, 0, 0, 0);
+		}
+
+		/*!
+			Método que monta o quadro do próximo registro. Chamado apenas pela SaidaUSB, na interrupção do leitor USB.
+			\param quadro recebe o quadro, com espaço para TAMANHO_MAXIMO_QUADRO bytes.
+			\return Tamanho do quadro em bytes, ou 0 se não há quadro a enviar.
+		*/
+		static int proximoQuadro(unsigned char* quadro) {
+			if (!CAPTURA_TRAFEGO || (escoados == gravados)) {
+				return 0;
+			}
+			__sync_synchronize(); // O registro é lido depois de ver o novo fim.
+			unsigned int posicao = escoados;
+			quadro[0] = INICIO_QUADRO_CAPTURA;
+			quadro[1] = anel[posicao++ % TAMANHO_ANEL_CAPTURA];
+			quadro[2] = anel[posicao++ % TAMANHO_ANEL_CAPTURA];
+			unsigned char verificacao = quadro[1] ^ quadro[2];
+			int tamanho = 3;
+			for (int i = 0; i < quadro[2]; i++) {
+				quadro[tamanho] = anel[posicao++ % TAMANHO_ANEL_CAPTURA];
+				verificacao ^= quadro[tamanho++];
+			}
+			quadro[tamanho++] = verificacao;
+			__sync_synchronize(); // As posições só são devolvidas à tarefa de decisão depois da leitura.
+			escoados = posicao;
+			return tamanho;
 		}
 };
 
+static_assert((TAMANHO_ANEL_CAPTURA & (TAMANHO_ANEL_CAPTURA - 1)) == 0, "TAMANHO_ANEL_CAPTURA deve ser uma potencia de 2.");
+static_assert(sizeof(Quadro) + 6 <= CapturaDeTrafego::TAMANHO_MAXIMO_REGISTRO, "Uma mensagem recebida nao cabe em um registro da captura.");
+static_assert(NUMERO_SOQUETES * 2 * sizeof(float) <= CapturaDeTrafego::TAMANHO_MAXIMO_REGISTRO, "Uma amostra nao cabe em um registro da captura.");
+
+unsigned char CapturaDeTrafego::anel[CAPTURA_TRAFEGO ? TAMANHO_ANEL_CAPTURA : 1];
+volatile unsigned int CapturaDeTrafego::gravados = 0;
+volatile unsigned int CapturaDeTrafego::escoados = 0;
+unsigned int CapturaDeTrafego::perdidos = 0;
+long long CapturaDeTrafego::tempoDoPasso = 0;
+long long CapturaDeTrafego::ultimoPasso = 0;
+bool CapturaDeTrafego::passoGravado = true;
+
 //----------------------------------------------------------------------------
-//!  Classe TomadaInteligente
+//!  Classe PoolDeTomadas
 /*!
-	Classe que representa uma tomada controlada pelo EPOSMoteIII.
+	Conjunto fixo de entradas da tabela (Dados e elemento da hash) usadas no lugar de alocações no heap.
+	Os campos usados nas somas da tabela são copiados também em colunas (ColunasDaTabela, um vetor por campo, indexado pela entrada), de forma
+	que as somas percorrem vetores contíguos em vez de registros Dados inteiros. Entradas livres têm colunas nulas e não entram em nenhuma soma.
+	Na placa as somas são escalares; as instruções vetoriais (SSE2) só são usadas no computador, pela bancadaTabela.
 */
-class TomadaInteligente: virtual public Tomada {
-	protected:
-		int tipo; /*!< Variável que indica o tipo da tomada. Tipo 1 indica uma TomadaInteligente*/
-		float consumo; /*!< Variável que indica o consumo da tomada.*/
+class PoolDeTomadas {
+	public:
+		enum {
+			CAPACIDADE = ((NUMERO_MAXIMO_TOMADAS - 1) + 3) / 4 * 4 /*!< Entradas das colunas, arredondadas para múltiplo de ColunasDaTabela::LARGURA_SOMA. */
+		};
+
 	private:
-		Prioridades prioridades; /*!< Variável que contém as prioridade da tomada ao longo do dia.*/
-		bool podeDesligar[4];
+		Dados dados[NUMERO_MAXIMO_TOMADAS - 1]; /*!< Dados de cada entrada.*/
+		Estatico<Hash_Element> elementos[NUMERO_MAXIMO_TOMADAS - 1]; /*!< Elemento da hash de cada entrada.*/
+		int livres[NUMERO_MAXIMO_TOMADAS - 1]; /*!< Índices das entradas livres.*/
+		int quantidadeLivres; /*!< Quantidade de índices em livres.*/
+		ColunasDaTabela<CAPACIDADE, NUMERO_NIVEIS_PRIORIDADE> colunas; /*!< Colunas das entradas usadas nas somas.*/
 
 	public:
 		/*!
-			Método construtor da classe
+			Método construtor da classe.
 		*/
-		TomadaInteligente() {
-			consumo = 0;
-			tipo = 1; // Indica uma TomadaInteligente
-			setPrioridades(1); // Prioridade padrão é 1
-			setPodeDesligar(true, 0);
-			setPodeDesligar(true, 1);
-			setPodeDesligar(true, 2);
-			setPodeDesligar(true, 3);
+		PoolDeTomadas() {
+			quantidadeLivres = 0;
+			for (int i = CAPACIDADE - 1; i >= 0; i--) {
+				colunas.zerar(i);
+				if (i < NUMERO_MAXIMO_TOMADAS - 1) {
+					livres[quantidadeLivres++] = i;
+				}
+			}
 		}
 
 		/*!
-			Método que devolve o tipo de tomada.
-			\return o tipo dessa tomada.
+			Método que ocupa uma entrada com uma cópia dos dados passados.
+			\param d são os dados da tomada.
+			\return Elemento da hash indexado pelo endereço da tomada, ou 0 se não há entradas livres.
 		*/
-		int getTipo(){
-			return tipo;
+		Hash_Element* alocar(const Dados& d) {
+			if (quantidadeLivres == 0) {
+				return 0;
+			}
+			int i = livres[--quantidadeLivres];
+			dados[i] = d;
+			Hash_Element* e = elementos[i].construir(&dados[i], d.remetente); // Hash é indexada pelo endereço da tomada.
+			atualizarColunas(e);
+			return e;
 		}
 
 		/*!
-			Método que altera todas as prioridades da tomada para o valor passado por parâmetro.
-			\param p é o novo valor das prioridades da tomada.
+			Método que libera a entrada de um elemento.
+			\param e é o elemento, já removido da hash.
 		*/
-		void setPrioridades(int p) {
-			prioridades.madrugada = p;
-			prioridades.manha = p;
-			prioridades.tarde = p;
-			prioridades.noite = p;
+		void liberar(Hash_Element* e) {
+			int i = e->object() - dados;
+			elementos[i].destruir();
+			colunas.zerar(i);
+			livres[quantidadeLivres++] = i;
 		}
 
 		/*!
-			Método que altera a prioridade no período das 00:00 às 06:00.
- 			\param p é o novo valor da prioridade nesse horário.
+			Método que copia para as colunas os Dados de uma entrada. Deve ser chamado sempre que os Dados da entrada mudam.
+			Definido depois de PlanejadorDeCorte, cujo nivelDaPrioridade() dá o nível da coluna.
+			\param e é o elemento da entrada.
 		*/
-		void setPrioridadeMadrugada(int p) {
-			prioridades.madrugada = p;
-		}
+		void atualizarColunas(Hash_Element* e);
 
 		/*!
-			Método que altera a prioridade no período das 06:00 às 12:00.
- 			\param p é o novo valor da prioridade nesse horário.
+			Método que soma o consumo previsto das entradas enviadas em uma época, as mesmas que entram no plano de corte.
+			\param e é a época.
+			\return Soma do consumo previsto.
 		*/
-		void setPrioridadeManha(int p) {
-			prioridades.manha = p;
+		float somarPrevisto(unsigned long e) const {
+			return colunas.somarPrevisto(e);
 		}
 
 		/*!
-			Método que altera a prioridade no período das 12:00 às 18:00.
- 			\param p é o novo valor da prioridade nesse horário.
+			Método que soma o último consumo das entradas ouvidas em uma época.
+			\param e é a época local.
+			\return Soma do último consumo.
 		*/
-		void setPrioridadeTarde(int p) {
-			prioridades.tarde = p;
+		float somarUltimoConsumo(unsigned long e) const {
+			return colunas.somarUltimoConsumo(e);
 		}
 
 		/*!
-			Método que altera a prioridade no período das 18:00 às 00:00.
- 			\param p é o novo valor da prioridade nesse horário.
+			Método que soma as entradas enviadas em uma época, como Agregador::somar() faria com cada uma delas.
+			\param e é a época.
+			\param somas recebe as somas das entradas (somadas ao valor anterior).
+			\param consumoMensalMaior recebe o maior consumo mensal informado, se ele for maior que o valor anterior.
+			\param limiteMenor recebe o menor consumo máximo informado, se ele for menor que o valor anterior.
+			\return Quantidade de entradas somadas.
 		*/
-		void setPrioridadeNoite(int p) {
-			prioridades.noite = p;
+		int somarEpoca(unsigned long e, Agregado* somas, float* consumoMensalMaior, float* limiteMenor) const {
+			return colunas.somarEpoca(e, somas, consumoMensalMaior, limiteMenor);
 		}
+};
 
+//----------------------------------------------------------------------------
+//!  Classe BaseDeTempo
+/*!
+	Classe que fornece a todo o controlador uma única contagem de microssegundos desde a inicialização, lida de um cronômetro sempre ligado.
+	A tarefa de decisão lê o tempo uma vez no início de cada volta do laço (marcarPasso()) e usa essa leitura em toda a volta (doPasso()),
+	então o que ela decide só depende das entradas e dos instantes das voltas. Na reprodução de tráfego o tempo é virtual, avançado pelo reprodutor.
+*/
+class BaseDeTempo {
+	private:
+		static Chronometer* cronometro; /*!< Cronômetro sempre ligado.*/
+		static Estatico<Chronometer> memoriaCronometro; /*!< Espaço do cronômetro.*/
+		static bool emTempoVirtual; /*!< Indica se o tempo é virtual.*/
+		static long long tempoVirtual; /*!< Tempo virtual atual.*/
+		static long long tempoDoPasso; /*!< Leitura feita no início da volta atual do laço de decisão.*/
+
+	public:
 		/*!
-			Método que altera se a tomada pode ou não ser desligada no periodo especificado.
- 			\param valor é o valor booleano que especifica se a tomada pode ou não desligar.
- 			\param periodo é o periodo em que sera feita a alteração. (0 -Madrugada, 1 -Manhã, 2 -Tarde, 3 -Noite)
+			Método que liga o cronômetro. Chamado uma vez, antes de as outras tarefas serem criadas.
 		*/
-		void setPodeDesligar(bool valor, int periodo) {
-			podeDesligar[periodo] = valor;
+		static void iniciar() {
+			if (cronometro == 0) {
+				cronometro = memoriaCronometro.construir();
+				cronometro->start();
+			}
 		}
 
 		/*!
-			Método que retorna as prioridades da tomada.
-			\return Struct que contém as quatro possiveis prioridades da tomada.
+			Método que passa a usar o tempo virtual, que só anda por setTempoVirtual().
+			\param tempo é o tempo virtual em microssegundos.
 		*/
-		Prioridades getPrioridades() {
-			return prioridades;
+		static void setTempoVirtual(long long tempo) {
+			tempoVirtual = tempo;
+			emTempoVirtual = true;
+		}
+
+		/*!
+			Método que lê o tempo atual. Pode ser chamado por qualquer tarefa.
+			\return Microssegundos desde a inicialização (ou o tempo virtual).
+		*/
+		static long long ler() {
+			return emTempoVirtual ? tempoVirtual : cronometro->read();
+		}
+
+		/*!
+			Método que lê o cronômetro, mesmo com o tempo virtual. Usado para medir o tempo gasto na reprodução.
+			\return Microssegundos desde a inicialização.
+		*/
+		static long long lerReal() {
+			return cronometro->read();
+		}
+
+		/*!
+			Método que lê o tempo no início de uma volta do laço de decisão. Chamado apenas pela tarefa de decisão.
+			\return Leitura da volta.
+		*/
+		static long long marcarPasso() {
+			tempoDoPasso = ler();
+			return tempoDoPasso;
+		}
+
+		/*!
+			Método que retorna a leitura da volta atual do laço de decisão (0 antes da primeira volta).
+			\return Leitura feita por marcarPasso().
+		*/
+		static long long doPasso() {
+			return tempoDoPasso;
+		}
+};
+
+Chronometer* BaseDeTempo::cronometro = 0;
+Estatico<Chronometer> BaseDeTempo::memoriaCronometro;
+bool BaseDeTempo::emTempoVirtual = false;
+long long BaseDeTempo::tempoVirtual = 0;
+long long BaseDeTempo::tempoDoPasso = 0;
+
+//----------------------------------------------------------------------------
+//!  Classe Relogio
+/*!
+	Classe que lida com as informações de datas e horários.
+*/
+class Relogio {
+	private:
+		Data data; /*!< É uma struct Data para o controle da data atual.*/
+		unsigned long long tempo; /*!< Tempo atual em microssegundos desde 01/01/2016, mantido junto com data para que agora() não precise converter a data.*/
+		int diasNoMes[12]; /*!< Vetor que guarda quantos dias tem em cada mês.*/
+		unsigned long long tempoAncora; /*!< Tempo na última alteração do relógio ou da taxa. O tempo atual é calculado a partir dele, sem acumular arredondamentos.*/
+		long long baseAncora; /*!< Leitura da BaseDeTempo correspondente a tempoAncora.*/
+		float correcaoTaxa; /*!< Correção relativa da taxa do cronômetro (0 = sem correção), estimada pela sincronização de tempo.*/
+
+		/*!
+			Método que fixa a âncora no tempo atual. Chamado sempre que o tempo ou a taxa são alterados.
+		*/
+		void ancorar() {
+			tempoAncora = tempo;
+			baseAncora = BaseDeTempo::doPasso();
+		}
+
+		/*!
+			Método que inicializa o vetor com a quantidade de dias em cada mẽs.
+		*/
+		void inicializarMeses() {
+			diasNoMes[0]  = 31; // Janeiro;
+			diasNoMes[1]  = 28; // Fevereiro;
+			diasNoMes[2]  = 31; // Março;
+			diasNoMes[3]  = 30; // Abril;
+			diasNoMes[4]  = 31; // Maio;
+			diasNoMes[5]  = 30; // Junho;
+			diasNoMes[6]  = 31; // Julho;
+			diasNoMes[7]  = 31; // Agosto;
+			diasNoMes[8]  = 30; // Setembro;
+			diasNoMes[9]  = 31; // Outubro;
+			diasNoMes[10] = 30; // Novembro;
+			diasNoMes[11] =	31;	// Dezembro.
+		}
+
+	public:
+		/*!
+			Método construtor da classe.
+		*/
+		Relogio() {
+			correcaoTaxa = 0;
+
+			// data default
+			data.ano = 2016;
+			data.mes= 1;
+			data.dia = 1;
+			data.hora = 0;
+			data.minuto = 0;
+
+			data.segundo = 0;
+			data.microssegundos = 0;
+			tempo = 0;
+			ancorar();
+			inicializarMeses();
+		}
+
+		/*!
+			Método que retorna o dia atual.
+			\return um inteiro que representa o dia atual.
+		*/
+		Data getData() {
+			atualizaRelogio();
+			return data;
+		}
+
+		/*!
+			Método que retorna quantos tempo se passou em microssegundos desde 01/01/2016.
+			\param data data que será convertida para microssegundos.
+			\return Quanto tempo em microssegundos se passou desde 01/01/2016.
+		*/
+		unsigned long long dataEmMicrosec(Data data) {
+			// Valores para "conversão". São inteiros para não perder precisão (a sincronização de tempo trabalha com microssegundos).
+			unsigned long long micssNumSeg = 1000000;
+			unsigned long long micssNumMin = 60 * micssNumSeg;
+			unsigned long long micssNumaHor = 60 * micssNumMin;
+			unsigned long long micssNumDia = 24 * micssNumaHor;
+
+			// Conversões de unidades dentro de um dia.
+			unsigned long long tempoEmMicrosec = 0;
+			tempoEmMicrosec += data.microssegundos;
+			tempoEmMicrosec += data.segundo * micssNumSeg;
+			tempoEmMicrosec += data.minuto * micssNumMin;
+			tempoEmMicrosec += data.hora * micssNumaHor;
+
+			// Conversões maiores que de um dia.
+			// Dia.
+			tempoEmMicrosec += (data.dia - 1) * micssNumDia;
+
+			// Mês.
+			for (int i = 1; i < data.mes; i++) { // i < data.mes ??
+				tempoEmMicrosec += getDiasNoMes(i, data.ano) * micssNumDia;
+			}
+
+			// Ano.
+			// A contagem começa em 2016.
+			// Para que o valor não seja muito grande.
+			int anoMin = 2016;
+			data.ano -= anoMin;
+			if (data.ano < 0) {
+				data.ano = 0;
+			}
+			// Anos bissextos completos desde 2016 (inclusive).
+			tempoEmMicrosec += ((data.ano) * 365 + (data.ano + 3) / 4) * micssNumDia;
+
+			return tempoEmMicrosec;
+		}
+
+		/*!
+			Método que altera a data atual.
+			\param d é a data para qual será feita a alteração.
+		*/
+		void setData(Data d) {
+			data = d;
+			tempo = dataEmMicrosec(data);
+			ancorar();
+		}
+
+		/*!
+			Método que altera o ano atual.
+			\param a é um inteiro que indica o ano.
+		*/
+		void setAno(int a) {
+			data.ano = a;
+			tempo = dataEmMicrosec(data);
+			ancorar();
+		}
+
+		/*!
+			Método que altera o mês atual.
+			\param m é um inteiro que indica o mês.
+		*/
+		void setMes(int m) {
+			data.mes= m;
+			tempo = dataEmMicrosec(data);
+			ancorar();
+		}
+
+		/*!
+			Método que altera o dia atual.
+			\param d é um inteiro que indica o dia.
+		*/
+		void setDia(int d) {
+			data.dia = d;
+			tempo = dataEmMicrosec(data);
+			ancorar();
+		}
+
+		/*!
+			Método que altera a hora atual.
+			\param h é um inteiro que indica a hora.
+		*/
+		void setHora(int h) {
+			data.hora = h;
+			tempo = dataEmMicrosec(data);
+			ancorar();
+		}
+
+		/*!
+			Método que altera o minuto atual.
+			\param m é um inteiro que indica o minuto.
+		*/
+		void setMinuto(int m) {
+			data.minuto = m;
+			tempo = dataEmMicrosec(data);
+			ancorar();
+		}
+
+		/*!
+			Método que altera o segundo atual.
+			\param s é um inteiro que indica o segundo.
+		*/
+		void setSegundo(int s) {
+			data.segundo = s;
+			tempo = dataEmMicrosec(data);
+			ancorar();
+		}
+
+		/*!
+			Método que atualiza os dados do relógio com o tempo da volta atual do laço de decisão (BaseDeTempo::doPasso()).
+			O tempo é calculado a partir da âncora, então não depende de quantas vezes o relógio foi lido.
+		*/
+		void atualizaRelogio() {
+			long long decorrido = BaseDeTempo::doPasso() - baseAncora;
+			unsigned long long novo = tempoAncora + decorrido + (long long) (decorrido * (double) correcaoTaxa);
+			if (novo > tempo) {
+				incrementarMicrossegundo(novo - tempo);
+				tempo = novo;
+			}
+		}
+
+		/*!
+			Método que converte um tempo desde 01/01/2016 em uma data. É o inverso de dataEmMicrosec().
+			\param tempo é o tempo em microssegundos desde 01/01/2016.
+			\return Data correspondente.
+		*/
+		Data microsecEmData(unsigned long long tempo) {
+			unsigned long long micssNumDia = 24 * 60 * 60 * 1000000ULL;
+			unsigned long long dias = tempo / micssNumDia;
+			unsigned long long restoDoDia = tempo % micssNumDia;
+
+			Data d;
+			d.ano = 2016;
+			d.mes = 1;
+			while (dias >= (unsigned long long) ((d.ano % 4 == 0) ? 366 : 365)) {
+				dias -= (d.ano % 4 == 0) ? 366 : 365;
+				d.ano++;
+			}
+			while (dias >= (unsigned long long) getDiasNoMes(d.mes, d.ano)) {
+				dias -= getDiasNoMes(d.mes, d.ano);
+				d.mes++;
+			}
+			d.dia = dias + 1;
+			d.hora = restoDoDia / (60 * 60 * 1000000ULL);
+			d.minuto = (restoDoDia / (60 * 1000000ULL)) % 60;
+			d.segundo = (restoDoDia / 1000000ULL) % 60;
+			d.microssegundos = restoDoDia % 1000000ULL;
+			return d;
+		}
+
+		/*!
+			Método que adianta (ou atrasa, se negativo) o relógio.
+			\param microssegundos é o ajuste em microssegundos.
+		*/
+		void ajustar(long long microssegundos) {
+			atualizaRelogio();
+			long long ajustado = (long long) tempo + microssegundos;
+			if (ajustado < 0) {
+				ajustado = 0;
+			}
+			tempo = (unsigned long long) ajustado;
+			data = microsecEmData(tempo);
+			ancorar();
+		}
+
+		/*!
+			Método que corrige a taxa do relógio.
+			\param correcao é a correção relativa somada à atual (por exemplo, 0.00002 adianta o relógio em 20 microssegundos por segundo).
+		*/
+		void corrigirTaxa(float correcao) {
+			atualizaRelogio();
+			ancorar();
+			correcaoTaxa += correcao;
+		}
+
+		/*!
+			Método que retorna o tempo atual em microssegundos desde 01/01/2016.
+			\return Tempo atual.
+		*/
+		unsigned long long agora() {
+			atualizaRelogio();
+			return tempo;
+		}
+
+		/*!
+			Método que incrementa o ano.
+			\param anos é a quantidade de anos que serão incrementados no relógio.
+		*/
+		void incrementarAno(long long anos){
+			data.ano+=anos;
+		}
+
+		/*!
+			Método que incrementa os meses de forma a atualizar todas as unidades de tempo superiores.
+			\param meses é a quantidade de meses que serão incrementados no relógio.
+		*/
+		void incrementarMes(long long meses){
+			data.mes+=meses;
+			if (data.mes > 12) {
+				incrementarAno( data.mes/12 );
+				data.mes = data.mes % 12;
+			}
+		}
+
+		/*!
+			Método que incrementa os dias de forma a atualizar todas as unidades de tempo superiores.
+			\param dias é a quantidade de dias que serão incrementados no relógio.
+		*/
+		void incrementarDia(long long dias){
+			while (dias > 0) {
+				data.dia++;
+				if (data.dia > getDiasNoMes(data.mes, data.ano)) {
+					incrementarMes(1);
+					data.dia = 1;
+				}
+				dias--;
+			}
+		}
+
+		/*!
+			Método que incrementa as horas de forma a atualizar todas as unidades de tempo superiores.
+			\param hrs é a quantidade de horas que serão incrementadas no relógio.
+		*/
+		void incrementarHora(long long hrs){
+			data.hora+=hrs;
+			if (data.hora >= 24) {
+				incrementarDia( data.hora/24 );
+				data.hora = data.hora % 24;
+			}
+		}
+
+		/*!
+			Método que incrementa os minutos de forma a atualizar todas as unidades de tempo superiores.
+			\param mins é a quantidade de minutos que serão incrementados no relógio.
+		*/
+		void incrementarMinuto(long long mins){
+			data.minuto+=mins;
+			if (data.minuto >= 60) {
+				incrementarHora( data.minuto/60 );
+				data.minuto = data.minuto % 60;
+			}
+		}
+
+		/*!
+			Método que incrementa os segundos de forma a atualizar todas as unidades de tempo superiores.
+			\param secs é a quantidade de segundos que serão incrementados no relógio.
+		*/
+		void incrementarSegundo(long long secs){
+			data.segundo+=secs;
+			if (data.segundo >= 60) {
+				incrementarMinuto( data.segundo/60 );
+				data.segundo = data.segundo % 60;
+			}
+		}
+
+		/*!
+			Método que incrementa os microssegundos de forma a atualizar todas as unidades de tempo superiores.
+			\param mcsec é a quantidade de microssegundos que serão incrementados no relógio.
+		*/
+		void incrementarMicrossegundo(long long mcsec){
+			data.microssegundos+=mcsec;
+			if (data.microssegundos >= 1000000) {
+				incrementarSegundo( data.microssegundos/1000000 );
+				data.microssegundos = data.microssegundos % 1000000;
+			}
+		}
+
+		/*!
+			Método que retorna quantos dias tem no mês atual.
+ 			\param mes é um inteiro que indica o mês atual.
+ 			\param ano é um inteiro que indica o ano atual.
+			\return Valor inteiro que representa quantos dias tem no mês.
+		*/
+		int getDiasNoMes(int mes, int ano) {
+			if (ano % 4 == 0 && mes == 2) { // Se é ano bissexto e o mês é fevereiro.
+				return 29;
+			} else {
+				return diasNoMes[mes-1];
+			}
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe Calendario
+/*!
+	Classe que calcula com antecedência os próximos instantes em que algo muda no calendário (sincronização, hora, quarto do dia e mês)
+	e os publica como eventos. A cada passagem do laço principal, verificar() só compara o tempo atual com esses instantes;
+	a data só é convertida quando um deles passa. O quarto do dia, a época e as épocas até o fim do mês ficam guardados para as consultas.
+	As sincronizações acontecem nos múltiplos do intervalo entre elas, contados desde 01/01/2016: tomadas com intervalos diferentes (potências de 2)
+	ainda se encontram nas sincronizações do intervalo maior.
+	Os instantes são tempos absolutos, então os pequenos ajustes da sincronização de tempo não os invalidam; depois de um salto para trás, eles são recalculados.
+*/
+class Calendario {
+	private:
+		Relogio* relogio; /*!< Relógio consultado.*/
+		unsigned long long proximaSincronizacao; /*!< Início da época da próxima sincronização, em microssegundos desde 01/01/2016.*/
+		unsigned long long proximaHora; /*!< Início da próxima hora.*/
+		unsigned long long proximoPeriodo; /*!< Início do próximo quarto do dia.*/
+		unsigned long long proximoMes; /*!< Início do próximo mês.*/
+		unsigned long long proximaEpoca; /*!< Início da próxima época.*/
+		unsigned long epoca; /*!< Época da última sincronização, isto é, quantos intervalos de MIN_POR_EPOCA minutos passaram desde 01/01/2016.*/
+		int periodo; /*!< Quarto do dia atual (0 -Madrugada, 1 -Manhã, 2 -Tarde, 3 -Noite).*/
+		int epocasAteFimDoMes; /*!< Épocas do mês a partir da época da última sincronização, inclusive.*/
+		int epocasEntreSincs; /*!< Quantidade de épocas entre as sincronizações (potência de 2).*/
+
+		/*!
+			Método que calcula o início do mês seguinte ao de um tempo. Só é chamado quando um mês começa ou o relógio é alterado.
+			\param agora é o tempo em microssegundos desde 01/01/2016.
+		*/
+		void calcularMes(unsigned long long agora) {
+			Data data = relogio->microsecEmData(agora);
+			Data inicio;
+			inicio.ano = (data.mes == 12) ? (data.ano + 1) : data.ano;
+			inicio.mes = (data.mes == 12) ? 1 : (data.mes + 1);
+			inicio.dia = 1;
+			inicio.hora = 0;
+			inicio.minuto = 0;
+			inicio.segundo = 0;
+			inicio.microssegundos = 0;
+			proximoMes = relogio->dataEmMicrosec(inicio);
+		}
+
+		/*!
+			Método que calcula as épocas que faltam no mês, contando a atual. Como os meses começam à meia-noite, a divisão é exata.
+		*/
+		void calcularEpocas() {
+			unsigned long long tempoEpoca = MIN_POR_EPOCA * 60 * 1000000ULL;
+			unsigned long long inicioEpoca = epoca * tempoEpoca;
+			epocasAteFimDoMes = (proximoMes > inicioEpoca) ? (int) ((proximoMes - inicioEpoca) / tempoEpoca) : 1;
+		}
+
+		/*!
+			Método que calcula o início da próxima sincronização depois de um tempo.
+			\param agora é o tempo em microssegundos desde 01/01/2016.
+		*/
+		void calcularSincronizacao(unsigned long long agora) {
+			unsigned long long tempoEntreSincs = epocasEntreSincs * MIN_POR_EPOCA * 60 * 1000000ULL;
+			proximaSincronizacao = (agora / tempoEntreSincs + 1) * tempoEntreSincs;
+		}
+
+	public:
+		/*!
+			Método construtor da classe.
+			\param r é o relógio consultado.
+		*/
+		Calendario(Relogio* r) {
+			relogio = r;
+			epocasEntreSincs = EPOCAS_ENTRE_SINC_PADRAO;
+			reiniciar();
+		}
+
+		/*!
+			Método que recalcula todos os instantes a partir do relógio, sem publicar eventos. Chamado quando o relógio é alterado.
+		*/
+		void reiniciar() {
+			unsigned long long agora = relogio->agora();
+			unsigned long long umaHora = 3600000000ULL;
+			epoca = (unsigned long) (agora / (MIN_POR_EPOCA * 60 * 1000000ULL));
+			calcularSincronizacao(agora);
+			proximaEpoca = (epoca + 1) * (MIN_POR_EPOCA * 60 * 1000000ULL);
+			proximaHora = (agora / umaHora + 1) * umaHora;
+			proximoPeriodo = (agora / (6 * umaHora) + 1) * (6 * umaHora);
+			periodo = (int) ((agora / (6 * umaHora)) % 4);
+			calcularMes(agora);
+			calcularEpocas();
+		}
+
+		/*!
+			Método que publica os eventos do calendário desde a última chamada. Deve ser chamado a cada passagem do laço principal.
+			\param agora é o tempo atual em microssegundos desde 01/01/2016.
+			\return Eventos (CALENDARIO_SINCRONIZACAO, CALENDARIO_EPOCA, CALENDARIO_PERIODO, CALENDARIO_HORA e CALENDARIO_MES) que aconteceram, ou 0.
+		*/
+		int verificar(unsigned long long agora) {
+			unsigned long long tempoEntreSincs = epocasEntreSincs * MIN_POR_EPOCA * 60 * 1000000ULL;
+			if (agora + tempoEntreSincs < proximaSincronizacao) { // O relógio voltou mais de um intervalo (nova raiz de tempo).
+				reiniciar();
+				return 0;
+			}
+			int eventos = 0;
+			if (agora >= proximaHora) {
+				unsigned long long umaHora = 3600000000ULL;
+				proximaHora = (agora / umaHora + 1) * umaHora;
+				if (agora >= proximoPeriodo) {
+					proximoPeriodo = (agora / (6 * umaHora) + 1) * (6 * umaHora);
+					periodo = (int) ((agora / (6 * umaHora)) % 4);
+					eventos |= CALENDARIO_PERIODO;
+				}
+				eventos |= CALENDARIO_HORA;
+			}
+			if (agora >= proximoMes) {
+				calcularMes(agora);
+				eventos |= CALENDARIO_MES;
+			}
+			if (agora >= proximaEpoca) {
+				proximaEpoca = (agora / (MIN_POR_EPOCA * 60 * 1000000ULL) + 1) * (MIN_POR_EPOCA * 60 * 1000000ULL);
+				eventos |= CALENDARIO_EPOCA;
+			}
+			if (agora >= proximaSincronizacao) {
+				epoca = (unsigned long) (agora / (MIN_POR_EPOCA * 60 * 1000000ULL));
+				calcularSincronizacao(agora);
+				calcularEpocas();
+				eventos |= CALENDARIO_SINCRONIZACAO;
+			}
+			return eventos;
+		}
+
+		/*!
+			Método que retorna a época da última sincronização.
+			\return Quantidade de épocas desde 01/01/2016.
+		*/
+		unsigned long getEpoca() {
+			return epoca;
+		}
+
+		/*!
+			Método que retorna o quarto do dia atual, usado nas prioridades e permissões de cada soquete.
+			\return Quarto do dia (0 -Madrugada, 1 -Manhã, 2 -Tarde, 3 -Noite).
+		*/
+		int getPeriodo() {
+			return periodo;
+		}
+
+		/*!
+			Método que retorna quantas épocas faltam no mês, contando a da última sincronização.
+			\return Quantidade de épocas.
+		*/
+		int getEpocasAteFimDoMes() {
+			return epocasAteFimDoMes;
+		}
+
+		/*!
+			Método que altera o intervalo entre as sincronizações. A próxima acontece no primeiro múltiplo do novo intervalo.
+			\param epocas é a quantidade de épocas entre as sincronizações (potência de 2).
+		*/
+		void setEpocasEntreSincs(int epocas) {
+			epocasEntreSincs = epocas;
+			calcularSincronizacao(relogio->agora());
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe SincronizadorDeTempo
+/*!
+	Classe que sincroniza o relógio da tomada com o da tomada raiz (a de menor endereço conhecido), no estilo do FTSP.
+	Toda mensagem leva o tempo do remetente. A cada mensagem de uma tomada sincronizada com a mesma raiz, a diferença entre os relógios é guardada
+	em uma tabela e estimada por regressão linear: a diferença atual é corrigida imediatamente e a inclinação corrige a taxa do relógio.
+	Tomadas sincronizadas repassam o tempo da raiz em suas próprias mensagens, então tomadas fora do alcance da raiz também são sincronizadas.
+	Os tempos são obtidos por software ao enviar e ao receber, então a precisão é limitada pela latência do NIC.
+*/
+class SincronizadorDeTempo {
+	private:
+		Relogio* relogio; /*!< Relógio disciplinado.*/
+		Address proprio; /*!< Endereço da própria tomada.*/
+		Address raiz; /*!< Tomada com a qual o relógio está sendo sincronizado.*/
+		long long locais[NUMERO_PONTOS_REGRESSAO]; /*!< Tempo local de recebimento de cada ponto.*/
+		long long diferencas[NUMERO_PONTOS_REGRESSAO]; /*!< Diferença entre o tempo do remetente e o local de cada ponto.*/
+		int quantidadePontos; /*!< Quantidade de pontos válidos.*/
+		int proximoPonto; /*!< Posição do próximo ponto (a tabela é circular).*/
+		long long ultimoAjuste; /*!< Último ajuste aplicado ao relógio, em microssegundos.*/
+		bool sincronizada; /*!< Indica se o último ajuste foi pequeno o suficiente para considerar o relógio sincronizado.*/
+		int epocasSemReferencia; /*!< Quantidade de sincronizações sem ouvir nenhuma tomada sincronizada com a raiz.*/
+
+		/*!
+			Método que estima, por regressão linear, a diferença para a raiz em um instante e a inclinação dessa diferença.
+			\param instante é o tempo local em que a diferença é estimada.
+			\param inclinacao recebe a variação da diferença por microssegundo local.
+			\return Diferença estimada em microssegundos.
+		*/
+		long long estimar(long long instante, double* inclinacao) {
+			long long base = locais[0];
+			double mediaT = 0;
+			double mediaD = 0;
+			for (int i = 0; i < quantidadePontos; i++) {
+				mediaT += (double) (locais[i] - base);
+				mediaD += (double) diferencas[i];
+			}
+			mediaT /= quantidadePontos;
+			mediaD /= quantidadePontos;
+
+			double numerador = 0;
+			double denominador = 0;
+			for (int i = 0; i < quantidadePontos; i++) {
+				double dt = (double) (locais[i] - base) - mediaT;
+				numerador += dt * ((double) diferencas[i] - mediaD);
+				denominador += dt * dt;
+			}
+			*inclinacao = (denominador > 0) ? (numerador / denominador) : 0;
+			return (long long) (mediaD + *inclinacao * ((double) (instante - base) - mediaT));
+		}
+
+		/*!
+			Método que retorna a extensão de tempo local coberta pelos pontos.
+		*/
+		long long extensao() {
+			long long menor = locais[0];
+			long long maior = locais[0];
+			for (int i = 1; i < quantidadePontos; i++) {
+				if (locais[i] < menor) {
+					menor = locais[i];
+				}
+				if (locais[i] > maior) {
+					maior = locais[i];
+				}
+			}
+			return maior - menor;
+		}
+
+	public:
+		/*!
+			Método construtor da classe.
+			\param r é o relógio que será disciplinado.
+			\param endereco é o endereço da própria tomada.
+		*/
+		SincronizadorDeTempo(Relogio* r, const Address& endereco) {
+			relogio = r;
+			proprio = endereco;
+			raiz = proprio;
+			ultimoAjuste = 0;
+			epocasSemReferencia = 0;
+			reiniciar();
+		}
+
+		/*!
+			Método que descarta os pontos da regressão. Usado quando o relógio é alterado por outro meio ou a raiz muda.
+		*/
+		void reiniciar() {
+			quantidadePontos = 0;
+			proximoPonto = 0;
+			sincronizada = false;
+		}
+
+		/*!
+			Método que preenche o carimbo de tempo de uma mensagem que será enviada.
+			\param carimbo é o carimbo da mensagem.
+		*/
+		void carimbar(CarimboDeTempo* carimbo) {
+			carimbo->raiz = raiz;
+			carimbo->valido = estaSincronizada();
+			carimbo->tempo = relogio->agora();
+		}
+
+		/*!
+			Método que incorpora o carimbo de tempo de uma mensagem recebida.
+			\param carimbo é o carimbo da mensagem.
+			\param atraso é o tempo (em microssegundos) desde a chegada da mensagem.
+		*/
+		void receber(const CarimboDeTempo& carimbo, long long atraso) {
+			long long chegada = relogio->agora() - atraso;
+			if (!carimbo.valido) { // O remetente ainda não sabe o tempo da raiz.
+				return;
+			}
+			int comparacao = ComparadorDeEnderecos::comparar(carimbo.raiz, raiz);
+			if (comparacao > 0) { // O remetente segue uma raiz pior.
+				return;
+			}
+			if (comparacao < 0) { // Raiz de menor endereço: recomeça a sincronização com ela.
+				raiz = carimbo.raiz;
+				reiniciar();
+				RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_NOVA_RAIZ, RegistroDeEventos::endereco(raiz));
+			}
+			if (raiz == proprio) {
+				return;
+			}
+			epocasSemReferencia = 0;
+
+			locais[proximoPonto] = chegada;
+			diferencas[proximoPonto] = carimbo.tempo - chegada;
+			proximoPonto = (proximoPonto + 1) % NUMERO_PONTOS_REGRESSAO;
+			if (quantidadePontos < NUMERO_PONTOS_REGRESSAO) {
+				quantidadePontos++;
+			}
+
+			// Corrige a diferença atual. Os pontos passam a ser expressos no relógio já ajustado.
+			double inclinacao = 0;
+			ultimoAjuste = estimar(chegada, &inclinacao);
+			relogio->ajustar(ultimoAjuste);
+			for (int i = 0; i < quantidadePontos; i++) {
+				locais[i] += ultimoAjuste;
+				diferencas[i] -= ultimoAjuste;
+			}
+			sincronizada = (ultimoAjuste > -LIMIAR_SINCRONIZADA) && (ultimoAjuste < LIMIAR_SINCRONIZADA);
+
+			// Com pontos suficientes e espaçados, corrige também a taxa e recomeça a tabela com a nova taxa.
+			if ((quantidadePontos == NUMERO_PONTOS_REGRESSAO) && (extensao() >= INTERVALO_CORRECAO_TAXA * 1000000LL)) {
+				relogio->corrigirTaxa((float) inclinacao);
+				quantidadePontos = 0;
+				proximoPonto = 0;
+			}
+		}
+
+		/*!
+			Método chamado a cada sincronização. Se a raiz não é ouvida por SINCS_PARA_EXPIRAR sincronizações, a tomada volta a ser sua própria raiz.
+		*/
+		void novaEpoca() {
+			if (raiz == proprio) {
+				return;
+			}
+			epocasSemReferencia++;
+			if (epocasSemReferencia >= SINCS_PARA_EXPIRAR) {
+				raiz = proprio;
+				reiniciar();
+				RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_RAIZ_PERDIDA);
+			}
+		}
+
+		/*!
+			Método que verifica se o relógio é a raiz ou está sincronizado com ela.
+			\return Valor booleano que indica se o relógio está sincronizado.
+		*/
+		bool estaSincronizada() {
+			return (raiz == proprio) || sincronizada;
+		}
+
+		/*!
+			Método que retorna o último ajuste aplicado ao relógio.
+			\return Ajuste em microssegundos.
+		*/
+		long long getUltimoAjuste() {
+			return ultimoAjuste;
+		}
+
+		/*!
+			Método que retorna a raiz atual.
+			\return Endereço da raiz.
+		*/
+		const Address getRaiz() {
+			return raiz;
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe Mensageiro
+/*!
+	Classe encarregada de enviar e receber mensagens.
+	O NIC é usado apenas pela tarefa do rádio (tarefaRadio()). As outras tarefas enviam e recebem pelas filas filaEnvio e filaRecebidos,
+	e ligam ou desligam o rádio por um pedido (pedidoLigado) que a tarefa do rádio aplica entre as transferências.
+*/
+class Mensageiro {
+	private:
+		NIC * nic; /*!< Variável que representa o NIC.*/
+		Estatico<NIC> memoriaNIC; /*!< Espaço do NIC.*/
+		volatile bool ligado; /*!< Indica se o rádio está ligado. Escrito só pela tarefa do rádio.*/
+		volatile bool pedidoLigado; /*!< Estado do rádio pedido pela tarefa de decisão, aplicado pela tarefa do rádio.*/
+		long long inicioLigado; /*!< Leitura da BaseDeTempo quando o rádio foi ligado (ou quando a medição foi reiniciada).*/
+		long long tempoLigado; /*!< Tempo (em microssegundos) com o rádio ligado desde a última chamada a zerarTempoLigado(), sem contar o período atual.*/
+		SincronizadorDeTempo* sincronizador; /*!< Objeto que carimba as mensagens enviadas e recebe os carimbos das recebidas.*/
+		FilaSPSC<QuadroRecebido, TAMANHO_FILA_RECEBIDOS> filaRecebidos; /*!< Mensagens recebidas, da tarefa do rádio para a de decisão.*/
+		FilaSPSC<QuadroEnvio, TAMANHO_FILA_ENVIO> filaEnvio; /*!< Mensagens a enviar, da tarefa de decisão para a do rádio.*/
+		unsigned char grupo; /*!< Grupo de orçamento da placa, enviado no carimbo de todas as mensagens.*/
+		unsigned char epocasPropostas; /*!< Épocas entre sincronizações propostas pela placa, enviadas no carimbo de todas as mensagens.*/
+		static bool reproducao; /*!< Indica uma reprodução de tráfego: as mensagens chegam por injetar() e as enviadas não vão ao NIC.*/
+		static Address enderecoReproducao; /*!< Endereço da placa que gravou a captura reproduzida.*/
+
+		/*!
+			Método que passa à fila uma mensagem recebida pelo NIC. Chamado pela tarefa do rádio.
+			\return Valor booleano que indica se alguma mensagem foi recebida.
+		*/
+		bool receberDoNIC() {
+			if (!ligado || reproducao) {
+				return false;
+			}
+			QuadroRecebido recebido;
+			Address remetente;
+			recebido.protocolo = 0;
+			int tamanho = nic->receive(&remetente, &recebido.protocolo, &recebido.quadro, sizeof recebido.quadro);
+			if (tamanho < (int) sizeof(CarimboDeTempo)) { // Se não foi recebida nenhuma mensagem
+				return false;
+			}
+			// O resto do quadro é zerado para que a mensagem tratada seja a mesma que a capturada.
+			memset(reinterpret_cast<unsigned char*>(&recebido.quadro) + tamanho, 0, sizeof recebido.quadro - tamanho);
+			recebido.tamanho = (unsigned short) tamanho;
+			recebido.chegada = BaseDeTempo::ler();
+			filaRecebidos.inserir(recebido);
+			return true;
+		}
+
+		/*!
+			Método que liga ou desliga o NIC conforme o último pedido. Chamado pela tarefa do rádio.
+		*/
+		void aplicarPedidoDeEnergia() {
+			bool pedido = pedidoLigado;
+			if (pedido != ligado) {
+				nic->power(pedido ? FULL : OFF);
+				ligado = pedido;
+			}
+		}
+
+		/*!
+			Método que envia as mensagens da fila de envio. Chamado pela tarefa do rádio.
+		*/
+		void transmitirPendentes() {
+			QuadroEnvio envio;
+			while (filaEnvio.retirar(&envio)) {
+				// O carimbo é corrigido pelo tempo que a mensagem passou na fila.
+				CarimboDeTempo* carimbo = reinterpret_cast<CarimboDeTempo*>(&envio.quadro);
+				carimbo->tempo += BaseDeTempo::ler() - envio.enfileirado;
+				nic->send(envio.destino, envio.protocolo, &envio.quadro, envio.tamanho);
+			}
+		}
+
+	public:
+		/*!
+			Método construtor da classe.
+		*/
+		Mensageiro() {
+			nic = memoriaNIC.construir();
+			inicioLigado = 0;
+			tempoLigado = 0;
+			sincronizador = 0;
+			grupo = 0;
+			epocasPropostas = EPOCAS_ENTRE_SINC_PADRAO;
+			// A tarefa do rádio ainda não existe, então o NIC é ligado aqui mesmo.
+			nic->power(FULL);
+			ligado = true;
+			pedidoLigado = true;
+		}
+
+		/*!
+			Método executado pela tarefa do rádio: recebe mensagens do NIC e envia as que estão na fila.
+			\param m é o mensageiro.
+			\return Nunca retorna.
+		*/
+		static int tarefaRadio(Mensageiro* m) {
+			while (true) {
+				m->aplicarPedidoDeEnergia();
+				while (m->receberDoNIC()) {
+				}
+				m->transmitirPendentes();
+				Thread::yield();
+			}
+			return 0;
+		}
+
+		/*!
+			Método que define o objeto que carimba as mensagens com o tempo da tomada.
+			\param s é o sincronizador de tempo.
+		*/
+		void setSincronizadorDeTempo(SincronizadorDeTempo* s) {
+			sincronizador = s;
+		}
+
+		/*!
+			Método que pede à tarefa do rádio que ligue o rádio. O tempo ligado é contado a partir do pedido.
+		*/
+		void ligarRadio() {
+			if (!pedidoLigado) {
+				pedidoLigado = true;
+				inicioLigado = BaseDeTempo::doPasso();
+			}
+		}
+
+		/*!
+			Método que pede à tarefa do rádio que desligue o rádio. Mensagens enviadas por outras tomadas enquanto ele está desligado são perdidas.
+		*/
+		void desligarRadio() {
+			if (pedidoLigado) {
+				tempoLigado += BaseDeTempo::doPasso() - inicioLigado;
+				pedidoLigado = false;
+			}
+		}
+
+		/*!
+			Método que verifica se o rádio foi pedido ligado (ele é ligado na próxima passagem da tarefa do rádio).
+			\return Valor booleano que indica se o rádio está ligado.
+		*/
+		bool radioLigado() {
+			return pedidoLigado;
+		}
+
+		/*!
+			Método que retorna o tempo com o rádio ligado desde a última chamada a zerarTempoLigado().
+			\return Tempo em microssegundos.
+		*/
+		long long lerTempoLigado() {
+			return tempoLigado + (pedidoLigado ? BaseDeTempo::doPasso() - inicioLigado : 0);
+		}
+
+		/*!
+			Método que reinicia a medição do tempo com o rádio ligado.
+		*/
+		void zerarTempoLigado() {
+			tempoLigado = 0;
+			inicioLigado = BaseDeTempo::doPasso();
+		}
+
+		/*!
+			Método que transmite uma mensagem em broadcast.
+			\param msg é a mensagem que será enviada.
+		*/
+		void enviarBroadcast(Dados msg) {
+			enviarMensagem(nic->broadcast(), msg);
+		}
+
+		/*!
+			Método que transmite uma mensagem para um destinatário.
+			\param destino é o endereço do dispositivo destinatário.
+			\param msg é a mensagem que será enviada.
+		*/
+		void enviarMensagem(const Address destino, const Dados msg) {
+			enviar(destino, PROTOCOLO_DADOS, &msg, sizeof msg);
+		}
+
+		/*!
+			Método que transmite uma mensagem de qualquer protocolo para um destinatário.
+			\param destino é o endereço do dispositivo destinatário.
+			\param protocolo é o protocolo que identifica o tipo da mensagem.
+			\param msg é o ponteiro para a mensagem que será enviada.
+			\param tamanho é o tamanho da mensagem em bytes.
+			\return Valor booleano que indica se a mensagem entrou na fila de envio (sempre verdadeiro na reprodução).
+		*/
+		bool enviar(const Address destino, const Protocol protocolo, const void* msg, unsigned int tamanho) {
+			// Todas as mensagens começam com um CarimboDeTempo. O tempo na fila é somado pela tarefa do rádio.
+			QuadroEnvio envio;
+			envio.destino = destino;
+			envio.protocolo = protocolo;
+			envio.tamanho = tamanho;
+			memcpy(&envio.quadro, msg, tamanho);
+			CarimboDeTempo* carimbo = reinterpret_cast<CarimboDeTempo*>(&envio.quadro);
+			unsigned char sequencia = carimbo->sequencia; // A numeração é de quem envia.
+			unsigned char envios = carimbo->envios;
+			if (sincronizador != 0) {
+				memset(carimbo, 0, sizeof(CarimboDeTempo)); // Sem os bytes de alinhamento da pilha, o mesmo envio gera sempre o mesmo quadro.
+				sincronizador->carimbar(carimbo);
+			}
+			carimbo->grupo = grupo;
+			carimbo->epocasPropostas = epocasPropostas;
+			carimbo->sequencia = sequencia;
+			carimbo->envios = envios;
+			CapturaDeTrafego::enviado(destino, protocolo, &envio.quadro, tamanho);
+			if (reproducao) {
+				return true;
+			}
+			envio.enfileirado = BaseDeTempo::doPasso();
+			if (!filaEnvio.inserir(envio)) {
+				RegistroDeEventos::registrar<NIVEL_REGISTRO_ERRO>(EVENTO_FILA_ENVIO_CHEIA);
+				return false;
+			}
+			return true;
+		}
+
+		/*!
+			Método que retorna o endereço de broadcast.
+			\return Endereço que alcança todas as tomadas.
+		*/
+		const Address obterBroadcast() {
+			return nic->broadcast();
+		}
+
+		/*!
+			Método que retira uma mensagem de qualquer protocolo da fila de mensagens recebidas.
+			\param quadro é o espaço onde a mensagem será copiada.
+			\param chegada recebe a leitura da BaseDeTempo quando ela chegou.
+			\return Protocolo da mensagem recebida, ou 0 se nenhuma mensagem foi recebida.
+		*/
+		Protocol receberQuadro(Quadro* quadro, long long* chegada) {
+			QuadroRecebido recebido;
+			if (!filaRecebidos.retirar(&recebido)) { // Se não foi recebida nenhuma mensagem
+				return 0;
+			}
+			memcpy(quadro, &recebido.quadro, sizeof *quadro);
+			*chegada = recebido.chegada;
+			long long atraso = BaseDeTempo::doPasso() - recebido.chegada; // Relativo à volta atual, a mesma referência do relógio.
+			if (atraso < 0) { // Chegou depois do início da volta: para a volta, chegou agora.
+				atraso = 0;
+			}
+			CapturaDeTrafego::recebido(recebido.protocolo, atraso, &recebido.quadro, recebido.tamanho);
+			if (sincronizador != 0) {
+				sincronizador->receber(*reinterpret_cast<CarimboDeTempo*>(&recebido.quadro), atraso);
+			}
+			if (recebido.protocolo == PROTOCOLO_DADOS) {
+				RegistroDeEventos::registrar<NIVEL_REGISTRO_DEPURACAO>(EVENTO_MENSAGEM_RECEBIDA, RegistroDeEventos::endereco(reinterpret_cast<Dados*>(quadro)->remetente));
+			} else if (recebido.protocolo == PROTOCOLO_REGUA) {
+				RegistroDeEventos::registrar<NIVEL_REGISTRO_DEPURACAO>(EVENTO_MENSAGEM_RECEBIDA, RegistroDeEventos::endereco(reinterpret_cast<MensagemRegua*>(quadro)->remetente));
+			}
+			return recebido.protocolo;
+		}
+
+		/*!
+			Método que retorna o tempo decorrido desde uma leitura da BaseDeTempo.
+			\param leitura é a leitura anterior.
+			\return Tempo em microssegundos.
+		*/
+		long long tempoDesde(long long leitura) {
+			return BaseDeTempo::ler() - leitura;
+		}
+
+		/*!
+			Método que coloca na fila de recebidas uma mensagem lida de uma captura. Usado apenas na reprodução de tráfego.
+			\param protocolo é o protocolo da mensagem.
+			\param quadro são os bytes da mensagem.
+			\param tamanho é a quantidade de bytes.
+			\param atraso é o tempo que a mensagem esperou na fila, na captura, até a volta do laço que a tratou.
+			\return Valor booleano que indica se a mensagem coube na fila.
+		*/
+		bool injetar(Protocol protocolo, const unsigned char* quadro, int tamanho, long long atraso) {
+			QuadroRecebido recebido;
+			if ((tamanho < (int) sizeof(CarimboDeTempo)) || (tamanho > (int) sizeof recebido.quadro)) {
+				return false;
+			}
+			memset(&recebido.quadro, 0, sizeof recebido.quadro);
+			memcpy(&recebido.quadro, quadro, tamanho);
+			recebido.protocolo = protocolo;
+			recebido.tamanho = (unsigned short) tamanho;
+			recebido.chegada = BaseDeTempo::ler() - atraso;
+			return filaRecebidos.inserir(recebido);
+		}
+
+		/*!
+			Método que faz a placa se passar pela que gravou uma captura: as mensagens recebidas vêm de injetar() e as enviadas não saem pelo rádio.
+			Chamado antes da construção dos objetos que guardam o próprio endereço.
+			\param endereco é o endereço da placa que gravou a captura.
+		*/
+		static void reproduzirComo(const Address& endereco) {
+			enderecoReproducao = endereco;
+			reproducao = true;
+		}
+
+		/*!
+			Método que registra a quantidade de mensagens descartadas com as filas cheias.
+		*/
+		void registrarDescartes() {
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_DESCARTES_MENSAGENS, filaRecebidos.getDescartados(), filaEnvio.getDescartados());
+		}
+
+		/*!
+			Método que marca uma mensagem como "vazia", isto é, que indica que nenhuma mensagem foi recebida.
+			\param msg é a mensagem a ser marcada.
+		*/
+		static void marcarVazia(Dados* msg) {
+			//msg->remetente = -1;
+			//msg->ligada = false;
+			msg->consumoPrevisto = -1;
+			msg->ultimoConsumo = -1;
+			msg->soquete = -1;
+			msg->prioridade = -1;
+			msg->configuracao[0] = '\0';
+			msg->podeDesligar = -1;
+		}
+
+		/*!
+			Método que retorna o endereço NIC do dispositivo.
+			\return Valor do tipo Address que representa o endereço do dispositivo.
+		*/
+		const Address obterEnderecoNIC() {
+			return reproducao ? enderecoReproducao : nic->address();
+		}
+
+		/*!
+			Método que altera o grupo de orçamento enviado nas mensagens.
+			\param g é o grupo (0 a NUMERO_GRUPOS - 1).
+		*/
+		void setGrupo(int g) {
+			grupo = (unsigned char) g;
+		}
+
+		/*!
+			Método que retorna o grupo de orçamento da placa.
+		*/
+		int getGrupo() {
+			return grupo;
+		}
+
+		/*!
+			Método que altera as épocas entre sincronizações propostas nas mensagens.
+			\param epocas é a proposta (1 a EPOCAS_ENTRE_SINC_MAXIMO).
+		*/
+		void setEpocasPropostas(int epocas) {
+			epocasPropostas = (unsigned char) epocas;
+		}
+
+		/*!
+			Método que retorna um endereço, convertendo seus valores hexadecimais para decimais.
+			\param endereco string com o endereço em hexadecimal.
+			\param retorno ponteiro que recebera a string convertida.
+		*/
+		void converterEndereco(char* endereco, char* retorno) {
+			char endA[3];
+			char endB[3];
+
+			int numA = 0;
+			int numB = 0;
+			int num = 0;
+			char c;
+			for (int i = 0; i < 5; i++) {
+				if (i == 2) {
+					i++;
+				}
+				c = endereco[i];
+				switch (c) {
+					case 'a':
+						num = 10;
+						break;
+					case 'b':
+						num = 11;
+						break;
+					case 'c':
+						num = 12;
+						break;
+					case 'd':
+						num = 13;
+						break;
+					case 'e':
+						num = 14;
+						break;
+					case 'f':
+						num = 15;
+						break;
+					default:
+						num = c - '0';
+						break;
+				}
+				if (i < 2) {
+					numA += num*pow(16, (1-i));
+				} else {
+					numB += num*pow(16, (4-i));
+				}
+			}
+
+			for (int i = 0; i < 3; i++) {
+				endA[2-i] = (numA % 10) + '0';
+				numA /= 10;
+				endB[2-i] = (numB % 10) + '0';
+				numB /= 10;
+			}
+
+			for (int i = 0; i < 6; i++) {
+				if (i < 3) {
+					retorno[i] = endA[i];
+				} else {
+					retorno[i+1] = endB[i-3];
+				}
+			}
+			retorno[3] = ':';
+		}
+};
+
+bool Mensageiro::reproducao = false;
+Address Mensageiro::enderecoReproducao;
+
+//----------------------------------------------------------------------------
+//!  Classe Led
+/*!
+	Classe que faz o controle do LED do EPOSMoteIII.
+*/
+class Led {
+	private:
+		GPIO *led; /*!< Variável que representa o LED.*/
+		Estatico<GPIO> memoriaGPIO; /*!< Espaço do GPIO do LED.*/
+
+	public:
+		/*!
+			Método construtor da classe
+		*/
+		Led() {
+			led = memoriaGPIO.construir('C', 3, GPIO::OUTPUT);
+		}
+
+		/*!
+			Método que acende o LED do EPOSMoteIII.
+		*/
+		void acenderLED() {
+			led->set(true);
+		}
+
+		/*!
+			Método que desliga o LED do EPOSMoteIII.
+		*/
+		void desligarLED() {
+			led->set(false);
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe Tomada
+/*!
+	Classe que representa uma tomada.
+*/
+class Tomada {
+	private:
+		volatile bool ligada; /*!< Estado pedido pela tarefa de decisão. Escrito só por ela.*/
+		volatile bool cortada; /*!< Indica que o limite de pico desligou a tomada. Marcado só pela interrupção de amostragem e desmarcado no rearme.*/
+		Led *led; /*!< Variável que representa o LED.*/
+		Estatico<Led> memoriaLed; /*!< Espaço do LED.*/
+
+		/*!
+			Método que aciona o LED conforme o estado pedido e o corte. Chamado pela tarefa de decisão.
+		*/
+		void acionar() {
+			if (ligada && !cortada) {
+				led->acenderLED();
+				if (cortada) { // A interrupção cortou a tomada entre o teste e o acendimento.
+					led->desligarLED();
+				}
+			} else {
+				led->desligarLED();
+			}
+		}
+
+	public:
+		/*!
+			Método construtor da classe
+		*/
+		Tomada() {
+			led = memoriaLed.construir();
+			cortada = false;
+			ligar();
+		}
+
+		/*!
+			Método que verifica se a tomada está ligada ou não.
+			\return Valor booleano que indica se a tomada está ligada (pedida ligada e não cortada pelo limite de pico).
+		*/
+		bool estaLigada() {
+			return ligada && !cortada;
+		}
+
+		/*!
+			Método que liga a tomada. Uma tomada cortada pelo limite de pico só liga no rearme.
+		*/
+		void ligar() {
+			ligada = true;
+			acionar();
+		}
+
+		/*!
+			Método que desliga a tomada.
+		*/
+		void desligar() {
+			ligada = false;
+			acionar();
+		}
+
+		/*!
+			Método que desliga a tomada pelo limite de pico, até o rearme. Chamado só pela interrupção de amostragem.
+		*/
+		void cortar() {
+			cortada = true;
+			led->desligarLED();
+		}
+
+		/*!
+			Método que rearma o corte: a tomada volta ao estado pedido pela tarefa de decisão.
+		*/
+		void liberarCorte() {
+			cortada = false;
+			acionar();
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe Dimmer
+/*!
+	Classe que aciona a saída de um dimmer por PWM, gerado na interrupção de um alarme comum a todos os dimmers da placa.
+	O nível pedido é limitado a [DIMERIZACAO_MINIMA, 1] e a saída anda até ele em rampa, no máximo NIVEIS_RAMPA_DIMMER níveis por período,
+	de forma que a carga não sofre degraus quando a decisão muda. O limite de pico impõe um teto que vale na hora, sem rampa. Sem a placa, o GPIO é o simulado pelo EPOS.
+*/
+class Dimmer {
+	private:
+		static Dimmer* canais[NUMERO_SOQUETES]; /*!< Dimmers acionados pela interrupção, que não recebe parâmetros.*/
+		static int quantidadeCanais; /*!< Quantidade de entradas em canais.*/
+		static Function_Handler* tratador; /*!< Tratador do alarme.*/
+		static Alarm* alarme; /*!< Alarme do PWM, criado com o primeiro dimmer.*/
+		static Estatico<Function_Handler> memoriaTratador; /*!< Espaço do tratador.*/
+		static Estatico<Alarm> memoriaAlarme; /*!< Espaço do alarme.*/
+
+		GPIO* saida; /*!< Saída que aciona a carga.*/
+		Estatico<GPIO> memoriaSaida; /*!< Espaço da saída.*/
+		volatile int alvo; /*!< Nível pedido, de 0 a PASSOS_PWM_DIMMER.*/
+		volatile int atual; /*!< Nível aplicado na saída, que anda em rampa até o alvo.*/
+		volatile int teto; /*!< Nível máximo imposto pelo limite de pico, que vale sobre o alvo e sem rampa.*/
+		int passo; /*!< Posição no período da saída.*/
+
+		/*!
+			Método executado na interrupção do alarme: avança a saída de todos os dimmers.
+		*/
+		static void tratarInterrupcao() {
+			for (int i = 0; i < quantidadeCanais; i++) {
+				canais[i]->avancar();
+			}
+		}
+
+		/*!
+			Método que avança a saída um passo. No início de cada período, o nível aplicado anda em direção ao alvo.
+		*/
+		void avancar() {
+			if (passo == 0) {
+				int diferenca = ((alvo < teto) ? alvo : teto) - atual;
+				if (diferenca > NIVEIS_RAMPA_DIMMER) {
+					diferenca = NIVEIS_RAMPA_DIMMER;
+				} else if (diferenca < -NIVEIS_RAMPA_DIMMER) {
+					diferenca = -NIVEIS_RAMPA_DIMMER;
+				}
+				atual = atual + diferenca;
+			}
+			saida->set(passo < atual);
+			passo = (passo + 1) % PASSOS_PWM_DIMMER;
+		}
+
+	public:
+		/*!
+			Método construtor da classe. O dimmer usa o próximo pino livre e começa em 100%.
+		*/
+		Dimmer() {
+			alvo = PASSOS_PWM_DIMMER;
+			atual = PASSOS_PWM_DIMMER;
+			teto = PASSOS_PWM_DIMMER;
+			passo = 0;
+			saida = memoriaSaida.construir(PORTA_DIMMER, PINO_DIMMER + quantidadeCanais, GPIO::OUTPUT);
+			if (quantidadeCanais < NUMERO_SOQUETES) {
+				canais[quantidadeCanais++] = this;
+			}
+			if (alarme == 0) {
+				tratador = memoriaTratador.construir(&Dimmer::tratarInterrupcao);
+				alarme = memoriaAlarme.construir(PERIODO_TICK_DIMMER, tratador, (int) Alarm::INFINITE);
+			}
+		}
+
+		/*!
+			Método que pede um novo nível ao dimmer. Pedidos que não mudam o nível (menos de um passo) são ignorados.
+			\param porcentagem é a dimmerização pedida (1 = 100%).
+			\return Dimmerização efetivamente pedida, depois de limitada.
+		*/
+		float definir(float porcentagem) {
+			if (porcentagem > 1) {
+				porcentagem = 1;
+			} else if (!(porcentagem >= DIMERIZACAO_MINIMA)) { // Também trata NaN.
+				porcentagem = DIMERIZACAO_MINIMA;
+			}
+			alvo = (int) (porcentagem * PASSOS_PWM_DIMMER + 0.5f);
+			return porcentagem;
+		}
+
+		/*!
+			Método que retorna o nível aplicado na saída, que pode ainda estar em rampa.
+			\return Dimmerização aplicada (1 = 100%).
+		*/
+		float getNivelAtual() {
+			return (float) atual / PASSOS_PWM_DIMMER;
+		}
+
+		/*!
+			Método que retorna o nível aplicado na saída em passos, sem conta de ponto flutuante. Usado na interrupção de amostragem.
+			\return Nível aplicado, de 0 a PASSOS_PWM_DIMMER.
+		*/
+		int getPassosAtuais() {
+			return atual;
+		}
+
+		/*!
+			Método que impõe um teto ao nível, aplicado na hora e sem rampa. Chamado na interrupção de amostragem.
+			\param passos é o nível máximo, de 0 a PASSOS_PWM_DIMMER.
+		*/
+		void limitar(int passos) {
+			teto = passos;
+			if (atual > passos) {
+				atual = passos;
+			}
+		}
+
+		/*!
+			Método que retira o teto. A saída volta ao nível pedido em rampa.
+		*/
+		void liberar() {
+			teto = PASSOS_PWM_DIMMER;
+		}
+};
+
+Dimmer* Dimmer::canais[NUMERO_SOQUETES];
+int Dimmer::quantidadeCanais = 0;
+Function_Handler* Dimmer::tratador = 0;
+Alarm* Dimmer::alarme = 0;
+Estatico<Function_Handler> Dimmer::memoriaTratador;
+Estatico<Alarm> Dimmer::memoriaAlarme;
+
+//----------------------------------------------------------------------------
+//!  Classe TomadaComDimmer
+/*!
+	Classe que representa uma tomada com dimmer.
+*/
+class TomadaComDimmer: virtual public Tomada {
+	protected:
+		float dimPorcentagem; /*!< Váriavel float que indica a porcentagem de dimmerização pedida para a tomada.*/
+		Dimmer* dimmer; /*!< Acionador do dimmer.*/
+		Estatico<Dimmer> memoriaDimmer; /*!< Espaço do acionador.*/
+
+	public:
+		/*!
+			Método construtor da classe
+		*/
+		TomadaComDimmer() {
+			dimmer = memoriaDimmer.construir();
+			dimPorcentagem = 1; // 100%
+		}
+
+		/*!
+			Método que retorna a porcentagem de dimmerização da tomada.
+			\return Valor float que indica a porcentagem de dimmerização pedida para a tomada.
+		*/
+		float getPorcentagem() {
+			return dimPorcentagem;
+		}
+
+		/*!
+			Método que retorna a porcentagem de dimmerização aplicada na carga, que segue a pedida em rampa.
+			\return Valor float que indica a porcentagem de dimmerização aplicada.
+		*/
+		float getPorcentagemAtual() {
+			return dimmer->getNivelAtual();
+		}
+
+		/*!
+			Método que retorna o acionador do dimmer, usado pelo limite de pico na interrupção de amostragem.
+			\return Acionador do dimmer da tomada.
+		*/
+		Dimmer* getDimmer() {
+			return dimmer;
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe TomadaInteligente
+/*!
+	Classe que representa uma tomada controlada pelo EPOSMoteIII.
+*/
+class TomadaInteligente: virtual public Tomada {
+	protected:
+		int tipo; /*!< Variável que indica o tipo da tomada. Tipo 1 indica uma TomadaInteligente*/
+		float consumo; /*!< Variável que indica o consumo da tomada.*/
+	private:
+		Prioridades prioridades; /*!< Variável que contém as prioridade da tomada ao longo do dia.*/
+		bool podeDesligar[4];
+
+	public:
+		/*!
+			Método construtor da classe
+		*/
+		TomadaInteligente() {
+			consumo = 0;
+			tipo = 1; // Indica uma TomadaInteligente
+			setPrioridades(1); // Prioridade padrão é 1
+			setPodeDesligar(true, 0);
+			setPodeDesligar(true, 1);
+			setPodeDesligar(true, 2);
+			setPodeDesligar(true, 3);
+		}
+
+		/*!
+			Método que devolve o tipo de tomada.
+			\return o tipo dessa tomada.
+		*/
+		int getTipo(){
+			return tipo;
+		}
+
+		/*!
+			Método que altera todas as prioridades da tomada para o valor passado por parâmetro.
+			\param p é o novo valor das prioridades da tomada.
+		*/
+		void setPrioridades(int p) {
+			prioridades.madrugada = p;
+			prioridades.manha = p;
+			prioridades.tarde = p;
+			prioridades.noite = p;
+		}
+
+		/*!
+			Método que altera a prioridade no período das 00:00 às 06:00.
+ 			\param p é o novo valor da prioridade nesse horário.
+		*/
+		void setPrioridadeMadrugada(int p) {
+			prioridades.madrugada = p;
+		}
+
+		/*!
+			Método que altera a prioridade no período das 06:00 às 12:00.
+ 			\param p é o novo valor da prioridade nesse horário.
+		*/
+		void setPrioridadeManha(int p) {
+			prioridades.manha = p;
+		}
+
+		/*!
+			Método que altera a prioridade no período das 12:00 às 18:00.
+ 			\param p é o novo valor da prioridade nesse horário.
+		*/
+		void setPrioridadeTarde(int p) {
+			prioridades.tarde = p;
+		}
+
+		/*!
+			Método que altera a prioridade no período das 18:00 às 00:00.
+ 			\param p é o novo valor da prioridade nesse horário.
+		*/
+		void setPrioridadeNoite(int p) {
+			prioridades.noite = p;
+		}
+
+		/*!
+			Método que altera se a tomada pode ou não ser desligada no periodo especificado.
+ 			\param valor é o valor booleano que especifica se a tomada pode ou não desligar.
+ 			\param periodo é o periodo em que sera feita a alteração. (0 -Madrugada, 1 -Manhã, 2 -Tarde, 3 -Noite)
+		*/
+		void setPodeDesligar(bool valor, int periodo) {
+			podeDesligar[periodo] = valor;
+		}
+
+		/*!
+			Método que retorna as prioridades da tomada.
+			\return Struct que contém as quatro possiveis prioridades da tomada.
+		*/
+		Prioridades getPrioridades() {
+			return prioridades;
 		}
 
 		/*!
@@ -682,476 +2758,3947 @@ class TomadaInteligente: virtual public Tomada {
  			\param periodo é o periodo em que se deseja consultar. (0 -Madrugada, 1 -Manhã, 2 -Tarde, 3 -Noite)
 			\return Valor booleano que representa se a tomada pode desligar.
 		*/
-		bool getPodeDesligar(int periodo) {
-			return podeDesligar[periodo];
+		bool getPodeDesligar(int periodo) {
+			return podeDesligar[periodo];
+		}
+
+		/*!
+			Método que retorna o consumo atual da tomada.
+			\return Valor float que indica o consumo atual da tomada. Caso esteja desligada, o valor retornado é 0.
+		*/
+		virtual float getConsumo() {
+
+			// Método criado para possibilitar a simulação da análise de consumo de uma tomada.
+			// Em um sistema real este método retornaria o consumo da tomada.
+
+			if (estaLigada()) {
+				unsigned int rand;
+				if (consumo == 0) {
+					rand = Random::random();
+					consumo = (25 + (rand % (425-25+1))) / 1000.0;
+				}
+				// Aplica uma variação ao último consumo registrado, para simular um sistema real onde os valores são de certa forma consistentes.
+				rand = Random::random();
+				float variacao = (90 + (rand % 21)) / 100.0f; // Valor de 0.9 até 1.1 ou 90% até 110%
+
+				consumo = (consumo+variacao) * variacao;
+			} else {
+				consumo = 0;
+			}
+			return consumo;
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe TomadaMulti
+/*!
+	Classe que representa uma tomada com dimmer controlada pelo EPOSMoteIII.
+*/
+class TomadaMulti: public TomadaComDimmer, public TomadaInteligente {
+	public:
+		/*!
+			Método construtor da classe
+		*/
+		TomadaMulti() {
+			tipo = 2; // Indica uma TomadaInteligente com dimmer
+		}
+
+		/*!
+			Método que define o valor da porcentagem de dimmerização da tomada, limitado a [DIMERIZACAO_MINIMA, 1].
+		*/
+		void setDimerizacao(float porcentagem) {
+			dimPorcentagem = dimmer->definir(porcentagem);
+		}
+
+		/*!
+			Método que calcula a porcentagem de dimmerização da tomada. Essa porcentagem é armazenada na variável dimPorcentagem.
+ 			\param consumo é o consumo previsto da tomada até o fim do mês, sem dimmerização.
+ 			\param sobra é o máximo de consumo que a tomada pode ter para o limite máximo de consumo ser mantido.
+		*/
+		void dimerizar(float consumo, float sobra) {
+			setDimerizacao((consumo > 0) ? (sobra/consumo) : 1);
+		}
+
+		/*!
+			Método que retorna o consumo atual da tomada.
+			\return Valor float que indica o consumo atual da tomada. Caso esteja desligada, o valor retornado é 0.
+		*/
+		float getConsumo() {
+
+			// Método criado para possibilitar a simulação da análise de consumo de uma tomada.
+ 			// Em um  sistema real este metodo não existiria, ja que o consumo recebido ja seria o consumo alterado pela dimerização.
+			// Como estamos simulando o consumo, este metodo existe para simular a dimerizado do consumo da tomada.
+
+			TomadaInteligente::getConsumo();
+			return consumo * dimPorcentagem;
+
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe GeradorDeSinal
+/*!
+	Classe que simula o conversor analógico-digital da placa, gerando amostras da tensão (comum a todos os soquetes) e da corrente de cada soquete
+	(Q15, em fase, carga resistiva). A carga segue o estado de cada soquete (ligado e dimmerização), varia um pouco a cada bloco e tem picos curtos
+	ocasionais, que uma leitura a cada SEGS_ENTRE_CONSUMO segundos não veria. Em um sistema real esta classe seria substituída pela leitura do conversor.
+*/
+class GeradorDeSinal {
+	private:
+		TomadaInteligente** tomadas; /*!< Soquetes cujas cargas são simuladas.*/
+		int quantidade; /*!< Quantidade de soquetes.*/
+		short seno[1 << BITS_TABELA_SENO]; /*!< Um ciclo de seno em Q15.*/
+		unsigned int fase; /*!< Fase atual (um ciclo completo corresponde a 2^32).*/
+		unsigned int incrementoFase; /*!< Incremento da fase a cada amostra.*/
+		int amplitudeTensao; /*!< Amplitude da tensão em unidades do conversor.*/
+		volatile int amplitudeCorrente[NUMERO_SOQUETES]; /*!< Amplitude da corrente de cada soquete em unidades do conversor. Alterada fora da interrupção.*/
+		float potenciaNominal[NUMERO_SOQUETES]; /*!< Consumo médio simulado de cada carga em SEGS_ENTRE_CONSUMO segundos.*/
+
+	public:
+		/*!
+			Método construtor da classe.
+			\param t são os soquetes cujas cargas são simuladas.
+			\param q é a quantidade de soquetes.
+		*/
+		GeradorDeSinal(TomadaInteligente** t, int q) {
+			tomadas = t;
+			quantidade = q;
+
+			// Rotação de um vetor unitário, para não depender de sin() na placa.
+			const float cosPasso = 0.99518472667f; // cos(2*pi/64)
+			const float senPasso = 0.09801714033f; // sin(2*pi/64)
+			float x = 1;
+			float y = 0;
+			for (int n = 0; n < (1 << BITS_TABELA_SENO); n++) {
+				seno[n] = (short) (y * 32767);
+				float proximoX = x * cosPasso - y * senPasso;
+				y = x * senPasso + y * cosPasso;
+				x = proximoX;
+			}
+
+			fase = 0;
+			incrementoFase = (unsigned int) ((FREQUENCIA_REDE * 4294967296.0) / TAXA_AMOSTRAGEM);
+			amplitudeTensao = (int) ((TENSAO_REDE * 1.41421356f * 32767) / TENSAO_FUNDO_ESCALA);
+			for (int k = 0; k < quantidade; k++) {
+				amplitudeCorrente[k] = 0;
+				potenciaNominal[k] = (25 + (Random::random() % (425-25+1))) / 1000.0f;
+			}
+		}
+
+		/*!
+			Método que avança a fase para a próxima amostra. Chamado na interrupção de amostragem.
+			\return Seno da nova fase (Q15), comum à tensão e às correntes da amostra.
+		*/
+		int avancar() {
+			fase += incrementoFase;
+			return seno[fase >> (32 - BITS_TABELA_SENO)];
+		}
+
+		/*!
+			Método que retorna a amostra de tensão.
+			\param s é o seno retornado por avancar().
+		*/
+		short tensao(int s) {
+			return (short) ((s * amplitudeTensao) >> 15);
+		}
+
+		/*!
+			Método que retorna a amostra de corrente de um soquete.
+			\param s é o seno retornado por avancar().
+			\param soquete é o soquete amostrado.
+		*/
+		short corrente(int s, int soquete) {
+			return (short) ((s * amplitudeCorrente[soquete]) >> 15);
+		}
+
+		/*!
+			Método que sorteia a carga de cada soquete no próximo bloco. Chamado pela tarefa de amostragem, fora da interrupção.
+		*/
+		void atualizarCarga() {
+			for (int k = 0; k < quantidade; k++) {
+				TomadaInteligente* tomada = tomadas[k];
+				float potencia = 0;
+				if (tomada->estaLigada()) {
+					potencia = potenciaNominal[k] * (90 + (Random::random() % 21)) / 100.0f; // Variação de 90% até 110%
+					if (tomada->getTipo() == 2) {
+						potencia *= static_cast<TomadaMulti*>(tomada)->getPorcentagemAtual();
+					}
+					if ((Random::random() % CHANCE_PICO) == 0) {
+						potencia *= FATOR_PICO;
+					}
+				}
+				// Potência média = ENERGIA_FUNDO_ESCALA * média(v * i) / 2^29.
+				float amplitude = (potencia * 1073741824.0f) / (ENERGIA_FUNDO_ESCALA * amplitudeTensao);
+				amplitudeCorrente[k] = (amplitude > 32767) ? 32767 : (int) amplitude;
+			}
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe MedidorDeEnergia
+/*!
+	Classe que amostra a tensão e a corrente de cada soquete a TAXA_AMOSTRAGEM por segundo e integra a energia consumida.
+	A interrupção do alarme apenas guarda as amostras em um buffer duplo (como um DMA): enquanto um bloco é preenchido, o outro é integrado
+	pela tarefa de amostragem, com acumuladores inteiros de potência instantânea e dos quadrados de tensão e corrente (RMS).
+	As correntes de cada soquete ficam contíguas no bloco, de forma que cada soquete é integrado em um laço sobre um único vetor.
+	A cada SEGS_ENTRE_CONSUMO segundos, o consumo de cada soquete no período é entregue ao gerente.
+	A interrupção também mantém a potência média de cada soquete nas últimas AMOSTRAS_JANELA_POTENCIA amostras e a compara ao limite de pico do soquete
+	e, somada, à parte da placa no limite de pico do grupo. O soquete que passa do limite é cortado ali mesmo (dimerizado até caber, se tem dimmer,
+	ou desligado), sem esperar a tarefa de decisão, e fica cortado até o rearme, no início da época seguinte. O corte é entregue depois ao gerente para ser registrado e avisado.
+*/
+class MedidorDeEnergia {
+	private:
+		static MedidorDeEnergia* instancia; /*!< Medidor usado pela interrupção, que não recebe parâmetros.*/
+		TomadaInteligente** tomadas; /*!< Soquetes medidos, cortados pela interrupção quando passam do limite de pico.*/
+		GeradorDeSinal* gerador; /*!< Fonte das amostras.*/
+		Estatico<GeradorDeSinal> memoriaGerador; /*!< Espaço do gerador.*/
+		short tensoes[2][AMOSTRAS_POR_BLOCO]; /*!< Buffer duplo de amostras de tensão.*/
+		short correntes[2][NUMERO_SOQUETES][AMOSTRAS_POR_BLOCO]; /*!< Buffer duplo de amostras de corrente, um vetor por soquete.*/
+		int quantidade; /*!< Quantidade de soquetes medidos.*/
+		volatile int blocoAtivo; /*!< Bloco sendo preenchido pela interrupção.*/
+		volatile int posicao; /*!< Próxima posição do bloco ativo.*/
+		volatile int pendente; /*!< Bloco completo aguardando a integração, ou -1.*/
+		volatile unsigned int blocosPerdidos; /*!< Blocos descartados porque o anterior ainda não tinha sido integrado.*/
+		Semaphore* blocosCompletos; /*!< Sinalizado pela interrupção a cada bloco completo.*/
+		Estatico<Semaphore> memoriaSemaforo; /*!< Espaço do semáforo.*/
+		Function_Handler* tratador; /*!< Tratador do alarme.*/
+		Estatico<Function_Handler> memoriaTratador; /*!< Espaço do tratador.*/
+		Alarm* alarme; /*!< Alarme de amostragem.*/
+		Estatico<Alarm> memoriaAlarme; /*!< Espaço do alarme.*/
+
+		long long somaPotencia[NUMERO_SOQUETES]; /*!< Soma de tensão * corrente de cada soquete no período (Q30).*/
+		unsigned long long somaTensao2; /*!< Soma dos quadrados da tensão no período (Q30).*/
+		unsigned long long somaCorrente2[NUMERO_SOQUETES]; /*!< Soma dos quadrados da corrente de cada soquete no período (Q30).*/
+		int picoCorrente[NUMERO_SOQUETES]; /*!< Maior valor absoluto de corrente de cada soquete no período.*/
+		int blocosIntegrados; /*!< Blocos integrados no período.*/
+		unsigned int perdidosAntes; /*!< Valor de blocosPerdidos no início do período.*/
+		int tensaoRms; /*!< Tensão RMS do último período, em unidades do conversor.*/
+		int correnteRms[NUMERO_SOQUETES]; /*!< Corrente RMS de cada soquete no último período, em unidades do conversor.*/
+		int ultimoPicoCorrente[NUMERO_SOQUETES]; /*!< Pico de corrente de cada soquete no último período, em unidades do conversor.*/
+
+		short potencias[NUMERO_SOQUETES][AMOSTRAS_JANELA_POTENCIA]; /*!< Potência instantânea (Q15) de cada soquete nas últimas amostras, em anel.*/
+		int somaJanela[NUMERO_SOQUETES]; /*!< Soma de potencias de cada soquete.*/
+		int posicaoJanela; /*!< Posição da próxima amostra em potencias.*/
+		unsigned int amostraAtual; /*!< Quantidade de amostras feitas, para medir as latências de disparo.*/
+		volatile int limiteSoquete[NUMERO_SOQUETES]; /*!< Limite de pico de cada soquete (potência média Q15), ou 0 sem limite.*/
+		volatile int limitePlaca; /*!< Parte da placa no limite de pico do grupo (potência média Q15, soma dos soquetes), ou 0 sem limite.*/
+		unsigned int inicioExcesso[NUMERO_SOQUETES]; /*!< Amostra em que a potência instantânea do soquete passou do dobro do limite, válida se emExcesso.*/
+		bool emExcesso[NUMERO_SOQUETES]; /*!< Indica se o soquete deu sinal de excesso na última janela.*/
+		unsigned int inicioExcessoPlaca; /*!< Amostra em que a potência instantânea da placa passou do dobro da sua parte no limite do grupo, válida se placaEmExcesso.*/
+		bool placaEmExcesso; /*!< Indica se a placa deu sinal de excesso na última janela.*/
+		volatile bool disparado[NUMERO_SOQUETES]; /*!< Soquetes cortados pelo limite de pico desde o último rearme.*/
+		bool desligadoPeloLimite[NUMERO_SOQUETES]; /*!< Soquetes desligados (e não dimerizados) pelo limite de pico desde o último rearme.*/
+		unsigned int amostraCorte[NUMERO_SOQUETES]; /*!< Amostra do último corte de cada soquete. O soquete dimerizado volta a ser verificado quando a janela só tem amostras depois do corte.*/
+		volatile bool disparoPendente[NUMERO_SOQUETES]; /*!< Indica que disparos[k] ainda não foi entregue ao gerente.*/
+		DisparoDePotencia disparos[NUMERO_SOQUETES]; /*!< Último corte de cada soquete.*/
+		unsigned short histogramaDisparo[FAIXAS_HISTOGRAMA_DISPARO]; /*!< Quantidade de disparos por faixa de latência (LARGURA_FAIXA_DISPARO), desde o início.*/
+
+		/*!
+			Método executado na interrupção do alarme: guarda uma amostra e troca de bloco quando o atual fica completo.
+		*/
+		static void tratarInterrupcao() {
+			MedidorDeEnergia* m = instancia;
+			int bloco = m->blocoAtivo;
+			int posicao = m->posicao;
+			int s = m->gerador->avancar();
+			m->tensoes[bloco][posicao] = m->gerador->tensao(s);
+			for (int k = 0; k < m->quantidade; k++) {
+				m->correntes[bloco][k][posicao] = m->gerador->corrente(s, k);
+			}
+			m->verificarPotencia(bloco, posicao);
+			m->posicao = posicao + 1;
+			if (m->posicao == AMOSTRAS_POR_BLOCO) {
+				m->posicao = 0;
+				if (m->pendente != -1) { // A tarefa ainda não integrou o outro bloco: este é descartado e preenchido de novo.
+					m->blocosPerdidos = m->blocosPerdidos + 1;
+				} else {
+					m->pendente = bloco;
+					m->blocoAtivo = 1 - bloco;
+					m->blocosCompletos->v();
+				}
+			}
+		}
+
+		/*!
+			Método executado na interrupção a cada amostra: atualiza a média móvel de potência de cada soquete e corta o soquete que passou do seu limite de pico
+			ou, se a soma da placa passou da sua parte no limite do grupo, o soquete de maior potência. Só usa contas inteiras.
+			O primeiro sinal do excesso é a potência instantânea passar do dobro do limite, o que uma carga resistiva dentro do limite nunca faz (o pico de v * i é o dobro da média).
+			Um soquete dimerizado pelo corte volta a ser verificado depois de uma janela, e é cortado de novo se ainda passa do limite.
+			\param bloco é o bloco da amostra.
+			\param posicao é a posição da amostra no bloco.
+		*/
+		void verificarPotencia(int bloco, int posicao) {
+			int v = tensoes[bloco][posicao];
+			int j = posicaoJanela;
+			int somaPlaca = 0;
+			int instantaneaPlaca = 0;
+			int maior = -1;
+			for (int k = 0; k < quantidade; k++) {
+				int p = (v * correntes[bloco][k][posicao]) >> 15;
+				somaJanela[k] += p - potencias[k][j];
+				potencias[k][j] = (short) p;
+				if (disparado[k] && desligadoPeloLimite[k]) { // Continua cortado (Tomada::ligar() não o liga) até o rearme.
+					continue;
+				}
+				if (disparado[k] && (amostraAtual - amostraCorte[k] < AMOSTRAS_JANELA_POTENCIA)) { // A janela ainda tem amostras de antes do corte.
+					continue;
+				}
+				somaPlaca += somaJanela[k];
+				instantaneaPlaca += p;
+				if ((maior == -1) || (somaJanela[k] > somaJanela[maior])) {
+					maior = k;
+				}
+				int limite = limiteSoquete[k];
+				if (limite == 0) {
+					continue;
+				}
+				if (p > 2 * limite) {
+					if (!emExcesso[k]) {
+						emExcesso[k] = true;
+						inicioExcesso[k] = amostraAtual;
+					}
+				} else if (emExcesso[k] && (amostraAtual - inicioExcesso[k] >= AMOSTRAS_JANELA_POTENCIA)) {
+					emExcesso[k] = false;
+				}
+				if (somaJanela[k] > limite * AMOSTRAS_JANELA_POTENCIA) {
+					somaPlaca -= somaJanela[k];
+					instantaneaPlaca -= p;
+					cortar(k, limite * AMOSTRAS_JANELA_POTENCIA, emExcesso[k] ? inicioExcesso[k] : amostraAtual - AMOSTRAS_JANELA_POTENCIA, false);
+					if (maior == k) {
+						maior = -1;
+					}
+				}
+			}
+			int limite = limitePlaca;
+			if (limite != 0) {
+				if (instantaneaPlaca > 2 * limite) {
+					if (!placaEmExcesso) {
+						placaEmExcesso = true;
+						inicioExcessoPlaca = amostraAtual;
+					}
+				} else if (placaEmExcesso && (amostraAtual - inicioExcessoPlaca >= AMOSTRAS_JANELA_POTENCIA)) {
+					placaEmExcesso = false;
+				}
+				if ((maior != -1) && (somaPlaca > limite * AMOSTRAS_JANELA_POTENCIA)) {
+					cortar(maior, somaJanela[maior] - (somaPlaca - limite * AMOSTRAS_JANELA_POTENCIA),
+						placaEmExcesso ? inicioExcessoPlaca : amostraAtual - AMOSTRAS_JANELA_POTENCIA, true);
+				}
+			}
+			posicaoJanela = (j + 1) % AMOSTRAS_JANELA_POTENCIA;
+			amostraAtual++;
+		}
+
+		/*!
+			Método executado na interrupção que corta um soquete: se ele tem dimmer e um nível acima de DIMERIZACAO_MINIMA cabe no permitido, o dimmer é limitado a esse nível;
+			senão, o soquete é desligado. O primeiro corte desde o rearme entra no histograma e fica guardado para o gerente; os seguintes só ajustam o nível.
+			\param k é o soquete.
+			\param permitido é a soma da janela que o soquete pode ter.
+			\param inicio é a amostra do primeiro sinal do excesso.
+			\param peloGrupo indica se o corte é pela parte da placa no limite do grupo.
+		*/
+		void cortar(int k, int permitido, unsigned int inicio, bool peloGrupo) {
+			TomadaInteligente* tomada = tomadas[k];
+			int soma = somaJanela[k];
+			int nivel = 0;
+			if ((tomada->getTipo() == 2) && (permitido > 0)) {
+				Dimmer* dimmer = static_cast<TomadaMulti*>(tomada)->getDimmer();
+				nivel = (int) (((long long) dimmer->getPassosAtuais() * permitido) / soma);
+				if (nivel >= (int) (DIMERIZACAO_MINIMA * PASSOS_PWM_DIMMER + 0.5f)) {
+					dimmer->limitar(nivel);
+				} else {
+					nivel = 0;
+				}
+			}
+			if (nivel == 0) {
+				tomada->cortar();
+			}
+			desligadoPeloLimite[k] = (nivel == 0);
+			amostraCorte[k] = amostraAtual;
+			if (disparado[k]) {
+				return;
+			}
+			disparado[k] = true;
+
+			int latencia = (int) (((amostraAtual - inicio) * 1000000ULL) / TAXA_AMOSTRAGEM);
+			int faixa = latencia / LARGURA_FAIXA_DISPARO;
+			histogramaDisparo[(faixa < FAIXAS_HISTOGRAMA_DISPARO) ? faixa : (FAIXAS_HISTOGRAMA_DISPARO - 1)]++;
+			disparos[k].soquete = k;
+			disparos[k].potencia = (soma * 100) / (POTENCIA_FUNDO_ESCALA * AMOSTRAS_JANELA_POTENCIA);
+			disparos[k].latencia = latencia;
+			disparos[k].peloGrupo = peloGrupo;
+			disparos[k].passos = nivel;
+			disparoPendente[k] = true;
+		}
+
+		/*!
+			Método que calcula a raiz quadrada inteira.
+		*/
+		static int raizInteira(unsigned long long valor) {
+			unsigned long long raiz = 0;
+			unsigned long long bit = 1ULL << 62;
+			while (bit > valor) {
+				bit >>= 2;
+			}
+			while (bit != 0) {
+				if (valor >= raiz + bit) {
+					valor -= raiz + bit;
+					raiz = (raiz >> 1) + bit;
+				} else {
+					raiz >>= 1;
+				}
+				bit >>= 2;
+			}
+			return (int) raiz;
+		}
+
+		/*!
+			Método que zera os acumuladores do período.
+		*/
+		void iniciarPeriodo() {
+			somaTensao2 = 0;
+			for (int k = 0; k < quantidade; k++) {
+				somaPotencia[k] = 0;
+				somaCorrente2[k] = 0;
+				picoCorrente[k] = 0;
+			}
+			blocosIntegrados = 0;
+			perdidosAntes = blocosPerdidos;
+		}
+
+	public:
+		/*!
+			Método construtor da classe. Inicia a amostragem.
+			\param t são os soquetes medidos.
+			\param q é a quantidade de soquetes.
+		*/
+		MedidorDeEnergia(TomadaInteligente** t, int q) {
+			instancia = this;
+			tomadas = t;
+			quantidade = q;
+			gerador = memoriaGerador.construir(t, q);
+			gerador->atualizarCarga();
+			blocoAtivo = 0;
+			posicao = 0;
+			pendente = -1;
+			blocosPerdidos = 0;
+			tensaoRms = 0;
+			for (int k = 0; k < quantidade; k++) {
+				correnteRms[k] = 0;
+				ultimoPicoCorrente[k] = 0;
+				for (int j = 0; j < AMOSTRAS_JANELA_POTENCIA; j++) {
+					potencias[k][j] = 0;
+				}
+				somaJanela[k] = 0;
+				limiteSoquete[k] = 0;
+				emExcesso[k] = false;
+				disparado[k] = false;
+				desligadoPeloLimite[k] = false;
+				disparoPendente[k] = false;
+			}
+			posicaoJanela = 0;
+			amostraAtual = 0;
+			limitePlaca = 0;
+			placaEmExcesso = false;
+			for (int f = 0; f < FAIXAS_HISTOGRAMA_DISPARO; f++) {
+				histogramaDisparo[f] = 0;
+			}
+			iniciarPeriodo();
+			blocosCompletos = memoriaSemaforo.construir(0);
+			tratador = memoriaTratador.construir(&MedidorDeEnergia::tratarInterrupcao);
+			alarme = memoriaAlarme.construir(1000000 / TAXA_AMOSTRAGEM, tratador, (int) Alarm::INFINITE);
+		}
+
+		/*!
+			Método que espera o próximo bloco completo e o integra. Chamado pela tarefa de amostragem.
+			\param consumos recebe o consumo de cada soquete no período, quando ele termina.
+			\return Valor booleano que indica se um período de SEGS_ENTRE_CONSUMO segundos terminou.
+		*/
+		bool integrarBloco(float* consumos) {
+			blocosCompletos->p();
+			int bloco = pendente;
+			gerador->atualizarCarga();
+
+			const short* v = tensoes[bloco];
+			for (int k = 0; k < AMOSTRAS_POR_BLOCO; k++) {
+				somaTensao2 += v[k] * v[k];
+			}
+			for (int j = 0; j < quantidade; j++) {
+				const short* i = correntes[bloco][j];
+				long long potencia = 0;
+				unsigned long long corrente2 = 0;
+				int pico = picoCorrente[j];
+				for (int k = 0; k < AMOSTRAS_POR_BLOCO; k++) {
+					potencia += v[k] * i[k];
+					corrente2 += i[k] * i[k];
+					int absoluta = (i[k] < 0) ? -i[k] : i[k];
+					if (absoluta > pico) {
+						pico = absoluta;
+					}
+				}
+				somaPotencia[j] += potencia;
+				somaCorrente2[j] += corrente2;
+				picoCorrente[j] = pico;
+			}
+			pendente = -1;
+			blocosIntegrados++;
+
+			int blocosPorPeriodo = (SEGS_ENTRE_CONSUMO * TAXA_AMOSTRAGEM) / AMOSTRAS_POR_BLOCO;
+			if (blocosIntegrados + (int) (blocosPerdidos - perdidosAntes) < blocosPorPeriodo) {
+				return false;
+			}
+
+			// A potência média dos blocos integrados vale para todo o período, inclusive os blocos perdidos.
+			long long amostras = (long long) blocosIntegrados * AMOSTRAS_POR_BLOCO;
+			for (int j = 0; j < quantidade; j++) {
+				consumos[j] = (ENERGIA_FUNDO_ESCALA * (float) somaPotencia[j]) / (536870912.0f * (float) amostras);
+				if (consumos[j] < 0) {
+					consumos[j] = 0;
+				}
+				correnteRms[j] = raizInteira(somaCorrente2[j] / amostras);
+				ultimoPicoCorrente[j] = picoCorrente[j];
+			}
+			tensaoRms = raizInteira(somaTensao2 / amostras);
+			iniciarPeriodo();
+			return true;
+		}
+
+		/*!
+			Método que registra os valores RMS do último período e a quantidade de blocos perdidos.
+		*/
+		void registrarMedidas() {
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_MEDIDOR, (int) ((tensaoRms * TENSAO_FUNDO_ESCALA) / 32767), (int) blocosPerdidos);
+			for (int j = 0; j < quantidade; j++) {
+				RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_MEDIDOR_SOQUETE, j, (int) ((correnteRms[j] * 100) / 32767), (int) ((ultimoPicoCorrente[j] * 100) / 32767));
+			}
+			int disparosTotais = 0;
+			for (int f = 0; f < FAIXAS_HISTOGRAMA_DISPARO; f++) {
+				disparosTotais += histogramaDisparo[f];
+			}
+			if (disparosTotais > 0) {
+				RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_HISTOGRAMA_DISPARO, histogramaDisparo[0], histogramaDisparo[1], histogramaDisparo[2],
+					histogramaDisparo[3], histogramaDisparo[4]);
+			}
+		}
+
+		/*!
+			Método que altera o limite de pico de um soquete.
+			\param soquete é o soquete.
+			\param porcentagem é o limite em % do fundo de escala, ou 0 para nenhum limite.
+		*/
+		void setLimiteSoquete(int soquete, int porcentagem) {
+			limiteSoquete[soquete] = (porcentagem * POTENCIA_FUNDO_ESCALA) / 100;
+		}
+
+		/*!
+			Método que altera a parte da placa no limite de pico do grupo, comparada à soma dos soquetes.
+			\param porcentagem é o limite em % do fundo de escala de um soquete, ou 0 para nenhum limite.
+		*/
+		void setLimitePlaca(int porcentagem) {
+			limitePlaca = (porcentagem * POTENCIA_FUNDO_ESCALA) / 100;
+		}
+
+		/*!
+			Método que entrega ao gerente um corte feito pela interrupção.
+			\param disparo recebe o corte.
+			\return Valor booleano que indica se havia um corte a entregar.
+		*/
+		bool retirarDisparo(DisparoDePotencia* disparo) {
+			for (int k = 0; k < quantidade; k++) {
+				if (disparoPendente[k]) {
+					*disparo = disparos[k];
+					disparoPendente[k] = false;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/*!
+			Método que para a amostragem. Usado na reprodução de tráfego, em que as amostras e os disparos vêm da captura.
+		*/
+		void parar() {
+			memoriaAlarme.destruir();
+		}
+
+		/*!
+			Método que refaz um corte lido de uma captura, como a interrupção o fez: limita o dimmer ou desliga o soquete e guarda o corte para o gerente.
+			\param disparo é o corte capturado.
+		*/
+		void reproduzirDisparo(const DisparoDePotencia& disparo) {
+			int k = disparo.soquete;
+			if ((k < 0) || (k >= quantidade)) {
+				return;
+			}
+			if ((disparo.passos > 0) && (tomadas[k]->getTipo() == 2)) {
+				static_cast<TomadaMulti*>(tomadas[k])->getDimmer()->limitar(disparo.passos);
+			} else {
+				tomadas[k]->cortar();
+			}
+			desligadoPeloLimite[k] = (disparo.passos == 0);
+			disparado[k] = true;
+			int faixa = disparo.latencia / LARGURA_FAIXA_DISPARO;
+			histogramaDisparo[(faixa < FAIXAS_HISTOGRAMA_DISPARO) ? faixa : (FAIXAS_HISTOGRAMA_DISPARO - 1)]++;
+			disparos[k] = disparo;
+			disparoPendente[k] = true;
+		}
+
+		/*!
+			Método que rearma o limite de pico: os soquetes cortados voltam ao estado e ao nível pedidos pela decisão do gerente.
+			Chamado pela tarefa de decisão no início de cada época. Um soquete que ainda passa do limite é cortado de novo pela interrupção.
+		*/
+		void rearmar() {
+			for (int k = 0; k < quantidade; k++) {
+				if (disparado[k]) {
+					if (tomadas[k]->getTipo() == 2) {
+						static_cast<TomadaMulti*>(tomadas[k])->getDimmer()->liberar();
+					}
+					tomadas[k]->liberarCorte();
+					disparado[k] = false;
+				}
+			}
+		}
+};
+
+MedidorDeEnergia* MedidorDeEnergia::instancia = 0;
+
+//----------------------------------------------------------------------------
+//!  Classe HistoricoEmCamadas
+/*!
+	Histórico de consumo de um soquete em três resoluções, em memória fixa: os últimos NUMERO_ENTRADAS_HISTORICO períodos entre sincronizações,
+	as últimas NUMERO_HORAS_HISTORICO horas e os últimos NUMERO_DIAS_HISTORICO dias. Cada camada é um anel.
+	As horas e os dias guardam o consumo médio por período e são preenchidos aos poucos: cada período registrado é somado à hora e ao dia correntes,
+	que entram nos anéis quando o relógio passa para a hora (ou o dia) seguinte. Horas e dias sem nenhum período com o soquete ligado ficam sem dados.
+	Qualquer entrada de qualquer camada é consultada em O(1) pela idade (0 é a mais recente) ou pelo índice absoluto (0 é a primeira registrada), usado nas consultas de outras tomadas.
+*/
+class HistoricoEmCamadas {
+	private:
+		float periodos[NUMERO_ENTRADAS_HISTORICO]; /*!< Consumo dos últimos períodos.*/
+		float horas[NUMERO_HORAS_HISTORICO]; /*!< Consumo médio por período das últimas horas, ou SEM_DADOS.*/
+		float dias[NUMERO_DIAS_HISTORICO]; /*!< Consumo médio por período dos últimos dias, ou SEM_DADOS.*/
+		int proximoPeriodo; /*!< Posição do próximo período em periodos.*/
+		int proximaHora; /*!< Posição da próxima hora em horas.*/
+		int proximoDia; /*!< Posição do próximo dia em dias.*/
+		int quantidadeHoras; /*!< Quantidade de horas fechadas (no máximo NUMERO_HORAS_HISTORICO).*/
+		int quantidadeDias; /*!< Quantidade de dias fechados (no máximo NUMERO_DIAS_HISTORICO).*/
+		unsigned long totalPeriodos; /*!< Quantidade de períodos registrados desde que o histórico foi zerado.*/
+		unsigned long totalHoras; /*!< Quantidade de horas fechadas desde que o histórico foi zerado.*/
+		unsigned long totalDias; /*!< Quantidade de dias fechados desde que o histórico foi zerado.*/
+		long horaAtual; /*!< Hora corrente (horas desde 01/01/2016), ou -1 antes do primeiro registro.*/
+		float somaHora; /*!< Soma dos períodos registrados na hora corrente.*/
+		int periodosHora; /*!< Quantidade de períodos registrados na hora corrente.*/
+		float somaDia; /*!< Soma dos períodos registrados no dia corrente.*/
+		int periodosDia; /*!< Quantidade de períodos registrados no dia corrente.*/
+
+		/*!
+			Método que insere uma entrada em um anel.
+		*/
+		static void inserir(float* anel, int tamanho, int* proxima, int* quantidade, unsigned long* total, float valor) {
+			anel[*proxima] = valor;
+			*proxima = (*proxima + 1) % tamanho;
+			if (*quantidade < tamanho) {
+				(*quantidade)++;
+			}
+			(*total)++;
+		}
+
+		/*!
+			Método que fecha a hora corrente e, se o dia mudou, o dia corrente. Horas e dias pulados (placa sem sincronizar) entram sem dados.
+			\param hora é a nova hora corrente.
+		*/
+		void avancarHora(long hora) {
+			long horasPassadas = (hora > horaAtual) ? (hora - horaAtual) : 1; // Relógio acertado para trás: só fecha a hora corrente.
+			long diasPassados = (hora / 24 > horaAtual / 24) ? (hora / 24 - horaAtual / 24) : ((hora > horaAtual) ? 0 : 1);
+
+			inserir(horas, NUMERO_HORAS_HISTORICO, &proximaHora, &quantidadeHoras, &totalHoras, (periodosHora > 0) ? (somaHora / periodosHora) : SEM_DADOS);
+			for (long i = 1; (i < horasPassadas) && (i <= NUMERO_HORAS_HISTORICO); i++) {
+				inserir(horas, NUMERO_HORAS_HISTORICO, &proximaHora, &quantidadeHoras, &totalHoras, SEM_DADOS);
+			}
+			somaHora = 0;
+			periodosHora = 0;
+
+			if (diasPassados > 0) {
+				inserir(dias, NUMERO_DIAS_HISTORICO, &proximoDia, &quantidadeDias, &totalDias, (periodosDia > 0) ? (somaDia / periodosDia) : SEM_DADOS);
+				for (long i = 1; (i < diasPassados) && (i <= NUMERO_DIAS_HISTORICO); i++) {
+					inserir(dias, NUMERO_DIAS_HISTORICO, &proximoDia, &quantidadeDias, &totalDias, SEM_DADOS);
+				}
+				somaDia = 0;
+				periodosDia = 0;
+			}
+			horaAtual = hora;
+		}
+
+	public:
+		/*!
+			Método construtor da classe.
+		*/
+		HistoricoEmCamadas() {
+			zerar();
+		}
+
+		/*!
+			Método que apaga o histórico. Os períodos voltam a valer 0; horas e dias ficam sem dados.
+		*/
+		void zerar() {
+			for (int i = 0; i < NUMERO_ENTRADAS_HISTORICO; i++) {
+				periodos[i] = 0;
+			}
+			proximoPeriodo = 0;
+			proximaHora = 0;
+			proximoDia = 0;
+			quantidadeHoras = 0;
+			quantidadeDias = 0;
+			totalPeriodos = 0;
+			totalHoras = 0;
+			totalDias = 0;
+			horaAtual = -1;
+			somaHora = 0;
+			periodosHora = 0;
+			somaDia = 0;
+			periodosDia = 0;
+		}
+
+		/*!
+			Método que registra o consumo de um período que terminou.
+			\param consumo é o consumo do período, sem dimmerização.
+			\param ligado indica se o soquete estava ligado. Períodos com o soquete desligado só fazem as horas e os dias avançarem.
+			\param tempo é o tempo atual (microssegundos desde 01/01/2016).
+		*/
+		void registrar(float consumo, bool ligado, unsigned long long tempo) {
+			long hora = (long) (tempo / 3600000000ULL);
+			if (horaAtual < 0) {
+				horaAtual = hora;
+			} else if (hora != horaAtual) {
+				avancarHora(hora);
+			}
+			if (ligado) {
+				periodos[proximoPeriodo] = consumo;
+				proximoPeriodo = (proximoPeriodo + 1) % NUMERO_ENTRADAS_HISTORICO;
+				totalPeriodos++;
+				somaHora += consumo;
+				periodosHora++;
+				somaDia += consumo;
+				periodosDia++;
+			}
+		}
+
+		/*!
+			Método que retorna o consumo de um período.
+			\param idade é a idade do período, de 0 (o último) a NUMERO_ENTRADAS_HISTORICO - 1.
+		*/
+		float periodo(int idade) const {
+			return periodos[(proximoPeriodo + NUMERO_ENTRADAS_HISTORICO - 1 - idade) % NUMERO_ENTRADAS_HISTORICO];
+		}
+
+		/*!
+			Método que retorna o consumo médio por período de uma hora fechada.
+			\param idade é a idade da hora, a partir de 0 (a última hora fechada).
+			\return Consumo médio, ou SEM_DADOS.
+		*/
+		float hora(int idade) const {
+			if (idade >= quantidadeHoras) {
+				return SEM_DADOS;
+			}
+			return horas[(proximaHora + NUMERO_HORAS_HISTORICO - 1 - idade) % NUMERO_HORAS_HISTORICO];
+		}
+
+		/*!
+			Método que retorna o consumo médio por período de um dia fechado.
+			\param idade é a idade do dia, a partir de 0 (o último dia fechado).
+			\return Consumo médio, ou SEM_DADOS.
+		*/
+		float dia(int idade) const {
+			if (idade >= quantidadeDias) {
+				return SEM_DADOS;
+			}
+			return dias[(proximoDia + NUMERO_DIAS_HISTORICO - 1 - idade) % NUMERO_DIAS_HISTORICO];
+		}
+
+		/*!
+			Método que retorna a quantidade de entradas já registradas em uma camada, que é o índice absoluto da próxima entrada.
+			\param camada é CAMADA_PERIODOS, CAMADA_HORAS ou CAMADA_DIAS.
+		*/
+		unsigned long total(int camada) const {
+			if (camada == CAMADA_PERIODOS) {
+				return totalPeriodos;
+			}
+			return (camada == CAMADA_HORAS) ? totalHoras : totalDias;
+		}
+
+		/*!
+			Método que retorna o índice absoluto da entrada mais antiga que ainda está no anel de uma camada.
+			\param camada é CAMADA_PERIODOS, CAMADA_HORAS ou CAMADA_DIAS.
+		*/
+		unsigned long primeiroDisponivel(int camada) const {
+			unsigned long tamanho = (camada == CAMADA_PERIODOS) ? NUMERO_ENTRADAS_HISTORICO
+				: ((camada == CAMADA_HORAS) ? NUMERO_HORAS_HISTORICO : NUMERO_DIAS_HISTORICO);
+			unsigned long registradas = total(camada);
+			return (registradas > tamanho) ? (registradas - tamanho) : 0;
+		}
+
+		/*!
+			Método que retorna uma entrada pelo índice absoluto.
+			\param camada é CAMADA_PERIODOS, CAMADA_HORAS ou CAMADA_DIAS.
+			\param indice é o índice absoluto, entre primeiroDisponivel(camada) e total(camada) - 1.
+			\return Consumo da entrada, ou SEM_DADOS se ela não está no anel.
+		*/
+		float entrada(int camada, unsigned long indice) const {
+			if ((indice < primeiroDisponivel(camada)) || (indice >= total(camada))) {
+				return SEM_DADOS;
+			}
+			int idade = (int) (total(camada) - 1 - indice);
+			if (camada == CAMADA_PERIODOS) {
+				return periodo(idade);
+			}
+			return (camada == CAMADA_HORAS) ? hora(idade) : dia(idade);
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe Previsor
+/*!
+	Classe que faz a previsão de consumo de uma determinada tomada.
+*/
+class Previsor {
+	public:
+		/*!
+			Método construtor da classe
+		*/
+		//Previsor();
+
+		/*!
+			Método estático que estima o consumo da tomada em uma época.
+			A média ponderada dos últimos períodos (os mais recentes pesam mais) é combinada com a média da última semana, que cobre o ciclo semanal,
+			ou, enquanto não há uma semana de dados, com a média das últimas 24 horas, que cobre o ciclo diário.
+ 			\param historico é o histórico de consumo da tomada.
+		*/
+		static float preverConsumoProprio(const HistoricoEmCamadas& historico) {
+			float previsao = 0;
+
+			int N = NUMERO_ENTRADAS_HISTORICO;
+
+			// Soma de todos os números de 1 até N.
+			float somaPesos = (N * (N + 1)) / 2;
+
+			for (int i = 0; i < NUMERO_ENTRADAS_HISTORICO; i++) {
+				previsao += ((N - i)/somaPesos) * historico.periodo(i);
+			}
+
+			float ciclo;
+			if (mediaCompleta(historico, true, 7, &ciclo) || mediaCompleta(historico, false, 24, &ciclo)) {
+				previsao = PESO_PREVISAO_RECENTE * previsao + (1 - PESO_PREVISAO_RECENTE) * ciclo;
+			}
+			return previsao;
+		}
+
+		/*!
+			Método que calcula a média das últimas entradas de uma camada do histórico, se todas tiverem dados.
+			\param historico é o histórico de consumo da tomada.
+			\param emDias indica se a camada é a dos dias (senão, a das horas).
+			\param quantidade é a quantidade de entradas.
+			\param media recebe a média.
+			\return Valor booleano que indica se todas as entradas tinham dados.
+		*/
+		static bool mediaCompleta(const HistoricoEmCamadas& historico, bool emDias, int quantidade, float* media) {
+			float soma = 0;
+			for (int i = 0; i < quantidade; i++) {
+				float valor = emDias ? historico.dia(i) : historico.hora(i);
+				if (valor == SEM_DADOS) {
+					return false;
+				}
+				soma += valor;
+			}
+			*media = soma / quantidade;
+			return true;
+		}
+
+		/*!
+			Método que estima o consumo de todas as tomadas juntas até o fim do mês, com as mesmas tomadas do plano de corte (as ouvidas na época).
+			\param pool são as entradas da tabela, com os valores enviados pelas outras tomadas.
+ 			\param minhaPrevisao é a previsão da tomada até o fim do mês.
+			\param epoca é a época da sincronização.
+			\return Valor previsto para o consumo total das tomadas.
+		*/
+		static float preverConsumoTotal(const PoolDeTomadas& pool, float minhaPrevisao, unsigned long epoca) {
+			return minhaPrevisao + pool.somarPrevisto(epoca);
+		}
+
+		/*!
+			Método que estima o consumo de todas as tomadas juntas até o fim do mês a partir das somas do sistema.
+			\param agregado são as somas do sistema, obtidas por gossip.
+			\return Valor previsto para o consumo total das tomadas.
+		*/
+		static float preverConsumoTotal(const Agregado& agregado) {
+			return agregado.consumoPrevisto;
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Struct Decisao
+/*!
+	Estado que o plano de corte atribui a uma tomada.
+*/
+struct Decisao {
+	bool ligada; /*!< Indica se a tomada deve ficar ligada. */
+	float dimerizacao; /*!< Porcentagem de dimmerização da tomada (1 = 100%). Só é diferente de 1 para tomadas com dimmer. */
+};
+
+//----------------------------------------------------------------------------
+//!  Classe PlanejadorDeCorte
+/*!
+	Classe que calcula o plano de corte (quais tomadas desligar ou dimerizar) de todo o sistema.
+	O plano depende apenas da visão da tabela passada, de forma que todas as tomadas que têm a mesma visão calculam exatamente o mesmo plano.
+*/
+class PlanejadorDeCorte {
+	private:
+		/*!
+			Método que define a ordem de corte: primeiro as de menor prioridade, entre elas as de menor consumo previsto e, em caso de empate, a de menor endereço
+			e menor soquete.
+			\return Valor booleano que indica se a deve ser cortada antes de b.
+		*/
+		static bool cortarAntes(const Dados* a, const Dados* b) {
+			if (a->prioridade != b->prioridade) {
+				return a->prioridade < b->prioridade;
+			}
+			if (a->consumoPrevisto != b->consumoPrevisto) {
+				return a->consumoPrevisto < b->consumoPrevisto;
+			}
+			int comparacao = ComparadorDeEnderecos::comparar(a->remetente, b->remetente);
+			if (comparacao != 0) {
+				return comparacao < 0;
+			}
+			return a->soquete < b->soquete;
+		}
+
+		/*!
+			Método que acumula um valor de 32 bits no resumo (FNV-1a).
+		*/
+		static unsigned long acumularResumo(unsigned long resumo, const void* valor, unsigned int tamanho) {
+			const unsigned char* bytes = static_cast<const unsigned char*>(valor);
+			for (unsigned int i = 0; i < tamanho; i++) {
+				resumo ^= bytes[i];
+				resumo *= 16777619UL;
+			}
+			return resumo & 0xffffffffUL;
+		}
+
+	public:
+		/*!
+			Método que converte uma prioridade no nível usado na agregação.
+			\param prioridade é a prioridade da tomada.
+			\return Nível entre 0 e NUMERO_NIVEIS_PRIORIDADE - 1.
+		*/
+		static int nivelDaPrioridade(int prioridade) {
+			if (prioridade < 0) {
+				return 0;
+			}
+			if (prioridade >= NUMERO_NIVEIS_PRIORIDADE) {
+				return NUMERO_NIVEIS_PRIORIDADE - 1;
+			}
+			return prioridade;
+		}
+
+		/*!
+			Método que ordena a visão da tabela na ordem de corte e calcula seu resumo.
+			\param entradas vetor com os dados de cada tomada (incluindo a própria).
+			\param n é a quantidade de entradas.
+			\return Resumo da visão ordenada. Tomadas com o mesmo resumo calcularam o mesmo plano.
+		*/
+		static unsigned long ordenar(Dados** entradas, int n) {
+			// Inserção direta: n é pequeno e a ordem resultante não depende da ordem da hash.
+			for (int i = 1; i < n; i++) {
+				Dados* atual = entradas[i];
+				int j = i - 1;
+				while (j >= 0 && cortarAntes(atual, entradas[j])) {
+					entradas[j+1] = entradas[j];
+					j--;
+				}
+				entradas[j+1] = atual;
+			}
+
+			unsigned long resumo = 2166136261UL;
+			for (int i = 0; i < n; i++) {
+				resumo = acumularResumo(resumo, &entradas[i]->remetente, sizeof(Address));
+				resumo = acumularResumo(resumo, &entradas[i]->soquete, sizeof(int));
+				resumo = acumularResumo(resumo, &entradas[i]->prioridade, sizeof(int));
+				resumo = acumularResumo(resumo, &entradas[i]->podeDesligar, sizeof(bool));
+				resumo = acumularResumo(resumo, &entradas[i]->temDimmer, sizeof(bool));
+				resumo = acumularResumo(resumo, &entradas[i]->consumoPrevisto, sizeof(float));
+				resumo = acumularResumo(resumo, &entradas[i]->ultimoConsumo, sizeof(float));
+				resumo = acumularResumo(resumo, &entradas[i]->consumoMensal, sizeof(float));
+				resumo = acumularResumo(resumo, &entradas[i]->maximoConsumoMensal, sizeof(float));
+			}
+			return resumo;
+		}
+
+		/*!
+			Método que calcula quanto o consumo previsto do sistema passa do limite.
+			\param entradas vetor com os dados de cada tomada, já ordenado por ordenar().
+			\param n é a quantidade de entradas.
+			\return Excesso de consumo previsto até o fim do mês. Valores menores ou iguais a 0 indicam que o consumo fica dentro do limite.
+		*/
+		static float calcularExcesso(Dados** entradas, int n) {
+			// Usa o maior consumo mensal e o menor limite informados, para que todas as tomadas partam dos mesmos valores.
+			float consumoMensal = 0;
+			float limite = 0;
+			float total = 0;
+			for (int i = 0; i < n; i++) {
+				if (i == 0 || entradas[i]->consumoMensal > consumoMensal) {
+					consumoMensal = entradas[i]->consumoMensal;
+				}
+				if (i == 0 || entradas[i]->maximoConsumoMensal < limite) {
+					limite = entradas[i]->maximoConsumoMensal;
+				}
+			}
+			// As somas são feitas na ordem de corte para que o arredondamento seja o mesmo em todas as tomadas.
+			for (int i = 0; i < n; i++) {
+				consumoMensal += entradas[i]->ultimoConsumo;
+				total += entradas[i]->consumoPrevisto;
+			}
+			return consumoMensal + total - limite;
+		}
+
+		/*!
+			Método que calcula o plano de corte e devolve as decisões de todos os soquetes de uma placa, em uma única passada pela visão.
+			Percorre as tomadas na ordem de corte desligando (ou dimerizando, se tiverem dimmer e a dimmerização necessária não for menor que DIMERIZACAO_MINIMA)
+			as que podem ser desligadas até que o excesso seja eliminado.
+			\param entradas vetor com os dados de cada tomada, já ordenado por ordenar().
+			\param n é a quantidade de entradas.
+			\param endereco é o endereço da placa cujas decisões se deseja.
+			\param decisoes recebe a decisão de cada soquete da placa, indexada pelo soquete. Soquetes fora da visão ficam ligados.
+			\param quantidade é a quantidade de soquetes da placa.
+		*/
+		static void planejar(Dados** entradas, int n, const Address& endereco, Decisao* decisoes, int quantidade) {
+			float excesso = calcularExcesso(entradas, n);
+
+			for (int k = 0; k < quantidade; k++) {
+				decisoes[k].ligada = true;
+				decisoes[k].dimerizacao = 1;
+			}
+
+			for (int i = 0; i < n; i++) {
+				Decisao decisao;
+				decisao.ligada = true;
+				decisao.dimerizacao = 1;
+
+				Dados* d = entradas[i];
+				if (excesso > 0 && d->podeDesligar && d->consumoPrevisto > 0) {
+					if (d->temDimmer && (d->consumoPrevisto - excesso >= DIMERIZACAO_MINIMA * d->consumoPrevisto)) {
+						decisao.dimerizacao = (d->consumoPrevisto - excesso) / d->consumoPrevisto;
+						excesso = 0;
+					} else {
+						decisao.ligada = false;
+						excesso -= d->consumoPrevisto;
+					}
+				}
+
+				if ((d->soquete >= 0) && (d->soquete < quantidade) && (ComparadorDeEnderecos::comparar(d->remetente, endereco) == 0)) {
+					decisoes[d->soquete] = decisao;
+				}
+			}
+		}
+
+		/*!
+			Método que resume a decisão de corte do sistema conhecendo apenas as somas do sistema, e não os dados de cada tomada.
+			Os níveis de prioridade são cortados do menor para o maior até que o excesso seja eliminado.
+			\param agregado são as somas do sistema.
+			\param consumoMensal é o consumo do sistema no mês até o momento.
+			\param limite é o consumo máximo mensal.
+			\return Decisão resumida do sistema.
+		*/
+		static DecisaoResumida resumirDecisao(const Agregado& agregado, float consumoMensal, float limite) {
+			DecisaoResumida resumida;
+			resumida.nivelCorte = NUMERO_NIVEIS_PRIORIDADE;
+			resumida.fracao = 0;
+
+			float excesso = consumoMensal + agregado.consumoPrevisto - limite;
+			for (int nivel = 0; nivel < NUMERO_NIVEIS_PRIORIDADE; nivel++) {
+				float consumoNivel = agregado.previstoDesligavel[nivel];
+				if (excesso <= 0) {
+					resumida.nivelCorte = nivel;
+					break;
+				}
+				if (consumoNivel > excesso) {
+					resumida.nivelCorte = nivel;
+					resumida.fracao = excesso / consumoNivel;
+					break;
+				}
+				excesso -= consumoNivel;
+			}
+			return resumida;
+		}
+
+		/*!
+			Método que calcula a decisão de uma tomada a partir da decisão resumida do sistema.
+			No nível de corte, a fração é aplicada como dimmerização nas tomadas com dimmer (se não ficar abaixo de DIMERIZACAO_MINIMA) e como sorteio
+			(pelo endereço, soquete e época) nas demais, para que tomadas diferentes sejam desligadas a cada época.
+			\param resumida é a decisão resumida do sistema.
+			\param minha são os dados da própria tomada.
+			\return Decisão da tomada.
+		*/
+		static Decisao decidir(const DecisaoResumida& resumida, const Dados& minha) {
+			Decisao decisao;
+			decisao.ligada = true;
+			decisao.dimerizacao = 1;
+
+			int meuNivel = nivelDaPrioridade(minha.prioridade);
+			if (!minha.podeDesligar || (meuNivel > resumida.nivelCorte)) {
+				return decisao;
+			}
+
+			if (meuNivel < resumida.nivelCorte) {
+				decisao.ligada = false;
+			} else if (resumida.fracao <= 0) {
+				return decisao;
+			} else if (minha.temDimmer && (1 - resumida.fracao >= DIMERIZACAO_MINIMA)) {
+				decisao.dimerizacao = 1 - resumida.fracao;
+			} else {
+				unsigned long sorteio = 2166136261UL;
+				sorteio = acumularResumo(sorteio, &minha.remetente, sizeof(Address));
+				sorteio = acumularResumo(sorteio, &minha.soquete, sizeof(int));
+				sorteio = acumularResumo(sorteio, &minha.epoca, sizeof(unsigned long));
+				decisao.ligada = ((sorteio % 1000) >= (unsigned long) (resumida.fracao * 1000));
+			}
+			return decisao;
+		}
+
+		/*!
+			Método que calcula a decisão de uma tomada conhecendo apenas as somas do sistema.
+			\param agregado são as somas do sistema.
+			\param consumoMensal é o consumo do sistema no mês até o momento.
+			\param limite é o consumo máximo mensal.
+			\param minha são os dados da própria tomada.
+			\return Decisão da tomada.
+			\sa resumirDecisao(), decidir()
+		*/
+		static Decisao planejarPorAgregado(const Agregado& agregado, float consumoMensal, float limite, const Dados& minha) {
+			return decidir(resumirDecisao(agregado, consumoMensal, limite), minha);
+		}
+};
+
+void PoolDeTomadas::atualizarColunas(Hash_Element* e) {
+	const Dados* d = e->object();
+	colunas.atualizar(d - dados, d->consumoPrevisto, d->ultimoConsumo, d->consumoMensal, d->maximoConsumoMensal, (int) d->epoca,
+			(int) d->ultimaEpocaOuvida, PlanejadorDeCorte::nivelDaPrioridade(d->prioridade), d->podeDesligar);
+}
+
+//----------------------------------------------------------------------------
+//!  Classe Agregador
+/*!
+	Classe que calcula as somas do sistema por gossip (push-sum): a cada rodada a tomada envia metade de suas somas e de seu peso a um vizinho aleatório.
+	Somente a tomada raiz (menor endereço conhecido) tem peso 1, de forma que somas/peso converge para a soma de todas as tomadas.
+	A raiz é a aprendida na época anterior; quando não há uma (primeira época ou mudança de grupo), ela é escolhida pelos anúncios da própria época,
+	e o peso só é dado na primeira rodada, depois deles, para que as tomadas não comecem todas como raiz.
+	Peso e somas viajam juntos, então um quadro perdido no rádio leva a mesma fração dos dois e a estimativa (somas/peso) continua normalizada pelo
+	peso que de fato chegou. Um quadro que não entra na fila de envio não é contado como enviado: a tomada fica com as duas metades.
+	A quantidade de soquetes de cada tomada é somada da mesma forma, para que o limite de pico do grupo seja dividido sem a tabela completa.
+	Cada tomada envia apenas uma mensagem de tamanho fixo por rodada, em vez de receber as mensagens de todas as outras.
+*/
+class Agregador {
+	private:
+		Mensageiro* mensageiro; /*!< Objeto que provê a comunicação da placa com as outras.*/
+		Address proprio; /*!< Endereço da própria tomada.*/
+		Address raiz; /*!< Raiz da rodada atual.*/
+		Address raizProxima; /*!< Menor endereço ouvido na rodada atual, que será a raiz da próxima.*/
+		Address vizinhos[NUMERO_VIZINHOS_GOSSIP]; /*!< Tomadas ouvidas recentemente, candidatas a destino das rodadas.*/
+		int quantidadeVizinhos; /*!< Quantidade de entradas válidas em vizinhos.*/
+		int proximaSubstituicao; /*!< Posição de vizinhos substituída quando o vetor está cheio.*/
+		unsigned long epoca; /*!< Época da agregação atual.*/
+		bool raizConhecida; /*!< Indica se alguma tomada foi ouvida desde o início da época, isto é, se raizProxima pode ser a raiz da próxima.*/
+		bool pesoDefinido; /*!< Indica se o peso inicial da época já foi dado.*/
+		float peso; /*!< Peso atual do push-sum.*/
+		Agregado somas; /*!< Somas atuais do push-sum.*/
+		float soquetes; /*!< Soma atual da quantidade de soquetes do push-sum.*/
+		Agregado contribuicao; /*!< Valores da própria tomada na época atual.*/
+		unsigned int semente; /*!< Estado do gerador (xorshift) que sorteia o vizinho de cada rodada. Próprio do agregador, para que a escolha só dependa do endereço e da época.*/
+
+		/*!
+			Método que lembra uma tomada como vizinha.
+		*/
+		void lembrarVizinho(const Address& endereco) {
+			for (int i = 0; i < quantidadeVizinhos; i++) {
+				if (vizinhos[i] == endereco) {
+					return;
+				}
+			}
+			if (quantidadeVizinhos < NUMERO_VIZINHOS_GOSSIP) {
+				vizinhos[quantidadeVizinhos++] = endereco;
+			} else {
+				vizinhos[proximaSubstituicao] = endereco;
+				proximaSubstituicao = (proximaSubstituicao + 1) % NUMERO_VIZINHOS_GOSSIP;
+			}
+		}
+
+		/*!
+			Método que envia uma mensagem de agregação.
+			\return Valor booleano que indica se a mensagem entrou na fila de envio.
+		*/
+		bool enviar(const Address& destino, float p, const Agregado& a, float q) {
+			MensagemAgregacao msg;
+			memset(&msg, 0, sizeof msg);
+			msg.remetente = proprio;
+			msg.raiz = raizProxima;
+			msg.epoca = epoca;
+			msg.peso = p;
+			msg.somas = a;
+			msg.soquetes = q;
+			return mensageiro->enviar(destino, PROTOCOLO_AGREGACAO, &msg, sizeof msg);
+		}
+
+	public:
+		/*!
+			Método que zera todas as somas de um agregado.
+		*/
+		static void zerar(Agregado* a) {
+			a->consumoPrevisto = 0;
+			a->ultimoConsumo = 0;
+			for (int i = 0; i < NUMERO_NIVEIS_PRIORIDADE; i++) {
+				a->previstoDesligavel[i] = 0;
+			}
+		}
+
+		/*!
+			Método que soma os valores de uma tomada a um agregado.
+			\param a é o agregado.
+			\param d são os dados da tomada.
+		*/
+		static void somar(Agregado* a, const Dados& d) {
+			a->consumoPrevisto += d.consumoPrevisto;
+			a->ultimoConsumo += d.ultimoConsumo;
+			if (d.podeDesligar) {
+				a->previstoDesligavel[PlanejadorDeCorte::nivelDaPrioridade(d.prioridade)] += d.consumoPrevisto;
+			}
+		}
+
+		/*!
+			Método que soma um agregado a outro.
+			\param a é o agregado que recebe a soma.
+			\param b é o agregado somado.
+		*/
+		static void somar(Agregado* a, const Agregado& b) {
+			a->consumoPrevisto += b.consumoPrevisto;
+			a->ultimoConsumo += b.ultimoConsumo;
+			for (int i = 0; i < NUMERO_NIVEIS_PRIORIDADE; i++) {
+				a->previstoDesligavel[i] += b.previstoDesligavel[i];
+			}
+		}
+
+		/*!
+			Método construtor da classe.
+			\param m é o mensageiro usado para enviar as mensagens.
+		*/
+		Agregador(Mensageiro* m) {
+			mensageiro = m;
+			proprio = mensageiro->obterEnderecoNIC();
+			raiz = proprio;
+			raizProxima = proprio;
+			quantidadeVizinhos = 0;
+			proximaSubstituicao = 0;
+			epoca = 0;
+			raizConhecida = false;
+			pesoDefinido = false;
+			peso = 0;
+			semente = 1;
+			soquetes = 0;
+			zerar(&somas);
+			zerar(&contribuicao);
+		}
+
+		/*!
+			Método que inicia a agregação de uma época com os valores da própria placa.
+			\param e é a época que será agregada.
+			\param meus são as somas dos dados de todos os soquetes da placa nesta época.
+			\param q é a quantidade de soquetes da placa.
+		*/
+		void iniciar(unsigned long e, const Agregado& meus, int q) {
+			epoca = e;
+			raiz = raizProxima;
+			raizProxima = proprio;
+			if (ComparadorDeEnderecos::comparar(raiz, proprio) > 0) {
+				raiz = proprio;
+			}
+
+			contribuicao = meus;
+			somas = contribuicao;
+			soquetes = (float) q;
+			// Sem raiz da época anterior, o peso espera os anúncios desta época (definirPeso()).
+			pesoDefinido = raizConhecida;
+			raizConhecida = false;
+			peso = (pesoDefinido && (raiz == proprio)) ? 1 : 0;
+			semente = ((unsigned int) RegistroDeEventos::endereco(proprio) * 2654435761u) ^ (unsigned int) e;
+			if (semente == 0) {
+				semente = 1;
+			}
+		}
+
+		/*!
+			Método que esquece os vizinhos e a raiz ouvidos, quando a placa muda de grupo de orçamento. A próxima rodada começa só com o novo grupo.
+		*/
+		void esquecerVizinhos() {
+			quantidadeVizinhos = 0;
+			proximaSubstituicao = 0;
+			raizProxima = proprio;
+			raizConhecida = false;
+		}
+
+		/*!
+			Método que dá o peso inicial da época, se ele esperava os anúncios: a raiz é o menor endereço ouvido até aqui.
+		*/
+		void definirPeso() {
+			if (pesoDefinido) {
+				return;
+			}
+			raiz = raizProxima;
+			peso = (raiz == proprio) ? 1 : 0;
+			pesoDefinido = true;
+		}
+
+		/*!
+			Método que anuncia a tomada às vizinhas, com peso e somas nulos.
+		*/
+		void anunciar() {
+			Agregado vazio;
+			zerar(&vazio);
+			enviar(mensageiro->obterBroadcast(), 0, vazio, 0);
+		}
+
+		/*!
+			Método que executa uma rodada: metade das somas e do peso é enviada a um vizinho aleatório e a outra metade é mantida.
+		*/
+		void enviarRodada() {
+			definirPeso();
+			if (quantidadeVizinhos == 0) {
+				return;
+			}
+			float metadePeso = peso / 2;
+			Agregado metade;
+			metade.consumoPrevisto = somas.consumoPrevisto / 2;
+			metade.ultimoConsumo = somas.ultimoConsumo / 2;
+			for (int i = 0; i < NUMERO_NIVEIS_PRIORIDADE; i++) {
+				metade.previstoDesligavel[i] = somas.previstoDesligavel[i] / 2;
+			}
+			semente ^= semente << 13;
+			semente ^= semente >> 17;
+			semente ^= semente << 5;
+			float metadeSoquetes = soquetes / 2;
+			if (enviar(vizinhos[semente % quantidadeVizinhos], metadePeso, metade, metadeSoquetes)) { // Sem envio, a tomada fica com as duas metades.
+				peso = metadePeso;
+				somas = metade;
+				soquetes = metadeSoquetes;
+			}
+		}
+
+		/*!
+			Método que incorpora uma mensagem recebida. Mensagens de outras épocas só servem para conhecer vizinhos.
+			\param msg é a mensagem recebida.
+		*/
+		void receber(const MensagemAgregacao& msg) {
+			lembrarVizinho(msg.remetente);
+			if (ComparadorDeEnderecos::comparar(msg.raiz, raizProxima) < 0) {
+				raizProxima = msg.raiz;
+			}
+			if (ComparadorDeEnderecos::comparar(msg.remetente, raizProxima) < 0) {
+				raizProxima = msg.remetente;
+			}
+			raizConhecida = true;
+			if (msg.epoca != epoca) {
+				return;
+			}
+			peso += msg.peso;
+			somar(&somas, msg.somas);
+			soquetes += msg.soquetes;
+		}
+
+		/*!
+			Método que devolve a estimativa das somas do sistema.
+			\param resultado recebe a estimativa. Se a tomada ainda não recebeu peso, recebe apenas os valores da própria tomada.
+			\return Valor booleano que indica se a estimativa é válida.
+		*/
+		bool estimativa(Agregado* resultado) {
+			definirPeso(); // Uma janela sem rodadas também dá o peso.
+			if (peso <= 0) {
+				*resultado = contribuicao;
+				return false;
+			}
+			resultado->consumoPrevisto = somas.consumoPrevisto / peso;
+			resultado->ultimoConsumo = somas.ultimoConsumo / peso;
+			for (int i = 0; i < NUMERO_NIVEIS_PRIORIDADE; i++) {
+				resultado->previstoDesligavel[i] = somas.previstoDesligavel[i] / peso;
+			}
+			return true;
+		}
+
+		/*!
+			Método que devolve a estimativa da quantidade de soquetes do grupo, arredondada para cima.
+			\return Quantidade estimada, ou 0 se a tomada ainda não recebeu peso.
+		*/
+		int estimativaSoquetes() {
+			definirPeso();
+			if (peso <= 0) {
+				return 0;
+			}
+			float q = soquetes / peso;
+			int inteiro = (int) q;
+			return (q > inteiro) ? inteiro + 1 : inteiro;
+		}
+
+		/*!
+			Método que retorna a quantidade de vizinhos conhecidos.
+			\return Quantidade de vizinhos.
+		*/
+		int getQuantidadeVizinhos() {
+			return quantidadeVizinhos;
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe Cluster
+/*!
+	Classe que organiza as tomadas em clusters no modo de agregação hierárquica.
+	A cada época, as tomadas de menor endereço entre as vizinhas se tornam chefes e as outras escolhem o chefe de menor endereço que ouviram.
+	Os membros enviam seus Dados apenas ao chefe, os chefes trocam as somas de seus clusters entre si e enviam aos membros uma decisão resumida.
+*/
+class Cluster {
+	private:
+		Mensageiro* mensageiro; /*!< Objeto que provê a comunicação da placa com as outras.*/
+		Address proprio; /*!< Endereço da própria tomada.*/
+		Address chefe; /*!< Chefe do cluster da tomada na época atual.*/
+		Address menorVizinho; /*!< Menor endereço ouvido na fase de anúncio.*/
+		Address menorChefe; /*!< Menor endereço que se anunciou como chefe.*/
+		bool ouviuVizinho; /*!< Indica se menorVizinho é válido.*/
+		bool ouviuChefe; /*!< Indica se menorChefe é válido.*/
+		bool ehChefe; /*!< Indica se a tomada é chefe de um cluster na época atual.*/
+		unsigned long epoca; /*!< Época atual.*/
+		int fase; /*!< Fase atual da sincronização hierárquica.*/
+		MensagemCluster agregadoProprio; /*!< Somas do cluster da tomada, quando ela é chefe.*/
+		MensagemCluster outros[NUMERO_MAXIMO_CLUSTERS]; /*!< Somas dos outros clusters recebidas na época atual.*/
+		int quantidadeOutros; /*!< Quantidade de entradas válidas em outros.*/
+		MensagemCluster decisao; /*!< Decisão resumida do sistema na época atual.*/
+		bool temDecisao; /*!< Indica se decisao é válida.*/
+
+		/*!
+			Método que envia uma mensagem de cluster em broadcast.
+		*/
+		void enviar(MensagemCluster msg, int tipo) {
+			msg.remetente = proprio;
+			msg.chefe = chefe;
+			msg.tipo = tipo;
+			msg.epoca = epoca;
+			mensageiro->enviar(mensageiro->obterBroadcast(), PROTOCOLO_CLUSTER, &msg, sizeof msg);
+		}
+
+	public:
+		/*!
+			Método construtor da classe.
+			\param m é o mensageiro usado para enviar as mensagens.
+		*/
+		Cluster(Mensageiro* m) {
+			mensageiro = m;
+			proprio = mensageiro->obterEnderecoNIC();
+			iniciar(0);
+		}
+
+		/*!
+			Método que inicia uma nova época. Os clusters são formados novamente a cada época.
+			\param e é a nova época.
+		*/
+		void iniciar(unsigned long e) {
+			epoca = e;
+			fase = FASE_ANUNCIO;
+			chefe = proprio;
+			ehChefe = false;
+			ouviuVizinho = false;
+			ouviuChefe = false;
+			quantidadeOutros = 0;
+			temDecisao = false;
+		}
+
+		/*!
+			Método que retorna a fase atual.
+			\return Fase atual da sincronização hierárquica.
+		*/
+		int getFase() {
+			return fase;
+		}
+
+		/*!
+			Método que avança para a próxima fase, tomando as decisões de eleição do fim da fase anterior.
+		*/
+		void avancarFase() {
+			fase++;
+			if (fase == FASE_CHEFE) {
+				// Candidata a chefe se nenhuma vizinha tem endereço menor.
+				ehChefe = !ouviuVizinho || (ComparadorDeEnderecos::comparar(proprio, menorVizinho) < 0);
+			} else if (fase == FASE_MEMBROS) {
+				if (ehChefe) {
+					chefe = proprio;
+				} else if (ouviuChefe) {
+					chefe = menorChefe;
+				} else { // Nenhum chefe ao alcance: a tomada forma um cluster sozinha.
+					ehChefe = true;
+					chefe = proprio;
+				}
+			}
+		}
+
+		/*!
+			Método que envia a mensagem da fase de eleição atual.
+		*/
+		void anunciar() {
+			MensagemCluster msg;
+			memset(&msg, 0, sizeof msg);
+			if (fase == FASE_ANUNCIO) {
+				enviar(msg, CLUSTER_ANUNCIO);
+			} else if ((fase == FASE_CHEFE) && ehChefe) {
+				enviar(msg, CLUSTER_CHEFE);
+			}
+		}
+
+		/*!
+			Método que define as somas do cluster da tomada, quando ela é chefe.
+			\param somas são as somas do próprio chefe e de seus membros.
+			\param membros é a quantidade de tomadas somadas.
+			\param consumoMensal é o maior consumo mensal informado por elas.
+			\param limite é o menor consumo máximo informado por elas.
+		*/
+		void definirAgregado(const Agregado& somas, int membros, float consumoMensal, float limite) {
+			memset(&agregadoProprio, 0, sizeof agregadoProprio); // Campos sem uso (decisão) e enchimento vão zerados no quadro.
+			agregadoProprio.somas = somas;
+			agregadoProprio.membros = membros;
+			agregadoProprio.consumoMensal = consumoMensal;
+			agregadoProprio.maximoConsumoMensal = limite;
+		}
+
+		/*!
+			Método que envia as somas do cluster aos outros chefes.
+		*/
+		void enviarAgregado() {
+			enviar(agregadoProprio, CLUSTER_AGREGADO);
+		}
+
+		/*!
+			Método que soma os clusters conhecidos e calcula a decisão resumida do sistema.
+		*/
+		void calcularDecisao() {
+			decisao = agregadoProprio;
+			for (int i = 0; i < quantidadeOutros; i++) {
+				Agregador::somar(&decisao.somas, outros[i].somas);
+				decisao.membros += outros[i].membros;
+				if (outros[i].consumoMensal > decisao.consumoMensal) {
+					decisao.consumoMensal = outros[i].consumoMensal;
+				}
+				if (outros[i].maximoConsumoMensal < decisao.maximoConsumoMensal) {
+					decisao.maximoConsumoMensal = outros[i].maximoConsumoMensal;
+				}
+			}
+			decisao.decisao = PlanejadorDeCorte::resumirDecisao(decisao.somas, decisao.consumoMensal + decisao.somas.ultimoConsumo, decisao.maximoConsumoMensal);
+			temDecisao = true;
+		}
+
+		/*!
+			Método que envia a decisão resumida aos membros do cluster.
+		*/
+		void enviarDecisao() {
+			if (temDecisao) {
+				enviar(decisao, CLUSTER_DECISAO);
+			}
+		}
+
+		/*!
+			Método que incorpora uma mensagem de cluster recebida.
+			\param msg é a mensagem recebida.
+		*/
+		void receber(const MensagemCluster& msg) {
+			if (msg.epoca != epoca) {
+				return;
+			}
+			if ((msg.tipo == CLUSTER_ANUNCIO) || (msg.tipo == CLUSTER_CHEFE)) {
+				if (!ouviuVizinho || (ComparadorDeEnderecos::comparar(msg.remetente, menorVizinho) < 0)) {
+					menorVizinho = msg.remetente;
+					ouviuVizinho = true;
+				}
+				if ((msg.tipo == CLUSTER_CHEFE) && (!ouviuChefe || (ComparadorDeEnderecos::comparar(msg.remetente, menorChefe) < 0))) {
+					menorChefe = msg.remetente;
+					ouviuChefe = true;
+				}
+			} else if ((msg.tipo == CLUSTER_AGREGADO) && ehChefe && (msg.remetente != proprio)) {
+				for (int i = 0; i < quantidadeOutros; i++) {
+					if (outros[i].remetente == msg.remetente) {
+						outros[i] = msg;
+						return;
+					}
+				}
+				if (quantidadeOutros < NUMERO_MAXIMO_CLUSTERS) {
+					outros[quantidadeOutros++] = msg;
+				}
+			} else if ((msg.tipo == CLUSTER_DECISAO) && !ehChefe && (msg.remetente == chefe)) {
+				decisao = msg;
+				temDecisao = true;
+			}
+		}
+
+		/*!
+			Método que indica se a tomada é chefe de um cluster.
+			\return Valor booleano que indica se a tomada é chefe.
+		*/
+		bool souChefe() {
+			return ehChefe;
+		}
+
+		/*!
+			Método que retorna o chefe do cluster da tomada.
+			\return Endereço do chefe.
+		*/
+		const Address getChefe() {
+			return chefe;
+		}
+
+		/*!
+			Método que retorna a quantidade de outros clusters ouvidos na época.
+			\return Quantidade de outros clusters.
+		*/
+		int getQuantidadeOutros() {
+			return quantidadeOutros;
+		}
+
+		/*!
+			Método que devolve a decisão resumida do sistema na época atual.
+			\param resumida recebe a decisão.
+			\param somas recebe as somas do sistema.
+			\param membros recebe a quantidade de tomadas no sistema.
+			\return Valor booleano que indica se uma decisão foi calculada ou recebida nesta época.
+		*/
+		bool obterDecisao(DecisaoResumida* resumida, Agregado* somas, int* membros) {
+			if (!temDecisao) {
+				return false;
+			}
+			*resumida = decisao.decisao;
+			*somas = decisao.somas;
+			*membros = decisao.membros;
+			return true;
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe CicloDeRadio
+/*!
+	Classe que controla quando o rádio fica ligado. Durante a sincronização ele fica sempre ligado.
+	Fora dela, com o ciclo ativo, ele só é ligado em janelas de escuta curtas, alinhadas ao relógio (todas as tomadas escutam nos mesmos instantes),
+	para receber comandos de configuração. Comandos a reenviar aguardam a próxima janela, então a latência de um comando fica limitada ao período entre janelas.
+*/
+class CicloDeRadio {
+	private:
+		Mensageiro* mensageiro; /*!< Objeto que provê a comunicação da placa com as outras.*/
+		bool ativo; /*!< Indica se o ciclo está ativo. Se não está, o rádio fica sempre ligado.*/
+		long long periodo; /*!< Intervalo entre as janelas de escuta, em microssegundos.*/
+		long long janela; /*!< Duração de cada janela de escuta, em microssegundos.*/
+		bool emSincronizacao; /*!< Indica se a placa está sincronizando.*/
+		bool escutando; /*!< Indica se a placa está em uma janela de escuta.*/
+		Dados pendentes[NUMERO_COMANDOS_PENDENTES]; /*!< Comandos que aguardam uma janela de escuta para serem reenviados.*/
+		int repeticoes[NUMERO_COMANDOS_PENDENTES]; /*!< Quantidade de janelas em que cada comando pendente ainda será reenviado. 0 indica posição livre.*/
+		bool medindo; /*!< Indica se o tempo com o rádio ligado está sendo medido desde o início de uma hora.*/
+		unsigned long long fimJanela; /*!< Fim da janela de escuta atual (ou da última), em microssegundos desde 01/01/2016.*/
+		unsigned long long proximaJanela; /*!< Início da próxima janela de escuta. 0 se ainda não foi calculado.*/
+
+		/*!
+			Método que reenvia os comandos pendentes, no início de uma janela de escuta.
+		*/
+		void enviarPendentes() {
+			for (int i = 0; i < NUMERO_COMANDOS_PENDENTES; i++) {
+				if (repeticoes[i] > 0) {
+					mensageiro->enviarBroadcast(pendentes[i]);
+					repeticoes[i]--;
+				}
+			}
+		}
+
+	public:
+		/*!
+			Método construtor da classe. O ciclo começa inativo (rádio sempre ligado).
+			\param m é o mensageiro cujo rádio é controlado.
+		*/
+		CicloDeRadio(Mensageiro* m) {
+			mensageiro = m;
+			ativo = false;
+			periodo = PERIODO_ESCUTA_PADRAO * 1000000LL;
+			janela = JANELA_ESCUTA_PADRAO * 1000LL;
+			emSincronizacao = false;
+			escutando = true;
+			medindo = false;
+			fimJanela = 0;
+			proximaJanela = 0;
+			for (int i = 0; i < NUMERO_COMANDOS_PENDENTES; i++) {
+				repeticoes[i] = 0;
+			}
+		}
+
+		/*!
+			Método que configura o ciclo. Janelas maiores e mais frequentes diminuem a latência dos comandos e aumentam o consumo do rádio.
+			\param periodoSegs é o intervalo entre janelas em segundos. 0 desativa o ciclo.
+			\param janelaMs é a duração de cada janela em milissegundos.
+		*/
+		void configurar(int periodoSegs, int janelaMs) {
+			if ((periodoSegs <= 0) || (janelaMs <= 0)) {
+				ativo = false;
+				mensageiro->ligarRadio();
+				return;
+			}
+			ativo = true;
+			periodo = periodoSegs * 1000000LL;
+			janela = janelaMs * 1000LL;
+			if (janela > periodo) {
+				janela = periodo;
+			}
+			fimJanela = 0;
+			proximaJanela = 0;
+		}
+
+		/*!
+			Método chamado ao iniciar a sincronização. O rádio fica ligado até terminarSincronizacao().
+		*/
+		void iniciarSincronizacao() {
+			emSincronizacao = true;
+			mensageiro->ligarRadio();
+		}
+
+		/*!
+			Método chamado ao terminar a sincronização.
+		*/
+		void terminarSincronizacao() {
+			emSincronizacao = false;
+		}
+
+		/*!
+			Método que liga ou desliga o rádio conforme o horário. Deve ser chamado a cada passagem do laço principal.
+			Enquanto o relógio não está sincronizado os horários das janelas não coincidem com os das outras tomadas, então o rádio fica ligado.
+			As janelas começam nos múltiplos do período desde 01/01/2016. O início da próxima janela é guardado, então fora das trocas só há comparações.
+			\param agora é o tempo atual em microssegundos desde 01/01/2016.
+			\param novaHora indica se uma hora acabou de começar (evento CALENDARIO_HORA).
+			\param relogioSincronizado indica se o relógio está sincronizado com a raiz.
+			\return Valor booleano que indica se uma janela de escuta acabou de começar.
+		*/
+		bool atualizar(unsigned long long agora, bool novaHora, bool relogioSincronizado) {
+			if (novaHora) { // Medição do tempo com o rádio ligado na última hora.
+				if (medindo) {
+					long long ligado = mensageiro->lerTempoLigado();
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_RADIO_LIGADO, (int) (ligado / 1000), (int) ((ligado * 100) / 3600000000LL));
+				}
+				mensageiro->zerarTempoLigado();
+				medindo = true;
+			}
+
+			if (!ativo || !relogioSincronizado) {
+				mensageiro->ligarRadio();
+				escutando = true;
+				return false;
+			}
+			if (emSincronizacao) {
+				return false;
+			}
+
+			if ((agora >= proximaJanela) || (agora + periodo < proximaJanela)) { // Começou outra janela, ou o relógio voltou.
+				unsigned long long inicio = agora - (agora % periodo);
+				fimJanela = inicio + janela;
+				proximaJanela = inicio + periodo;
+			}
+			bool naJanela = (agora < fimJanela);
+			if (naJanela && !escutando) {
+				mensageiro->ligarRadio();
+				escutando = true;
+				enviarPendentes();
+				return true;
+			} else if (!naJanela && (escutando || mensageiro->radioLigado())) {
+				mensageiro->desligarRadio();
+				escutando = false;
+			}
+			return false;
+		}
+
+		/*!
+			Método que verifica se as outras tomadas podem estar com o rádio desligado, isto é, se o ciclo está ativo e a tomada está fora da sincronização.
+			\return Valor booleano que indica se mensagens enviadas agora podem não ser ouvidas.
+		*/
+		bool outrasPodemEstarDesligadas() {
+			return ativo && !emSincronizacao;
+		}
+
+		/*!
+			Método que verifica se o rádio está ligado.
+			\return Valor booleano que indica se o rádio está ligado.
+		*/
+		bool radioLigado() {
+			return mensageiro->radioLigado();
+		}
+
+		/*!
+			Método que reenvia um comando de configuração às outras tomadas. Se elas podem estar com o rádio desligado, o comando aguarda as próximas janelas de escuta.
+			\param d é a mensagem com o comando.
+		*/
+		void enviarComando(const Dados& d) {
+			if (!ativo || emSincronizacao) {
+				mensageiro->enviarBroadcast(d);
+				return;
+			}
+			for (int i = 0; i < NUMERO_COMANDOS_PENDENTES; i++) {
+				if (repeticoes[i] == 0) {
+					pendentes[i] = d;
+					repeticoes[i] = REPETICOES_COMANDO;
+					return;
+				}
+			}
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_ERRO>(EVENTO_COMANDO_PENDENTE_DESCARTADO);
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe AdaptacaoDaSincronizacao
+/*!
+	Classe que escolhe, ao fim de cada sincronização, quantas épocas faltam até a próxima e quantas vezes os dados são enviados na janela.
+	O intervalo é a maior potência de 2 (entre os limites configurados) em que a variação esperada da previsão do sistema, com DESVIOS_FOLGA desvios padrão,
+	ainda cabe na folga até o limite mensal: longe do limite e com a previsão estável as sincronizações ficam raras; perto dele, ou com a previsão oscilando, frequentes.
+	A variação é medida pela diferença entre as previsões de duas sincronizações seguidas, por época, já que ela cresce com o tempo entre elas.
+	Cada tomada anuncia sua proposta no carimbo das mensagens da janela seguinte, e o intervalo só muda ao fim de uma janela em que alguma tomada do grupo foi ouvida:
+	ele passa a ser a menor das propostas anunciadas nessa janela. Assim as tomadas que se ouvem mudam juntas, na mesma sincronização, e nenhuma sai sozinha
+	da grade comum (um encurtamento espera uma sincronização para ser anunciado; o alerta de excesso continua imediato). Como as sincronizações ficam nos
+	múltiplos do intervalo, tomadas que ainda discordam se encontram nas do intervalo maior.
+	Os envios de dados do modo direto são numerados na janela (CarimboDeTempo::sequencia e CarimboDeTempo::envios). Quem recebe conta as mensagens que chegaram
+	e as que foram enviadas, e a taxa de entrega define a menor quantidade de envios que faz os dados chegarem com probabilidade ENTREGA_ALVO.
+	Nos outros modos de agregação as rodadas não são repetições e a quantidade de envios não muda.
+*/
+class AdaptacaoDaSincronizacao {
+	private:
+		int epocasMinimo; /*!< Menor intervalo permitido, em épocas (potência de 2).*/
+		int epocasMaximo; /*!< Maior intervalo permitido, em épocas (potência de 2, até EPOCAS_ENTRE_SINC_MAXIMO).*/
+		int repeticoesMinimo; /*!< Menor quantidade de envios por janela.*/
+		int repeticoesMaximo; /*!< Maior quantidade de envios por janela (até REPETICOES_SINC_MAXIMO).*/
+		int epocasEntreSincs; /*!< Intervalo combinado com as outras tomadas, usado pelo calendário.*/
+		int epocasPropostas; /*!< Intervalo proposto por esta tomada.*/
+		int menorProposta; /*!< Menor proposta ouvida das outras tomadas na janela atual, ou 0 se nenhuma foi ouvida.*/
+		int repeticoes; /*!< Quantidade de envios por janela.*/
+		int recebidas; /*!< Mensagens numeradas recebidas na janela atual.*/
+		int enviadas; /*!< Mensagens numeradas enviadas na janela atual pelas tomadas ouvidas.*/
+		float taxaEntrega; /*!< Média móvel da fração das mensagens numeradas que chegam, ou -1 antes da primeira medida.*/
+		float variancia; /*!< Média móvel da variância por época da previsão do sistema, em frações do limite ao quadrado, ou -1 antes da primeira medida.*/
+		float previsaoAnterior; /*!< Previsão do consumo do sistema no mês na última sincronização, ou -1.*/
+		unsigned long epocaAnterior; /*!< Época da última sincronização.*/
+
+		/*!
+			Método que retorna a maior potência de 2 que não passa de um valor, limitada a [1, EPOCAS_ENTRE_SINC_MAXIMO].
+			\param epocas é o valor.
+		*/
+		static int potenciaDe2(int epocas) {
+			int p = 1;
+			while ((p * 2 <= epocas) && (p * 2 <= EPOCAS_ENTRE_SINC_MAXIMO)) {
+				p *= 2;
+			}
+			return p;
+		}
+
+		/*!
+			Método que calcula a quantidade de envios pela taxa de entrega: a menor em que a chance de todos se perderem fica abaixo de 1 - ENTREGA_ALVO.
+		*/
+		void calcularRepeticoes() {
+			if (taxaEntrega < 0) {
+				repeticoes = repeticoesMaximo;
+				return;
+			}
+			float falha = 1 - taxaEntrega;
+			float todasPerdidas = falha;
+			repeticoes = 1;
+			while ((repeticoes < repeticoesMaximo) && ((repeticoes < repeticoesMinimo) || (todasPerdidas > 1 - ENTREGA_ALVO))) {
+				todasPerdidas *= falha;
+				repeticoes++;
+			}
+		}
+
+	public:
+		/*!
+			Método construtor da classe. Até as primeiras medidas, as sincronizações são a cada EPOCAS_ENTRE_SINC_PADRAO épocas, com REPETICOES_SINC_MAXIMO envios.
+		*/
+		AdaptacaoDaSincronizacao() {
+			epocasMinimo = 1;
+			epocasMaximo = EPOCAS_ENTRE_SINC_MAXIMO;
+			repeticoesMinimo = REPETICOES_SINC_MINIMO;
+			repeticoesMaximo = REPETICOES_SINC_MAXIMO;
+			epocasEntreSincs = EPOCAS_ENTRE_SINC_PADRAO;
+			epocasPropostas = EPOCAS_ENTRE_SINC_PADRAO;
+			repeticoes = REPETICOES_SINC_MAXIMO;
+			taxaEntrega = -1;
+			variancia = -1;
+			esquecerPrevisao();
+			iniciarJanela();
+		}
+
+		/*!
+			Método que altera os limites do intervalo entre sincronizações. Limites iguais desligam a adaptação do intervalo.
+			O intervalo combinado passa a respeitar os novos limites no fim da próxima sincronização, junto com as outras tomadas.
+			\param minimo é o menor intervalo, em épocas (arredondado para uma potência de 2).
+			\param maximo é o maior intervalo, em épocas (arredondado para uma potência de 2).
+		*/
+		void configurarIntervalo(int minimo, int maximo) {
+			epocasMinimo = potenciaDe2(minimo);
+			epocasMaximo = potenciaDe2(maximo);
+			if (epocasMaximo < epocasMinimo) {
+				epocasMaximo = epocasMinimo;
+			}
+			epocasPropostas = (epocasPropostas < epocasMinimo) ? epocasMinimo : ((epocasPropostas > epocasMaximo) ? epocasMaximo : epocasPropostas);
+		}
+
+		/*!
+			Método que altera os limites da quantidade de envios por janela. Limites iguais desligam a adaptação dos envios.
+			\param minimo é a menor quantidade de envios.
+			\param maximo é a maior quantidade de envios (até REPETICOES_SINC_MAXIMO).
+		*/
+		void configurarRepeticoes(int minimo, int maximo) {
+			repeticoesMaximo = (maximo < 1) ? 1 : ((maximo > REPETICOES_SINC_MAXIMO) ? REPETICOES_SINC_MAXIMO : maximo);
+			repeticoesMinimo = (minimo < 1) ? 1 : ((minimo > repeticoesMaximo) ? repeticoesMaximo : minimo);
+			calcularRepeticoes();
+		}
+
+		/*!
+			Método que descarta a última previsão, para que uma mudança que não é variação do consumo (novo mês, novo limite) não encurte o intervalo.
+		*/
+		void esquecerPrevisao() {
+			previsaoAnterior = -1;
+			epocaAnterior = 0;
+		}
+
+		/*!
+			Método que começa a contagem de uma janela de sincronização.
+		*/
+		void iniciarJanela() {
+			menorProposta = 0;
+			recebidas = 0;
+			enviadas = 0;
+		}
+
+		/*!
+			Método que registra a proposta de intervalo de uma mensagem recebida de uma tomada do grupo durante a janela, em qualquer modo de agregação.
+			\param carimbo é o carimbo da mensagem.
+		*/
+		void ouvirProposta(const CarimboDeTempo& carimbo) {
+			if ((carimbo.epocasPropostas > 0) && ((menorProposta == 0) || (carimbo.epocasPropostas < menorProposta))) {
+				menorProposta = carimbo.epocasPropostas;
+			}
+		}
+
+		/*!
+			Método que registra uma mensagem de dados numerada recebida de uma tomada do grupo durante a janela.
+			\param carimbo é o carimbo da mensagem.
+			\param ultimoNaJanela é o número do último envio já recebido desta tomada na janela, ou 0.
+			\return Valor booleano que indica se a mensagem é nova (não é a repetição de um envio já recebido).
+		*/
+		bool ouvir(const CarimboDeTempo& carimbo, int ultimoNaJanela) {
+			if ((carimbo.sequencia == 0) || (carimbo.sequencia > carimbo.envios)) { // Mensagem sem numeração.
+				return true;
+			}
+			if (carimbo.sequencia <= ultimoNaJanela) {
+				return false;
+			}
+			if (ultimoNaJanela == 0) { // Primeira mensagem da tomada na janela: todos os seus envios passam a ser esperados.
+				enviadas += carimbo.envios;
+			}
+			recebidas++;
+			return true;
+		}
+
+		/*!
+			Método que, ao fim da sincronização, mede a janela e escolhe o intervalo até a próxima e os envios por janela.
+			\param previsao é a previsão do consumo do sistema no mês (consumo até agora mais o previsto).
+			\param maximo é o limite mensal.
+			\param epoca é a época da sincronização.
+			\return Épocas até a próxima sincronização.
+		*/
+		int decidir(float previsao, float maximo, unsigned long epoca) {
+			int anunciada = epocasPropostas; // Proposta enviada nesta janela, que as outras tomadas também ouviram.
+			if (enviadas > 0) {
+				float medida = (recebidas >= enviadas) ? 1.0f : ((float) recebidas / enviadas);
+				taxaEntrega = (taxaEntrega < 0) ? medida : (taxaEntrega + PESO_TAXA_ENTREGA * (medida - taxaEntrega));
+			}
+			calcularRepeticoes();
+
+			if ((maximo > 0) && (previsaoAnterior >= 0) && (epoca > epocaAnterior)) {
+				float variacao = (previsao - previsaoAnterior) / maximo;
+				float porEpoca = (variacao * variacao) / (epoca - epocaAnterior);
+				variancia = (variancia < 0) ? porEpoca : (variancia + PESO_VARIACAO_PREVISAO * (porEpoca - variancia));
+			}
+			previsaoAnterior = previsao;
+			epocaAnterior = epoca;
+
+			float folga = (maximo > 0) ? ((maximo - previsao) / maximo) : 0;
+			if (variancia < 0) { // Sem medida ainda: o intervalo padrão, se a previsão está dentro do limite.
+				epocasPropostas = (folga > 0) ? EPOCAS_ENTRE_SINC_PADRAO : epocasMinimo;
+			} else {
+				epocasPropostas = epocasMinimo;
+				while ((folga > 0) && (epocasPropostas * 2 <= epocasMaximo)
+						&& (DESVIOS_FOLGA * DESVIOS_FOLGA * variancia * (epocasPropostas * 2) <= folga * folga)) {
+					epocasPropostas *= 2;
+				}
+			}
+			epocasPropostas = (epocasPropostas < epocasMinimo) ? epocasMinimo : ((epocasPropostas > epocasMaximo) ? epocasMaximo : epocasPropostas);
+
+			// A nova proposta só vale depois de anunciada. Sem nenhuma tomada ouvida, o intervalo fica como está.
+			if (menorProposta > 0) {
+				int combinado = potenciaDe2((menorProposta < anunciada) ? menorProposta : anunciada);
+				epocasEntreSincs = (combinado < epocasMinimo) ? epocasMinimo : ((combinado > epocasMaximo) ? epocasMaximo : combinado);
+			}
+			return epocasEntreSincs;
+		}
+
+		/*!
+			Método que retorna o intervalo combinado entre sincronizações.
+			\return Quantidade de épocas.
+		*/
+		int getEpocasEntreSincs() {
+			return epocasEntreSincs;
+		}
+
+		/*!
+			Método que retorna o intervalo proposto por esta tomada.
+			\return Quantidade de épocas.
+		*/
+		int getEpocasPropostas() {
+			return epocasPropostas;
+		}
+
+		/*!
+			Método que retorna a quantidade de envios por janela no modo direto.
+		*/
+		int getRepeticoes() {
+			return repeticoes;
+		}
+
+		/*!
+			Método que retorna a taxa de entrega medida.
+			\return Porcentagem das mensagens numeradas que chegam, ou -1 antes da primeira medida.
+		*/
+		int getTaxaEntrega() {
+			return (taxaEntrega < 0) ? -1 : (int) (taxaEntrega * 100 + 0.5f);
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe Alerta
+/*!
+	Classe que envia e recebe os alertas de excesso. Cada alerta é tratado e repassado uma única vez por tomada,
+	de forma que alcança tomadas fora do alcance da origem sem esperar a próxima sincronização.
+	Também mede o tempo entre a detecção na origem e a reação de cada tomada, usando os relógios sincronizados.
+*/
+class Alerta {
+	private:
+		Mensageiro* mensageiro; /*!< Objeto que provê a comunicação da placa com as outras.*/
+		CicloDeRadio* cicloRadio; /*!< Ciclo do rádio, consultado para saber se o alerta deve ser repetido.*/
+		Address proprio; /*!< Endereço da própria tomada.*/
+		unsigned long proximaSequencia; /*!< Sequência do próximo alerta da própria tomada.*/
+		Address origensVistas[NUMERO_ALERTAS_LEMBRADOS]; /*!< Origens dos alertas recentes.*/
+		unsigned long sequenciasVistas[NUMERO_ALERTAS_LEMBRADOS]; /*!< Sequências dos alertas recentes.*/
+		int quantidadeVistos; /*!< Quantidade de entradas válidas em origensVistas.*/
+		int proximoVisto; /*!< Posição substituída quando a lista de alertas recentes está cheia.*/
+		MensagemAlerta ultimoProprio; /*!< Último alerta da própria tomada, repetido nas próximas janelas de escuta.*/
+		int repeticoes; /*!< Quantidade de repetições restantes do último alerta próprio.*/
+		EstatisticaLatencia latencias; /*!< Tempo entre a detecção na origem e a reação da tomada.*/
+
+		/*!
+			Método que verifica se um alerta já foi visto e, se não foi, o lembra.
+			\return Valor booleano que indica se o alerta é novo.
+		*/
+		bool lembrar(const MensagemAlerta& alerta) {
+			for (int i = 0; i < quantidadeVistos; i++) {
+				if ((origensVistas[i] == alerta.origem) && (sequenciasVistas[i] == alerta.sequencia)) {
+					return false;
+				}
+			}
+			origensVistas[proximoVisto] = alerta.origem;
+			sequenciasVistas[proximoVisto] = alerta.sequencia;
+			proximoVisto = (proximoVisto + 1) % NUMERO_ALERTAS_LEMBRADOS;
+			if (quantidadeVistos < NUMERO_ALERTAS_LEMBRADOS) {
+				quantidadeVistos++;
+			}
+			return true;
+		}
+
+	public:
+		/*!
+			Método construtor da classe.
+			\param m é o mensageiro usado nos envios.
+			\param c é o ciclo do rádio.
+		*/
+		Alerta(Mensageiro* m, CicloDeRadio* c) {
+			mensageiro = m;
+			cicloRadio = c;
+			proprio = mensageiro->obterEnderecoNIC();
+			proximaSequencia = 0;
+			quantidadeVistos = 0;
+			proximoVisto = 0;
+			repeticoes = 0;
+		}
+
+		/*!
+			Método que envia um alerta da própria tomada. Os campos origem e sequencia são preenchidos aqui.
+			\param alerta é o alerta a enviar.
+		*/
+		void enviar(MensagemAlerta* alerta) {
+			alerta->origem = proprio;
+			alerta->sequencia = proximaSequencia++;
+			lembrar(*alerta);
+			mensageiro->enviar(mensageiro->obterBroadcast(), PROTOCOLO_ALERTA, alerta, sizeof *alerta);
+
+			// Se as outras tomadas podem estar com o rádio desligado, o alerta é repetido nas próximas janelas de escuta.
+			ultimoProprio = *alerta;
+			repeticoes = cicloRadio->outrasPodemEstarDesligadas() ? REPETICOES_ALERTA : 0;
+		}
+
+		/*!
+			Método que trata um alerta recebido. Alertas novos são repassados às outras tomadas.
+			\param alerta é o alerta recebido.
+			\return Valor booleano que indica se o alerta é novo e a decisão deve ser refeita.
+		*/
+		bool receber(const MensagemAlerta& alerta) {
+			if ((alerta.origem == proprio) || !lembrar(alerta)) {
+				return false;
+			}
+			mensageiro->enviar(mensageiro->obterBroadcast(), PROTOCOLO_ALERTA, &alerta, sizeof alerta);
+			return true;
+		}
+
+		/*!
+			Método chamado quando uma janela de escuta começa. Repete o último alerta próprio, se necessário.
+		*/
+		void janelaAberta() {
+			if (repeticoes > 0) {
+				mensageiro->enviar(mensageiro->obterBroadcast(), PROTOCOLO_ALERTA, &ultimoProprio, sizeof ultimoProprio);
+				repeticoes--;
+			}
+		}
+
+		/*!
+			Método que registra o tempo entre a detecção do excesso na origem e a reação da tomada.
+			\param alerta é o alerta ao qual a tomada reagiu.
+			\param agora é o tempo da tomada ao terminar a reação.
+		*/
+		void registrarReacao(const MensagemAlerta& alerta, long long agora) {
+			long long latencia = agora - alerta.instanteDeteccao;
+			latencias.registrar(latencia);
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_REACAO_ALERTA, RegistroDeEventos::endereco(alerta.origem), (int) latencia,
+				latencias.getQuantidade(), latencias.getMedia(), latencias.getMaxima());
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Classe ConsultaDeHistorico
+/*!
+	Classe que consulta, a pedido do usuário, um trecho do histórico de um soquete de outra placa. Os dados detalhados só trafegam quando alguém pede.
+	Cada pedido é respondido com até VALORES_POR_QUADRO_HISTORICO entradas, e o próximo pedido parte da primeira entrada que ainda falta.
+	Um pedido ou uma resposta perdidos só atrasam a consulta: depois de TEMPO_REENVIO_HISTORICO o pedido é repetido do mesmo ponto.
+	As entradas recebidas vão para o registro de eventos (e, por ele, para o computador).
+*/
+class ConsultaDeHistorico {
+	private:
+		Mensageiro* mensageiro; /*!< Objeto que provê a comunicação da placa com as outras.*/
+		CicloDeRadio* cicloRadio; /*!< Ciclo do rádio, consultado para só pedir quando a resposta pode ser ouvida.*/
+		bool ativa; /*!< Indica se há uma consulta em andamento.*/
+		Address alvo; /*!< Placa consultada.*/
+		int camada; /*!< Camada consultada.*/
+		int soquete; /*!< Soquete consultado.*/
+		unsigned short consulta; /*!< Número da consulta atual, repetido nas respostas.*/
+		unsigned long proximo; /*!< Índice absoluto da primeira entrada que ainda falta.*/
+		unsigned long fim; /*!< Índice absoluto seguinte à última entrada pedida. Sem quantidade no comando, vale o total informado na primeira resposta.*/
+		bool fimConhecido; /*!< Indica se fim já é conhecido.*/
+		unsigned long recebidas; /*!< Entradas recebidas na consulta atual.*/
+		unsigned long perdidas; /*!< Entradas pedidas que já tinham saído do anel do alvo.*/
+		int tentativas; /*!< Pedidos seguidos sem resposta.*/
+		long long ultimoPedido; /*!< Tempo (microssegundos desde 01/01/2016) do último pedido.*/
+
+		/*!
+			Método que pede ao alvo as entradas a partir de proximo.
+			\param agora é o tempo atual.
+		*/
+		void pedir(long long agora) {
+			MensagemHistorico pedido;
+			memset(&pedido, 0, sizeof pedido);
+			pedido.remetente = mensageiro->obterEnderecoNIC();
+			pedido.tipo = HISTORICO_PEDIDO;
+			pedido.camada = (unsigned char) camada;
+			pedido.soquete = (signed char) soquete;
+			pedido.quantidade = (!fimConhecido || (fim - proximo > 255)) ? 255 : (unsigned char) (fim - proximo);
+			pedido.consulta = consulta;
+			pedido.primeiro = proximo;
+			pedido.total = 0;
+			mensageiro->enviar(alvo, PROTOCOLO_HISTORICO, &pedido, sizeof pedido);
+			ultimoPedido = agora;
+			tentativas++;
+		}
+
+		/*!
+			Método que encerra a consulta atual.
+		*/
+		void concluir() {
+			ativa = false;
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_CONSULTA_HISTORICO_CONCLUIDA, RegistroDeEventos::endereco(alvo), (int) recebidas, (int) perdidas);
+		}
+
+	public:
+		/*!
+			Método construtor da classe.
+			\param m é o mensageiro usado nos envios.
+			\param c é o ciclo do rádio.
+		*/
+		ConsultaDeHistorico(Mensageiro* m, CicloDeRadio* c) {
+			mensageiro = m;
+			cicloRadio = c;
+			ativa = false;
+			camada = CAMADA_PERIODOS;
+			soquete = 0;
+			consulta = 0;
+			proximo = 0;
+			fim = 0;
+			fimConhecido = false;
+			recebidas = 0;
+			perdidas = 0;
+			tentativas = 0;
+			ultimoPedido = 0;
+		}
+
+		/*!
+			Método que começa uma consulta, abandonando a anterior. O primeiro pedido é enviado assim que o rádio estiver ligado.
+			\param a é a placa consultada.
+			\param c é a camada (CAMADA_PERIODOS, CAMADA_HORAS ou CAMADA_DIAS).
+			\param s é o soquete.
+			\param primeiro é o índice absoluto da primeira entrada. Entradas que já saíram do anel são puladas; 0 pede desde a mais antiga.
+			\param quantidade é a quantidade de entradas, ou 0 para todas até a mais recente.
+		*/
+		void iniciar(const Address& a, int c, int s, unsigned long primeiro, unsigned long quantidade) {
+			ativa = true;
+			alvo = a;
+			camada = c;
+			soquete = s;
+			consulta++;
+			proximo = primeiro;
+			fim = primeiro + quantidade;
+			fimConhecido = (quantidade > 0);
+			recebidas = 0;
+			perdidas = 0;
+			tentativas = 0;
+			ultimoPedido = 0;
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_CONSULTA_HISTORICO, RegistroDeEventos::endereco(alvo), soquete, camada, (int) primeiro);
+		}
+
+		/*!
+			Método que trata uma resposta recebida. Respostas repetidas ou de consultas antigas são ignoradas.
+			Respostas com mais entradas do que cabem no quadro ou que passam de total são descartadas, para que um quadro corrompido não encerre a consulta antes do fim.
+			\param resposta é a resposta recebida.
+			\param agora é o tempo atual.
+		*/
+		void receber(const MensagemHistorico& resposta, long long agora) {
+			if (!ativa || (resposta.consulta != consulta) || !(resposta.remetente == alvo)) {
+				return;
+			}
+			if ((resposta.quantidade > VALORES_POR_QUADRO_HISTORICO) || (resposta.total < resposta.primeiro)
+					|| (resposta.quantidade > resposta.total - resposta.primeiro)) {
+				RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_COMANDO_INVALIDO);
+				return;
+			}
+			if ((resposta.quantidade > 0) && (resposta.primeiro + resposta.quantidade <= proximo)) {
+				return;
+			}
+			if (!fimConhecido) {
+				fim = resposta.total;
+				fimConhecido = true;
+			}
+			if (resposta.primeiro > proximo) {
+				perdidas += resposta.primeiro - proximo;
+				proximo = resposta.primeiro;
+			}
+			for (int i = proximo - resposta.primeiro; (i < resposta.quantidade) && (proximo < fim); i++) {
+				RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_ENTRADA_HISTORICO, RegistroDeEventos::endereco(alvo), soquete, camada, (int) proximo,
+					RegistroDeEventos::real(resposta.valores[i]));
+				proximo++;
+				recebidas++;
+			}
+			tentativas = 0;
+			if ((resposta.quantidade == 0) || (proximo >= fim)) {
+				concluir();
+			} else {
+				pedir(agora);
+			}
+		}
+
+		/*!
+			Método chamado a cada volta da tarefa de decisão. Envia o primeiro pedido e repete o último quando a resposta demora.
+			\param agora é o tempo atual.
+			\return Valor booleano que indica se um pedido foi enviado ou a consulta foi abandonada.
+		*/
+		bool verificar(long long agora) {
+			if (!ativa || !cicloRadio->radioLigado()) {
+				return false;
+			}
+			long long decorrido = agora - ultimoPedido;
+			if ((tentativas > 0) && (decorrido >= 0) && (decorrido < TEMPO_REENVIO_HISTORICO * 1000LL)) {
+				return false;
+			}
+			if (tentativas >= TENTATIVAS_HISTORICO) {
+				ativa = false;
+				RegistroDeEventos::registrar<NIVEL_REGISTRO_ERRO>(EVENTO_CONSULTA_HISTORICO_ABANDONADA, RegistroDeEventos::endereco(alvo), camada, soquete, (int) proximo);
+				return true;
+			}
+			pedir(agora);
+			return true;
+		}
+};
+
+//----------------------------------------------------------------------------
+//!  Struct Telemetria
+/*!
+	Dados de um soquete (próprio ou de outra placa) encaminhados ao computador pelo GatewayUSB.
+*/
+struct Telemetria {
+	long long tempo; /*!< Tempo do gateway (microssegundos desde 01/01/2016) quando os dados foram recebidos ou enviados. */
+	Address remetente; /*!< Placa a que os dados se referem. */
+	int soquete; /*!< Soquete da placa. */
+	unsigned int epoca; /*!< Época em que os dados foram enviados. */
+	float consumoPrevisto; /*!< Consumo previsto do soquete até o fim do mês. */
+	float ultimoConsumo; /*!< Consumo do soquete desde a última sincronização. */
+	float consumoMensal; /*!< Consumo do sistema no mês, segundo o remetente. */
+	float maximoConsumoMensal; /*!< Consumo máximo mensal configurado no remetente. */
+	signed char prioridade; /*!< Prioridade do soquete, limitada a 127 como na MensagemRegua. */
+	unsigned char indicadores; /*!< TELEMETRIA_PODE_DESLIGAR, TELEMETRIA_TEM_DIMMER e TELEMETRIA_PROPRIA. */
+	unsigned char grupo; /*!< Grupo de orçamento da placa. */
+};
+
+//----------------------------------------------------------------------------
+//!  Classe GatewayUSB
+/*!
+	Classe que, quando ativa, encaminha ao computador por USB os dados de todas as tomadas ouvidas e os próprios, um quadro por soquete.
+	Cada quadro é [INICIO_QUADRO_TELEMETRIA][tamanho][tempo, remetente, soquete, época, consumos, prioridade, indicadores e grupo em little-endian][xor de tamanho e dados].
+	O coletor no computador (coletorTelemetria.cc) grava os quadros em um arquivo e repassa o resto da saída.
+	A tarefa de decisão enfileira os dados e a SaidaUSB monta os quadros na interrupção do leitor USB. Com a fila cheia, os dados são descartados e contados.
+*/
+class GatewayUSB {
+	private:
+		static GatewayUSB* instancia; /*!< Gateway usado pela interrupção, que não recebe parâmetros.*/
+		FilaSPSC<Telemetria, TAMANHO_FILA_TELEMETRIA> fila; /*!< Dados a encaminhar, da tarefa de decisão para a interrupção.*/
+		bool ativo; /*!< Indica se os dados são encaminhados.*/
+
+		/*!
+			Método que escreve um valor em little-endian no quadro e atualiza a verificação.
+		*/
+		static void escrever(unsigned char* quadro, int* tamanho, unsigned char* verificacao, unsigned long long valor, int bytes) {
+			for (int b = 0; b < bytes; b++) {
+				quadro[*tamanho] = (unsigned char) (valor >> (8 * b));
+				*verificacao ^= quadro[(*tamanho)++];
+			}
+		}
+
+		/*!
+			Método que enfileira dados a encaminhar, se o gateway estiver ativo.
+		*/
+		void enfileirar(const Telemetria& t) {
+			if (ativo) {
+				fila.inserir(t);
+			}
+		}
+
+	public:
+		enum {
+			TAMANHO_DADOS = 8 + 4 + 1 + 4 + 4 * 4 + 1 + 1 + 1, /*!< Bytes dos dados de um quadro. */
+			TAMANHO_MAXIMO_QUADRO = TAMANHO_DADOS + 3 /*!< Bytes de um quadro. */
+		};
+
+		/*!
+			Método construtor da classe. O gateway começa inativo.
+		*/
+		GatewayUSB() {
+			instancia = this;
+			ativo = false;
+		}
+
+		/*!
+			Método que ativa ou desativa o encaminhamento.
+		*/
+		void setAtivo(bool valor) {
+			ativo = valor;
+		}
+
+		/*!
+			Método que retorna se o gateway está ativo.
+		*/
+		bool getAtivo() {
+			return ativo;
+		}
+
+		/*!
+			Método que encaminha os dados de um soquete recebidos (ou enviados) em uma mensagem PROTOCOLO_DADOS.
+			\param d são os dados.
+			\param tempo é o tempo do gateway.
+			\param propria indica se os dados são da própria placa.
+		*/
+		void encaminhar(const Dados& d, long long tempo, bool propria) {
+			Telemetria t;
+			t.tempo = tempo;
+			t.remetente = d.remetente;
+			t.soquete = d.soquete;
+			t.epoca = d.epoca;
+			t.consumoPrevisto = d.consumoPrevisto;
+			t.ultimoConsumo = d.ultimoConsumo;
+			t.consumoMensal = d.consumoMensal;
+			t.maximoConsumoMensal = d.maximoConsumoMensal;
+			t.prioridade = (d.prioridade > 127) ? 127 : d.prioridade;
+			t.indicadores = (d.podeDesligar ? TELEMETRIA_PODE_DESLIGAR : 0) | (d.temDimmer ? TELEMETRIA_TEM_DIMMER : 0) | (propria ? TELEMETRIA_PROPRIA : 0);
+			t.grupo = d.carimbo.grupo;
+			enfileirar(t);
+		}
+
+		/*!
+			Método que encaminha os dados de todos os soquetes de uma mensagem PROTOCOLO_REGUA.
+			\param msg é a mensagem.
+			\param tempo é o tempo do gateway.
+		*/
+		void encaminhar(const MensagemRegua& msg, long long tempo) {
+			int quantidade = (msg.quantidade > NUMERO_MAXIMO_SOQUETES) ? NUMERO_MAXIMO_SOQUETES : msg.quantidade;
+			for (int k = 0; k < quantidade; k++) {
+				Telemetria t;
+				t.tempo = tempo;
+				t.remetente = msg.remetente;
+				t.soquete = k;
+				t.epoca = msg.epoca;
+				t.consumoPrevisto = msg.consumoPrevisto[k];
+				t.ultimoConsumo = msg.ultimoConsumo[k];
+				t.consumoMensal = msg.consumoMensal;
+				t.maximoConsumoMensal = msg.maximoConsumoMensal;
+				t.prioridade = msg.prioridade[k];
+				t.indicadores = (((msg.podeDesligar >> k) & 1) ? TELEMETRIA_PODE_DESLIGAR : 0) | (((msg.temDimmer >> k) & 1) ? TELEMETRIA_TEM_DIMMER : 0);
+				t.grupo = msg.carimbo.grupo;
+				enfileirar(t);
+			}
+		}
+
+		/*!
+			Método que retorna a quantidade de dados descartados com a fila cheia.
+		*/
+		unsigned int getDescartados() {
+			return fila.getDescartados();
+		}
+
+		/*!
+			Método que monta o quadro dos próximos dados a encaminhar. Chamado apenas pela SaidaUSB, na interrupção do leitor USB.
+			\param quadro recebe o quadro, com espaço para TAMANHO_MAXIMO_QUADRO bytes.
+			\return Tamanho do quadro em bytes, ou 0 se não há quadro a enviar.
+		*/
+		static int proximoQuadro(unsigned char* quadro) {
+			Telemetria t;
+			if ((instancia == 0) || !instancia->fila.retirar(&t)) {
+				return 0;
+			}
+			unsigned char verificacao = TAMANHO_DADOS;
+			int tamanho = 0;
+			quadro[tamanho++] = INICIO_QUADRO_TELEMETRIA;
+			quadro[tamanho++] = TAMANHO_DADOS;
+			escrever(quadro, &tamanho, &verificacao, (unsigned long long) t.tempo, 8);
+			escrever(quadro, &tamanho, &verificacao, (unsigned int) RegistroDeEventos::endereco(t.remetente), 4);
+			escrever(quadro, &tamanho, &verificacao, (unsigned char) t.soquete, 1);
+			escrever(quadro, &tamanho, &verificacao, t.epoca, 4);
+			escrever(quadro, &tamanho, &verificacao, (unsigned int) RegistroDeEventos::real(t.consumoPrevisto), 4);
+			escrever(quadro, &tamanho, &verificacao, (unsigned int) RegistroDeEventos::real(t.ultimoConsumo), 4);
+			escrever(quadro, &tamanho, &verificacao, (unsigned int) RegistroDeEventos::real(t.consumoMensal), 4);
+			escrever(quadro, &tamanho, &verificacao, (unsigned int) RegistroDeEventos::real(t.maximoConsumoMensal), 4);
+			escrever(quadro, &tamanho, &verificacao, (unsigned char) t.prioridade, 1);
+			escrever(quadro, &tamanho, &verificacao, t.indicadores, 1);
+			escrever(quadro, &tamanho, &verificacao, t.grupo, 1);
+			quadro[tamanho++] = verificacao;
+			return tamanho;
+		}
+};
+
+GatewayUSB* GatewayUSB::instancia = 0;
+
+//----------------------------------------------------------------------------
+//!  Classe SaidaUSB
+/*!
+	Classe que envia ao USB, sem bloquear, os quadros do RegistroDeEventos, do GatewayUSB e da CapturaDeTrafego, alternando entre eles.
+	Só envia bytes enquanto o USB os aceita e continua o quadro interrompido na próxima chamada, então os quadros nunca se misturam.
+*/
+class SaidaUSB {
+	private:
+		// Os tamanhos vêm de enums diferentes, então são comparados como int.
+		enum {
+			TAMANHO_REGISTRO_GATEWAY = ((int) RegistroDeEventos::TAMANHO_MAXIMO_QUADRO > (int) GatewayUSB::TAMANHO_MAXIMO_QUADRO) ?
+				(int) RegistroDeEventos::TAMANHO_MAXIMO_QUADRO : (int) GatewayUSB::TAMANHO_MAXIMO_QUADRO, /*!< Espaço do maior quadro do registro e do gateway. */
+			TAMANHO_QUADRO = ((int) TAMANHO_REGISTRO_GATEWAY > (int) CapturaDeTrafego::TAMANHO_MAXIMO_QUADRO) ?
+				(int) TAMANHO_REGISTRO_GATEWAY : (int) CapturaDeTrafego::TAMANHO_MAXIMO_QUADRO, /*!< Espaço do maior quadro. */
+			FONTES = 3 /*!< Quantidade de fontes de quadros. */
+		};
+
+		static unsigned char quadro[TAMANHO_QUADRO]; /*!< Quadro sendo enviado.*/
+		static int tamanho; /*!< Quantidade de bytes do quadro sendo enviado.*/
+		static int enviados; /*!< Quantidade de bytes do quadro já enviados.*/
+		static int vez; /*!< Fonte a que o próximo quadro é pedido primeiro: 0 é o registro, 1 o gateway e 2 a captura.*/
+
+		/*!
+			Método que pede o próximo quadro a uma fonte.
+			\param fonte é a fonte (0 a FONTES - 1).
+			\return Quantidade de bytes do quadro, ou 0 se a fonte não tem quadros.
+		*/
+		static int quadroDaFonte(int fonte) {
+			if (fonte == 0) {
+				return RegistroDeEventos::proximoQuadro(quadro);
+			} else if (fonte == 1) {
+				return GatewayUSB::proximoQuadro(quadro);
+			}
+			return CapturaDeTrafego::proximoQuadro(quadro);
+		}
+
+		/*!
+			Método que prepara o próximo quadro, pedindo primeiro à fonte da vez e depois às outras.
+			\return Valor booleano que indica se há um quadro a enviar.
+		*/
+		static bool proximoQuadro() {
+			tamanho = 0;
+			for (int i = 0; (i < FONTES) && (tamanho == 0); i++) {
+				tamanho = quadroDaFonte((vez + i) % FONTES);
+			}
+			vez = (vez + 1) % FONTES;
+			enviados = 0;
+			return tamanho > 0;
+		}
+
+	public:
+		/*!
+			Método que envia ao USB os bytes dos quadros pendentes enquanto o USB os aceita. Chamado apenas pela interrupção do leitor USB.
+		*/
+		static void escoar() {
+			while (USB::ready_to_put()) {
+				if ((enviados == tamanho) && !proximoQuadro()) {
+					return;
+				}
+				USB::put(quadro[enviados++]);
+			}
+		}
+};
+
+unsigned char SaidaUSB::quadro[SaidaUSB::TAMANHO_QUADRO];
+int SaidaUSB::tamanho = 0;
+int SaidaUSB::enviados = 0;
+int SaidaUSB::vez = 0;
+
+//----------------------------------------------------------------------------
+//!  Classe LeitorUSB
+/*!
+	Classe que recebe os comandos de configuração enviados por USB, um por linha.
+	Uma interrupção periódica (alarme) move os bytes disponíveis no USB para um buffer circular e sinaliza um semáforo a cada fim de linha,
+	então a tarefa de comandos fica bloqueada até haver uma linha completa. Bytes que não cabem no buffer são descartados e contados.
+	A mesma interrupção envia ao USB os quadros pendentes (SaidaUSB).
+	Na reprodução de tráfego (REPRODUCAO_TRAFEGO), o USB traz quadros de uma captura: os bytes são guardados como chegam, sem linhas,
+	e só são retirados do USB enquanto cabem no buffer, então o computador espera em vez de perdê-los.
+*/
+class LeitorUSB {
+	private:
+		static LeitorUSB* instancia; /*!< Leitor usado pela interrupção, que não recebe parâmetros.*/
+		FilaSPSC<char, TAMANHO_BUFFER_USB> bytes; /*!< Bytes recebidos, da interrupção para a tarefa de comandos.*/
+		Semaphore* linhasCompletas; /*!< Quantidade de fins de linha no buffer.*/
+		Estatico<Semaphore> memoriaSemaforo; /*!< Espaço do semáforo.*/
+		Function_Handler* tratador; /*!< Tratador do alarme.*/
+		Estatico<Function_Handler> memoriaTratador; /*!< Espaço do tratador.*/
+		Alarm* alarme; /*!< Alarme que lê o USB a cada PERIODO_LEITURA_USB.*/
+		Estatico<Alarm> memoriaAlarme; /*!< Espaço do alarme.*/
+		unsigned int linhasTruncadas; /*!< Quantidade de linhas maiores que o espaço de um comando.*/
+
+		/*!
+			Método executado na interrupção do alarme: move para o buffer todos os bytes disponíveis no USB e escoa a saída.
+		*/
+		static void tratarInterrupcao() {
+			LeitorUSB* leitor = instancia;
+			if (REPRODUCAO_TRAFEGO) {
+				while (!leitor->bytes.cheia() && USB::ready_to_get()) {
+					leitor->bytes.inserir(USB::get());
+				}
+				SaidaUSB::escoar();
+				return;
+			}
+			while (USB::ready_to_get()) {
+				char c = USB::get();
+				if (c == '\r') { // Aceita fins de linha "\r", "\n" e "\r\n" (as linhas vazias são ignoradas).
+					c = '\n';
+				}
+				if (leitor->bytes.inserir(c) && (c == '\n')) {
+					leitor->linhasCompletas->v();
+				}
+			}
+			SaidaUSB::escoar();
+		}
+
+	public:
+		/*!
+			Método construtor da classe. Inicia as leituras periódicas do USB.
+		*/
+		LeitorUSB() {
+			instancia = this;
+			linhasTruncadas = 0;
+			linhasCompletas = memoriaSemaforo.construir(0);
+			tratador = memoriaTratador.construir(&LeitorUSB::tratarInterrupcao);
+			alarme = memoriaAlarme.construir(PERIODO_LEITURA_USB, tratador, (int) Alarm::INFINITE);
+		}
+
+		/*!
+			Método que espera uma linha completa e a copia, sem o fim de linha. O que não couber é descartado.
+			\param linha recebe a linha, terminada em '\0'.
+			\param tamanho é o espaço disponível em linha, incluindo o '\0'.
+			\return Valor booleano que indica se a linha tem algum caractere.
+		*/
+		bool lerLinha(char* linha, int tamanho) {
+			linhasCompletas->p();
+
+			int quantidade = 0;
+			bool truncada = false;
+			char c;
+			while (bytes.retirar(&c) && (c != '\n')) {
+				if (quantidade < tamanho - 1) {
+					linha[quantidade++] = c;
+				} else {
+					truncada = true;
+				}
+			}
+			linha[quantidade] = '\0';
+			if (truncada) {
+				linhasTruncadas++;
+				RegistroDeEventos::registrar<NIVEL_REGISTRO_ERRO>(EVENTO_COMANDO_TRUNCADO, tamanho - 1);
+			}
+			return quantidade > 0;
+		}
+
+		/*!
+			Método que espera e retira um byte de uma captura. Antes da construção do leitor, lê o USB diretamente.
+			\return Byte lido.
+		*/
+		static unsigned char lerByte() {
+			if (instancia == 0) {
+				while (!USB::ready_to_get()) {
+				}
+				return (unsigned char) USB::get();
+			}
+			char c;
+			while (!instancia->bytes.retirar(&c)) {
+				Thread::yield();
+			}
+			return (unsigned char) c;
+		}
+
+		/*!
+			Método que lê o próximo quadro de uma captura ([INICIO_QUADRO_CAPTURA][tipo][tamanho][dados][verificação]), descartando os bytes antes do início.
+			\param tipo recebe o tipo do registro.
+			\param dados recebe os dados (até 255 bytes).
+			\return Quantidade de bytes dos dados, ou -1 se a verificação falhou.
+		*/
+		static int lerQuadroCapturado(unsigned char* tipo, unsigned char* dados) {
+			while (lerByte() != INICIO_QUADRO_CAPTURA) {
+			}
+			*tipo = lerByte();
+			int tamanho = lerByte();
+			unsigned char verificacao = (unsigned char) (*tipo ^ tamanho);
+			for (int i = 0; i < tamanho; i++) {
+				dados[i] = lerByte();
+				verificacao ^= dados[i];
+			}
+			return (lerByte() == verificacao) ? tamanho : -1;
+		}
+
+		/*!
+			Método que registra a quantidade de bytes perdidos com o buffer cheio e de linhas truncadas.
+		*/
+		void registrarDescartes() {
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_DESCARTES_USB, bytes.getDescartados(), linhasTruncadas);
+		}
+};
+
+LeitorUSB* LeitorUSB::instancia = 0;
+
+//----------------------------------------------------------------------------
+//!  Struct EstadoDosSoquetes
+/*!
+	Estado de todos os soquetes controlados pelo gerente, com um vetor por campo indexado pelo soquete.
+	Assim, a previsão, o envio e a decisão percorrem todos os soquetes em laços curtos sobre vetores contíguos.
+*/
+struct EstadoDosSoquetes {
+	float consumo[NUMERO_SOQUETES]; /*!< Consumo de cada soquete no período atual. */
+	float somaNivel[NUMERO_SOQUETES]; /*!< Soma da dimmerização aplicada em cada soquete nas amostras do período atual. */
+	int amostras; /*!< Quantidade de amostras do período atual. */
+	float ultimoConsumo[NUMERO_SOQUETES]; /*!< Consumo medido de cada soquete no período encerrado pela última sincronização. */
+	float consumoPrevisto[NUMERO_SOQUETES]; /*!< Consumo previsto de cada soquete até o fim do mês, sem dimmerização. */
+	int prioridade[NUMERO_SOQUETES]; /*!< Prioridade de cada soquete no período da última sincronização. */
+	bool podeDesligar[NUMERO_SOQUETES]; /*!< Indica se cada soquete podia ser desligado no período da última sincronização. */
+	bool temDimmer[NUMERO_SOQUETES]; /*!< Indica se cada soquete possui dimmer. */
+	bool ligado[NUMERO_SOQUETES]; /*!< Estado de cada soquete na última decisão. */
+	float dimerizacao[NUMERO_SOQUETES]; /*!< Dimmerização de cada soquete na última decisão (1 = 100%). */
+	HistoricoEmCamadas historico[NUMERO_SOQUETES]; /*!< Consumo de cada soquete nos últimos períodos, horas e dias, sem dimmerização. */
+};
+
+//----------------------------------------------------------------------------
+//!  Struct ResumoDosGrupos
+/*!
+	Consumo do mês e limite de cada grupo de orçamento ouvido, com um vetor por campo indexado pelo número do grupo.
+	Os valores vêm do que as tomadas de cada grupo anunciam sobre o próprio grupo, então repetições de uma mesma mensagem não alteram o resumo.
+*/
+struct ResumoDosGrupos {
+	unsigned long epoca[NUMERO_GRUPOS]; /*!< Última época em que o grupo foi ouvido, ou -1. */
+	float consumoMensal[NUMERO_GRUPOS]; /*!< Maior consumo do grupo no mês anunciado na época. */
+	float maximoConsumoMensal[NUMERO_GRUPOS]; /*!< Menor limite do grupo anunciado na época. */
+};
+
+//----------------------------------------------------------------------------
+//!  Classe Gerente
+/*!
+	Classe que faz o controle das tomadas inteligentes com EPOSMoteIII.
+*/
+class Gerente {
+	private:
+		TomadaInteligente* tomadas[NUMERO_SOQUETES]; /*!< Soquetes que o gerente controla.*/
+		int quantidadeSoquetes; /*!< Quantidade de soquetes controlados.*/
+		EstadoDosSoquetes soquetes; /*!< Estado de cada soquete.*/
+		ResumoDosGrupos grupos; /*!< Consumo e limite de cada grupo de orçamento ouvido.*/
+		Relogio* relogio; /*!< Objeto que possui informações como data e hora.*/
+		Calendario* calendario; /*!< Objeto que publica as trocas de época, hora, quarto do dia e mês.*/
+		Mensageiro* mensageiro;	/*!< Objeto que provê a comunicação da placa com as outras.*/
+		Tabela* hash; /*!< Hash que guarda informações recebidas sobre as outras tomadas indexadas pelo endereço da tomada.*/
+		float maximoConsumoMensal; /*!< Variável que indica o máximo de consumo que as tomadas podem ter mensalmente.*/
+		float consumoMensal; /*!< Variável que indica o consumo mensal das tomadas até o momento.*/
+		float consumoProprioPrevisto; /*!< Variável que indica o consumo previsto da placa (soma dos soquetes) no mês.*/
+		float consumoTotalPrevisto; /*!< Variável que indica o consumo total previsto no mês.*/
+		int quantidadeDeEpocas; /*!< Variável que indica a quantidade de épocas que faltam para o fim do mês.*/
+		float consumoProprio; /*!< Variável que indica o consumo da placa (soma dos soquetes) no período atual.*/
+		unsigned long epocaAtual; /*!< Época da sincronização atual, igual em todas as tomadas com o relógio acertado.*/
+		int epocasDoPeriodo; /*!< Épocas entre a sincronização anterior e a atual. O consumo do período é dividido por elas no histórico.*/
+		unsigned long sincsRecentes[SINCS_PARA_EXPIRAR]; /*!< Épocas das últimas sincronizações, em anel. Uma tomada não ouvida em nenhuma delas expira.*/
+		int proximaSincRecente; /*!< Posição da próxima época em sincsRecentes.*/
+		AdaptacaoDaSincronizacao adaptacao; /*!< Objeto que escolhe o intervalo entre sincronizações e os envios por janela.*/
+		Dados dadosEnviados[NUMERO_SOQUETES]; /*!< Últimos dados enviados de cada soquete. São as entradas da própria placa no plano de corte.*/
+		Dados* instantaneo[NUMERO_MAXIMO_TOMADAS]; /*!< Visão da tabela (tomadas ouvidas na época atual) usada no plano de corte.*/
+		int tamanhoInstantaneo; /*!< Quantidade de entradas em instantaneo.*/
+		unsigned long resumoInstantaneo; /*!< Resumo da visão usada no último plano de corte.*/
+		Agregador* agregador; /*!< Objeto que calcula as somas do sistema no modo AGREGACAO_GOSSIP.*/
+		int modoAgregacao; /*!< Modo como as tomadas obtêm os totais do sistema (AGREGACAO_DIRETA ou AGREGACAO_GOSSIP).*/
+		Agregado agregadoSistema; /*!< Somas do sistema obtidas na última sincronização nos modos AGREGACAO_GOSSIP e AGREGACAO_HIERARQUICA.*/
+		Cluster* cluster; /*!< Objeto que organiza os clusters no modo AGREGACAO_HIERARQUICA.*/
+		DecisaoResumida decisaoCluster; /*!< Decisão resumida recebida do chefe (ou calculada, se a tomada é chefe) na última sincronização.*/
+		bool temDecisaoCluster; /*!< Indica se decisaoCluster é válida.*/
+		int quantidadeTomadas; /*!< Quantidade de entradas na tabela.*/
+		int soquetesDoGrupo; /*!< Quantidade de soquetes do grupo na última contagem confiável (tabela, gossip com peso ou decisão do cluster), ou 0 sem contagem.*/
+		long long inicioSinc; /*!< Leitura da BaseDeTempo no início da janela de sincronização.*/
+		CicloDeRadio* cicloRadio; /*!< Objeto que decide quando o rádio fica ligado.*/
+		SincronizadorDeTempo* sincronizadorTempo; /*!< Objeto que sincroniza o relógio com o das outras tomadas.*/
+		bool sincronizando; /*!< Indica se uma sincronização está em andamento.*/
+		long long tempoDeSinc; /*!< Duração da sincronização em andamento, em microssegundos.*/
+		long long proximoEnvio; /*!< Tempo da sincronização em que será feito o próximo envio.*/
+		int enviosSinc; /*!< Quantidade de envios feitos na sincronização em andamento.*/
+		int enviosJanela; /*!< Quantidade de envios da sincronização em andamento.*/
+		float consumoUltimoPeriodo; /*!< Consumo da placa no período encerrado pela última sincronização.*/
+		FilaSPSC<AmostraDeConsumo, TAMANHO_FILA_AMOSTRAS> filaAmostras; /*!< Amostras de consumo, da tarefa de amostragem para a de decisão.*/
+		FilaSPSC<LinhaDeComando, TAMANHO_FILA_COMANDOS> filaComandos; /*!< Comandos recebidos por USB, da tarefa de comandos para a de decisão.*/
+		EstatisticaLatencia latenciaMensagens; /*!< Tempo entre a chegada de cada mensagem e o fim do seu tratamento pela tarefa de decisão.*/
+		Alerta* alerta; /*!< Objeto que envia e recebe os alertas de excesso.*/
+		ConsultaDeHistorico* consultaHistorico; /*!< Objeto que consulta o histórico de outras tomadas a pedido do usuário.*/
+		bool dentroDoLimite; /*!< Indica se a última decisão previu o consumo dentro do limite. Só então um excesso detectado gera alerta.*/
+		int limitePotenciaGrupo; /*!< Limite de pico do grupo, em % do fundo de escala de um soquete, ou 0 sem limite. Cada soquete do grupo fica com uma parte igual.*/
+		bool reproduzindo; /*!< Indica uma reprodução de tráfego: as amostras, a dimmerização aplicada e os cortes vêm da captura.*/
+
+		// Espaço dos objetos do gerente. Ver RelatorioMemoria.
+		Estatico<Relogio> memoriaRelogio; /*!< Espaço do relógio.*/
+		Estatico<Calendario> memoriaCalendario; /*!< Espaço do calendário.*/
+		Estatico<Mensageiro> memoriaMensageiro; /*!< Espaço do mensageiro (inclui o NIC).*/
+		Estatico<Tabela> memoriaTabela; /*!< Espaço da hash.*/
+		PoolDeTomadas pool; /*!< Entradas da tabela.*/
+		Estatico<Agregador> memoriaAgregador; /*!< Espaço do agregador.*/
+		Estatico<Cluster> memoriaCluster; /*!< Espaço do cluster.*/
+		Estatico<CicloDeRadio> memoriaCicloRadio; /*!< Espaço do ciclo de rádio.*/
+		Estatico<SincronizadorDeTempo> memoriaSincronizador; /*!< Espaço do sincronizador de tempo.*/
+		Estatico<Alerta> memoriaAlerta; /*!< Espaço do objeto de alertas.*/
+		Estatico<ConsultaDeHistorico> memoriaConsultaHistorico; /*!< Espaço da consulta de histórico.*/
+		LeitorUSB* leitorUSB; /*!< Objeto que recebe os comandos enviados por USB.*/
+		GatewayUSB* gateway; /*!< Objeto que encaminha os dados das tomadas por USB, quando a placa é gateway.*/
+		MedidorDeEnergia* medidor; /*!< Objeto que mede o consumo dos soquetes.*/
+		Estatico<MedidorDeEnergia> memoriaMedidor; /*!< Espaço do medidor.*/
+		Estatico<LeitorUSB> memoriaLeitorUSB; /*!< Espaço do leitor USB.*/
+		Estatico<GatewayUSB> memoriaGateway; /*!< Espaço do gateway.*/
+		Estatico<Thread> memoriaTarefaRadio; /*!< Espaço da tarefa do rádio.*/
+		Estatico<Thread> memoriaTarefaAmostragem; /*!< Espaço da tarefa de amostragem.*/
+		Estatico<Thread> memoriaTarefaComandos; /*!< Espaço da tarefa de comandos.*/
+
+
+		/*!
+			Método que começa o trabalho da placa: faz a previsão própria e inicia a sincronização.
+			A sincronização não bloqueia: ela avança a cada chamada de passoSincronizacao() e, ao fim da janela, terminarAdministracao() toma a decisão.
+			\sa Calendario, atualizaHistorico(), fazerPrevisaoConsumoProprio(), preparaEnvio(), iniciarSincronizacao(), terminarAdministracao()
+		*/
+		void administrar() {
+			quantidadeDeEpocas = calendario->getEpocasAteFimDoMes();
+			unsigned long epocaAnterior = epocaAtual;
+			epocaAtual = calendario->getEpoca();
+			epocasDoPeriodo = ((epocaAnterior != 0) && (epocaAtual > epocaAnterior)) ? (int) (epocaAtual - epocaAnterior) : adaptacao.getEpocasEntreSincs();
+			sincsRecentes[proximaSincRecente] = epocaAtual;
+			proximaSincRecente = (proximaSincRecente + 1) % SINCS_PARA_EXPIRAR;
+			sincronizadorTempo->novaEpoca();
+
+			// Preparando a previsao própria.
+			consumoUltimoPeriodo = consumoProprio;
+			consumoProprio = 0; // As amostras feitas durante a sincronização já contam para o próximo período.
+			atualizaHistorico();
+			fazerPrevisaoConsumoProprio();
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_PREVISAO, RegistroDeEventos::real(consumoUltimoPeriodo), (int) consumoProprioPrevisto);
+
+			// Preparando Dados para enviar.
+			preparaEnvio();
+
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_INICIO_SINCRONIZACAO, (int) epocaAtual);
+			// Sincronização entre as placas.
+			iniciarSincronizacao();
+		}
+
+		/*!
+			Método que termina o trabalho da placa depois da sincronização, ajustando o estado da tomada conforme o necessário.
+			\sa atualizaConsumoMensal(), fazerPrevisaoConsumoTotal(), administrarConsumo(float)
+		*/
+		void terminarAdministracao() {
+			expirarTomadas();
+			atualizarLimitePlaca();
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_FIM_SINCRONIZACAO, getQuantidadeTomadasVivas());
+			printHash();
+
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_DADOS_PROPRIOS, RegistroDeEventos::endereco(mensageiro->obterEnderecoNIC()), (int) consumoProprioPrevisto,
+				RegistroDeEventos::real(consumoUltimoPeriodo));
+			for (int k = 0; k < quantidadeSoquetes; k++) {
+				RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_SOQUETE_PROPRIO, k, (int) soquetes.consumoPrevisto[k], soquetes.prioridade[k]);
+			}
+
+			// Atualiza as previsões com base nos novos dados recebidos.
+			atualizaConsumoMensal();
+			fazerPrevisaoConsumoTotal(); // Considera todas as tomadas, mesmo as desligadas.
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_CONSUMO_DO_SISTEMA, (int) consumoMensal, (int) maximoConsumoMensal, (int) (consumoTotalPrevisto+consumoMensal));
+			registrarGrupos();
+			// Toma decisões dependendo de como está o consumo do sistema.
+			dentroDoLimite = (consumoMensal + consumoTotalPrevisto <= maximoConsumoMensal);
+			adaptarSincronizacao();
+			administrarConsumo(maximoConsumoMensal);
+
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_LATENCIA_MENSAGENS, latenciaMensagens.getQuantidade(), latenciaMensagens.getMedia(), latenciaMensagens.getMaxima());
+			latenciaMensagens.zerar();
+			mensageiro->registrarDescartes();
+			leitorUSB->registrarDescartes();
+			medidor->registrarMedidas();
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_DESCARTES_TAREFAS, filaAmostras.getDescartados(), filaComandos.getDescartados());
+			if (gateway->getAtivo()) {
+				RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_DESCARTES_TELEMETRIA, gateway->getDescartados());
+			}
 		}
 
 		/*!
-			Método que retorna o consumo atual da tomada.
-			\return Valor float que indica o consumo atual da tomada. Caso esteja desligada, o valor retornado é 0.
+			Método que escolhe, com a decisão tomada, o intervalo até a próxima sincronização e os envios por janela, e os passa ao calendário e ao mensageiro.
+			\sa AdaptacaoDaSincronizacao
 		*/
-		virtual float getConsumo() {
+		void adaptarSincronizacao() {
+			int epocas = adaptacao.decidir(consumoMensal + consumoTotalPrevisto, maximoConsumoMensal, epocaAtual);
+			calendario->setEpocasEntreSincs(epocas);
+			mensageiro->setEpocasPropostas(adaptacao.getEpocasPropostas());
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_ADAPTACAO_SINCRONIZACAO, epocas * MIN_POR_EPOCA, adaptacao.getEpocasPropostas() * MIN_POR_EPOCA,
+				adaptacao.getRepeticoes(), adaptacao.getTaxaEntrega());
+		}
 
-			// Método criado para possibilitar a simulação da análise de consumo de uma tomada.
-			// Em um sistema real este método retornaria o consumo da tomada.
+		/*!
+			Método que prepara os dados de cada soquete a serem enviados para as outras tomadas, guardando-os em dadosEnviados.
+			A prioridade é limitada a 127 para caber na MensagemRegua, e todas as tomadas planejam com o mesmo valor.
+ 			\sa prioridadeAtual(), enviarDadosDosSoquetes()
+		*/
+		void preparaEnvio() {
+			Address endereco = mensageiro->obterEnderecoNIC();
+			for (int k = 0; k < quantidadeSoquetes; k++) {
+				int prioridade = prioridadeAtual(k);
+				soquetes.prioridade[k] = (prioridade > 127) ? 127 : prioridade;
+				soquetes.podeDesligar[k] = podeDesligarAtual(k);
+				soquetes.temDimmer[k] = (tomadas[k]->getTipo() == 2);
+
+				Dados& dados = dadosEnviados[k];
+				dados.remetente = endereco;
+				dados.soquete = k;
+				//dados.ligada = tomada->estaLigada();
+				dados.consumoPrevisto = soquetes.consumoPrevisto[k];
+				if (tomadas[k]->estaLigada()) {
+					dados.ultimoConsumo = soquetes.ultimoConsumo[k];
+				} else {
+					dados.ultimoConsumo = 0;
+				}
 
-			if (ligada) {
-				unsigned int rand;
-				if (consumo == 0) {
-					rand = Random::random();
-					consumo = (25 + (rand % (425-25+1))) / 1000.0;
+				dados.configuracao[0] = '\0';
+				dados.prioridade = soquetes.prioridade[k];
+				dados.podeDesligar = soquetes.podeDesligar[k];
+				dados.temDimmer = soquetes.temDimmer[k];
+				dados.epoca = epocaAtual;
+				dados.resumo = resumoInstantaneo;
+				dados.consumoMensal = consumoMensal;
+				dados.maximoConsumoMensal = maximoConsumoMensal;
+				dados.carimbo.grupo = (unsigned char) mensageiro->getGrupo(); // Os dados próprios não passam pelo Mensageiro antes do gateway.
+				gateway->encaminhar(dados, relogio->agora(), true);
+			}
+		}
+
+		/*!
+			Método que envia os dados de todos os soquetes em uma única mensagem PROTOCOLO_REGUA.
+			\param destino é o endereço do destinatário (broadcast no modo direto, o chefe no modo hierárquico).
+			\param sequencia é o número do envio na janela (1 a envios), ou 0 se os envios não são repetições.
+			\param envios é a quantidade de envios na janela, ou 0.
+		*/
+		void enviarDadosDosSoquetes(const Address& destino, int sequencia, int envios) {
+			MensagemRegua msg;
+			memset(&msg, 0, sizeof msg);
+			msg.carimbo.sequencia = (unsigned char) sequencia;
+			msg.carimbo.envios = (unsigned char) envios;
+			msg.remetente = dadosEnviados[0].remetente;
+			msg.epoca = dadosEnviados[0].epoca;
+			msg.resumo = dadosEnviados[0].resumo;
+			msg.consumoMensal = dadosEnviados[0].consumoMensal;
+			msg.maximoConsumoMensal = dadosEnviados[0].maximoConsumoMensal;
+			msg.quantidade = (unsigned char) quantidadeSoquetes;
+			msg.podeDesligar = 0;
+			msg.temDimmer = 0;
+			for (int k = 0; k < quantidadeSoquetes; k++) {
+				msg.prioridade[k] = (signed char) dadosEnviados[k].prioridade;
+				msg.consumoPrevisto[k] = dadosEnviados[k].consumoPrevisto;
+				msg.ultimoConsumo[k] = dadosEnviados[k].ultimoConsumo;
+				if (dadosEnviados[k].podeDesligar) {
+					msg.podeDesligar |= (1 << k);
 				}
-				// Aplica uma variação ao último consumo registrado, para simular um sistema real onde os valores são de certa forma consistentes.
-				rand = Random::random();
-				float variacao = (90 + (rand % 21)) / 100.0f; // Valor de 0.9 até 1.1 ou 90% até 110%
+				if (dadosEnviados[k].temDimmer) {
+					msg.temDimmer |= (1 << k);
+				}
+			}
+			mensageiro->enviar(destino, PROTOCOLO_REGUA, &msg, sizeof msg);
+		}
 
-				consumo = (consumo+variacao) * variacao;
+		/*!
+			Método que soma os dados enviados de todos os soquetes da placa.
+			\return Somas da própria placa.
+		*/
+		Agregado somarSoquetes() {
+			Agregado somas;
+			Agregador::zerar(&somas);
+			for (int k = 0; k < quantidadeSoquetes; k++) {
+				Agregador::somar(&somas, dadosEnviados[k]);
+			}
+			return somas;
+		}
+
+		/*!
+			Método que inicia a sincronização das placas, em que os dados em dadosEnviados são trocados com as outras tomadas.
+			\sa passoSincronizacao()
+		*/
+		void iniciarSincronizacao() {
+			cicloRadio->iniciarSincronizacao();
+			if (modoAgregacao == AGREGACAO_GOSSIP) {
+				agregador->iniciar(epocaAtual, somarSoquetes(), quantidadeSoquetes);
+			} else if (modoAgregacao == AGREGACAO_HIERARQUICA) {
+				cluster->iniciar(epocaAtual);
+			}
+
+			// Com o relógio sincronizado as janelas das tomadas coincidem e podem ser curtas.
+			tempoDeSinc = INTERVALO_ENVIO_MENSAGENS*60*1000000LL; // Minutos pra Microssegundos.
+			if (sincronizadorTempo->estaSincronizada()) {
+				tempoDeSinc = JANELA_SINC_SINCRONIZADA*1000LL;
+			}
+			// No modo direto cada envio repete os dados; nos outros, cada um é uma rodada.
+			enviosJanela = (modoAgregacao == AGREGACAO_DIRETA) ? adaptacao.getRepeticoes() : REPETICOES_SINC_MAXIMO;
+			adaptacao.iniciarJanela();
+			proximoEnvio = 0;
+			enviosSinc = 0;
+			inicioSinc = BaseDeTempo::doPasso();
+			sincronizando = true;
+		}
+
+		/*!
+			Método que avança a sincronização em um passo: um envio, se estiver na hora. Não bloqueia.
+			As mensagens recebidas durante a sincronização são tratadas por tratarMensagensRecebidas().
+			Ao fim da janela, termina a sincronização e chama terminarAdministracao().
+			\return Valor booleano que indica se algo foi enviado ou a sincronização terminou.
+			\sa enviarDadosDosSoquetes(), atualizaHash()
+		*/
+		bool passoSincronizacao() {
+			long long cronTime = BaseDeTempo::doPasso() - inicioSinc;
+
+			if (cronTime >= tempoDeSinc) {
+				terminarSincronizacao();
+				terminarAdministracao();
+			} else if (cronTime >= proximoEnvio) {
+				if (modoAgregacao == AGREGACAO_DIRETA) {
+					enviarDadosDosSoquetes(mensageiro->obterBroadcast(), enviosSinc + 1, enviosJanela);
+				} else if (modoAgregacao == AGREGACAO_HIERARQUICA) {
+					passoCluster(faseDoCluster(cronTime, tempoDeSinc));
+				} else if (enviosSinc == 0) {
+					agregador->anunciar(); // O primeiro envio apenas anuncia a tomada às vizinhas.
+				} else {
+					agregador->enviarRodada();
+				}
+				enviosSinc++;
+				proximoEnvio += tempoDeSinc/enviosJanela;
 			} else {
-				consumo = 0;
+				return false;
 			}
-			return consumo;
+			return true;
 		}
-};
 
-//----------------------------------------------------------------------------
-//!  Classe TomadaMulti
-/*!
-	Classe que representa uma tomada com dimmer controlada pelo EPOSMoteIII.
-*/
-class TomadaMulti: public TomadaComDimmer, public TomadaInteligente {
-	public:
 		/*!
-			Método construtor da classe
+			Método que termina a sincronização e obtém as somas do sistema nos modos que não usam a tabela completa.
 		*/
-		TomadaMulti() {
-			tipo = 2; // Indica uma TomadaInteligente com dimmer
+		void terminarSincronizacao() {
+			sincronizando = false;
+			cicloRadio->terminarSincronizacao();
+
+			if (modoAgregacao == AGREGACAO_GOSSIP) {
+				if (agregador->estimativa(&agregadoSistema)) {
+					soquetesDoGrupo = agregador->estimativaSoquetes();
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_GOSSIP, agregador->getQuantidadeVizinhos());
+				} else {
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_GOSSIP_SEM_PESO);
+				}
+			} else if (modoAgregacao == AGREGACAO_HIERARQUICA) {
+				finalizarCluster();
+			}
 		}
 
 		/*!
-			Método que define o valor da porcentagem de dimmerização da tomada.
+			Método que calcula a fase da sincronização hierárquica a partir do tempo decorrido na janela.
+			\param cronTime é o tempo decorrido desde o início da janela.
+			\param tempoDeSinc é a duração da janela.
+			\return Fase da sincronização hierárquica.
 		*/
-		void setDimerizacao(float porcentagem) {
-			dimPorcentagem = porcentagem;
+		int faseDoCluster(long long cronTime, long long tempoDeSinc) {
+			long long porcentagem = (cronTime * 100) / tempoDeSinc;
+			if (porcentagem < 20) {
+				return FASE_ANUNCIO;
+			} else if (porcentagem < 30) {
+				return FASE_CHEFE;
+			} else if (porcentagem < 55) {
+				return FASE_MEMBROS;
+			} else if (porcentagem < 80) {
+				return FASE_AGREGADOS;
+			}
+			return FASE_DECISAO;
 		}
 
 		/*!
-			Método que calcula a porcentagem de dimmerização da tomada. Essa porcentagem é armazenada na variável dimPorcentagem.
- 			\param consumo é o consumo previsto da tomada até o fim do mês.
- 			\param sobra é o máximo de consumo que a tomada pode ter para o limite máximo de consumo ser mantido.
+			Método que avança o cluster até a fase passada e envia a mensagem dessa fase.
+			Os membros usam o envio unicast para mandar os dados de seus soquetes apenas ao chefe.
+			\param fase é a fase atual da janela.
 		*/
-		void dimerizar(float consumo, float sobra) {
-			dimPorcentagem = (sobra/consumo);
+		void passoCluster(int fase) {
+			while (cluster->getFase() < fase) {
+				cluster->avancarFase();
+				if (cluster->souChefe() && (cluster->getFase() == FASE_AGREGADOS)) {
+					Agregado somas;
+					int membros;
+					float consumoMensalCluster;
+					float limiteCluster;
+					agregarTabela(&somas, &membros, &consumoMensalCluster, &limiteCluster);
+					cluster->definirAgregado(somas, membros, consumoMensalCluster, limiteCluster);
+				} else if (cluster->souChefe() && (cluster->getFase() == FASE_DECISAO)) {
+					cluster->calcularDecisao();
+				}
+			}
+
+			switch (fase) {
+				case FASE_ANUNCIO:
+				case FASE_CHEFE:
+					cluster->anunciar();
+					break;
+				case FASE_MEMBROS:
+					if (!cluster->souChefe()) {
+						enviarDadosDosSoquetes(cluster->getChefe(), 0, 0);
+					}
+					break;
+				case FASE_AGREGADOS:
+					if (cluster->souChefe()) {
+						cluster->enviarAgregado();
+					}
+					break;
+				case FASE_DECISAO:
+					if (cluster->souChefe()) {
+						cluster->enviarDecisao();
+					}
+					break;
+			}
 		}
 
 		/*!
-			Método que retorna o consumo atual da tomada.
-			\return Valor float que indica o consumo atual da tomada. Caso esteja desligada, o valor retornado é 0.
+			Método que obtém a decisão resumida e as somas do sistema ao fim da sincronização hierárquica.
 		*/
-		float getConsumo() {
+		void finalizarCluster() {
+			int membros = 1;
+			if (cluster->getFase() < FASE_DECISAO) { // A janela acabou antes da última fase.
+				passoCluster(FASE_DECISAO);
+			}
+			temDecisaoCluster = cluster->obterDecisao(&decisaoCluster, &agregadoSistema, &membros);
+			if (temDecisaoCluster) {
+				soquetesDoGrupo = membros;
+				if (cluster->souChefe()) {
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_CHEFE_DE_CLUSTER, cluster->getQuantidadeOutros() + 1, membros);
+				} else {
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_DECISAO_DO_CHEFE, RegistroDeEventos::endereco(cluster->getChefe()), membros);
+				}
+			} else {
+				RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_CHEFE_SEM_DECISAO, RegistroDeEventos::endereco(cluster->getChefe()));
+				agregadoSistema = somarSoquetes();
+			}
+		}
 
-			// Método criado para possibilitar a simulação da análise de consumo de uma tomada.
- 			// Em um  sistema real este metodo não existiria, ja que o consumo recebido ja seria o consumo alterado pela dimerização.
-			// Como estamos simulando o consumo, este metodo existe para simular a dimerizado do consumo da tomada.
+		/*!
+			Método que soma os dados dos próprios soquetes e das tomadas da tabela ouvidas na época atual.
+			No modo hierárquico, a tabela do chefe contém apenas os membros de seu cluster.
+			\param somas recebe as somas.
+			\param membros recebe a quantidade de tomadas somadas.
+			\param consumoMensalMaior recebe o maior consumo mensal informado.
+			\param limiteMenor recebe o menor consumo máximo informado.
+		*/
+		void agregarTabela(Agregado* somas, int* membros, float* consumoMensalMaior, float* limiteMenor) {
+			*somas = somarSoquetes();
+			*membros = quantidadeSoquetes;
+			*consumoMensalMaior = dadosEnviados[0].consumoMensal;
+			*limiteMenor = dadosEnviados[0].maximoConsumoMensal;
+			*membros += pool.somarEpoca(epocaAtual, somas, consumoMensalMaior, limiteMenor);
+		}
 
-			TomadaInteligente::getConsumo();
-			return consumo * dimPorcentagem;
+		/*!
+			Método que verifica se consumo previsto está acima do m´sximo e se alguma decisão deve ser tomada.
+			\param limite é o consumo máximo mensal usado nas decisões pelas somas (fora do modo AGREGACAO_DIRETA, em que vale o da tabela).
+ 			\sa mantemConsumoDentroDoLimite()
+		*/
+		void administrarConsumo(float limite) {
+			Decisao decisoes[NUMERO_SOQUETES];
+			if ((modoAgregacao == AGREGACAO_HIERARQUICA) && temDecisaoCluster) {
+				// A decisão resumida vem do chefe do cluster.
+				if (algumPodeDesligar() && (consumoMensal + consumoTotalPrevisto > limite)) {
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_ACIMA_DO_LIMITE);
+				}
+				for (int k = 0; k < quantidadeSoquetes; k++) {
+					decisoes[k] = PlanejadorDeCorte::decidir(decisaoCluster, dadosEnviados[k]);
+				}
+				aplicarDecisoes(decisoes);
+				return;
+			}
+			if (modoAgregacao != AGREGACAO_DIRETA) {
+				// Sem a tabela completa, a decisão é tomada a partir das somas por nível de prioridade.
+				if (algumPodeDesligar() && (consumoMensal + consumoTotalPrevisto > limite)) {
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_ACIMA_DO_LIMITE);
+				}
+				DecisaoResumida resumida = PlanejadorDeCorte::resumirDecisao(agregadoSistema, consumoMensal, limite);
+				for (int k = 0; k < quantidadeSoquetes; k++) {
+					decisoes[k] = PlanejadorDeCorte::decidir(resumida, dadosEnviados[k]);
+				}
+				aplicarDecisoes(decisoes);
+				return;
+			}
 
+			montarInstantaneo();
+			// Se o consumo até agora somado à previsão de consumo até o fim do mês ficam acima do consumo máximo, segundo a visão da época atual.
+			float excesso = PlanejadorDeCorte::calcularExcesso(instantaneo, tamanhoInstantaneo);
+			if ((excesso > 0) && algumPodeDesligar()) {
+				RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_ACIMA_DO_LIMITE);
+				mantemConsumoDentroDoLimite(); // Desliga as tomadas necessárias para manter o consumo dentro do limite.
+			} else { // Se o consumo está dentro do limite ou se nenhum soquete pode ser desligado
+				if (algumPodeDesligar()) {
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_DENTRO_DO_LIMITE);
+				} else {
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_NAO_PODE_DESLIGAR);
+				}
+				// Liga todos os soquetes
+				for (int k = 0; k < quantidadeSoquetes; k++) {
+					soquetes.ligado[k] = true;
+					soquetes.dimerizacao[k] = 1;
+					if (tomadas[k]->getTipo() == 2) {
+						static_cast<TomadaMulti*>(tomadas[k])->setDimerizacao(1);
+					}
+					tomadas[k]->ligar();
+				}
+			}
 		}
-};
 
-//----------------------------------------------------------------------------
-//!  Classe Previsor
-/*!
-	Classe que faz a previsão de consumo de uma determinada tomada.
-*/
-class Previsor {
-	public:
 		/*!
-			Método construtor da classe
+			Método que atualiza o histórico de consumo de cada soquete com o consumo do período que terminou e zera o consumo do período.
+			Consumo nulo (soquete desligado) não é inserido. O consumo de um soquete dimerizado é dividido pela dimmerização média do período,
+			para que o histórico e a previsão representem a carga sem dimmer e o plano de corte não dimerize de novo o que já foi dimerizado.
 		*/
-		//Previsor();
+		void atualizaHistorico() {
+			unsigned long long agora = relogio->agora();
+			for (int k = 0; k < quantidadeSoquetes; k++) {
+				soquetes.ultimoConsumo[k] = soquetes.consumo[k];
+				float nivelMedio = (soquetes.amostras > 0) ? (soquetes.somaNivel[k] / soquetes.amostras) : 1;
+				float semDimmer = (nivelMedio > 0) ? (soquetes.consumo[k] / nivelMedio) : soquetes.consumo[k];
+				soquetes.historico[k].registrar(semDimmer / epocasDoPeriodo, tomadas[k]->estaLigada(), agora); // O histórico guarda o consumo por época.
+				soquetes.consumo[k] = 0;
+				soquetes.somaNivel[k] = 0;
+			}
+			soquetes.amostras = 0;
+		}
 
 		/*!
-			Método estático que estima o consumo da tomada até a próxima sincronização.
- 			\param historico é um vetor que contém os consumos da tomada.
+			Método que retorna a dimmerização aplicada em um soquete (1 para soquetes sem dimmer).
+			\param soquete é o soquete consultado.
 		*/
-		static float preverConsumoProprio(float historico[NUMERO_ENTRADAS_HISTORICO]) {
-			float previsao = 0;
+		float nivelAplicado(int soquete) {
+			if (tomadas[soquete]->getTipo() == 2) {
+				return static_cast<TomadaMulti*>(tomadas[soquete])->getPorcentagemAtual();
+			}
+			return 1;
+		}
 
-			int N = NUMERO_ENTRADAS_HISTORICO;
+		/*!
+			Método que ajusta, a cada amostra, a dimmerização dos soquetes que o plano de corte dimerizou, para que cada um consuma até o fim do mês
+			o que o plano lhe deixou: a previsão sem dimmer vezes a dimmerização decidida. Se a carga cresce, a dimmerização aumenta; se diminui, ela alivia.
+			\param amostra é o consumo de cada soquete na última amostra, com a dimmerização aplicada.
+		*/
+		void acompanharOrcamento(const AmostraDeConsumo& amostra) {
+			float amostrasAteFimDoMes = (float) quantidadeDeEpocas * ((MIN_POR_EPOCA * 60) / SEGS_ENTRE_CONSUMO);
+			for (int k = 0; k < quantidadeSoquetes; k++) {
+				if (!soquetes.temDimmer[k] || !soquetes.ligado[k] || (soquetes.dimerizacao[k] >= 1)) {
+					continue;
+				}
+				float nivel = amostra.nivel[k];
+				if (nivel <= 0) {
+					continue;
+				}
+				float projecaoSemDimmer = (amostra.consumo[k] / nivel) * amostrasAteFimDoMes;
+				float orcamento = soquetes.consumoPrevisto[k] * soquetes.dimerizacao[k];
+				static_cast<TomadaMulti*>(tomadas[k])->dimerizar(projecaoSemDimmer, orcamento);
+			}
+		}
 
-			// Soma de todos os números de 1 até N.
-			float somaPesos = (N * (N + 1)) / 2;
+		/*!
+			Método que atualiza a entrada da hash correspondente aos dados passados por parâmetro. Se ela não existir, é adicionada.
+			\param d são os dados recebidos de um soquete de uma tomada.
+		*/
+		void atualizaHash(const Dados& d) {
+			if ((d.prioridade == -1) || (d.soquete < 0)) {
+				// Elemento "vazio"(prioridade é igual a -1 quando não há mensagem recebida) ou mensagem de configuração, que não substituem os dados da tomada.
+				return;
+			}
 
-			for (int i = 0; i < NUMERO_ENTRADAS_HISTORICO; i++) {
-				previsao += ((i+1)/somaPesos) * historico[i];
+			Hash_Element* foundElement = buscarTomada(d.remetente, d.soquete);
+			if (foundElement == 0) {  // Se uma entrada para a tomada passada ainda não existe
+				if (quantidadeTomadas >= NUMERO_MAXIMO_TOMADAS - 1) { // Tabela cheia: sai a tomada ouvida há mais tempo.
+					removerTomadaMenosRecente();
+				}
+				foundElement = pool.alocar(d);
+				hash->insert(foundElement);
+				quantidadeTomadas++;
+			} else {
+				*foundElement->object() = d;
 			}
+			foundElement->object()->ultimaEpocaOuvida = epocaAtual;
+			pool.atualizarColunas(foundElement);
+		}
 
-			return previsao;
+		/*!
+			Método que atualiza a tabela com os dados de todos os soquetes de uma placa. Cada soquete tem sua própria entrada.
+			\param msg é a mensagem recebida da placa.
+		*/
+		void atualizaHash(const MensagemRegua& msg) {
+			// O último envio recebido da placa nesta janela fica no carimbo da entrada do soquete 0.
+			Hash_Element* anterior = buscarTomada(msg.remetente, 0);
+			int ultimoNaJanela = ((anterior != 0) && (anterior->object()->epoca == msg.epoca)) ? anterior->object()->carimbo.sequencia : 0;
+			if (!adaptacao.ouvir(msg.carimbo, ultimoNaJanela)) {
+				return; // Repetição de um envio já recebido.
+			}
+
+			int quantidade = (msg.quantidade > NUMERO_MAXIMO_SOQUETES) ? NUMERO_MAXIMO_SOQUETES : msg.quantidade;
+			Dados d;
+			d.carimbo = msg.carimbo;
+			d.remetente = msg.remetente;
+			d.configuracao[0] = '\0';
+			d.epoca = msg.epoca;
+			d.resumo = msg.resumo;
+			d.consumoMensal = msg.consumoMensal;
+			d.maximoConsumoMensal = msg.maximoConsumoMensal;
+			d.ultimaEpocaOuvida = 0;
+			for (int k = 0; k < quantidade; k++) {
+				d.soquete = k;
+				d.consumoPrevisto = msg.consumoPrevisto[k];
+				d.ultimoConsumo = msg.ultimoConsumo[k];
+				d.prioridade = msg.prioridade[k];
+				d.podeDesligar = ((msg.podeDesligar >> k) & 1) != 0;
+				d.temDimmer = ((msg.temDimmer >> k) & 1) != 0;
+				atualizaHash(d);
+			}
 		}
 
 		/*!
-			Método que estima o consumo de todas as tomadas juntas até o fim do mês.
-			\param h é uma hash que contém os valores enviados pelas outras tomadas.
- 			\param minhaPrevisao é a previsão da tomada até o fim do mês.
-			\return Valor previsto para o consumo total das tomadas.
+			Método que procura a entrada da tabela de um soquete. As entradas de uma mesma placa têm a mesma chave e ficam em sequência na hash.
+			\param endereco é o endereço da placa.
+			\param soquete é o soquete da placa.
+			\return Entrada do soquete, ou 0 se ela não existe.
+		*/
+		Hash_Element* buscarTomada(const Address& endereco, int soquete) {
+			for (Hash_Element* e = hash->search_key(endereco); (e != 0) && (e->key() == endereco); e = e->next()) {
+				if (e->object()->soquete == soquete) {
+					return e;
+				}
+			}
+			return 0;
+		}
+
+		/*!
+			Método que remove uma entrada da tabela, liberando seus dados.
+			\param endereco é o endereço da tomada removida.
+			\param soquete é o soquete removido.
 		*/
-		static float preverConsumoTotal(Tabela* h, float minhaPrevisao) {
-			float total = minhaPrevisao;
-			for(auto iter = h->begin(); iter != h->end(); iter++) {
-				//se iter não é vazio: begin() retorna um objeto vazio no inicio por algum motivo
+		void removerTomada(const Address& endereco, int soquete) {
+			Hash_Element* removido = buscarTomada(endereco, soquete);
+			if (removido != 0) {
+				hash->remove(removido);
+				pool.liberar(removido);
+				quantidadeTomadas--;
+			}
+		}
+
+		/*!
+			Método que remove da tabela a tomada ouvida há mais tempo (LRU). Em caso de empate sai a de maior endereço e, na mesma placa, a de maior soquete.
+		*/
+		void removerTomadaMenosRecente() {
+			Dados* escolhida = 0;
+			for(auto iter = hash->begin(); iter != hash->end(); iter++) {
+				// Se iter não é vazio: begin() retorna um objeto vazio no inicio por algum motivo
 				if (iter != 0) {
-					total += iter->object()->consumoPrevisto;
+					Dados* d = iter->object();
+					if ((escolhida == 0) || (d->ultimaEpocaOuvida < escolhida->ultimaEpocaOuvida)) {
+						escolhida = d;
+					} else if (d->ultimaEpocaOuvida == escolhida->ultimaEpocaOuvida) {
+						int comparacao = ComparadorDeEnderecos::comparar(d->remetente, escolhida->remetente);
+						if ((comparacao > 0) || ((comparacao == 0) && (d->soquete > escolhida->soquete))) {
+							escolhida = d;
+						}
+					}
 				}
 			}
-			return total;
+			if (escolhida != 0) {
+				Address endereco = escolhida->remetente;
+				removerTomada(endereco, escolhida->soquete);
+			}
 		}
-};
 
-//----------------------------------------------------------------------------
-//!  Classe Gerente
-/*!
-	Classe que faz o controle das tomadas inteligentes com EPOSMoteIII.
-*/
-class Gerente {
-	private:
-		TomadaInteligente* tomada; /*!< Variável que indica a tomada que o gerente controla.*/
-		Relogio* relogio; /*!< Objeto que possui informações como data e hora.*/
-		Mensageiro* mensageiro;	/*!< Objeto que provê a comunicação da placa com as outras.*/
-		Tabela* hash; /*!< Hash que guarda informações recebidas sobre as outras tomadas indexadas pelo endereço da tomada.*/
-		float maximoConsumoMensal; /*!< Variável que indica o máximo de consumo que as tomadas podem ter mensalmente.*/
-		float consumoMensal; /*!< Variável que indica o consumo mensal das tomadas até o momento.*/
-		float consumoProprioPrevisto; /*!< Variável que indica o consumo previsto da tomada no mês.*/
-		float consumoTotalPrevisto; /*!< Variável que indica o consumo total previsto no mês.*/
-		float *historico; /*!< Vetor que guarda o consumo da tomada nos ultimos periodos entre as sincronizações.*/
-		int quantidadeDeSincs; /*!< Variável que indica a quantidade de sincronizações que faltam para o fim do mês.*/
-		float consumoProprio; /*!< Variável que indica o consumo da tomada no último período.*/
+		/*!
+			Método que remove da tabela as tomadas que não foram ouvidas nas últimas SINCS_PARA_EXPIRAR sincronizações.
+			Assim, tomadas desconectadas deixam de contar na previsão do consumo total.
+		*/
+		void expirarTomadas() {
+			Address expiradas[NUMERO_MAXIMO_TOMADAS];
+			int soquetesExpirados[NUMERO_MAXIMO_TOMADAS];
+			int quantidadeExpiradas = 0;
 
+			// As entradas são removidas depois de percorrer a tabela, para não alterar a hash durante a iteração.
+			for(auto iter = hash->begin(); iter != hash->end(); iter++) {
+				// Se iter não é vazio: begin() retorna um objeto vazio no inicio por algum motivo
+				if (iter != 0) {
+					Dados* d = iter->object();
+					if ((d->ultimaEpocaOuvida < sincsRecentes[proximaSincRecente]) && (quantidadeExpiradas < NUMERO_MAXIMO_TOMADAS)) { // A mais antiga das últimas sincronizações.
+						expiradas[quantidadeExpiradas] = d->remetente;
+						soquetesExpirados[quantidadeExpiradas] = d->soquete;
+						quantidadeExpiradas++;
+					}
+				}
+			}
+			for (int i = 0; i < quantidadeExpiradas; i++) {
+				removerTomada(expiradas[i], soquetesExpirados[i]);
+			}
+			if (quantidadeExpiradas > 0) {
+				RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_TOMADAS_EXPIRADAS, quantidadeExpiradas);
+			}
+		}
 
 		/*!
-			Método que realiza o trabalho da placa, fazendo sua previsão, sincronização e ajustes no estado da tomada conforme o necessário.
-			\sa calculaQuantidadeDeSincs(), atualizaHistorico(), fazerPrevisaoConsumoProprio(), preparaEnvio(), sincronizar(), atualizaConsumoMensal(), fazerPrevisaoConsumoTotal(), administrarConsumo()
+			Método que calcula quanta energia já foi consumida no mês e atualiza a variável global consumoMensal.
+			Apenas as tomadas ouvidas nesta sincronização são somadas, para que o último consumo de uma tomada não seja somado mais de uma vez.
 		*/
-		void administrar() {
+		void atualizaConsumoMensal() {
+			if (modoAgregacao != AGREGACAO_DIRETA) { // A soma já inclui o consumo da própria tomada.
+				consumoMensal += agregadoSistema.ultimoConsumo;
+				return;
+			}
+			for (int k = 0; k < quantidadeSoquetes; k++) {
+				if (tomadas[k]->estaLigada()) {
+					consumoMensal += soquetes.ultimoConsumo[k];
+				}
+			}
+			consumoMensal += pool.somarUltimoConsumo(epocaAtual);
+		}
 
-			// Entrando em um novo mês
-			if (quantidadeDeSincs == 0) {
-				consumoMensal = 0;
-				calculaQuantidadeDeSincs();
+		/*!
+			Método que inicializa todos os valores do histórico e o estado de cada soquete.
+		*/
+		void inicializarHistorico() {
+			for (int k = 0; k < quantidadeSoquetes; k++) {
+				soquetes.historico[k].zerar();
+				soquetes.consumo[k] = 0;
+				soquetes.somaNivel[k] = 0;
+				soquetes.ultimoConsumo[k] = 0;
+				soquetes.consumoPrevisto[k] = 0;
+				soquetes.prioridade[k] = 0;
+				soquetes.podeDesligar[k] = false;
+				soquetes.temDimmer[k] = (tomadas[k]->getTipo() == 2);
+				soquetes.ligado[k] = tomadas[k]->estaLigada();
+				soquetes.dimerizacao[k] = 1;
 			}
+			soquetes.amostras = 0;
+		}
 
-			cout << "- Previsao." << endl;
-			// Preparando a previsao própria.
-			float ultimoConsumo = consumoProprio;
-			cout << "  Consumo efetivo do ultimo periodo: " << ultimoConsumo << endl;
-			atualizaHistorico(ultimoConsumo);
-			fazerPrevisaoConsumoProprio();
+	public:
+
+		/*!
+			Método construtor da classe.
+ 			\param t são os soquetes a serem controlados.
+ 			\param quantidade é a quantidade de soquetes (no máximo NUMERO_SOQUETES).
+ 			\sa inicializarHistorico(), Calendario
+		*/
+		Gerente(TomadaInteligente** t, int quantidade) {
+			BaseDeTempo::iniciar();
+			quantidadeSoquetes = (quantidade > NUMERO_SOQUETES) ? NUMERO_SOQUETES : quantidade;
+			for (int k = 0; k < quantidadeSoquetes; k++) {
+				tomadas[k] = t[k];
+			}
+			relogio = memoriaRelogio.construir();
+			calendario = memoriaCalendario.construir(relogio);
+			mensageiro = memoriaMensageiro.construir();
+			sincronizadorTempo = memoriaSincronizador.construir(relogio, mensageiro->obterEnderecoNIC());
+			mensageiro->setSincronizadorDeTempo(sincronizadorTempo);
+			hash = memoriaTabela.construir();
+			agregador = memoriaAgregador.construir(mensageiro);
+			cluster = memoriaCluster.construir(mensageiro);
+			cicloRadio = memoriaCicloRadio.construir(mensageiro);
+			alerta = memoriaAlerta.construir(mensageiro, cicloRadio);
+			consultaHistorico = memoriaConsultaHistorico.construir(mensageiro, cicloRadio);
+			leitorUSB = memoriaLeitorUSB.construir();
+			gateway = memoriaGateway.construir();
+			medidor = memoriaMedidor.construir(tomadas, quantidadeSoquetes);
+			dentroDoLimite = false;
+			limitePotenciaGrupo = 0;
+			reproduzindo = false;
+			inicioSinc = 0;
+			sincronizando = false;
+			tempoDeSinc = 0;
+			proximoEnvio = 0;
+			enviosSinc = 0;
+			enviosJanela = REPETICOES_SINC_MAXIMO;
+			consumoUltimoPeriodo = 0;
+			modoAgregacao = AGREGACAO_DIRETA;
+			temDecisaoCluster = false;
+			quantidadeTomadas = 0;
+			soquetesDoGrupo = 0;
+			for (int g = 0; g < NUMERO_GRUPOS; g++) {
+				grupos.epoca[g] = (unsigned long) -1;
+				grupos.consumoMensal[g] = 0;
+				grupos.maximoConsumoMensal[g] = 0;
+			}
 
-			cout << "  Previsao propria ate o fim do mes: " << (long long int) consumoProprioPrevisto << endl;
+			maximoConsumoMensal = 72000000; //consumo máximo padrão
 
-			cout << "- Prepadando dados para enviar." << endl;
-			// Preparando Dados para enviar.
-			Dados dadosEnviar;
-			dadosEnviar = preparaEnvio();
+			consumoMensal = 0;
+			consumoProprio = 0;
+			consumoProprioPrevisto = 0;
+			consumoTotalPrevisto = 0;
 
-			cout << "- Entrando em sincronizacao." << endl;
-			// Sincronização entre as placas.
-			sincronizar(dadosEnviar);
-			cout << "  Placas sincronizadas." << endl;
+			inicializarHistorico();
 
-			cout << "- Dados obtidos:" << endl;
-			printHash();
+			quantidadeDeEpocas = calendario->getEpocasAteFimDoMes();
 
-			cout << "- Dados proprios:" << endl;
-			cout << "   Placa " << mensageiro->obterEnderecoNIC() << ":" << endl;
-			cout << "    Consumo previsto: .. " << (long long int) consumoProprioPrevisto << endl;
-			cout << "    Ultimo consumo: .... " << ultimoConsumo << endl;
-			cout << "    Prioridade: ........ " << dadosEnviar.prioridade << endl;
+			epocaAtual = calendario->getEpoca();
+			epocasDoPeriodo = adaptacao.getEpocasEntreSincs();
+			for (int i = 0; i < SINCS_PARA_EXPIRAR; i++) {
+				sincsRecentes[i] = 0;
+			}
+			proximaSincRecente = 0;
+			tamanhoInstantaneo = 0;
+			resumoInstantaneo = 0;
+		}
 
-			cout << "- Tomada de decisao:" << endl;
-			// Atualiza as previsões com base nos novos dados recebidos.
-			atualizaConsumoMensal();
-			fazerPrevisaoConsumoTotal(); // Considera todas as tomadas, mesmo as desligadas.
-			cout << "  Consumo total deste mes ate o momento: ............... " << (long long int) consumoMensal << endl;
-			cout << "  Consumo maximo permitido ate o final do mes: ......... " << (long long int) maximoConsumoMensal << endl;
-			cout << "  Consumo total previsto do sistema ate o fim do mes: .. " << (long long int) (consumoTotalPrevisto+consumoMensal) << endl;
-			// Toma decisões dependendo de como está o consumo do sistema.
-			administrarConsumo();
+		/*!
+			Método que retorna a quantidade de tomadas vivas, isto é, ouvidas nas últimas SINCS_PARA_EXPIRAR sincronizações.
+			\return Quantidade de outras tomadas na tabela.
+		*/
+		int getQuantidadeTomadasVivas() {
+			return quantidadeTomadas;
+		}
 
-			// Atualiza a variável de controle que indica quantas verificações ainda serão feitas dentro desse mês.
-			quantidadeDeSincs--;
-			consumoProprio = 0;
+		/*!
+			Método que altera o valor do consumo mensal máximo para o valor passado por parâmetro.
+			\param consumo é o consumo máximo mensal.
+		*/
+		void setConsumoMensalMaximo(float consumo) {
+			maximoConsumoMensal = consumo;
+		}
+
+		/*!
+			Método que envia mensagem para as outras tomadas.
+		*/
+		void enviarMensagemBroadcast(Dados d) {
+			mensageiro->enviarBroadcast(d);
 		}
 
 		/*!
-			Método que prepara os dados a serem enviados para as outras tomadas.
-			\return Dados a serem enviados com os valores atuais da tomada.
- 			\sa prioridadeAtual()
+			Método que trata as mensagens recebidas pela tarefa do rádio desde a última chamada.
+			\return Último comando de configuração executado, ou 0.
 		*/
-		Dados preparaEnvio() {
-			Dados dados;
-			dados.remetente = mensageiro->obterEnderecoNIC();
-			//dados.ligada = tomada->estaLigada();
-			dados.consumoPrevisto = consumoProprioPrevisto;
-			if (tomada->estaLigada()) {
-				dados.ultimoConsumo = historico[NUMERO_ENTRADAS_HISTORICO - 1];
-			} else {
-				dados.ultimoConsumo = 0;
+		int tratarMensagensRecebidas() {
+			int comandoExecutado = 0;
+			Quadro quadro;
+			long long chegada = 0;
+			Protocol protocolo = mensageiro->receberQuadro(&quadro, &chegada);
+			while (protocolo != 0) {
+				int comando = tratarQuadro(protocolo, quadro);
+				if (comando != 0) {
+					comandoExecutado = comando;
+				}
+				latenciaMensagens.registrar(mensageiro->tempoDesde(chegada)); // Da chegada ao fim do tratamento (incluindo a decisão, se houve).
+				protocolo = mensageiro->receberQuadro(&quadro, &chegada);
 			}
-
-			dados.configuracao[0] = '\0';
-			dados.prioridade = prioridadeAtual();
-			dados.podeDesligar = podeDesligarAtual();
-			return dados;
+			return comandoExecutado;
 		}
 
 		/*!
-			Método que sincroniza as placas, enviando e recebendo mensagens com dados.
-			\param dadosEnviar é a struct que contém os dados que esta placa estará enviando.
-			\sa enviarMensagemBroadcast(), atualizaHash()
+			Método que trata uma mensagem recebida das outras tomadas, conforme o protocolo.
+			Dados de outras tomadas só entram na tabela durante a sincronização. Comandos de configuração são executados a qualquer momento.
+			\param protocolo é o protocolo da mensagem.
+			\param quadro é a mensagem.
+			\return Comando de configuração executado, ou 0.
 		*/
-		void sincronizar(Dados dadosEnviar) {
-			Dados* dadosRecebidos;
-			Hash_Element* elemento; // Elemento da hash.
-
-			Chronometer* cronSinc = new Chronometer();
-
-			long long tempoDeSinc = INTERVALO_ENVIO_MENSAGENS*60*1000000; // Minutos pra Microssegundos.
-			long long nextSend = 0;
-			long long nextReceive = 0;
-			cronSinc->reset();
-			cronSinc->start();
-			long long cronTime = cronSinc->read();
+		int tratarQuadro(Protocol protocolo, const Quadro& quadro) {
+			int comandoExecutado = 0;
+			CarimboDeTempo carimbo;
+			memcpy(&carimbo, &quadro, sizeof(CarimboDeTempo)); // Todas as mensagens começam com o carimbo.
+			bool mesmoGrupo = (carimbo.grupo == mensageiro->getGrupo());
+			if (sincronizando && mesmoGrupo) {
+				adaptacao.ouvirProposta(carimbo);
+			}
 
-			while (cronTime < tempoDeSinc) {
-				if (cronTime >= nextSend) {
-					enviarMensagemBroadcast(dadosEnviar);
-					nextSend += tempoDeSinc/15; // 15 envios durante a sincronização.
-				} else if (cronTime >= nextReceive) {
-					dadosRecebidos = receberMensagem();
-					elemento = new Hash_Element(dadosRecebidos,dadosRecebidos->remetente); // Hash é indexada pelo endereço da tomada.
-					atualizaHash(elemento);
-					nextReceive += tempoDeSinc/300; // Recebe 300 vezes durante a sincronização.
+			if (protocolo == PROTOCOLO_DADOS) {
+				Dados dadosRecebidos;
+				memcpy(&dadosRecebidos, quadro.dados, sizeof(Dados));
+				if (dadosRecebidos.configuracao[0] != '\0') { // Comandos valem para todos os grupos; o destino é verificado em processarComando().
+					// Reenvio é false pois mensagens recebidas por NIC ja são reenvio.
+					comandoExecutado = processarComando(dadosRecebidos.configuracao, false);
+				} else {
+					gateway->encaminhar(dadosRecebidos, relogio->agora(), false);
+					acompanharGrupo(carimbo.grupo, dadosRecebidos.epoca, dadosRecebidos.consumoMensal, dadosRecebidos.maximoConsumoMensal);
+					if (sincronizando && mesmoGrupo) {
+						atualizaHash(dadosRecebidos);
+					}
+				}
+			} else if (protocolo == PROTOCOLO_REGUA) { // Dados de todos os soquetes de uma placa.
+				MensagemRegua regua;
+				memcpy(&regua, quadro.regua, sizeof(MensagemRegua));
+				gateway->encaminhar(regua, relogio->agora());
+				acompanharGrupo(carimbo.grupo, regua.epoca, regua.consumoMensal, regua.maximoConsumoMensal);
+				if (sincronizando && mesmoGrupo) {
+					atualizaHash(regua);
+				}
+			} else if (!mesmoGrupo && (protocolo != PROTOCOLO_HISTORICO)) {
+				// Agregação, clusters e alertas de outros grupos não afetam as decisões deste grupo.
+			} else if (protocolo == PROTOCOLO_AGREGACAO) { // Mensagens de agregação são entregues ao agregador.
+				MensagemAgregacao agregacao;
+				memcpy(&agregacao, quadro.agregacao, sizeof(MensagemAgregacao));
+				agregador->receber(agregacao);
+			} else if (protocolo == PROTOCOLO_CLUSTER) { // Mensagens de cluster são entregues ao cluster.
+				MensagemCluster msgCluster;
+				memcpy(&msgCluster, quadro.cluster, sizeof(MensagemCluster));
+				cluster->receber(msgCluster);
+			} else if (protocolo == PROTOCOLO_ALERTA) { // Alertas são tratados imediatamente.
+				MensagemAlerta msgAlerta;
+				memcpy(&msgAlerta, quadro.alerta, sizeof(MensagemAlerta));
+				if (!alerta->receber(msgAlerta)) {
+					// Alerta já tratado.
+				} else if (msgAlerta.motivo == ALERTA_DISPARO_POTENCIA) { // O corte de outra tomada não muda a decisão.
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_DISPARO_RECEBIDO, RegistroDeEventos::endereco(msgAlerta.origem), msgAlerta.soquete, msgAlerta.potencia);
+				} else {
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_ALERTA_RECEBIDO, RegistroDeEventos::endereco(msgAlerta.origem));
+					reagirAlerta(msgAlerta);
+				}
+			} else if (protocolo == PROTOCOLO_HISTORICO) { // Consultas de histórico, pedidas por outra tomada ou respondidas a esta.
+				MensagemHistorico historico;
+				memcpy(&historico, quadro.historico, sizeof(MensagemHistorico));
+				if (historico.tipo == HISTORICO_PEDIDO) {
+					responderHistorico(historico);
+				} else {
+					consultaHistorico->receber(historico, relogio->agora());
 				}
-				cronTime = cronSinc->read();
 			}
-			delete cronSinc;
+			return comandoExecutado;
 		}
 
 		/*!
-			Método que verifica se consumo previsto está acima do m´sximo e se alguma decisão deve ser tomada.
- 			\sa mantemConsumoDentroDoLimite()
+			Método que responde a um pedido de histórico com as entradas pedidas que ainda estão no anel, até VALORES_POR_QUADRO_HISTORICO.
+			A resposta não depende de pedidos anteriores, então uma consulta interrompida pode ser retomada a qualquer momento.
+			\param pedido é o pedido recebido.
 		*/
-		void administrarConsumo() {
-			// Se o consumo até agora somado à previsão de consumo até o fim do mês ficam acima do consumo máximo.
-			if ((consumoMensal + consumoTotalPrevisto > maximoConsumoMensal) && podeDesligarAtual()) {
-				cout << "  A previsao passa do limite." << endl;
-				mantemConsumoDentroDoLimite(); // Desliga as tomadas necessárias para manter o consumo dentro do limite.
-			} else { // Se o consumo está dentro do limite ou se a tomada não pode ser desligada
-				if (podeDesligarAtual()) {
-					cout << "  A previsao esta dentro do limite. Posso ligar." << endl;
-				} else {
-					cout << "  Estou configurada para nao desligar. Fico ligada." << endl;
+		void responderHistorico(const MensagemHistorico& pedido) {
+			MensagemHistorico resposta;
+			memset(&resposta, 0, sizeof resposta);
+			resposta.remetente = mensageiro->obterEnderecoNIC();
+			resposta.tipo = HISTORICO_RESPOSTA;
+			resposta.camada = pedido.camada;
+			resposta.soquete = pedido.soquete;
+			resposta.consulta = pedido.consulta;
+			resposta.primeiro = pedido.primeiro;
+			resposta.total = 0;
+			resposta.quantidade = 0;
+			if ((pedido.soquete >= 0) && (pedido.soquete < quantidadeSoquetes) && (pedido.camada <= CAMADA_DIAS)) {
+				const HistoricoEmCamadas& historico = soquetes.historico[pedido.soquete];
+				unsigned long disponivel = historico.primeiroDisponivel(pedido.camada);
+				resposta.total = historico.total(pedido.camada);
+				if (resposta.primeiro < disponivel) {
+					resposta.primeiro = disponivel;
 				}
-				// Liga todas as tomadas
-				if (tomada->getTipo() == 2) {
-					static_cast<TomadaMulti*>(tomada)->setDimerizacao(1);
+				while ((resposta.quantidade < VALORES_POR_QUADRO_HISTORICO) && (resposta.quantidade < pedido.quantidade)
+						&& (resposta.primeiro + resposta.quantidade < resposta.total)) {
+					resposta.valores[resposta.quantidade] = historico.entrada(pedido.camada, resposta.primeiro + resposta.quantidade);
+					resposta.quantidade++;
 				}
-				tomada->ligar();
 			}
+			if (resposta.primeiro > resposta.total) {
+				resposta.primeiro = resposta.total; // Resposta vazia: primeiro nunca passa de total, ou o solicitante a descartaria.
+			}
+			mensageiro->enviar(pedido.remetente, PROTOCOLO_HISTORICO, &resposta, sizeof resposta);
 		}
 
 		/*!
-			Método que atualiza o vetor de histórico de consumo da tomada com o novo consumo. Consumo nulo(tomada desligada) não é inserido.
-			\param novo é o consumo atual da tomada que será inserido no histórico.
+			Método que atualiza o resumo de um grupo de orçamento com o que uma de suas tomadas anunciou. O grupo é o índice do resumo.
+			\param g é o grupo do remetente.
+			\param epoca é a época da mensagem.
+			\param consumo é o consumo do grupo no mês, segundo o remetente.
+			\param limite é o consumo máximo mensal configurado no remetente.
 		*/
-		void atualizaHistorico(float novo) {
-			if (tomada->estaLigada()) {
-				int i;
-				for (i = 0; i < (NUMERO_ENTRADAS_HISTORICO - 1); i++) {
-					historico[i] = historico[i+1];
-				}
-				// Consumo novo é adicionado no fim do vetor para manter coerência com a lógica da previsão de consumo
-				historico[NUMERO_ENTRADAS_HISTORICO - 1] = novo;
+		void acompanharGrupo(int g, unsigned long epoca, float consumo, float limite) {
+			if (g >= NUMERO_GRUPOS) {
+				return;
+			}
+			if (grupos.epoca[g] != epoca) {
+				grupos.epoca[g] = epoca;
+				grupos.consumoMensal[g] = consumo;
+				grupos.maximoConsumoMensal[g] = limite;
+				return;
+			}
+			if (consumo > grupos.consumoMensal[g]) {
+				grupos.consumoMensal[g] = consumo;
+			}
+			if (limite < grupos.maximoConsumoMensal[g]) {
+				grupos.maximoConsumoMensal[g] = limite;
 			}
 		}
 
 		/*!
-			Método que atualiza a entrada da hash correspondente ao elemente passado por parâmetro. Se ele não existir, é adicionado.
-			\param e é o elemento a ser atualizado ou adicionado na hash.
+			Método que registra o resumo dos outros grupos ouvidos na época atual.
 		*/
-		void atualizaHash(Hash_Element* e) {
-			Hash_Element* foundElement = hash->search_key(e->object()->remetente);
-			if (foundElement != 0) {  // Se uma entrada para a tomada passada já existe
-
-				Dados* d =  foundElement->object();
-				//d->ligada = e->object()->ligada;
-				d->consumoPrevisto = e->object()->consumoPrevisto;
-				d->ultimoConsumo = e->object()->ultimoConsumo;
-				d->prioridade = e->object()->prioridade;
-
-				for (int i; i < NUMERO_CHAR_CONFIG; i++) {
-					d->configuracao[i] = e->object()->configuracao[i];
+		void registrarGrupos() {
+			for (int g = 0; g < NUMERO_GRUPOS; g++) {
+				if ((g != mensageiro->getGrupo()) && (grupos.epoca[g] == epocaAtual)) {
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_RESUMO_GRUPO, g, (int) grupos.consumoMensal[g], (int) grupos.maximoConsumoMensal[g]);
 				}
-				d->configuracao[NUMERO_CHAR_CONFIG] = '\0';
-
-				d->podeDesligar = e->object()->podeDesligar;
-				delete e->object();
-				delete e;
-
-			} else if (e->object()->prioridade != -1) {
-				// Se elemento não está na hash e não é um elemento "vazio"(prioridade é igual a -1 quando não há mensagem recebida)
-				hash->insert(e);
-			} else if (e->object()->prioridade == -1) {
-				delete e->object();
-				delete e;
 			}
 		}
 
 		/*!
-			Método que calcula quanta energia já foi consumida no mês e atualiza a variável global consumoMensal.
+			Método que passa ao medidor a parte da placa no limite de pico do grupo: uma parte igual por soquete do grupo.
+			Como as partes somam o limite do grupo, o grupo não passa do limite mesmo que todas as tomadas tenham um pico ao mesmo tempo.
+			A contagem vem da tabela no modo direto, da estimativa do gossip ou da decisão do cluster. Sem contagem nesta sincronização vale a última
+			conhecida, e nunca uma menor que a da tabela; sem nenhuma, a de um grupo que enche a tabela. Contar soquetes a mais só diminui a parte.
 		*/
-		void atualizaConsumoMensal() {
-			if (tomada->estaLigada()) {
-				consumoMensal += historico[NUMERO_ENTRADAS_HISTORICO - 1];
+		void atualizarLimitePlaca() {
+			if (modoAgregacao == AGREGACAO_DIRETA) {
+				soquetesDoGrupo = quantidadeTomadas + quantidadeSoquetes;
 			}
-			for(auto iter = hash->begin(); iter != hash->end(); iter++) {
-				// Se iter não é vazio: begin() retorna um objeto vazio no inicio por algum motivo
-				if (iter != 0) {
-					consumoMensal += iter->object()->ultimoConsumo;
-				}
+			int soquetesContados = (soquetesDoGrupo > 0) ? soquetesDoGrupo : NUMERO_MAXIMO_TOMADAS - 1 + quantidadeSoquetes;
+			if (soquetesContados < quantidadeTomadas + quantidadeSoquetes) {
+				soquetesContados = quantidadeTomadas + quantidadeSoquetes;
 			}
+			medidor->setLimitePlaca((limitePotenciaGrupo * quantidadeSoquetes) / soquetesContados);
 		}
 
 		/*!
-			Método que inicializa todos os valores do histórico para 0.
+			Método que registra um corte feito pelo limite de pico e avisa as outras tomadas do grupo.
+			\param disparo é o corte entregue pelo medidor.
 		*/
-		void inicializarHistorico() {
-			for (int i = 0; i < NUMERO_ENTRADAS_HISTORICO; i++) {
-				historico[i] = 0;
-			}
+		void avisarDisparo(const DisparoDePotencia& disparo) {
+			int k = disparo.soquete;
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_DISPARO_POTENCIA, k, disparo.peloGrupo ? 1 : 0, disparo.potencia, disparo.latencia);
+			MensagemAlerta msg;
+			memset(&msg, 0, sizeof msg);
+			msg.instanteDeteccao = relogio->agora();
+			msg.soquete = k;
+			msg.prioridade = prioridadeAtual(k);
+			msg.podeDesligar = podeDesligarAtual(k);
+			msg.consumoPrevistoAnterior = soquetes.consumoPrevisto[k];
+			msg.consumoPrevisto = soquetes.consumoPrevisto[k];
+			msg.maximoConsumoMensal = maximoConsumoMensal;
+			msg.motivo = ALERTA_DISPARO_POTENCIA;
+			msg.potencia = (short) disparo.potencia;
+			alerta->enviar(&msg);
 		}
 
-	public:
-
 		/*!
-			Método construtor da classe.
- 			\param t é a tomada a ser controlada.
- 			\sa inicializarHistorico(), calculaQuantidadeDeSincs()
+			Método que remove todas as entradas da tabela. Usado quando a placa muda de grupo: a tabela volta a ser preenchida na próxima sincronização, só com o novo grupo.
 		*/
-		Gerente(TomadaInteligente* t) {
-			tomada = t;
-			relogio =  new Relogio();
-			mensageiro = new Mensageiro();
-			hash = new Tabela();
-
-			maximoConsumoMensal = 72000000; //consumo máximo padrão
-
-			consumoMensal = 0;
-			consumoProprio = 0;
-			consumoProprioPrevisto = 0;
-			consumoTotalPrevisto = 0;
+		void esvaziarTabela() {
+			Address removidas[NUMERO_MAXIMO_TOMADAS];
+			int soquetesRemovidos[NUMERO_MAXIMO_TOMADAS];
+			int quantidadeRemovidas = 0;
 
-			historico = new float[NUMERO_ENTRADAS_HISTORICO];
-			inicializarHistorico();
-
-			calculaQuantidadeDeSincs();
+			// As entradas são removidas depois de percorrer a tabela, para não alterar a hash durante a iteração.
+			for(auto iter = hash->begin(); iter != hash->end(); iter++) {
+				// Se iter não é vazio: begin() retorna um objeto vazio no inicio por algum motivo
+				if ((iter != 0) && (quantidadeRemovidas < NUMERO_MAXIMO_TOMADAS)) {
+					removidas[quantidadeRemovidas] = iter->object()->remetente;
+					soquetesRemovidos[quantidadeRemovidas] = iter->object()->soquete;
+					quantidadeRemovidas++;
+				}
+			}
+			for (int i = 0; i < quantidadeRemovidas; i++) {
+				removerTomada(removidas[i], soquetesRemovidos[i]);
+			}
 		}
 
 		/*!
-			Método que altera o valor do consumo mensal máximo para o valor passado por parâmetro.
-			\param consumo é o consumo máximo mensal.
+			Método que atualiza o valor da previsão do consumo de cada soquete até o fim do mês. A soma dos soquetes é armazenada na variável global consumoProprioPrevisto.
+			\sa Previsor
 		*/
-		void setConsumoMensalMaximo(float consumo) {
-			maximoConsumoMensal = consumo;
+		void fazerPrevisaoConsumoProprio() {
+			/* Cada previsão é a previsão de uma época. Assim, esse valor é multiplicado por quantas épocas faltam para acabar o mês para depois sabermos se o consumo está dentro do limite.*/
+			consumoProprioPrevisto = 0;
+			for (int k = 0; k < quantidadeSoquetes; k++) {
+				float retorno = Previsor::preverConsumoProprio(soquetes.historico[k]);
+				soquetes.consumoPrevisto[k] = retorno * quantidadeDeEpocas;
+				consumoProprioPrevisto += soquetes.consumoPrevisto[k];
+			}
 		}
 
 		/*!
-			Método que envia mensagem para as outras tomadas.
+			Método que atualiza o valor da previsão do consumo total das tomadas até o fim do mês. O valor é armazenado na variável global consumoTotalPrevisto.
 		*/
-		void enviarMensagemBroadcast(Dados d) {
-			mensageiro->enviarBroadcast(d);
+		void fazerPrevisaoConsumoTotal() {
+			if (modoAgregacao != AGREGACAO_DIRETA) {
+				consumoTotalPrevisto = Previsor::preverConsumoTotal(agregadoSistema);
+			} else {
+				consumoTotalPrevisto = Previsor::preverConsumoTotal(pool, consumoProprioPrevisto, epocaAtual);
+			}
 		}
 
 		/*!
-			Método que recebe mensagem das outras tomadas.
-			\return Ponteiro de Dados que indica os dados recebidos.
+			Método executado pela tarefa de amostragem: integra os blocos de amostras e entrega o consumo de cada soquete a cada SEGS_ENTRE_CONSUMO segundos.
+			\param g é o gerente.
+			\return Nunca retorna.
 		*/
-		Dados* receberMensagem() {
-			return mensageiro->receberMensagem();
+		static int tarefaAmostragem(Gerente* g) {
+			AmostraDeConsumo amostra;
+			while (true) {
+				if (g->medidor->integrarBloco(amostra.consumo)) {
+					g->filaAmostras.inserir(amostra);
+				}
+			}
+			return 0;
 		}
 
 		/*!
-			Método que atualiza o valor da previsão do consumo da tomada até o fim do mês. O valor é armazenado na variável global consumoProprioPrevisto.
-			\sa Previsor
+			Método executado pela tarefa de comandos: espera as linhas recebidas por USB e as passa à tarefa de decisão.
+			\param g é o gerente.
+			\return Nunca retorna.
 		*/
-		void fazerPrevisaoConsumoProprio() {
-			/* Cada previsão a previsão até o próxima sincronização. Assim, esse valor é multiplicado por quantas sincronizações faltam para acabar o mês para depois sabermos se o consumo está dentro do limite.*/
-			float retorno = Previsor::preverConsumoProprio(historico);
-			consumoProprioPrevisto = retorno * quantidadeDeSincs;
+		static int tarefaComandos(Gerente* g) {
+			while (true) {
+				LinhaDeComando linha;
+				if (g->leitorUSB->lerLinha(linha.texto, NUMERO_CHAR_CONFIG)) {
+					g->filaComandos.inserir(linha);
+				}
+			}
+			return 0;
 		}
 
 		/*!
-			Método que atualiza o valor da previsão do consumo total das tomadas até o fim do mês. O valor é armazenado na variável global consumoTotalPrevisto.
+			Método que executa uma volta da tarefa de decisão: a sincronização entre as tomadas e a sua administração.
+			O tempo é lido uma vez, no início da volta (BaseDeTempo::marcarPasso()), e as entradas tratadas na volta são gravadas pela CapturaDeTrafego.
+			Uma volta em que só o tempo mudou o estado da tomada também é marcada na captura, para que a reprodução a execute no mesmo instante.
+			\sa administrar(), passoSincronizacao(), tratarMensagensRecebidas()
 		*/
-		void fazerPrevisaoConsumoTotal() {
-			consumoTotalPrevisto = Previsor::preverConsumoTotal(hash, consumoProprioPrevisto);
+		void passo() {
+			CapturaDeTrafego::novoPasso(BaseDeTempo::marcarPasso());
+			unsigned long long agora = relogio->agora();
+			int eventos = calendario->verificar(agora);
+			bool marcar = (eventos != 0);
+
+			if (eventos & CALENDARIO_MES) { // Entrando em um novo mês.
+				consumoMensal = 0;
+				adaptacao.esquecerPrevisao();
+			}
+			if (eventos & CALENDARIO_EPOCA) {
+				medidor->rearmar(); // Os soquetes cortados pelo limite de pico voltam a seguir a decisão.
+			}
+			if ((eventos & CALENDARIO_SINCRONIZACAO) && !sincronizando) { // Sincronizar e Administrar.
+				administrar();
+			}
+			AmostraDeConsumo amostra;
+			while (filaAmostras.retirar(&amostra)) { // Incrementa o consumo, inclusive durante a sincronização.
+				if (!reproduzindo) { // Na reprodução, a dimmerização aplicada vem da captura.
+					for (int k = 0; k < quantidadeSoquetes; k++) {
+						amostra.nivel[k] = nivelAplicado(k);
+					}
+				}
+				CapturaDeTrafego::amostra(amostra, quantidadeSoquetes);
+				for (int k = 0; k < quantidadeSoquetes; k++) {
+					soquetes.consumo[k] += amostra.consumo[k];
+					soquetes.somaNivel[k] += amostra.nivel[k];
+					consumoProprio += amostra.consumo[k];
+				}
+				soquetes.amostras++;
+				verificarExcesso(&amostra);
+				acompanharOrcamento(amostra);
+			}
+			DisparoDePotencia disparo;
+			while (medidor->retirarDisparo(&disparo)) { // Cortes já feitos pela interrupção de amostragem.
+				CapturaDeTrafego::disparo(disparo);
+				avisarDisparo(disparo);
+			}
+
+			// Verifica mensagens de configuração e as mensagens das outras tomadas.
+			configuracaoViaUSB();
+			tratarMensagensRecebidas();
+			if (sincronizando && passoSincronizacao()) {
+				marcar = true;
+			}
+
+			bool radioLigado = cicloRadio->radioLigado();
+			if (cicloRadio->atualizar(agora, (eventos & CALENDARIO_HORA) != 0, sincronizadorTempo->estaSincronizada())) {
+				alerta->janelaAberta();
+				marcar = true;
+			}
+			if (cicloRadio->radioLigado() != radioLigado) {
+				marcar = true;
+			}
+			if (consultaHistorico->verificar(agora)) {
+				marcar = true;
+			}
+			if (marcar) {
+				CapturaDeTrafego::marcarPasso();
+			}
 		}
 
 		/*!
-			Método que realiza a sincronização entre as tomadas e a sua administração.
-			\sa administrar(), pausa()
+			Método que cria as tarefas do rádio, de amostragem e de comandos e executa a tarefa de decisão.
+			Somente a tarefa de decisão usa a tabela, o relógio e o estado da tomada, então a tabela não muda enquanto uma decisão é calculada.
+			\sa passo()
 		*/
 		void iniciar() {
-
-			long long tempoEntreSincs = MIN_ENTRE_SINC * 60 * 1000000.0;
-			long long tempoEntreConsumos = SEGS_ENTRE_CONSUMO * 1000000.0;
-
-			Data data;
-			long long tempoDecorridoEntreSinc;
-			long long tempoDecorridoEntreCons;
-
-			// Variáveis para verificar se houve a transição no módulo do calculo do tempoDecorridoEntreSinc e do tempoDecorridoEntreCons.
-			long long ultimoTDES = 0;
-			long long ultimoTDEC = 0;
+			Thread::Configuration configuracao(Thread::READY, Thread::NORMAL, TAMANHO_PILHA_TAREFA);
+			memoriaTarefaRadio.construir(configuracao, &Mensageiro::tarefaRadio, mensageiro);
+			memoriaTarefaAmostragem.construir(configuracao, &Gerente::tarefaAmostragem, this);
+			memoriaTarefaComandos.construir(configuracao, &Gerente::tarefaComandos, this);
+			CapturaDeTrafego::iniciar(mensageiro->obterEnderecoNIC());
 
 			while (true) {
-				data = relogio->getData();
-				tempoDecorridoEntreSinc =  ((long long) (data.minuto*60*1000000.0 + data.segundo*1000000.0 + data.microssegundos)) % tempoEntreSincs;
-				tempoDecorridoEntreCons = ((long long) (data.segundo*1000000.0 + data.microssegundos)) % tempoEntreConsumos;
+				passo();
+				Thread::yield();
+			}
+		}
 
-				if (tempoDecorridoEntreSinc < ultimoTDES) { // Sincronizar e Administrar.
-					administrar();
-					consumoProprio += tomada->getConsumo() * (MIN_ENTRE_SINC*60) / SEGS_ENTRE_CONSUMO; // Para compensar os consumos que não foram obtidos durante a sincronização.
-				} else if (tempoDecorridoEntreCons < ultimoTDEC) { // Incrementa o consumo.
-					consumoProprio += tomada->getConsumo();
+		/*!
+			Método que lê, do USB, o início de uma captura e faz a placa se passar pela que a gravou. Chamado antes da construção do gerente,
+			pois vários objetos guardam o próprio endereço ao serem construídos.
+			\sa reproduzir(), Mensageiro::reproduzirComo()
+		*/
+		static void prepararReproducao() {
+			unsigned char tipo;
+			unsigned char dados[CapturaDeTrafego::TAMANHO_MAXIMO_REGISTRO];
+			while (true) {
+				int tamanho = LeitorUSB::lerQuadroCapturado(&tipo, dados);
+				if ((tamanho == 3 + (int) sizeof(Address)) && (tipo == CAPTURA_INICIO) && (dados[0] == VERSAO_CAPTURA)
+						&& (dados[1] == NUMERO_SOQUETES) && (dados[2] == sizeof(Address))) {
+					break;
 				}
+			}
+			Address endereco;
+			memcpy(&endereco, dados + 3, sizeof(Address));
+			Mensageiro::reproduzirComo(endereco);
+			BaseDeTempo::setTempoVirtual(0);
+		}
 
-				// Verifica mensagens de configuração.
-				int comandoExecutadoUSB = configuracaoViaUSB();
-				int comandoExecutadoNIC = configuracaoViaNIC();
+		/*!
+			Método que reproduz uma captura recebida por USB (REPRODUCAO_TRAFEGO), no lugar de iniciar(). As mensagens, amostras, comandos e cortes
+			da captura são entregues à tarefa de decisão nas mesmas voltas e com o mesmo tempo da gravação, então ela toma as mesmas decisões
+			e envia as mesmas mensagens, gravadas em uma nova captura para comparação. O rádio e a amostragem ficam parados.
+			\sa passo(), prepararReproducao()
+		*/
+		void reproduzir() {
+			reproduzindo = true;
+			medidor->parar();
+			CapturaDeTrafego::iniciar(mensageiro->obterEnderecoNIC());
+
+			EstatisticaLatencia voltas;
+			bool pendente = false; // Há uma volta com as entradas já entregues esperando o próximo passo.
+			unsigned char tipo;
+			unsigned char dados[CapturaDeTrafego::TAMANHO_MAXIMO_REGISTRO];
+			while (true) {
+				int tamanho = LeitorUSB::lerQuadroCapturado(&tipo, dados);
+				if (tamanho < 0) {
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_ERRO>(EVENTO_CAPTURA_INVALIDA);
+					continue;
+				}
+				if (pendente && ((tipo == CAPTURA_PASSO) || (tipo == CAPTURA_FIM))) {
+					long long inicio = BaseDeTempo::lerReal();
+					passo();
+					voltas.registrar(BaseDeTempo::lerReal() - inicio);
+					pendente = false;
+				}
 
-				// Se o comando executado foi um comando que altera o relógio devemos ignorar os ultimos "tempos decorridos" antes dessa alteração.
-				if ((comandoExecutadoUSB == 3) || (comandoExecutadoNIC == 3)) {
-					ultimoTDES = 0;
-					ultimoTDEC = 0;
-				} else {
-					ultimoTDES = tempoDecorridoEntreSinc;
-					ultimoTDEC = tempoDecorridoEntreCons;
+				if (tipo == CAPTURA_PASSO) {
+					unsigned long long decorrido = 0;
+					for (int i = 0; (i < tamanho) && (i < 10); i++) {
+						decorrido |= ((unsigned long long) (dados[i] & 0x7f)) << (7 * i);
+					}
+					BaseDeTempo::setTempoVirtual(BaseDeTempo::ler() + (long long) decorrido);
+					pendente = true;
+				} else if ((tipo == CAPTURA_RECEBIDO) && (tamanho >= 6)) {
+					Protocol protocolo = (Protocol) (dados[0] | (dados[1] << 8));
+					int atraso = (int) (dados[2] | (dados[3] << 8) | (dados[4] << 16) | ((unsigned int) dados[5] << 24));
+					if (!mensageiro->injetar(protocolo, dados + 6, tamanho - 6, atraso)) {
+						RegistroDeEventos::registrar<NIVEL_REGISTRO_ERRO>(EVENTO_CAPTURA_PERDIDA, 1);
+					}
+				} else if (tipo == CAPTURA_COMANDO) {
+					LinhaDeComando linha;
+					int quantidade = (tamanho < NUMERO_CHAR_CONFIG - 1) ? tamanho : (NUMERO_CHAR_CONFIG - 1);
+					memcpy(linha.texto, dados, quantidade);
+					linha.texto[quantidade] = '\0';
+					if (!filaComandos.inserir(linha)) {
+						RegistroDeEventos::registrar<NIVEL_REGISTRO_ERRO>(EVENTO_CAPTURA_PERDIDA, 1);
+					}
+				} else if ((tipo == CAPTURA_AMOSTRA) && (tamanho == 2 * quantidadeSoquetes * (int) sizeof(float))) {
+					AmostraDeConsumo amostra;
+					memcpy(amostra.consumo, dados, quantidadeSoquetes * sizeof(float));
+					memcpy(amostra.nivel, dados + quantidadeSoquetes * sizeof(float), quantidadeSoquetes * sizeof(float));
+					if (!filaAmostras.inserir(amostra)) {
+						RegistroDeEventos::registrar<NIVEL_REGISTRO_ERRO>(EVENTO_CAPTURA_PERDIDA, 1);
+					}
+				} else if ((tipo == CAPTURA_DISPARO) && (tamanho == 12)) {
+					DisparoDePotencia disparo;
+					disparo.soquete = dados[0];
+					disparo.peloGrupo = (dados[1] != 0);
+					disparo.passos = dados[2];
+					disparo.potencia = (int) (dados[4] | (dados[5] << 8) | (dados[6] << 16) | ((unsigned int) dados[7] << 24));
+					disparo.latencia = (int) (dados[8] | (dados[9] << 8) | (dados[10] << 16) | ((unsigned int) dados[11] << 24));
+					medidor->reproduzirDisparo(disparo);
+				} else if ((tipo == CAPTURA_PERDA) && (tamanho == 4)) {
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_ERRO>(EVENTO_CAPTURA_PERDIDA,
+						(int) (dados[0] | (dados[1] << 8) | (dados[2] << 16) | ((unsigned int) dados[3] << 24)));
+				} else if (tipo == CAPTURA_FIM) {
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_REPRODUCAO_CONCLUIDA, voltas.getQuantidade(), voltas.getMedia(), voltas.getMaxima());
+					CapturaDeTrafego::fim();
+					voltas.zerar();
 				}
+				// CAPTURA_INICIO e CAPTURA_ENVIADO não são entradas: as mensagens enviadas são refeitas pela própria reprodução.
 			}
 		}
 
 		/*!
-			Método que, baseado no horário atual, descobre a prioridade certa.
-			\return Valor da prioridade da tomada no período atual do dia.
+			Método que, baseado no quarto do dia guardado pelo calendário, descobre a prioridade certa.
+			\param soquete é o soquete consultado.
+			\return Valor da prioridade do soquete no período atual do dia.
 		*/
-		int prioridadeAtual() {
-			Prioridades prioridades = tomada->getPrioridades();
-			Data data = relogio->getData();
-			long long hora = data.hora;
-			int quartosDeDia = (int) hora / 6;
-			switch(quartosDeDia){
+		int prioridadeAtual(int soquete) {
+			Prioridades prioridades = tomadas[soquete]->getPrioridades();
+			switch(calendario->getPeriodo()){
 				case 0:
 					return prioridades.madrugada;
 				case 1:
@@ -1164,134 +6711,193 @@ class Gerente {
 		}
 
 		/*!
-			Método que, baseado no horário atual, descobre se a tomada pode desligar.
-			\return Valor booleano que especifica se a tomada pode desligar.
+			Método que, baseado no quarto do dia guardado pelo calendário, descobre se o soquete pode desligar.
+			\param soquete é o soquete consultado.
+			\return Valor booleano que especifica se o soquete pode desligar.
 		*/
-		int podeDesligarAtual() {
-			Data data = relogio->getData();
-			long long hora = data.hora;
-			int quartosDeDia = (int) hora / 6;
-			return tomada->getPodeDesligar(quartosDeDia);
+		int podeDesligarAtual(int soquete) {
+			return tomadas[soquete]->getPodeDesligar(calendario->getPeriodo());
 		}
 
 		/*!
-			Método que verifica se a tomada deve desligar para manter o consumo mensal dentro do consumo máximo.
+			Método que verifica se algum dos soquetes pode desligar no horário atual.
+			\return Valor booleano que especifica se algum soquete pode desligar.
 		*/
-		void mantemConsumoDentroDoLimite() {
-			// Representa o quanto de consumo ainda resta até atingir o limite do mês.
-			float consumoRestante = maximoConsumoMensal - consumoMensal;
-
-			float sobraDeConsumo = 0;
-			float diferencaConsumo;
+		bool algumPodeDesligar() {
+			for (int k = 0; k < quantidadeSoquetes; k++) {
+				if (podeDesligarAtual(k)) {
+					return true;
+				}
+			}
+			return false;
+		}
 
-			// É o consumo total de todas as tomadas de menor prioridade que esta.
-			float consumoInferiores = 0;
-			// É o consumo total de todas as tomadas de mesma prioridade.
-			float consumoMesmaPioridade = consumoProprioPrevisto;
-			// É o consumo total de todas as tomadas de mesma prioridade e de consumo inferior.
-			float menorConsumoMesmaPrioridade = 0;
-			// Indica se há outras tomadas com a mesma prioridade.
-			bool outrasComMesmaPrioridade = false;
+		/*!
+			Método que monta a visão da tabela usada no plano de corte: os próprios soquetes e as tomadas ouvidas na época atual, já na ordem de corte.
+			Entradas de épocas anteriores ficam de fora, pois as outras tomadas não as ouviram nesta rodada.
+		*/
+		void montarInstantaneo() {
+			int concordam = 0;
 
+			tamanhoInstantaneo = 0;
+			for (int k = 0; k < quantidadeSoquetes; k++) {
+				instantaneo[tamanhoInstantaneo++] = &dadosEnviados[k];
+			}
 			for(auto iter = hash->begin(); iter != hash->end(); iter++) {
 				// Se iter não é vazio: begin() retorna um objeto vazio no inicio por algum motivo
 				if (iter != 0) {
-					if((prioridadeAtual() > iter->object()->prioridade) && iter->object()->podeDesligar) { // Outras tomadas que têm prioridade abaixo da minha prioridade e que podem ser desligadas
-						consumoInferiores += iter->object()->consumoPrevisto;
-					} else if ((prioridadeAtual() == iter->object()->prioridade) && iter->object()->podeDesligar) { // Outras tomadas com a mesma prioridade e que podem ser desligadas.
-						outrasComMesmaPrioridade = true;
-						consumoMesmaPioridade += iter->object()->consumoPrevisto;
-						if (consumoProprioPrevisto > iter->object()->consumoPrevisto) { // Tomadas cujo consumo é menor.
-							menorConsumoMesmaPrioridade += iter->object()->consumoPrevisto;
+					Dados* d = iter->object();
+					if ((d->epoca == epocaAtual) && (tamanhoInstantaneo < NUMERO_MAXIMO_TOMADAS)) {
+						instantaneo[tamanhoInstantaneo++] = d;
+						if (d->resumo == dadosEnviados[0].resumo) {
+							concordam++;
 						}
 					}
 				}
 			}
+			resumoInstantaneo = PlanejadorDeCorte::ordenar(instantaneo, tamanhoInstantaneo);
 
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_INFO>(EVENTO_PLANO, (int) epocaAtual, tamanhoInstantaneo, (int) resumoInstantaneo, concordam, tamanhoInstantaneo - quantidadeSoquetes);
+		}
 
-			diferencaConsumo = consumoTotalPrevisto - consumoInferiores;
-			if (diferencaConsumo <= consumoRestante) { // Se desligando as tomadas com prioridade inferior o consumo já fica dentro do limite.
-				cout << "   Desligando as tomadas de prioridade inferior o consumo fica abaixo do maximo. Posso ficar ligada." << endl;
-				// Liga a tomada.
-				if (tomada->getTipo() == 2) {
-					cout << "    Dimerizo para 100%." << endl;
-					static_cast<TomadaMulti*>(tomada)->setDimerizacao(1);
-				}
-				tomada->ligar();
-			} else { // Se mesmo desligando as tomadas com prioridade inferior o consumo ainda está abaixo do limite
-				cout << "   Desligando as tomadas de prioridade inferior o consumo ainda fica acima do maximo. Sou uma candidata a ser desligada." << endl;
-				if (outrasComMesmaPrioridade) { // Se há tomadas com a mesma prioridade.
-					// Se desligando as tomadas de mesmo consumo completamente o consumo fica abaixo do necessário para o consumo máximo ser mantido
-					cout << "    Ha outras tomadas de mesma prioridade, talvez nao precise desligar." << endl;
-					if ((diferencaConsumo - consumoMesmaPioridade) < consumoRestante) {
-						// Nesse caso, desligando apenas algumas tomadas de mesma prioridade que essa o consumo ainda pode ser mantido abaixo do limite
-						// Aqui, as tomadas com consumo menor são as escolhidas para desligamento
-						if ((diferencaConsumo - menorConsumoMesmaPrioridade)  <= consumoRestante) { // Se desligando as tomadas com mesma prioridade mas consumo menor é o suficiente para manter o limite de consumo
-							cout << "     Desligando as outras tomadas de mesma prioridade e que consomem menos o consumo fica abaixo do maximo, posso ligar." << endl;
-							// Essa tomada pode ser ligada
-							if (tomada->getTipo() == 2) {
-								cout << "      Dimerizo para 100%." << endl;
-								static_cast<TomadaMulti*>(tomada)->setDimerizacao(1);
-							}
-							tomada->ligar();
-						} else { //Tomada é desligada ou dimerizada
-							cout << "     Mesmo desligando todas as tomadas de mesma prioridade e que consomem menos, o consumo ainda fica acima do maximo, devo desligar." << endl;
-							tomada->desligar();
-							if ((diferencaConsumo - menorConsumoMesmaPrioridade - consumoProprioPrevisto)  <= consumoRestante && tomada->getTipo() == 2) {
-								// Se pode dimerizar
-								sobraDeConsumo = consumoRestante - (diferencaConsumo - menorConsumoMesmaPrioridade - consumoProprioPrevisto);
-								tomada->ligar();
-								static_cast<TomadaMulti*>(tomada)->dimerizar(consumoProprioPrevisto, sobraDeConsumo);
-								cout << "      Dimerizo para " << (static_cast<TomadaMulti*>(tomada)->getPorcentagem()*100) << "%." << endl;
-							} else {
-								cout << "      Desligo." << endl;
-								tomada->desligar();
-							}
-						}
+		/*!
+			Método que aplica a cada soquete a sua entrada no plano de corte, para manter o consumo mensal dentro do consumo máximo.
+			Todas as tomadas com a mesma visão calculam o mesmo plano, então tomadas de mesma prioridade não decidem de forma conflitante.
+			\sa montarInstantaneo(), PlanejadorDeCorte
+		*/
+		void mantemConsumoDentroDoLimite() {
+			Decisao decisoes[NUMERO_SOQUETES];
+			PlanejadorDeCorte::planejar(instantaneo, tamanhoInstantaneo, dadosEnviados[0].remetente, decisoes, quantidadeSoquetes);
+			aplicarDecisoes(decisoes);
+		}
 
-					} else { // Se mesmo desligando todas as tomadas de mesma prioridade o consumo ainda estiver acima do limite, não há o que fazer, apenas desligar.
-						cout << "     Mesmo desligando todas as tomadas de mesma prioridade, o consumo ainda fica acima do maximo, devo desligar." << endl;
-						tomada->desligar();
-					}
-				} else { // Se não há outras tomadas com a mesma prioridade.
-					 // Se desligando a tomada completamente o consumo fica abaixo do necessário para o consumo máximo ser mantido e a tomada tem dimmer
-					cout << "    Nao ha outras tomadas de mesma prioridade, devo ser desligada." << endl;
-					if ((diferencaConsumo - consumoProprioPrevisto) < consumoRestante && tomada->getTipo() == 2) {
-						sobraDeConsumo = consumoRestante - (diferencaConsumo - consumoProprioPrevisto);
-						tomada->ligar();
-						static_cast<TomadaMulti*>(tomada)->dimerizar(consumoProprioPrevisto, sobraDeConsumo);
-						cout << "     Dimerizo para " << (static_cast<TomadaMulti*>(tomada)->getPorcentagem()*100) << "%." << endl;
-					} else { // Se não tem dimmer
-						cout << "     Desligo." << endl;
-						tomada->desligar();
+		/*!
+			Método que verifica, entre sincronizações, se a previsão do sistema passou do limite. Se passou, envia um alerta e refaz a decisão.
+			A previsão de cada soquete passa a ser a maior entre a da última sincronização e a obtida mantendo o consumo da última amostra até o fim do mês.
+			O aumento de todos os soquetes vai em um único alerta, atribuído ao soquete que mais aumentou.
+			\param amostra é o consumo de cada soquete na última amostra, ou 0 se apenas o limite mudou.
+		*/
+		void verificarExcesso(const AmostraDeConsumo* amostra) {
+			if (!dentroDoLimite || sincronizando) { // O excesso já é conhecido desde a última decisão, ou a decisão será refeita ao fim da sincronização.
+				return;
+			}
+			float aumento = 0;
+			float maiorAumento = 0;
+			int soquete = 0;
+			if (amostra != 0) {
+				for (int k = 0; k < quantidadeSoquetes; k++) {
+					float previstoPelaAmostra = amostra->consumo[k] * quantidadeDeEpocas * ((MIN_POR_EPOCA * 60) / SEGS_ENTRE_CONSUMO);
+					float aumentoSoquete = previstoPelaAmostra - soquetes.consumoPrevisto[k];
+					if (aumentoSoquete > 0) {
+						aumento += aumentoSoquete;
+						if (aumentoSoquete > maiorAumento) {
+							maiorAumento = aumentoSoquete;
+							soquete = k;
+						}
 					}
 				}
 			}
+			float projecao = consumoMensal + consumoProprio + consumoTotalPrevisto + aumento;
+			if (projecao <= maximoConsumoMensal) {
+				return;
+			}
+
+			RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_ALERTA_ENVIADO, (int) projecao);
+			MensagemAlerta msg;
+			memset(&msg, 0, sizeof msg);
+			msg.instanteDeteccao = relogio->agora();
+			msg.soquete = soquete;
+			msg.prioridade = prioridadeAtual(soquete);
+			msg.podeDesligar = podeDesligarAtual(soquete);
+			msg.consumoPrevistoAnterior = soquetes.consumoPrevisto[soquete];
+			msg.consumoPrevisto = soquetes.consumoPrevisto[soquete] + aumento;
+			msg.maximoConsumoMensal = maximoConsumoMensal;
+			msg.motivo = ALERTA_EXCESSO_PREVISTO;
+			msg.potencia = 0;
+			alerta->enviar(&msg);
+			reagirAlerta(msg);
 		}
 
 		/*!
-			Método que calcula a quantidade de sincronizações que devem ser feitas até o fim do mês. O valor é armazenado na variável global quantidadeDeSincs.
-			\sa diasRestantes()
+			Método que refaz a decisão com os dados já conhecidos, atualizados pela nova previsão da origem do alerta.
+			Fora do modo AGREGACAO_DIRETA, um limite menor da origem vale só nesta decisão: o limite configurado na placa não muda.
+			\param msg é o alerta, recebido ou enviado pela própria tomada.
 		*/
-		void calculaQuantidadeDeSincs() {
-			Data data = relogio->getData();
-
-			// Obtem o número de sincronizações restantes até o fim do mês, contando que o dia de hoje já acabou.
-			quantidadeDeSincs = diasRestantes() * ((24 * 60) / MIN_ENTRE_SINC);
+		void reagirAlerta(const MensagemAlerta& msg) {
+			dentroDoLimite = false;
+			if (sincronizando) { // A decisão será refeita ao fim da sincronização, com os dados novos.
+				return;
+			}
+			float diferenca = msg.consumoPrevisto - msg.consumoPrevistoAnterior;
+			consumoTotalPrevisto += diferenca;
+			float limite = maximoConsumoMensal;
+
+			if (modoAgregacao == AGREGACAO_DIRETA) {
+				Dados* origem = 0;
+				Hash_Element* encontrado = 0;
+				if (msg.origem == dadosEnviados[0].remetente) {
+					if ((msg.soquete >= 0) && (msg.soquete < quantidadeSoquetes)) {
+						origem = &dadosEnviados[msg.soquete];
+						soquetes.consumoPrevisto[msg.soquete] = msg.consumoPrevisto;
+						consumoProprioPrevisto += diferenca;
+					}
+				} else {
+					encontrado = buscarTomada(msg.origem, msg.soquete);
+					if (encontrado != 0) {
+						origem = encontrado->object();
+					}
+				}
+				if (origem != 0) {
+					origem->consumoPrevisto = msg.consumoPrevisto;
+					origem->maximoConsumoMensal = msg.maximoConsumoMensal;
+				}
+				if (encontrado != 0) {
+					pool.atualizarColunas(encontrado);
+				}
+			} else {
+				// Sem a tabela completa, a nova previsão da origem é somada às somas do sistema.
+				agregadoSistema.consumoPrevisto += diferenca;
+				if (msg.podeDesligar) {
+					agregadoSistema.previstoDesligavel[PlanejadorDeCorte::nivelDaPrioridade(msg.prioridade)] += diferenca;
+				}
+				if (msg.maximoConsumoMensal < limite) {
+					limite = msg.maximoConsumoMensal;
+				}
+				temDecisaoCluster = false; // A decisão do chefe não considera o alerta.
+			}
+			administrarConsumo(limite);
 
-			// Obtem o número de sincronizações que já ocorreram hoje para subtrair do valor anterior.
-			quantidadeDeSincs -= (int) ((data.hora*60 + data.minuto) / MIN_ENTRE_SINC);
+			if ((msg.origem == dadosEnviados[0].remetente) || (msg.carimbo.valido && sincronizadorTempo->estaSincronizada())) {
+				alerta->registrarReacao(msg, relogio->agora());
+			}
 		}
 
 		/*!
-			Método que calcula quantos dias restam para o mês acabar.
-			\return Valor inteiro que indica quantos dias faltam para o fim do mês.
+			Método que aplica a cada soquete a decisão calculada pelo plano de corte.
+			\param decisoes é o estado que cada soquete deve assumir, indexado pelo soquete.
 		*/
-		int diasRestantes() {
-			Data data = relogio->getData();
-			int diaAtual = data.dia;
-			int diasNoMes = relogio->getDiasNoMes(data.mes, data.ano);
-			return (diasNoMes - diaAtual);
+		void aplicarDecisoes(const Decisao* decisoes) {
+			for (int k = 0; k < quantidadeSoquetes; k++) {
+				TomadaInteligente* tomada = tomadas[k];
+				Decisao decisao = decisoes[k];
+				soquetes.ligado[k] = decisao.ligada;
+				soquetes.dimerizacao[k] = decisao.dimerizacao;
+
+				if (!decisao.ligada) {
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_DESLIGADA, k);
+					tomada->desligar();
+				} else if (decisao.dimerizacao < 1) {
+					tomada->ligar();
+					static_cast<TomadaMulti*>(tomada)->setDimerizacao(decisao.dimerizacao);
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_DIMERIZADA, k, RegistroDeEventos::real(decisao.dimerizacao*100));
+				} else {
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_LIGADA, k);
+					if (tomada->getTipo() == 2) {
+						static_cast<TomadaMulti*>(tomada)->setDimerizacao(1);
+					}
+					tomada->ligar();
+				}
+			}
 		}
 
 		/*!
@@ -1311,69 +6917,17 @@ class Gerente {
 		}
 
 		/*!
-			Método que trata de alterações na configuração da tomada através de mensagens USB.
-			\return retorna um inteiro que representa qual comando foi executado.
+			Método que trata de alterações na configuração da tomada através de mensagens USB, lidas pela tarefa de comandos.
+			\return retorna um inteiro que representa o último comando executado.
 		*/
 		int configuracaoViaUSB() {
 			int comandoExecutado = 0;
-			if (temMsgUSB()) {
-				char strReceived[NUMERO_CHAR_CONFIG];
-				receberConfigViaUSB(strReceived);
+			LinhaDeComando linha;
+			while (filaComandos.retirar(&linha)) {
+				CapturaDeTrafego::comando(linha.texto);
 				// Reenvio é true pois mensagens recebidas por USB ainda não foram reenviadas.
-				comandoExecutado = processarComando(strReceived, true);
-			}
-			return comandoExecutado;
-		}
-
-		/*!
-			Método que verifica se há alguma mensagem de configuração sendo transmitida por USB.
-			\return Valor booleano que representa se hà uma mensagem via USB ou não.
-		*/
-		bool temMsgUSB() {
-			return USB::ready_to_get();
-		}
-
-		/*!
-			Método que recebe mensagens de configuração via USB.
-			\param receivedStr é o char* que irá receber a mensagem.
-		*/
-		void receberConfigViaUSB(char* receivedStr) {
-
-			// Para garantir que não vai ter lixo na mensagem.
-			for (int i; i < NUMERO_CHAR_CONFIG; i++) {
-				receivedStr[i] = '\0';
-			}
-
-			if (temMsgUSB()) {
-				int cont = 0;
-				while (temMsgUSB()) {
-					char c = USB::get();
-					receivedStr[cont] = c;
-					cont++;
-				}
-			} else {
-				receivedStr = "NOCON";
-			}
-		}
-
-		/*!
-			Método que trata de alterações na configuração da tomada através de mensagens recebidas via NIC.
-			\return retorna um inteiro que representa qual comando foi executado.
-		*/
-		int configuracaoViaNIC() {
-			int comandoExecutado = 0;
-			// Recebe mensagem.
-			Dados* dadosRecebidos = receberMensagem();
-
-			// Verifica se realmente é uma mensagem.
-			if (dadosRecebidos->configuracao[0] != '\0') {
-
-				// Processa comando.
-				// Reenvio é false pois mensagens recebidas por NIC ja são reenvio.
-				comandoExecutado = processarComando(dadosRecebidos->configuracao, false);
+				comandoExecutado = processarComando(linha.texto, true);
 			}
-
-			delete dadosRecebidos;
 			return comandoExecutado;
 		}
 
@@ -1398,13 +6952,16 @@ class Gerente {
 
 			char destinoDec[7];
 			mensageiro->converterEndereco(destinoHex, destinoDec);
-			Address* addDestino = new Address(destinoDec);
+			Address addDestino(destinoDec);
 			Address meuAdd = mensageiro->obterEnderecoNIC();
 
 			if (strcmp(destinoHex, "TODAS") == 0) {
 				souAlvo = true;
 				todos = true;
-			} else if ((strcmp(destinoHex, "PLACA") == 0) || (*addDestino == meuAdd)) {
+			} else if ((destinoHex[0] == 'G') && (destinoHex[1] == 'R') && (destinoHex[2] == 'P')) { // Todas as tomadas de um grupo de orçamento, por exemplo "GRP03 CONSUMO 50000".
+				souAlvo = (strToNum(destinoHex + 3) == mensageiro->getGrupo());
+				todos = true;
+			} else if ((strcmp(destinoHex, "PLACA") == 0) || (addDestino == meuAdd)) {
 				souAlvo = true;
 				todos = false;
 			} else {
@@ -1427,20 +6984,24 @@ class Gerente {
 					periodo[3] = '\0';
 
 					int prioridade = strToNum(comando+18);
+					int alvo = soqueteDoComando(comando+18);
 
-					if (prioridade > 0){
+					for (int k = 0; (k < quantidadeSoquetes) && (prioridade > 0); k++) {
+						if ((alvo != -1) && (alvo != k)) {
+							continue;
+						}
 						if (strcmp(periodo, "MAD") == 0) {
-							tomada->setPrioridadeMadrugada(prioridade);
+							tomadas[k]->setPrioridadeMadrugada(prioridade);
 						} else if (strcmp(periodo, "MAN") == 0) {
-							tomada->setPrioridadeManha(prioridade);
+							tomadas[k]->setPrioridadeManha(prioridade);
 						} else if (strcmp(periodo, "TAR") == 0) {
-							tomada->setPrioridadeTarde(prioridade);
+							tomadas[k]->setPrioridadeTarde(prioridade);
 						} else if (strcmp(periodo, "NOI") == 0) {
-							tomada->setPrioridadeNoite(prioridade);
+							tomadas[k]->setPrioridadeNoite(prioridade);
 						}
 					}
 
-					cout << "Prioridade alterada." << endl;
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_PRIORIDADE_ALTERADA);
 					comandoExecutado = 1;
 				} else if (strcmp(cmd, "DESLIGA") == 0) {
 					char periodo[3];
@@ -1462,17 +7023,24 @@ class Gerente {
 						valor = true;
 					}
 
-					if (strcmp(periodo, "MAD") == 0) {
-						tomada->setPodeDesligar(valor, 0);
-					} else if (strcmp(periodo, "MAN") == 0) {
-						tomada->setPodeDesligar(valor, 1);
-					} else if (strcmp(periodo, "TAR") == 0) {
-						tomada->setPodeDesligar(valor, 2);
-					} else if (strcmp(periodo, "NOI") == 0) {
-						tomada->setPodeDesligar(valor, 3);
+					int alvo = soqueteDoComando(comando+18);
+
+					for (int k = 0; k < quantidadeSoquetes; k++) {
+						if ((alvo != -1) && (alvo != k)) {
+							continue;
+						}
+						if (strcmp(periodo, "MAD") == 0) {
+							tomadas[k]->setPodeDesligar(valor, 0);
+						} else if (strcmp(periodo, "MAN") == 0) {
+							tomadas[k]->setPodeDesligar(valor, 1);
+						} else if (strcmp(periodo, "TAR") == 0) {
+							tomadas[k]->setPodeDesligar(valor, 2);
+						} else if (strcmp(periodo, "NOI") == 0) {
+							tomadas[k]->setPodeDesligar(valor, 3);
+						}
 					}
 
-					cout << "Permissao para desligar alterada." << endl;
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_PERMISSAO_ALTERADA);
 					comandoExecutado = 2;
 				} else if (strcmp(cmd, "RELOGIO") == 0) {
 
@@ -1523,17 +7091,165 @@ class Gerente {
 					novaData.microssegundos = 0;
 
 					relogio->setData(novaData);
+					calendario->reiniciar();
+					sincronizadorTempo->reiniciar();
 
-					cout << "Relogio alterado" << endl;
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_RELOGIO_ALTERADO);
 					comandoExecutado = 3;
+				} else if (strcmp(cmd, "AGREGAC") == 0) {
+					char modo[4];
+					for (int i = 0; i < 3; i++) {
+						modo[i] = comando[i+14];
+					}
+					modo[3] = '\0';
+
+					if (strcmp(modo, "GOS") == 0) {
+						modoAgregacao = AGREGACAO_GOSSIP;
+					} else if (strcmp(modo, "DIR") == 0) {
+						modoAgregacao = AGREGACAO_DIRETA;
+					} else if (strcmp(modo, "HIE") == 0) {
+						modoAgregacao = AGREGACAO_HIERARQUICA;
+					}
+
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_AGREGACAO_ALTERADA);
+					comandoExecutado = 5;
+				} else if (strcmp(cmd, "ESCUTAS") == 0) {
+					char* s = comando + 14;
+					int periodo = strToNum(s);
+
+					while ((*s != ' ') && (*s != '\0')) { // Para avançar o ponteiro até o próximo número.
+						s++;
+					}
+					int janela = (*s == ' ') ? strToNum(s + 1) : 0;
+
+					cicloRadio->configurar(periodo, janela);
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_CICLO_RADIO_ALTERADO);
+					comandoExecutado = 6;
 				} else if (strcmp(cmd, "CONSUMO") == 0) {
 					char* s = comando + 14;
 					long long int consumo = strToNum(s);
 					maximoConsumoMensal = (float) consumo;
-					cout << "Consumo maximo alterado" << endl;
+					adaptacao.esquecerPrevisao();
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_CONSUMO_MAXIMO_ALTERADO);
 					comandoExecutado = 4;
+				} else if (strcmp(cmd, "GATEWAY") == 0) {
+					char valor[4];
+					for (int i = 0; i < 3; i++) {
+						valor[i] = comando[i+14];
+					}
+					valor[3] = '\0';
+
+					gateway->setAtivo(strcmp(valor, "LIG") == 0);
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_GATEWAY_ALTERADO, gateway->getAtivo() ? 1 : 0);
+					comandoExecutado = 7;
+				} else if (strcmp(cmd, "HISTORI") == 0) { // Por exemplo, "PLACA HISTORI 0a:1b HOR 0", ou "PLACA HISTORI 0a:1b HOR 0 120 24" para retomar.
+					char alvoHex[6];
+					for (int i = 0; i < 5; i++) {
+						alvoHex[i] = comando[i+14];
+					}
+					alvoHex[5] = '\0';
+					char alvoDec[7];
+					mensageiro->converterEndereco(alvoHex, alvoDec);
+					Address alvo(alvoDec);
+
+					char camada[4];
+					for (int i = 0; i < 3; i++) {
+						camada[i] = comando[i+20];
+					}
+					camada[3] = '\0';
+
+					char* s = comando + 24;
+					int soquete = (int) strToNum(s);
+					unsigned long primeiro = 0;
+					unsigned long quantidade = 0;
+					while ((*s != ' ') && (*s != '\0')) { // Para avançar o ponteiro até o próximo número.
+						s++;
+					}
+					if (*s == ' ') {
+						s++;
+						primeiro = (unsigned long) strToNum(s);
+						while ((*s != ' ') && (*s != '\0')) {
+							s++;
+						}
+						if (*s == ' ') {
+							quantidade = (unsigned long) strToNum(s + 1);
+						}
+					}
+
+					if (strcmp(camada, "PER") == 0) {
+						consultaHistorico->iniciar(alvo, CAMADA_PERIODOS, soquete, primeiro, quantidade);
+						comandoExecutado = 8;
+					} else if (strcmp(camada, "HOR") == 0) {
+						consultaHistorico->iniciar(alvo, CAMADA_HORAS, soquete, primeiro, quantidade);
+						comandoExecutado = 8;
+					} else if (strcmp(camada, "DIA") == 0) {
+						consultaHistorico->iniciar(alvo, CAMADA_DIAS, soquete, primeiro, quantidade);
+						comandoExecutado = 8;
+					} else {
+						RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_COMANDO_INVALIDO);
+						comandoExecutado = -1;
+					}
+				} else if (strcmp(cmd, "GRUPOID") == 0) {
+					int novo = (int) strToNum(comando + 14);
+					if ((novo >= 0) && (novo < NUMERO_GRUPOS)) {
+						if (novo != mensageiro->getGrupo()) { // As tomadas do grupo anterior saem da tabela e das decisões.
+							mensageiro->setGrupo(novo);
+							esvaziarTabela();
+							agregador->esquecerVizinhos();
+							temDecisaoCluster = false;
+							soquetesDoGrupo = 0;
+						}
+						RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_GRUPO_ALTERADO, novo);
+						comandoExecutado = 9;
+					} else {
+						RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_COMANDO_INVALIDO);
+						comandoExecutado = -1;
+					}
+				} else if (strcmp(cmd, "POTENCI") == 0) { // Por exemplo, "PLACA POTENCI SOQ 80 S0", ou "GRP03 POTENCI GRP 250" para o grupo todo. 0 retira o limite.
+					char tipo[4];
+					for (int i = 0; i < 3; i++) {
+						tipo[i] = comando[i+14];
+					}
+					tipo[3] = '\0';
+
+					int porcentagem = (int) strToNum(comando + 18);
+					if (strcmp(tipo, "GRP") == 0) {
+						limitePotenciaGrupo = porcentagem;
+						atualizarLimitePlaca();
+					} else {
+						int alvo = soqueteDoComando(comando + 18);
+						for (int k = 0; k < quantidadeSoquetes; k++) {
+							if ((alvo == -1) || (alvo == k)) {
+								medidor->setLimiteSoquete(k, porcentagem);
+							}
+						}
+					}
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_LIMITE_POTENCIA_ALTERADO);
+					comandoExecutado = 10;
+				} else if (strcmp(cmd, "ADAPTAR") == 0) { // Por exemplo, "TODAS ADAPTAR SIN 5 80" (minutos entre sincronizações) ou "TODAS ADAPTAR REP 3 15" (envios por janela).
+					char tipo[4];
+					for (int i = 0; i < 3; i++) {
+						tipo[i] = comando[i+14];
+					}
+					tipo[3] = '\0';
+
+					char* s = comando + 18;
+					int minimo = (int) strToNum(s);
+					while ((*s != ' ') && (*s != '\0')) { // Para avançar o ponteiro até o próximo número.
+						s++;
+					}
+					int maximo = (*s == ' ') ? (int) strToNum(s + 1) : minimo;
+
+					if (strcmp(tipo, "SIN") == 0) {
+						adaptacao.configurarIntervalo(minimo / MIN_POR_EPOCA, maximo / MIN_POR_EPOCA);
+						mensageiro->setEpocasPropostas(adaptacao.getEpocasPropostas());
+					} else {
+						adaptacao.configurarRepeticoes(minimo, maximo);
+					}
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_ADAPTACAO_ALTERADA);
+					comandoExecutado = 11;
 				} else {
-					cout << "Comando invalido" << endl;
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_AVISO>(EVENTO_COMANDO_INVALIDO);
 					comandoExecutado = -1;
 				}
 
@@ -1542,19 +7258,31 @@ class Gerente {
 			//	Se a mensagem deve ser reenviada e o destinatário são todas as outras ou uma outra tomada.
 			if ((reenviar) && (todos || (!(souAlvo)))) {
 				Dados dadosEnviar;
+				memset(&dadosEnviar, 0, sizeof dadosEnviar); // Nenhum byte da pilha vai para o rádio (nem para a captura de tráfego).
 
 				dadosEnviar.remetente = mensageiro->obterEnderecoNIC();
+				dadosEnviar.soquete = -1;
 				dadosEnviar.consumoPrevisto = -1;
 				dadosEnviar.ultimoConsumo = -1;
 				dadosEnviar.prioridade = -1;
 				dadosEnviar.podeDesligar = -1;
+				dadosEnviar.temDimmer = false;
+				dadosEnviar.epoca = 0;
+				dadosEnviar.resumo = 0;
+				dadosEnviar.consumoMensal = -1;
+				dadosEnviar.maximoConsumoMensal = -1;
 
-				for (int i = 0; i < NUMERO_CHAR_CONFIG; i++) {
+				for (int i = 0; (i < NUMERO_CHAR_CONFIG - 1) && (comando[i] != '\0'); i++) {
 					dadosEnviar.configuracao[i] = comando[i];
 				}
-				dadosEnviar.configuracao[NUMERO_CHAR_CONFIG] = '\0';
+				dadosEnviar.configuracao[NUMERO_CHAR_CONFIG - 1] = '\0';
+
+				cicloRadio->enviarComando(dadosEnviar);
+			}
 
-				enviarMensagemBroadcast(dadosEnviar);
+			// Um limite menor configurado nesta tomada é verificado na hora, depois do comando ter sido repassado.
+			if ((comandoExecutado == 4) && reenviar) {
+				verificarExcesso(0);
 			}
 
 			return comandoExecutado;
@@ -1580,21 +7308,87 @@ class Gerente {
 		}
 
 		/*!
-			Método criado apenas para que a tomada imprima os dados contídos em seu banco de dados.
+			Método que lê o soquete opcional no fim dos comandos PRIORID, DESLIGA e POTENCI (por exemplo, "PLACA PRIORID MAD 5 S2").
+			\param valor é o ponteiro para o valor do comando.
+			\return Soquete indicado, ou -1 se o comando vale para todos os soquetes.
+		*/
+		int soqueteDoComando(char* valor) {
+			while ((*valor != ' ') && (*valor != '\0')) {
+				valor++;
+			}
+			if ((valor[0] == ' ') && (valor[1] == 'S')) {
+				return (int) strToNum(valor + 2);
+			}
+			return -1;
+		}
+
+		/*!
+			Método criado apenas para que a tomada registre os dados contídos em seu banco de dados. Só é compilado com NIVEL_REGISTRO_DEPURACAO.
 		*/
 		void printHash() {
+			if (NIVEL_REGISTRO < NIVEL_REGISTRO_DEPURACAO) {
+				return;
+			}
 			for(auto iter = hash->begin(); iter != hash->end(); iter++) {
 				if (iter != 0) {
 					Dados* d = iter->object();
-					cout << "   Placa " << d->remetente << ":" << endl;
-					cout << "    Consumo previsto: .. " << (long long int ) d->consumoPrevisto << endl;
-					cout << "    Ultimo consumo: .... " << d->ultimoConsumo << endl;
-					cout << "    Prioridade: ........ " << d->prioridade << endl;
+					RegistroDeEventos::registrar<NIVEL_REGISTRO_DEPURACAO>(EVENTO_TOMADA_DA_TABELA, RegistroDeEventos::endereco(d->remetente), d->soquete,
+						(int) d->consumoPrevisto, RegistroDeEventos::real(d->ultimoConsumo), d->prioridade);
 				}
 			}
 		}
 };
 
+//----------------------------------------------------------------------------
+//!  Struct RelatorioMemoria
+/*!
+	Bytes de RAM ocupados por cada subsistema do controlador, conhecidos em tempo de compilação.
+	O total é verificado contra ORCAMENTO_RAM na compilação e, depois da ligação, "nm -S -C --size-sort" mostra arenaGerente e arenaTomadas.
+*/
+struct RelatorioMemoria {
+	enum {
+		RADIO = sizeof(Mensageiro) + sizeof(CicloDeRadio) + sizeof(AdaptacaoDaSincronizacao) + sizeof(Alerta) + sizeof(ConsultaDeHistorico), /*!< Mensageiro, NIC, ciclo do rádio, adaptação da sincronização, alertas e consultas de histórico. */
+		COMANDOS = sizeof(LeitorUSB) + sizeof(GatewayUSB), /*!< Leitor e buffer dos comandos USB e fila do gateway. */
+		MEDICAO = sizeof(MedidorDeEnergia), /*!< Medidor de energia, seu buffer duplo e o gerador de sinal. */
+		RELOGIO = sizeof(Relogio) + sizeof(SincronizadorDeTempo) + sizeof(Chronometer), /*!< Relógio, sincronização de tempo e cronômetro da BaseDeTempo. */
+		TABELA = sizeof(Tabela) + sizeof(PoolDeTomadas), /*!< Hash e entradas da tabela. */
+		AGREGACAO = sizeof(Agregador) + sizeof(Cluster), /*!< Gossip e clusters. */
+		HISTORICO = sizeof(EstadoDosSoquetes), /*!< Histórico de consumo e estado dos soquetes. */
+		GERENTE = sizeof(Gerente), /*!< Gerente inteiro, incluindo os subsistemas acima. */
+		TOMADA = sizeof(TomadaMulti) * NUMERO_SOQUETES, /*!< Soquetes, do tamanho da maior tomada, incluindo o LED. */
+		PILHAS = 3 * TAMANHO_PILHA_TAREFA, /*!< Pilhas das tarefas do rádio, de amostragem e de comandos (alocadas pelo EPOS). */
+		REGISTRO = sizeof(EntradaDoRegistro) * TAMANHO_REGISTRO, /*!< Anel do registro de eventos. */
+		CAPTURA = CAPTURA_TRAFEGO ? TAMANHO_ANEL_CAPTURA : 0, /*!< Anel da captura de tráfego, só com CAPTURA_TRAFEGO. */
+		TOTAL = GERENTE + TOMADA + PILHAS + REGISTRO + sizeof(Chronometer) + CAPTURA /*!< Total do controlador. */
+	};
+
+	/*!
+		Método que imprime o relatório.
+	*/
+	static void imprimir() {
+		cout << "Memoria do controlador (bytes):" << endl;
+		cout << " Radio: ..... " << (int) RADIO << endl;
+		cout << " Comandos: .. " << (int) COMANDOS << endl;
+		cout << " Medicao: ... " << (int) MEDICAO << endl;
+		cout << " Relogio: ... " << (int) RELOGIO << endl;
+		cout << " Tabela: .... " << (int) TABELA << endl;
+		cout << " Agregacao: . " << (int) AGREGACAO << endl;
+		cout << " Historico: . " << (int) HISTORICO << endl;
+		cout << " Gerente: ... " << (int) GERENTE << endl;
+		cout << " Tomada: .... " << (int) TOMADA << endl;
+		cout << " Pilhas: .... " << (int) PILHAS << endl;
+		cout << " Registro: .. " << (int) REGISTRO << endl;
+		cout << " Captura: ... " << (int) CAPTURA << endl;
+		cout << " Total: ..... " << (int) TOTAL << " de " << ORCAMENTO_RAM << endl;
+	}
+};
+
+static_assert(RelatorioMemoria::TOTAL <= ORCAMENTO_RAM + RelatorioMemoria::CAPTURA, "Os objetos do controlador nao cabem em ORCAMENTO_RAM.");
+static_assert(NUMERO_SOQUETES <= NUMERO_MAXIMO_SOQUETES, "A placa tem mais soquetes do que cabem em uma MensagemRegua.");
+
+Estatico<TomadaInteligente> arenaTomadas[NUMERO_SOQUETES]; /*!< Espaço dos soquetes controlados. */
+Estatico<Gerente> arenaGerente; /*!< Espaço do gerente e de todos os seus objetos. */
+
 //----------------------------------------------------------------------------
 //!  Método Main
 /*!
@@ -1604,14 +7398,28 @@ int main() {
 
 	Alarm::delay(2*1000000);
 
-	TomadaInteligente* t = new TomadaInteligente();
-	Gerente* g = new Gerente(t);
-	t->setPrioridadeMadrugada(5);
-	t->setPrioridadeManha(5);
-	t->setPrioridadeTarde(5);
-	t->setPrioridadeNoite(5);
-
-	g->iniciar();
+	RelatorioMemoria::imprimir();
+	if (REPRODUCAO_TRAFEGO) {
+		Gerente::prepararReproducao();
+	}
+
+	TomadaInteligente* tomadas[NUMERO_SOQUETES];
+	for (int k = 0; k < NUMERO_SOQUETES; k++) {
+		tomadas[k] = arenaTomadas[k].construir();
+	}
+	Gerente* g = arenaGerente.construir(tomadas, NUMERO_SOQUETES);
+	for (int k = 0; k < NUMERO_SOQUETES; k++) {
+		tomadas[k]->setPrioridadeMadrugada(5);
+		tomadas[k]->setPrioridadeManha(5);
+		tomadas[k]->setPrioridadeTarde(5);
+		tomadas[k]->setPrioridadeNoite(5);
+	}
+
+	if (REPRODUCAO_TRAFEGO) {
+		g->reproduzir();
+	} else {
+		g->iniciar();
+	}
 
 	while (true);
 };